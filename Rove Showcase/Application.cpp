@@ -82,14 +82,16 @@ Rove::Application::Application()
 	m_Window = std::make_unique<Rove::Window>(this);
 	m_DxRenderer = std::make_unique<Rove::DxRenderer>(m_Window.get());
 	m_DxShader = std::make_unique<Rove::DxShader>(m_DxRenderer.get());
+	m_JobSystem = std::make_unique<Rove::JobSystem>();
+	m_LightClusters = std::make_unique<Rove::LightClusters>(m_JobSystem.get());
 
 	// Default light
-	auto light = std::make_unique<Rove::PointLight>();
-	light->Position = DirectX::XMFLOAT3(5.0f, 8.0f, -10.0f);
-	light->DiffuseColour = DirectX::XMFLOAT4(0.785f, 0.785f, 0.785f, 1.0f);
-	light->AmbientColour = DirectX::XMFLOAT4(0.3925f, 0.3925f, 0.3925f, 1.0f);
-	light->SpecularColour = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-	m_PointLights.push_back(std::move(light));
+	Rove::PointLight light;
+	light.Position = DirectX::XMFLOAT3(5.0f, 8.0f, -10.0f);
+	light.DiffuseColour = DirectX::XMFLOAT4(0.785f, 0.785f, 0.785f, 1.0f);
+	light.AmbientColour = DirectX::XMFLOAT4(0.3925f, 0.3925f, 0.3925f, 1.0f);
+	light.SpecularColour = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+	m_Lights.Add(light);
 
 	// Set colour
 	auto colour = DirectX::Colors::SteelBlue;
@@ -109,6 +111,10 @@ Rove::Application::~Application()
 
 int Rove::Application::Run()
 {
+#if ROVE_PROFILER
+	Rove::Profiler::Get().SetThreadName("Main");
+#endif
+
 	Create();
 	m_Window->Show();
 
@@ -116,7 +122,7 @@ int Rove::Application::Run()
 	m_Timer = std::make_unique<Rove::Timer>();
 	m_Timer->Start();
 
-	m_Object->LoadFile("D:\\GLTF Models\\double_crate.gltf");
+	m_SelectedObject = m_Scene->AddObject("D:\\GLTF Models\\double_crate.gltf");
 
 	// Main loop
 	MSG msg = {};
@@ -130,6 +136,10 @@ int Rove::Application::Run()
 		else
 		{
 			m_Timer->Tick();
+			Rove::Profiler::Get().MarkFrame();
+			Rove::MemoryTracker::Get().Update();
+			m_TraceCapture.EndFrame();
+			m_HitchDetector.EndFrame();
 			CalculateFramesPerSecond();
 
 			// Start rendering into Dear ImGui
@@ -137,6 +147,9 @@ int Rove::Application::Run()
 			ImGui_ImplWin32_NewFrame();
 			ImGui::NewFrame();
 
+			// Dear ImGui binds its own state without the cache, start each frame with nothing assumed bound
+			m_DxRenderer->GetStateCache()->BeginFrame();
+
 			// Clear backbuffer
 			m_DxRenderer->Clear(m_BackgroundColour);
 
@@ -150,6 +163,12 @@ int Rove::Application::Run()
 				m_DxRenderer->SetRenderToBackBuffer();
 			}
 
+			// Upload the changed lights and assign them to the clusters of the view before the shader binds them
+			{
+				ROVE_PROFILE_ZONE("Update lights");
+				UpdateLights();
+			}
+
 			// Apply shader
 			m_DxShader->Apply();
 
@@ -159,18 +178,44 @@ int Rove::Application::Run()
 				m_DxRenderer->SetWireframeRasterState();
 			}
 
-			// Render model
-			m_Object->Render();
+			// Render scene
+			m_Scene->Cull(*m_Camera);
+			m_Scene->Render(*m_Camera);
+
+			// Counters of the frame for trace captures and hitch reports
+			const Rove::RenderStats& render_stats = m_Scene->GetRenderStats();
+			uint64_t uploaded_bytes = m_DxShader->GetUploadedBytes();
+			ROVE_PROFILE_COUNTER("Draws", render_stats.draw_count);
+			ROVE_PROFILE_COUNTER("Triangles", render_stats.triangle_count);
+			ROVE_PROFILE_COUNTER("Vertices", render_stats.vertex_count);
+			ROVE_PROFILE_COUNTER("Buffer binds", render_stats.buffer_binds);
+			ROVE_PROFILE_COUNTER("Resource binds", render_stats.resource_binds);
+			ROVE_PROFILE_COUNTER("Constant bytes", render_stats.constant_bytes);
+			ROVE_PROFILE_COUNTER("Upload bytes", uploaded_bytes - m_UploadedBytes);
+
+			const Rove::CullingStats& culling_stats = m_Scene->GetCullingStats();
+			ROVE_PROFILE_COUNTER("Culled models", culling_stats.total_models - culling_stats.visible_models);
+			m_UploadedBytes = uploaded_bytes;
+
+			if (m_RecordCameraPath)
+			{
+				int width, height;
+				m_Window->GetSize(&width, &height);
+				m_CameraPath.Record(*m_Camera, width, height);
+			}
 
 			// Enable solid rendering
 			m_DxRenderer->SetSolidRasterState();
 
 			// Render ImGui windows
-			RenderGui();
+			{
+				ROVE_PROFILE_ZONE("ImGui");
+				RenderGui();
 
-			// Render Dear ImGui
-			ImGui::Render();
-			ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+				// Render Dear ImGui
+				ImGui::Render();
+				ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+			}
 
 			if (m_EnableMsaa)
 			{
@@ -178,7 +223,10 @@ int Rove::Application::Run()
 			}
 
 			// Present backbuffer to screen
-			m_DxRenderer->Present(m_EnableVSync);
+			{
+				ROVE_PROFILE_ZONE("Present");
+				m_DxRenderer->Present(m_EnableVSync);
+			}
 		}
 	}
 
@@ -221,15 +269,46 @@ void Rove::Application::OnMousePressed(int mouse_x, int mouse_y, int key_modifie
 		m_MousePressedX = mouse_x;
 		m_MousePressedY = mouse_y;
 	}
+
+	// Select the model under the cursor unless the click landed on a Dear ImGui window
+	if ((key_modifier & MK_LBUTTON) && !ImGui::GetIO().WantCaptureMouse)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		m_PickFound = Pick(mouse_x, mouse_y, m_PickHit);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		m_PickMicroseconds = std::chrono::duration<double, std::micro>(end - start).count();
+		if (m_PickFound)
+		{
+			m_SelectedObject = m_PickHit.object;
+		}
+	}
 }
 
 void Rove::Application::OnMouseReleased(int mouse_x, int mouse_y, int key_modifier)
 {
 }
 
+bool Rove::Application::Pick(int mouse_x, int mouse_y, RaycastHit& hit)
+{
+	int width, height;
+	m_Window->GetSize(&width, &height);
+
+	DirectX::XMFLOAT3 origin, direction;
+	m_Camera->CalculateRay(mouse_x, mouse_y, width, height, &origin, &direction);
+
+	return m_Scene->Raycast(origin, direction, FLT_MAX, hit);
+}
+
 void Rove::Application::SetupDearImGui()
 {
 	IMGUI_CHECKVERSION();
+
+	// Dear ImGui and ImPlot allocate through the allocator of their tag
+	auto allocate = [](size_t size, void* allocator) { return static_cast<Allocator*>(allocator)->Allocate(size); };
+	auto release = [](void* memory, void* allocator) { static_cast<Allocator*>(allocator)->Free(memory); };
+	ImGui::SetAllocatorFunctions(allocate, release, &TaggedAllocator::Get(MemoryTag::ImGui));
+
 	ImGui::CreateContext();
 	ImPlot::CreateContext();
 	ImGuiIO& io = ImGui::GetIO();
@@ -262,6 +341,8 @@ void Rove::Application::UpdateCamera()
 
 void Rove::Application::Create()
 {
+	ROVE_PROFILE_ZONE("Create");
+
 	// Create window
 	m_Window->Create(L"Rove Showcase");
 
@@ -274,16 +355,14 @@ void Rove::Application::Create()
 	m_Window->GetSize(&width, &height);
 	m_Camera = std::make_unique<Rove::Camera>(width, height);
 
-	// Model
-	m_Object = std::make_unique<Rove::Object>(m_DxRenderer.get(), m_DxShader.get());
+	// Scene
+	m_Scene = std::make_unique<Rove::Scene>(m_DxRenderer.get(), m_DxShader.get(), m_JobSystem.get());
+	m_Scene->SetLights(&m_Lights);
 
 	UpdateCamera();
 
 	// Dear ImGui
 	SetupDearImGui();
-
-	// Update buffers
-	UpdateLightBuffer();
 }
 
 void Rove::Application::MenuItem_Load()
@@ -293,7 +372,15 @@ void Rove::Application::MenuItem_Load()
 	{
 		try
 		{
-			m_Object->LoadFile(filepath);
+			m_Scene->Clear();
+			m_SelectedObject = nullptr;
+			m_PickFound = false;
+			m_SelectedObject = m_Scene->AddObject(filepath);
+
+			if (m_Scene->EnablePrecomputedVisibility)
+			{
+				m_Scene->BuildVisibilitySets(*m_Camera);
+			}
 		}
 		catch (std::exception& e)
 		{
@@ -304,28 +391,70 @@ void Rove::Application::MenuItem_Load()
 	}
 }
 
-void Rove::Application::UpdateLightBuffer()
+void Rove::Application::MenuItem_Add()
 {
-	// Update light buffer
-	Rove::PointLightBuffer light_buffer = {};
+	std::wstring filepath;
+	if (OpenFileDialog(filepath, m_Window->GetHwnd()))
+	{
+		try
+		{
+			m_SelectedObject = m_Scene->AddObject(filepath);
+
+			if (m_Scene->EnablePrecomputedVisibility)
+			{
+				m_Scene->BuildVisibilitySets(*m_Camera);
+			}
+		}
+		catch (std::exception& e)
+		{
+			CoUninitialize();
+			std::wstring error = Rove::ConvertToWideString(e.what());
+			MessageBox(NULL, error.c_str(), L"Error", MB_OK | MB_ICONERROR);
+		}
+	}
+}
+
+void Rove::Application::UpdateLights()
+{
+	m_DxShader->UpdatePointLights(m_Lights);
+
+	int width, height;
+	m_Window->GetSize(&width, &height);
 
-	light_buffer.lightCount = static_cast<int>(m_PointLights.size());
-	for (int i = 0; i < m_PointLights.size(); ++i)
+	// The scene builds a light list for each draw instead
+	if (m_Scene->EnablePerObjectLights)
 	{
-		light_buffer.pointLight[i] = Rove::PointLightStruct();
-		light_buffer.pointLight[i].position = m_PointLights[i]->Position;
-		light_buffer.pointLight[i].diffuse = m_PointLights[i]->DiffuseColour;
-		light_buffer.pointLight[i].ambient = m_PointLights[i]->AmbientColour;
-		light_buffer.pointLight[i].specular = m_PointLights[i]->SpecularColour;
+		m_DxShader->UpdateLightClusters(nullptr, width, height);
+		return;
 	}
 
-	m_DxShader->UpdatePointLightBuffer(light_buffer);
+	m_LightClusters->SetProjection(DirectX::XMConvertToRadians(m_Camera->GetFieldOfView()), m_Camera->GetAspectRatio(), Rove::Camera::NEAR_PLANE, Rove::Camera::FAR_PLANE);
+	m_LightClusters->Build(m_Camera->GetView(), m_Lights.GetSpheres(), m_Lights.Size());
+	m_DxShader->UpdateLightClusters(m_LightClusters.get(), width, height);
+}
+
+void Rove::Application::AddRandomLights(int count)
+{
+	static std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-20.0f, 20.0f);
+	std::uniform_real_distribution<float> radius(2.0f, 6.0f);
+	std::uniform_real_distribution<float> colour(0.2f, 1.0f);
+
+	for (int i = 0; i < count; ++i)
+	{
+		Rove::PointLight light;
+		light.Position = DirectX::XMFLOAT3(position(random), position(random), position(random));
+		light.Radius = radius(random);
+		light.DiffuseColour = DirectX::XMFLOAT4(colour(random), colour(random), colour(random), 1.0f);
+		light.AmbientColour = DirectX::XMFLOAT4(light.DiffuseColour.x * 0.05f, light.DiffuseColour.y * 0.05f, light.DiffuseColour.z * 0.05f, 1.0f);
+		light.SpecularColour = light.DiffuseColour;
+		m_Lights.Add(light);
+	}
 }
 
 void Rove::Application::CalculateFramesPerSecond()
 {
-	// Consider using a third-party library such as ImPlot: https://github.com/epezent/implot
-	// (see others https://github.com/ocornut/imgui/wiki/Useful-Extensions)
+	m_FrameTimes.Add(m_Timer->DeltaTime() * 1000.0);
 
 	static double time = 0;
 	static int frameCount = 0;
@@ -377,6 +506,121 @@ void Rove::Application::RenderGui()
 			std::string fps = "FPS: " + std::to_string(m_FramesPerSecond);
 			ImGui::Text(fps.c_str());
 
+			// Frame times of the last frames, the averaged FPS hides single slow frames
+			Rove::FrameTimeSummary frame_times = m_FrameTimes.GetSummary();
+			ImGui::Text("Frame time: p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms", frame_times.p50, frame_times.p95, frame_times.p99, frame_times.max);
+
+			float budget = static_cast<float>(m_FrameTimes.GetBudget());
+			if (ImGui::SliderFloat("Frame budget (ms)", &budget, 1.0f, 100.0f, "%.1f"))
+			{
+				m_FrameTimes.SetBudget(budget);
+			}
+
+			ImGui::Text("Stutters: %i in the last %zu frames, %lld in total", frame_times.stutters, frame_times.count, static_cast<long long>(frame_times.total_stutters));
+
+			int frame_count = static_cast<int>(m_FrameTimes.Size());
+			if (ImPlot::BeginPlot("Frame times", ImVec2(-1, 150), ImPlotFlags_NoLegend))
+			{
+				ImPlot::SetupAxes("frame", "ms", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+				ImPlot::PlotLine("Frame time", m_FrameTimes.GetData(), frame_count, 1.0, 0.0, static_cast<int>(m_FrameTimes.GetOffset()));
+				ImPlot::PlotHLines("Budget", &budget, 1);
+				ImPlot::EndPlot();
+			}
+
+			if (ImPlot::BeginPlot("Frame time histogram", ImVec2(-1, 150), ImPlotFlags_NoLegend))
+			{
+				ImPlot::SetupAxes("ms", "frames", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+				ImPlot::PlotHistogram("Frames", m_FrameTimes.GetData(), frame_count, 100, false, false, ImPlotRange(0.0, std::max(frame_times.max, 1.0)));
+				ImPlot::EndPlot();
+			}
+
+			// Frustum culling
+			const Rove::CullingStats& culling = m_Scene->GetCullingStats();
+			ImGui::Text("Visible models: %i / %i, %i culled", culling.visible_models, culling.total_models, culling.total_models - culling.visible_models);
+			ImGui::Text("Culling: %.1f us", culling.culling_microseconds);
+
+			// Occlusion culling
+			ImGui::Checkbox("Occlusion culling", &m_Scene->EnableOcclusionCulling);
+			ImGui::Text("Occluded models: %i", culling.occluded_models);
+			ImGui::Text("Occluders: %i (%i triangles)", culling.occluder_count, culling.occluder_triangles);
+			ImGui::Text("Occlusion: %.1f us", culling.occlusion_microseconds);
+
+			// Render queue
+			const Rove::RenderStats& render = m_Scene->GetRenderStats();
+			ImGui::Checkbox("Sort draws", &m_Scene->EnableDrawSorting);
+			ImGui::Checkbox("Instancing", &m_Scene->EnableInstancing);
+			ImGui::Text("Draws: %i for %i models, %i instanced, %lld triangles", render.draw_count, render.model_count, render.instanced_draws, static_cast<long long>(render.triangle_count));
+			ImGui::Text("Vertices: %lld", static_cast<long long>(render.vertex_count));
+			ImGui::Text("Binds: %i buffers, %i shader resources, %.1f KB constants", render.buffer_binds, render.resource_binds, render.constant_bytes / 1024.0);
+			ImGui::Text("Instances: %i / %i visible", render.visible_instances, render.total_instances);
+			ImGui::Checkbox("Static batching", &m_Scene->EnableStaticBatching);
+			ImGui::Text("Static batching: %i models in %i draws", render.batched_models, render.static_batches);
+
+			// Geometry pool
+			Rove::GeometryPoolStats geometry = m_Scene->GetGeometryPool().GetStats();
+			ImGui::Text("Geometry: %i buffers, %.1f / %.1f MB, %zu free ranges", geometry.buffer_count, geometry.used_bytes / (1024.0 * 1024.0), geometry.capacity_bytes / (1024.0 * 1024.0), geometry.free_ranges);
+			ImGui::Text("State changes: %i unsorted, %i submitted", render.unsorted_state_changes, render.state_changes);
+
+			// Bindings sent to and dropped by the state cache last frame
+			const Rove::StateCacheStats& state_cache = m_DxRenderer->GetStateCache()->GetFrameStats();
+			ImGui::Text("State cache: %i issued, %i filtered", state_cache.issued, state_cache.filtered);
+			ImGui::Text("Sort: %.1f us", render.sort_microseconds);
+			ImGui::Checkbox("Deferred contexts", &m_Scene->EnableDeferredContexts);
+			ImGui::Text("Record: %.1f us in %i buffers", render.record_microseconds, render.command_buffers);
+
+			// Lights assigned to the clusters of the view or to each draw this frame
+			ImGui::Checkbox("Per object lights", &m_Scene->EnablePerObjectLights);
+			ImGui::Text("Object lights: %i in %i lists, %i truncated, %.1f us", render.object_lights, render.light_lists, render.truncated_light_lists, render.light_assign_microseconds);
+			const Rove::LightClusterStats& clusters = m_LightClusters->GetStats();
+			ImGui::Text("Light clusters: %i / %i lights, %zu indices, max %i per cluster, %.1f us", clusters.visible_lights, clusters.light_count, clusters.index_count, clusters.max_cluster_lights, clusters.build_microseconds);
+
+			// Shader variants selected from the materials and where their bytecode came from
+			ImGui::Checkbox("Shader permutations", &m_Scene->EnableShaderPermutations);
+			const Rove::ShaderCacheStats& shader_cache = m_DxShader->GetShaderCacheStats();
+			ImGui::Text("Shader variants: %zu, %i compiled, %i from disk, %i failed", m_DxShader->GetVariantCount(), shader_cache.compiles, shader_cache.disk_hits, shader_cache.failures);
+			if (!shader_cache.last_error.empty())
+			{
+				ImGui::TextWrapped("Last shader error: %s", shader_cache.last_error.c_str());
+			}
+
+			// World constant updates
+			const Rove::TransformStats& transforms = m_Scene->GetTransformStats();
+			ImGui::Text("Transforms: %i objects, %i models, %.1f us", transforms.updated_objects, transforms.updated_models, transforms.update_microseconds);
+
+			// Precomputed visibility
+			ImGui::Checkbox("Precomputed visibility", &m_Scene->EnablePrecomputedVisibility);
+			ImGui::SameLine();
+			if (ImGui::Button("Build"))
+			{
+				m_Scene->BuildVisibilitySets(*m_Camera);
+			}
+
+			const Rove::PotentiallyVisibleSet& visibility = m_Scene->GetPotentiallyVisibleSet();
+			if (visibility.IsValid())
+			{
+				ImGui::Text("Visibility sets: %s", culling.precomputed_visibility ? "in use" : "field of view wider than the build");
+				ImGui::Text("Unique sets: %i / %i cells", static_cast<int>(visibility.GetUniqueSetCount()), Rove::PotentiallyVisibleSet::PITCH_CELLS * Rove::PotentiallyVisibleSet::YAW_CELLS);
+				ImGui::Text("Size: %.1f KB (%.1f KB uncompressed)", visibility.GetCompressedBytes() / 1024.0, visibility.GetUncompressedBytes() / 1024.0);
+				ImGui::Text("Build: %.1f ms", visibility.GetBuildMilliseconds());
+			}
+			else
+			{
+				ImGui::Text("Visibility sets: not built for this scene");
+			}
+
+			// Camera path for the headless occlusion test
+			if (ImGui::Checkbox("Record camera path", &m_RecordCameraPath))
+			{
+				if (m_RecordCameraPath)
+				{
+					m_CameraPath.Clear();
+				}
+				else
+				{
+					m_CameraPath.Save("camera_path.txt");
+				}
+			}
+
 			ImGui::Checkbox("MSAA", &m_EnableMsaa);
 			ImGui::Checkbox("V-Sync", &m_EnableVSync);
 			ImGui::Checkbox("Enable Wireframe", &m_RenderWireframe);
@@ -411,16 +655,66 @@ void Rove::Application::RenderGui()
 	{
 		if (ImGui::Begin("Model", &m_ShowModelDetails, ImGuiWindowFlags_AlwaysAutoResize))
 		{
-			ImGui::Text(m_Object->Filename.c_str());
-			ImGui::DragFloat3("Position", reinterpret_cast<float*>(&m_Object->Position), 0.1f);
-			ImGui::DragFloat3("Rotation", reinterpret_cast<float*>(&m_Object->Rotation), 0.1f);
-			ImGui::DragFloat3("Scale", reinterpret_cast<float*>(&m_Object->Scale), 0.1f);
-
-			// Model details
-			for (auto& model : m_Object->GetModels())
+			// Object selection
+			const auto& objects = m_Scene->GetObjects();
+			if (objects.size() > 1)
 			{
+				for (int i = 0; i < objects.size(); ++i)
+				{
+					std::string label = objects[i]->Filename + "##" + std::to_string(i);
+					if (ImGui::Selectable(label.c_str(), objects[i].get() == m_SelectedObject))
+					{
+						m_SelectedObject = objects[i].get();
+					}
+				}
+
 				ImGui::Separator();
-				ImGui::Text(model->Name.c_str());
+			}
+
+			// Moving an object only refits its proxies in the scene's spatial index on the next frame
+			if (m_SelectedObject != nullptr)
+			{
+				ImGui::Text(m_SelectedObject->Filename.c_str());
+				ImGui::DragFloat3("Position", reinterpret_cast<float*>(&m_SelectedObject->Position), 0.1f);
+				ImGui::DragFloat3("Rotation", reinterpret_cast<float*>(&m_SelectedObject->Rotation), 0.1f);
+				ImGui::DragFloat3("Scale", reinterpret_cast<float*>(&m_SelectedObject->Scale), 0.1f);
+
+				// Model details
+				for (auto& model : m_SelectedObject->GetModels())
+				{
+					ImGui::Separator();
+					ImGui::Text(model->Name.c_str());
+
+					// Material values, editing them changes every model sharing the material
+					Rove::MaterialTable& materials = m_Scene->GetMaterialTable();
+					Rove::Material material = materials.Get(model->MaterialIndex);
+
+					ImGui::PushID(model.get());
+					ImGui::Text("Material: %u", model->MaterialIndex);
+					ImGui::Text("GPU memory: %.1f KB", model->EstimateGpuBytes() / 1024.0);
+					bool edited = ImGui::SliderFloat("Metallic", &material.metallicFactor, 0.0f, 1.0f);
+					edited |= ImGui::SliderFloat("Roughness", &material.roughnessFactor, 0.0f, 1.0f);
+					if (edited)
+					{
+						materials.Update(model->MaterialIndex, material);
+					}
+
+					ImGui::PopID();
+
+					// Last pick on this model
+					if (m_PickFound && m_PickHit.model == model.get())
+					{
+						ImGui::Text("Picked triangle: %u", m_PickHit.triangle);
+						ImGui::Text("Barycentrics: %.3f, %.3f, %.3f", m_PickHit.barycentric_u, m_PickHit.barycentric_v, m_PickHit.barycentric_w);
+						ImGui::Text("Hit: %.3f, %.3f, %.3f (distance %.3f)", m_PickHit.position.x, m_PickHit.position.y, m_PickHit.position.z, m_PickHit.distance);
+						ImGui::Text("Pick: %.1f us", m_PickMicroseconds);
+					}
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Model costs"))
+			{
+				RenderModelCosts();
 			}
 		}
 
@@ -441,44 +735,88 @@ void Rove::Application::RenderGui()
 
 			if (ImGui::Button("Add light"))
 			{
-				m_PointLights.push_back(std::make_unique<Rove::PointLight>());
+				m_SelectedLight = static_cast<int>(m_Lights.Add(Rove::PointLight()));
 			}
 
-			for (int i = 0; i < m_PointLights.size(); ++i)
+			ImGui::SameLine();
+			if (ImGui::Button("Add 1000 lights"))
 			{
-				const auto& point_light = m_PointLights[i];
+				AddRandomLights(1000);
+			}
 
-				float* light_position = reinterpret_cast<float*>(&point_light->Position);
+			// Only the rows in view are submitted so the list stays cheap with thousands of lights
+			ImGui::BeginChild("Light list", ImVec2(300.0f, 120.0f), true);
+			ImGuiListClipper clipper;
+			clipper.Begin(static_cast<int>(m_Lights.Size()));
+			while (clipper.Step())
+			{
+				for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+				{
+					if (ImGui::Selectable(("Light " + std::to_string(i)).c_str(), m_SelectedLight == i))
+					{
+						m_SelectedLight = i;
+					}
+				}
+			}
+			ImGui::EndChild();
+
+			// Each edit marks only the selected light for upload
+			if (m_SelectedLight >= 0 && m_SelectedLight < static_cast<int>(m_Lights.Size()))
+			{
+				uint32_t index = static_cast<uint32_t>(m_SelectedLight);
+				Rove::PointLight point_light = m_Lights.Get(index);
 
-				if (ImGui::DragFloat3(("Position##" + std::to_string(i)).c_str(), light_position))
+				if (ImGui::DragFloat3("Position", reinterpret_cast<float*>(&point_light.Position)))
 				{
-					UpdateLightBuffer();
+					m_Lights.SetPosition(index, point_light.Position);
 				}
 
-				float* light_diffuse = reinterpret_cast<float*>(&point_light->DiffuseColour);
-				if (ImGui::ColorEdit3(("Diffuse##" + std::to_string(i)).c_str(), light_diffuse))
+				if (ImGui::DragFloat("Radius", &point_light.Radius, 0.1f, 0.1f, 1000.0f))
 				{
-					UpdateLightBuffer();
+					m_Lights.SetRadius(index, point_light.Radius);
 				}
 
-				float* light_ambient = reinterpret_cast<float*>(&point_light->AmbientColour);
-				if (ImGui::ColorEdit3(("Ambient##" + std::to_string(i)).c_str(), light_ambient))
+				if (ImGui::ColorEdit3("Diffuse", reinterpret_cast<float*>(&point_light.DiffuseColour)))
 				{
-					UpdateLightBuffer();
+					m_Lights.SetDiffuse(index, point_light.DiffuseColour);
 				}
 
-				float* light_specular = reinterpret_cast<float*>(&point_light->SpecularColour);
-				if (ImGui::ColorEdit3(("Specular##" + std::to_string(i)).c_str(), light_specular))
+				if (ImGui::ColorEdit3("Ambient", reinterpret_cast<float*>(&point_light.AmbientColour)))
 				{
-					UpdateLightBuffer();
+					m_Lights.SetAmbient(index, point_light.AmbientColour);
 				}
 
-				// Add line seperate between each light section
-				if (i != m_PointLights.size() - 1)
+				if (ImGui::ColorEdit3("Specular", reinterpret_cast<float*>(&point_light.SpecularColour)))
 				{
-					ImGui::Separator();
+					m_Lights.SetSpecular(index, point_light.SpecularColour);
 				}
 			}
+
+			// Lights copied to the GPU last frame
+			const Rove::LightUploadStats& upload = m_DxShader->GetLightUploadStats();
+			ImGui::Text("Upload: %i of %i lights in %i ranges, %u bytes, %.1f us", upload.dirty_lights, upload.light_count, upload.ranges, upload.bytes, upload.microseconds);
+		}
+
+		ImGui::End();
+	}
+
+	// Profiler timeline
+	if (m_ShowProfiler)
+	{
+		if (ImGui::Begin("Profiler", &m_ShowProfiler))
+		{
+			RenderProfiler();
+		}
+
+		ImGui::End();
+	}
+
+	// Memory by tag
+	if (m_ShowMemory)
+	{
+		if (ImGui::Begin("Memory", &m_ShowMemory))
+		{
+			RenderMemory();
 		}
 
 		ImGui::End();
@@ -495,6 +833,32 @@ void Rove::Application::RenderGui()
 				MenuItem_Load();
 			}
 
+			if (ImGui::MenuItem("Add to scene"))
+			{
+				MenuItem_Add();
+			}
+
+			// Chrome trace of the next frames, named by the time it was started
+			if (ImGui::BeginMenu("Capture trace", !m_TraceCapture.IsCapturing()))
+			{
+				for (uint32_t frame_count : { 10u, 100u, 1000u })
+				{
+					std::string label = std::to_string(frame_count) + " frames";
+					if (ImGui::MenuItem(label.c_str()))
+					{
+						std::time_t time = std::time(nullptr);
+						std::tm local_time = {};
+						localtime_s(&local_time, &time);
+
+						char file_name[64];
+						std::strftime(file_name, sizeof(file_name), "trace_%Y%m%d_%H%M%S.json", &local_time);
+						StartTraceCapture(frame_count, std::filesystem::current_path() / file_name);
+					}
+				}
+
+				ImGui::EndMenu();
+			}
+
 			ImGui::EndMenu();
 		}
 
@@ -505,9 +869,359 @@ void Rove::Application::RenderGui()
 			ImGui::MenuItem("Camera", nullptr, &m_ShowCameraDetails);
 			ImGui::MenuItem("Model", nullptr, &m_ShowModelDetails);
 			ImGui::MenuItem("Environment", nullptr, &m_ShowEnvironmentDetails);
+			ImGui::MenuItem("Profiler", nullptr, &m_ShowProfiler);
+			ImGui::MenuItem("Memory", nullptr, &m_ShowMemory);
 			ImGui::EndMenu();
 		}
 
 		ImGui::EndMainMenuBar();
 	}
 }
+
+void Rove::Application::StartTraceCapture(uint32_t frame_count, const std::filesystem::path& path)
+{
+	m_TraceCapture.Start(frame_count, path);
+}
+
+void Rove::Application::RenderProfiler()
+{
+	Profiler& profiler = Profiler::Get();
+
+#if !ROVE_PROFILER
+	ImGui::Text("Profile zones are compiled out, build with ROVE_PROFILER set to 1");
+#endif
+
+	bool enabled = profiler.IsEnabled();
+	if (ImGui::Checkbox("Record zones", &enabled))
+	{
+		profiler.SetEnabled(enabled);
+	}
+
+	ImGui::SameLine();
+	ImGui::Checkbox("Pause", &m_ProfilerPaused);
+
+	// Trace capture started from the file menu or the command line
+	Rove::TraceCaptureStats capture = m_TraceCapture.GetStats();
+	if (capture.capturing)
+	{
+		ImGui::Text("Capturing trace: frame %u / %u, %zu events written", capture.frames, capture.frame_count, capture.events);
+	}
+	else if (capture.frame_count > 0)
+	{
+		ImGui::Text("Trace: %u frames, %zu events, %.1f MB in %s", capture.frames, capture.events, capture.bytes / (1024.0 * 1024.0), m_TraceCapture.GetPath().filename().string().c_str());
+	}
+
+	// Reports of the seconds around frames over the threshold
+	if (ImGui::CollapsingHeader("Hitch detection"))
+	{
+		ImGui::Checkbox("Detect hitches", &m_HitchDetector.Enabled);
+		ImGui::SliderFloat("Threshold (ms)", &m_HitchDetector.ThresholdMilliseconds, 10.0f, 500.0f, "%.0f");
+		ImGui::SliderFloat("Seconds before", &m_HitchDetector.SecondsBefore, 0.5f, 10.0f, "%.1f");
+		ImGui::SliderFloat("Seconds after", &m_HitchDetector.SecondsAfter, 0.0f, 5.0f, "%.1f");
+		ImGui::SliderFloat("Minimum interval (s)", &m_HitchDetector.MinimumInterval, 0.0f, 300.0f, "%.0f");
+
+		const Rove::HitchStats& hitches = m_HitchDetector.GetStats();
+		ImGui::Text("Hitches: %i, %i reports saved, %i skipped, %i failed%s", hitches.hitches, hitches.saved_reports, hitches.skipped_hitches, hitches.failed_reports, m_HitchDetector.IsReporting() ? ", reporting" : "");
+		if (hitches.saved_reports > 0)
+		{
+			ImGui::Text("Last report: %.0f ms in %s", hitches.last_hitch_milliseconds, hitches.last_report.filename().string().c_str());
+		}
+	}
+	ImGui::SliderInt("Frames", &m_ProfilerFrames, 1, 32);
+
+	if (!m_ProfilerPaused)
+	{
+		profiler.GetFrames(static_cast<uint32_t>(m_ProfilerFrames), m_ProfilerFrameList);
+		if (!m_ProfilerFrameList.empty())
+		{
+			profiler.GetZones(m_ProfilerFrameList.front().start, m_ProfilerZones);
+		}
+	}
+
+	if (m_ProfilerFrameList.empty())
+	{
+		ImGui::Text("No frames recorded yet");
+		return;
+	}
+
+	// Each thread with zones in view gets a row for its name and one for every depth of its zones
+	uint32_t thread_count = profiler.GetThreadCount();
+	std::vector<int> thread_rows(thread_count, 0);
+	for (const ProfileZone& zone : m_ProfilerZones)
+	{
+		thread_rows[zone.thread] = std::max(thread_rows[zone.thread], static_cast<int>(zone.depth) + 1);
+	}
+
+	std::vector<int> first_row(thread_count, 0);
+	int row_count = 0;
+	for (uint32_t i = 0; i < thread_count; ++i)
+	{
+		if (thread_rows[i] > 0)
+		{
+			first_row[i] = row_count + 1;
+			row_count += thread_rows[i] + 1;
+		}
+	}
+
+	// Times are milliseconds from the start of the first frame shown
+	uint64_t origin = m_ProfilerFrameList.front().start;
+	auto to_milliseconds = [origin](uint64_t time) { return static_cast<double>(static_cast<int64_t>(time - origin)) / 1000000.0; };
+
+	const ProfileFrame& last = m_ProfilerFrameList.back();
+	ImGui::Text("Frame %llu: %.3f ms, %zu zones in view", static_cast<unsigned long long>(last.index), (last.end - last.start) / 1000000.0, m_ProfilerZones.size());
+
+	if (ImPlot::BeginPlot("##Timeline", ImVec2(-1, -1), ImPlotFlags_NoLegend | ImPlotFlags_NoMouseText))
+	{
+		ImPlot::SetupAxes("ms", nullptr, ImPlotAxisFlags_None, ImPlotAxisFlags_Invert | ImPlotAxisFlags_NoDecorations);
+		ImPlot::SetupAxisLimits(ImAxis_X1, 0.0, to_milliseconds(last.end), m_ProfilerPaused ? ImPlotCond_Once : ImPlotCond_Always);
+		ImPlot::SetupAxisLimits(ImAxis_Y1, 0.0, std::max(row_count, 1), ImPlotCond_Always);
+
+		// Frame boundaries
+		std::vector<double> boundaries;
+		for (const ProfileFrame& frame : m_ProfilerFrameList)
+		{
+			boundaries.push_back(to_milliseconds(frame.start));
+		}
+
+		boundaries.push_back(to_milliseconds(last.end));
+		ImPlot::PlotVLines("Frames", boundaries.data(), static_cast<int>(boundaries.size()));
+
+		ImDrawList* draw_list = ImPlot::GetPlotDrawList();
+		ImPlotPoint mouse = ImPlot::GetPlotMousePos();
+		const ProfileZone* hovered = nullptr;
+
+		ImPlot::PushPlotClipRect();
+		for (const ProfileZone& zone : m_ProfilerZones)
+		{
+			double start = to_milliseconds(zone.start);
+			double end = to_milliseconds(zone.end);
+			double row = first_row[zone.thread] + zone.depth;
+
+			ImVec2 top_left = ImPlot::PlotToPixels(start, row);
+			ImVec2 bottom_right = ImPlot::PlotToPixels(end, row + 1.0);
+			top_left.y += 1.0f;
+			bottom_right.x = std::max(bottom_right.x, top_left.x + 1.0f);
+
+			// Zones with the same name keep the same colour
+			float hue = static_cast<float>(std::hash<std::string_view>()(zone.name) % 360) / 360.0f;
+			draw_list->AddRectFilled(top_left, bottom_right, ImColor::HSV(hue, 0.5f, 0.75f));
+
+			if (bottom_right.x - top_left.x > ImGui::CalcTextSize(zone.name).x + 4.0f)
+			{
+				draw_list->AddText(ImVec2(top_left.x + 2.0f, top_left.y), IM_COL32_WHITE, zone.name);
+			}
+
+			if (mouse.x >= start && mouse.x <= end && mouse.y >= row && mouse.y < row + 1.0)
+			{
+				hovered = &zone;
+			}
+		}
+
+		// Thread names in the row above their zones
+		ImPlotRect limits = ImPlot::GetPlotLimits();
+		for (uint32_t i = 0; i < thread_count; ++i)
+		{
+			if (thread_rows[i] > 0)
+			{
+				ImVec2 position = ImPlot::PlotToPixels(limits.X.Min, first_row[i] - 1.0);
+				draw_list->AddText(ImVec2(position.x + 2.0f, position.y + 1.0f), IM_COL32(255, 255, 255, 160), profiler.GetThreadName(i));
+			}
+		}
+
+		ImPlot::PopPlotClipRect();
+
+		if (hovered != nullptr && ImPlot::IsPlotHovered())
+		{
+			ImGui::SetTooltip("%s\n%.3f ms\n%s", hovered->name, (hovered->end - hovered->start) / 1000000.0, profiler.GetThreadName(hovered->thread));
+		}
+
+		ImPlot::EndPlot();
+	}
+}
+
+void Rove::Application::RenderModelCosts()
+{
+	uint64_t frame = m_Scene->GetFrameIndex();
+	if (m_Scene->EnableStaticBatching)
+	{
+		ImGui::Text("Models drawn in static batches are not attributed");
+	}
+
+	m_ModelCostRows.clear();
+	for (const std::unique_ptr<Object>& object : m_Scene->GetObjects())
+	{
+		for (const std::unique_ptr<Model>& model : object->GetModels())
+		{
+			m_ModelCostRows.push_back(model.get());
+		}
+	}
+
+	ImGuiTableFlags flags = ImGuiTableFlags_Sortable | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_SizingFixedFit;
+	if (!ImGui::BeginTable("Model costs", 6, flags, ImVec2(0.0f, 300.0f)))
+	{
+		return;
+	}
+
+	ImGui::TableSetupScrollFreeze(0, 1);
+	ImGui::TableSetupColumn("Model");
+	ImGui::TableSetupColumn("Triangles", ImGuiTableColumnFlags_PreferSortDescending);
+	ImGui::TableSetupColumn("Vertices", ImGuiTableColumnFlags_PreferSortDescending);
+	ImGui::TableSetupColumn("Draws", ImGuiTableColumnFlags_PreferSortDescending);
+	ImGui::TableSetupColumn("State changes", ImGuiTableColumnFlags_PreferSortDescending);
+	ImGui::TableSetupColumn("Submit (us)", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
+	ImGui::TableHeadersRow();
+
+	// Triangles of every instance are counted, culled models included, which take the triangles of their geometry times their instances
+	auto triangles = [frame](const Model* model)
+	{
+		int64_t instances = static_cast<int64_t>(std::max<size_t>(model->Instances.size(), 1));
+		return model->Stats.frame == frame ? model->Stats.triangles : static_cast<int64_t>(model->Geometry->IndexCount / 3) * instances;
+	};
+
+	auto cost = [frame](const Model* model, int column) -> double
+	{
+		if (model->Stats.frame != frame)
+		{
+			return 0.0;
+		}
+
+		switch (column)
+		{
+		case 2: return static_cast<double>(model->Stats.vertices);
+		case 3: return model->Stats.draws;
+		case 4: return model->Stats.state_changes;
+		default: return model->Stats.submit_microseconds;
+		}
+	};
+
+	// Sorted every frame as the costs change, the table only holds the models of the scene
+	if (const ImGuiTableSortSpecs* sort_specs = ImGui::TableGetSortSpecs())
+	{
+		if (sort_specs->SpecsCount > 0)
+		{
+			int column = sort_specs->Specs[0].ColumnIndex;
+			bool ascending = sort_specs->Specs[0].SortDirection == ImGuiSortDirection_Ascending;
+			std::stable_sort(m_ModelCostRows.begin(), m_ModelCostRows.end(), [&](const Model* a, const Model* b)
+			{
+				if (column == 0)
+				{
+					return ascending ? a->Name < b->Name : b->Name < a->Name;
+				}
+
+				double a_value = column == 1 ? static_cast<double>(triangles(a)) : cost(a, column);
+				double b_value = column == 1 ? static_cast<double>(triangles(b)) : cost(b, column);
+				return ascending ? a_value < b_value : b_value < a_value;
+			});
+		}
+	}
+
+	ImGuiListClipper clipper;
+	clipper.Begin(static_cast<int>(m_ModelCostRows.size()));
+	while (clipper.Step())
+	{
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+		{
+			const Model* model = m_ModelCostRows[i];
+			bool culled = model->Stats.frame != frame;
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", model->Name.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%lld", static_cast<long long>(triangles(model)));
+
+			if (culled)
+			{
+				ImGui::TableNextColumn();
+				ImGui::TextDisabled("culled");
+				continue;
+			}
+
+			ImGui::TableNextColumn();
+			ImGui::Text("%lld", static_cast<long long>(model->Stats.vertices));
+			ImGui::TableNextColumn();
+			ImGui::Text("%i", model->Stats.draws);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", model->Stats.state_changes);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", model->Stats.submit_microseconds);
+		}
+	}
+
+	ImGui::EndTable();
+}
+
+void Rove::Application::RenderMemory()
+{
+#if !ROVE_MEMORY_TRACKING
+	ImGui::Text("Memory tracking is compiled out, build with ROVE_MEMORY_TRACKING set to 1");
+#endif
+
+	MemoryTracker& tracker = MemoryTracker::Get();
+	if (ImGui::Button("Reset peaks"))
+	{
+		tracker.ResetPeaks();
+	}
+
+	ImGui::SameLine();
+	ImGui::Text("%u threads counted", tracker.GetThreadCount());
+
+	ImGuiTableFlags flags = ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_SizingFixedFit;
+	if (ImGui::BeginTable("Memory tags", 5, flags))
+	{
+		ImGui::TableSetupColumn("Tag");
+		ImGui::TableSetupColumn("Current (KB)");
+		ImGui::TableSetupColumn("Peak (KB)");
+		ImGui::TableSetupColumn("Allocations");
+		ImGui::TableSetupColumn("Total allocations");
+		ImGui::TableHeadersRow();
+
+		for (size_t i = 0; i < MEMORY_TAG_COUNT; ++i)
+		{
+			MemoryTag tag = static_cast<MemoryTag>(i);
+			const MemoryTagStats& stats = tracker.GetStats(tag);
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", GetMemoryTagName(tag));
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", stats.bytes / 1024.0);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", stats.peak_bytes / 1024.0);
+			ImGui::TableNextColumn();
+			ImGui::Text("%lld", static_cast<long long>(stats.allocations));
+			ImGui::TableNextColumn();
+			ImGui::Text("%lld", static_cast<long long>(stats.total_allocations));
+		}
+
+		ImGui::EndTable();
+	}
+
+	// Geometry and materials shared between the models of an object are counted once for it
+	if (ImGui::CollapsingHeader("GPU memory by object"))
+	{
+		for (const std::unique_ptr<Object>& object : m_Scene->GetObjects())
+		{
+			std::unordered_set<const MeshGeometry*> geometries;
+			std::unordered_set<uint32_t> materials;
+			geometries.reserve(object->GetModels().size());
+			materials.reserve(object->GetModels().size());
+
+			uint64_t bytes = 0;
+			for (const std::unique_ptr<Model>& model : object->GetModels())
+			{
+				if (geometries.insert(model->Geometry.get()).second)
+				{
+					bytes += model->Geometry->GetGpuBytes();
+				}
+
+				if (materials.insert(model->MaterialIndex).second)
+				{
+					bytes += m_Scene->GetMaterialTable().GetGpuBytes(model->MaterialIndex);
+				}
+			}
+
+			ImGui::Text("%s: %.1f KB in %zu models", object->Filename.c_str(), bytes / 1024.0, object->GetModels().size());
+		}
+	}
+}
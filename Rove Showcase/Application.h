@@ -6,9 +6,19 @@
 #include "DxShader.h"
 
 #include "Model.h"
+#include "Scene.h"
 #include "Camera.h"
+#include "CameraPath.h"
+#include "JobSystem.h"
 #include "PointLight.h"
+#include "LightClusters.h"
+#include "LightList.h"
 #include "Timer.h"
+#include "Profiler.h"
+#include "FrameTimeStats.h"
+#include "TraceCapture.h"
+#include "HitchDetector.h"
+#include "MemoryTracker.h"
 
 // Components
 #include "ViewportComponent.h"
@@ -31,6 +41,10 @@ namespace Rove
 
 		int Run();
 
+		// Captures the zones and counters of a number of frames into a Chrome trace file, started before Run the capture
+		// also holds the loading of the window and the default scene
+		void StartTraceCapture(uint32_t frame_count, const std::filesystem::path& path);
+
 		Window* GetWindow() { return m_Window.get(); }
 		DxRenderer* GetRenderer() { return m_DxRenderer.get(); }
 
@@ -43,21 +57,45 @@ namespace Rove
 		void OnMousePressed(int mouse_x, int mouse_y, int key_modifier);
 		void OnMouseReleased(int mouse_x, int mouse_y, int key_modifier);
 
+		// Casts a ray from the camera through a point in the client area, returns true and fills the hit if a model was hit
+		bool Pick(int mouse_x, int mouse_y, RaycastHit& hit);
+
 	private:
 		std::unique_ptr<Window> m_Window = nullptr;
 		std::unique_ptr<DxRenderer> m_DxRenderer = nullptr;
 		std::unique_ptr<DxShader> m_DxShader = nullptr;
 		std::unique_ptr<Camera> m_Camera = nullptr;
 		std::unique_ptr<Timer> m_Timer = nullptr;
-		std::unique_ptr<Object> m_Object = nullptr;
+		std::unique_ptr<JobSystem> m_JobSystem = nullptr;
+		std::unique_ptr<Scene> m_Scene = nullptr;
+
+		// Object shown in the model panel
+		Object* m_SelectedObject = nullptr;
+
+		// Result of the last left click pick
+		RaycastHit m_PickHit;
+		bool m_PickFound = false;
+		double m_PickMicroseconds = 0.0;
+
+		// Point lights and the one shown in the environment panel
+		LightList m_Lights;
+		int m_SelectedLight = 0;
+
+		// Scatters lights with random colours around the origin
+		void AddRandomLights(int count);
+
+		// Point lights reaching each cluster of the view, rebuilt every frame
+		std::unique_ptr<LightClusters> m_LightClusters = nullptr;
 
-		std::vector<std::unique_ptr<PointLight>> m_PointLights;
+		// Uploads the changed lights and assigns them to the clusters of the view
+		void UpdateLights();
 
 		void SetupDearImGui();
 		void UpdateCamera();
 
 		void Create();
 		void MenuItem_Load();
+		void MenuItem_Add();
 
 		// Show camera GUI
 		bool m_ShowCameraDetails = true;
@@ -75,13 +113,40 @@ namespace Rove
 		// Model wireframe
 		bool m_RenderWireframe = false;
 
-		// Light updates
-		void UpdateLightBuffer();
+		// Camera path recorded for the headless occlusion test
+		CameraPath m_CameraPath;
+		bool m_RecordCameraPath = false;
 
 		// Calculate frames
 		void CalculateFramesPerSecond();
 		int m_FramesPerSecond = 0;
 
+		// Times of the last frames for the percentiles, graph and histogram of the renderer panel
+		FrameTimeStats m_FrameTimes;
+
+		// Profiler window showing the zones of the last frames on a timeline, a paused view keeps the zones it collected
+		void RenderProfiler();
+		bool m_ShowProfiler = false;
+		bool m_ProfilerPaused = false;
+		int m_ProfilerFrames = 4;
+		std::vector<ProfileFrame> m_ProfilerFrameList;
+		std::vector<ProfileZone> m_ProfilerZones;
+
+		// Trace capture of the next frames and the bytes uploaded up to the last frame, for the upload counter
+		TraceCapture m_TraceCapture;
+		uint64_t m_UploadedBytes = 0;
+
+		// Saves the last seconds of zones around frames over the hitch threshold
+		HitchDetector m_HitchDetector;
+
+		// Table of the submission cost of every model in the scene, sortable by each column
+		void RenderModelCosts();
+		std::vector<Model*> m_ModelCostRows;
+
+		// Memory window showing the current and peak memory of every tag and the estimated GPU memory of each object
+		void RenderMemory();
+		bool m_ShowMemory = false;
+
 		// Multisample anti-aliasing
 		bool m_EnableMsaa = false;
 
@@ -14,10 +14,10 @@ void Rove::Camera::Rotate(float pitch_radians, float yaw_radians)
 {
 	m_PitchRadians += pitch_radians;
 	m_YawRadians += yaw_radians;
-	m_PitchRadians = std::clamp<float>(m_PitchRadians, -(DirectX::XM_PIDIV2 - 0.1f), DirectX::XM_PIDIV2 - 0.1f);
+	m_PitchRadians = std::clamp<float>(m_PitchRadians, -MAX_PITCH_RADIANS, MAX_PITCH_RADIANS);
 
 	// Convert Spherical to Cartesian coordinates.
-	const auto radius = -8.0f;
+	const auto radius = -ORBIT_RADIUS;
 	auto rotation_matrix = DirectX::XMMatrixRotationRollPitchYaw(m_PitchRadians, m_YawRadians, 0);
 	auto position = DirectX::XMVectorSet(0.0f, 0.0f, radius, 0.0f);
 	position = XMVector3TransformCoord(position, rotation_matrix);
@@ -30,6 +30,15 @@ void Rove::Camera::Rotate(float pitch_radians, float yaw_radians)
 
 	// Set position
 	DirectX::XMStoreFloat3(&m_Position, position);
+
+	CalculateFrustum();
+}
+
+void Rove::Camera::SetRotation(float pitch_radians, float yaw_radians)
+{
+	m_PitchRadians = 0.0f;
+	m_YawRadians = 0.0f;
+	Rotate(pitch_radians, yaw_radians);
 }
 
 void Rove::Camera::UpdateAspectRatio(int width, int height)
@@ -58,5 +67,33 @@ void Rove::Camera::CalculateProjection()
 	auto field_of_view_radians = DirectX::XMConvertToRadians(m_FieldOfViewDegrees);
 
 	// Calculate camera's perspective
-	m_Projection = DirectX::XMMatrixPerspectiveFovLH(field_of_view_radians, m_AspectRatio, 0.01f, 100.0f);
+	m_Projection = DirectX::XMMatrixPerspectiveFovLH(field_of_view_radians, m_AspectRatio, NEAR_PLANE, FAR_PLANE);
+
+	CalculateFrustum();
+}
+
+DirectX::XMMATRIX Rove::Camera::GetViewProjection()
+{
+	return DirectX::XMMatrixMultiply(m_View, m_Projection);
+}
+
+void Rove::Camera::CalculateRay(int mouse_x, int mouse_y, int width, int height, DirectX::XMFLOAT3* origin, DirectX::XMFLOAT3* direction)
+{
+	// Unproject the point on the near and far plane
+	float x = static_cast<float>(mouse_x);
+	float y = static_cast<float>(mouse_y);
+	float w = static_cast<float>(width);
+	float h = static_cast<float>(height);
+
+	DirectX::XMMATRIX world = DirectX::XMMatrixIdentity();
+	DirectX::XMVECTOR near_point = DirectX::XMVector3Unproject(DirectX::XMVectorSet(x, y, 0.0f, 0.0f), 0.0f, 0.0f, w, h, 0.0f, 1.0f, m_Projection, m_View, world);
+	DirectX::XMVECTOR far_point = DirectX::XMVector3Unproject(DirectX::XMVectorSet(x, y, 1.0f, 0.0f), 0.0f, 0.0f, w, h, 0.0f, 1.0f, m_Projection, m_View, world);
+
+	DirectX::XMStoreFloat3(origin, near_point);
+	DirectX::XMStoreFloat3(direction, DirectX::XMVector3Normalize(DirectX::XMVectorSubtract(far_point, near_point)));
+}
+
+void Rove::Camera::CalculateFrustum()
+{
+	m_Frustum.Extract(GetViewProjection());
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Pch.h"
+#include "Frustum.h"
 
 namespace Rove
 {
@@ -11,9 +12,22 @@ namespace Rove
 		Camera(int width, int height);
 		virtual ~Camera() = default;
 
+		// Distance of the eye from the origin
+		static constexpr float ORBIT_RADIUS = 8.0f;
+
+		// Pitch is clamped to this either side of the horizon
+		static constexpr float MAX_PITCH_RADIANS = DirectX::XM_PIDIV2 - 0.1f;
+
+		// Clipping plane distances
+		static constexpr float NEAR_PLANE = 0.01f;
+		static constexpr float FAR_PLANE = 100.0f;
+
 		// Recalculates the view based on the pitch and yaw
 		void Rotate(float pitch_radians, float yaw_radians);
 
+		// Sets the absolute pitch and yaw
+		void SetRotation(float pitch_radians, float yaw_radians);
+
 		// Update aspect ratio
 		void UpdateAspectRatio(int width, int height);
 
@@ -32,9 +46,27 @@ namespace Rove
 		// Get field of view in degrees
 		constexpr float GetFieldOfView() { return m_FieldOfViewDegrees; }
 
+		// Get width divided by height
+		constexpr float GetAspectRatio() { return m_AspectRatio; }
+
 		// Get camera position
 		constexpr DirectX::XMFLOAT3 GetPosition() { return m_Position; }
 
+		// Get camera pitch in radians
+		constexpr float GetPitch() { return m_PitchRadians; }
+
+		// Get camera yaw in radians
+		constexpr float GetYaw() { return m_YawRadians; }
+
+		// Get combined view and projection matrix
+		DirectX::XMMATRIX GetViewProjection();
+
+		// Get view frustum
+		const Frustum& GetFrustum() { return m_Frustum; }
+
+		// World space ray through a point on the screen, the direction is normalised
+		void CalculateRay(int mouse_x, int mouse_y, int width, int height, DirectX::XMFLOAT3* origin, DirectX::XMFLOAT3* direction);
+
 	private:
 		// Camera position
 		DirectX::XMFLOAT3 m_Position;
@@ -59,5 +91,11 @@ namespace Rove
 
 		// Recalculates the projection based on the new window size
 		void CalculateProjection();
+
+		// View frustum
+		Frustum m_Frustum;
+
+		// Recalculates the frustum planes from the view and projection
+		void CalculateFrustum();
 	};
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "Pch.h"
+#include "CameraPath.h"
+#include "Camera.h"
+
+void Rove::CameraPath::Record(Camera& camera, int width, int height)
+{
+	CameraKey key;
+	key.pitch_radians = camera.GetPitch();
+	key.yaw_radians = camera.GetYaw();
+	key.fov_degrees = camera.GetFieldOfView();
+	key.width = width;
+	key.height = height;
+	m_Keys.push_back(key);
+}
+
+void Rove::CameraPath::Apply(size_t index, Camera& camera) const
+{
+	const CameraKey& key = m_Keys[index];
+	camera.SetRotation(key.pitch_radians, key.yaw_radians);
+	camera.SetFov(key.fov_degrees);
+
+	if (key.width > 0 && key.height > 0)
+	{
+		camera.UpdateAspectRatio(key.width, key.height);
+	}
+}
+
+void Rove::CameraPath::Clear()
+{
+	m_Keys.clear();
+}
+
+void Rove::CameraPath::Save(const std::filesystem::path& path) const
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+	{
+		throw std::exception("Could not write the camera path");
+	}
+
+	for (const CameraKey& key : m_Keys)
+	{
+		file << key.pitch_radians << ' ' << key.yaw_radians << ' ' << key.fov_degrees << ' ' << key.width << ' ' << key.height << '\n';
+	}
+}
+
+void Rove::CameraPath::Load(const std::filesystem::path& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		throw std::exception("Could not open the camera path");
+	}
+
+	m_Keys.clear();
+
+	CameraKey key;
+	while (file >> key.pitch_radians >> key.yaw_radians >> key.fov_degrees >> key.width >> key.height)
+	{
+		m_Keys.push_back(key);
+	}
+}
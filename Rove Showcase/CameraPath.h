@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Pch.h"
+
+namespace Rove
+{
+	// Forward declarations
+	class Camera;
+
+	// Camera state of a single frame
+	struct CameraKey
+	{
+		float pitch_radians = 0.0f;
+		float yaw_radians = 0.0f;
+		float fov_degrees = 50.0f;
+		int width = 0;
+		int height = 0;
+	};
+
+	// Camera state recorded every frame so a walkthrough can be replayed, stored as one line of text per frame
+	class CameraPath
+	{
+	public:
+		CameraPath() = default;
+		virtual ~CameraPath() = default;
+
+		// Appends the current state of the camera
+		void Record(Camera& camera, int width, int height);
+
+		// Applies a recorded frame to the camera
+		void Apply(size_t index, Camera& camera) const;
+
+		// Removes every frame
+		void Clear();
+
+		// Writes the path to a text file
+		void Save(const std::filesystem::path& path) const;
+
+		// Reads a path written by Save
+		void Load(const std::filesystem::path& path);
+
+		// Number of frames
+		size_t Size() const { return m_Keys.size(); }
+
+	private:
+		std::vector<CameraKey> m_Keys;
+	};
+}
@@ -0,0 +1,134 @@
+#include "CommandList.h"
+#include "JobSystem.h"
+#include <algorithm>
+
+namespace
+{
+	bool CompareKeys(const Rove::RenderCommand& a, const Rove::RenderCommand& b)
+	{
+		return a.key < b.key;
+	}
+}
+
+void Rove::CommandRecorder::Begin()
+{
+	for (size_t i = 0; i < m_BufferCount; ++i)
+	{
+		m_Buffers[i].clear();
+	}
+
+	m_BufferCount = 0;
+	m_Commands.clear();
+}
+
+void Rove::CommandRecorder::Record(JobSystem* job_system, uint32_t count, const RecordFunction& record)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	uint32_t range_count = (count + DRAWS_PER_JOB - 1) / DRAWS_PER_JOB;
+	size_t first_buffer = m_BufferCount;
+	m_BufferCount += range_count;
+	if (m_Buffers.size() < m_BufferCount)
+	{
+		m_Buffers.resize(m_BufferCount);
+	}
+
+	auto job = [&](uint32_t range)
+	{
+		uint32_t first = range * DRAWS_PER_JOB;
+		uint32_t end = std::min(first + DRAWS_PER_JOB, count);
+
+		std::vector<RenderCommand>& commands = m_Buffers[first_buffer + range];
+		commands.reserve(end - first);
+		record(first, end, commands);
+
+		// Draws taken from a sorted queue are already in order
+		if (!std::is_sorted(commands.begin(), commands.end(), CompareKeys))
+		{
+			std::stable_sort(commands.begin(), commands.end(), CompareKeys);
+		}
+	};
+
+	if (job_system != nullptr && range_count > 1)
+	{
+		job_system->ParallelFor(range_count, job);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < range_count; ++i)
+		{
+			job(i);
+		}
+	}
+}
+
+void Rove::CommandRecorder::Merge()
+{
+	// Concatenate the buffers, each is a sorted run
+	m_Commands.clear();
+	m_Runs.clear();
+	for (size_t i = 0; i < m_BufferCount; ++i)
+	{
+		if (!m_Buffers[i].empty())
+		{
+			m_Runs.push_back(m_Commands.size());
+			m_Commands.insert(m_Commands.end(), m_Buffers[i].begin(), m_Buffers[i].end());
+		}
+	}
+
+	m_Runs.push_back(m_Commands.size());
+	m_Scratch.resize(m_Commands.size());
+
+	// Merge neighbouring runs until one is left, std::merge takes equal keys from the first run so recording order holds
+	while (m_Runs.size() > 2)
+	{
+		size_t run_count = m_Runs.size() - 1;
+		size_t merged = 0;
+		for (size_t run = 0; run < run_count; run += 2)
+		{
+			auto first = m_Commands.begin() + m_Runs[run];
+			auto middle = m_Commands.begin() + m_Runs[std::min(run + 1, run_count)];
+			auto end = m_Commands.begin() + m_Runs[std::min(run + 2, run_count)];
+			std::merge(first, middle, middle, end, m_Scratch.begin() + m_Runs[run], CompareKeys);
+
+			m_Runs[merged++] = m_Runs[run];
+		}
+
+		m_Runs[merged++] = m_Runs[run_count];
+		m_Runs.resize(merged);
+		m_Commands.swap(m_Scratch);
+	}
+}
+
+Rove::CommandStats Rove::NullCommandBackend::Execute(const RenderCommand* commands, size_t count, CommandCost* costs)
+{
+	// Counts the bindings a replay would make, shader variant, geometry and material, without timing them
+	CommandStats stats;
+	const RenderCommand* previous = nullptr;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const RenderCommand& command = commands[i];
+		int state_changes = previous == nullptr || previous->shader != command.shader ? 1 : 0;
+		state_changes += previous == nullptr || previous->geometry != command.geometry ? 1 : 0;
+		state_changes += previous == nullptr || previous->material != command.material ? 1 : 0;
+		stats.state_changes += state_changes;
+		stats.buffer_binds += previous == nullptr || previous->geometry != command.geometry ? 2 : 0;
+
+		if (costs != nullptr)
+		{
+			costs[i] = { static_cast<uint32_t>(state_changes), 0 };
+		}
+
+		uint32_t instances = std::max(command.instance_count, 1u);
+		stats.instanced_draws += command.instance_count > 0 ? 1 : 0;
+		stats.triangles += static_cast<int64_t>(command.index_count / 3) * instances;
+		stats.vertices += static_cast<int64_t>(command.vertex_count) * instances;
+		++stats.draws;
+		previous = &command;
+	}
+
+	return stats;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+// Only the standard library so recording and merging build and are benchmarked without a graphics API
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Rove
+{
+	// Forward declarations
+	class JobSystem;
+
+	// One draw with everything it binds, replayed in key order
+	struct RenderCommand
+	{
+		uint64_t key;
+
+		// Opaque id the backend maps to the vertex and index buffers of the geometry
+		uint32_t geometry;
+
+		// Bits of the material and shader variant indices, which share 4 bytes to keep the command at 48 bytes
+		static constexpr uint32_t MATERIAL_BITS = 20;
+		static constexpr uint32_t SHADER_BITS = 12;
+
+		// Index in the material table
+		uint32_t material : MATERIAL_BITS;
+
+		// Shader variant, given by the shader of the renderer
+		uint32_t shader : SHADER_BITS;
+
+		// World constant of a single draw or first instance in the instance stream of an instanced draw
+		uint32_t first;
+
+		// Zero for a single draw
+		uint32_t instance_count;
+
+		// World constant holding the light list of an instanced draw
+		uint32_t constants;
+
+		// Range of the geometry in its buffers
+		uint32_t index_count;
+		uint32_t start_index;
+		int32_t base_vertex;
+		uint32_t vertex_count;
+	};
+
+	static_assert(sizeof(RenderCommand) == 48, "RenderCommand must be 48 bytes");
+
+	// Draws and bindings made by a replay
+	struct CommandStats
+	{
+		int draws = 0;
+		int instanced_draws = 0;
+		int state_changes = 0;
+
+		// Triangles and vertices of every draw and instance
+		int64_t triangles = 0;
+		int64_t vertices = 0;
+
+		// Buffer and shader resource bindings among the state changes
+		int buffer_binds = 0;
+		int resource_binds = 0;
+	};
+
+	// Bindings and CPU time of one replayed command, in time stamp counter ticks
+	struct CommandCost
+	{
+		uint32_t state_changes;
+		uint32_t ticks;
+	};
+
+	// Records the commands of a frame in parallel. The draws are split into fixed ranges, each job writes its range into
+	// a linear buffer of its own and sorts it by key, then the buffers are merged into one list in key order. Buffers
+	// keep their memory between frames so a steady frame does not touch the heap.
+	class CommandRecorder
+	{
+	public:
+		// Draws recorded by one job
+		static constexpr uint32_t DRAWS_PER_JOB = 2048;
+
+		// Writes the commands of the draws from first up to end
+		using RecordFunction = std::function<void(uint32_t first, uint32_t end, std::vector<RenderCommand>& commands)>;
+
+		CommandRecorder() = default;
+		virtual ~CommandRecorder() = default;
+
+		// Releases the buffers of the last frame
+		void Begin();
+
+		// Records a number of draws, on the job system when there is more than one range. Can be called several times
+		// before merging.
+		void Record(JobSystem* job_system, uint32_t count, const RecordFunction& record);
+
+		// Merges every buffer into the command list by key, commands with equal keys keep the order they were recorded in
+		void Merge();
+
+		// Merged commands
+		const std::vector<RenderCommand>& GetCommands() const { return m_Commands; }
+
+		// Buffers recorded since Begin
+		size_t GetBufferCount() const { return m_BufferCount; }
+
+	private:
+		std::vector<std::vector<RenderCommand>> m_Buffers;
+		size_t m_BufferCount = 0;
+		std::vector<RenderCommand> m_Commands;
+
+		// Start of each sorted run and the other half of the double buffer while merging
+		std::vector<size_t> m_Runs;
+		std::vector<RenderCommand> m_Scratch;
+	};
+
+	// Executes merged commands
+	class CommandBackend
+	{
+	public:
+		virtual ~CommandBackend() = default;
+
+		// Replays the commands in order, the cost of each command is written to the parallel costs when given
+		virtual CommandStats Execute(const RenderCommand* commands, size_t count, CommandCost* costs) = 0;
+	};
+
+	// Backend without a device that only counts what a replay would do, for measuring recording headless
+	class NullCommandBackend : public CommandBackend
+	{
+	public:
+		CommandStats Execute(const RenderCommand* commands, size_t count, CommandCost* costs) override;
+	};
+}
@@ -0,0 +1,180 @@
+#include "Pch.h"
+#include "DxCommandBackend.h"
+#include "DxRenderer.h"
+#include "DxShader.h"
+#include "MaterialTable.h"
+#include "JobSystem.h"
+#include "Model.h"
+#include "Profiler.h"
+
+namespace
+{
+	// Fewer commands than this per deferred context cost more to record and execute than they save
+	constexpr size_t MIN_COMMANDS_PER_CONTEXT = 1024;
+}
+
+Rove::DxCommandBackend::DxCommandBackend(DxRenderer* renderer, DxShader* shader, MaterialTable* material_table, JobSystem* job_system)
+	: m_DxRenderer(renderer), m_DxShader(shader), m_MaterialTable(material_table), m_JobSystem(job_system)
+{
+}
+
+Rove::CommandStats Rove::DxCommandBackend::Execute(const RenderCommand* commands, size_t count, CommandCost* costs)
+{
+	ROVE_PROFILE_ZONE("Submit");
+
+	if (UseDeferredContexts && m_JobSystem != nullptr && count >= 2 * MIN_COMMANDS_PER_CONTEXT)
+	{
+		return ExecuteDeferred(commands, count, costs);
+	}
+
+	return Replay(m_DxRenderer->GetDeviceContext(), m_DxRenderer->GetStateCache(), commands, count, costs);
+}
+
+Rove::CommandStats Rove::DxCommandBackend::Replay(ID3D11DeviceContext* context, DxStateCache* state_cache, const RenderCommand* commands, size_t count, CommandCost* costs)
+{
+	CommandStats stats;
+	StateCacheStats start_stats = state_cache->GetStats();
+	int shader = -1;
+
+	// One time stamp a command, the end of each command is the start of the next
+	uint64_t ticks = costs != nullptr ? Profiler::Ticks() : 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const RenderCommand& command = commands[i];
+		const MeshGeometry* geometry = m_Geometries[command.geometry];
+		int issued = state_cache->GetStats().issued;
+
+		// Switch shaders only when the variant changes
+		if (command.shader != shader)
+		{
+			m_DxShader->ApplyVariant(command.shader, state_cache);
+			shader = command.shader;
+		}
+
+		// Geometry in the same pool buffer and materials sharing textures leave their bindings in place
+		state_cache->IASetVertexBuffer(0, geometry->VertexBuffer.Get(), sizeof(Vertex), 0);
+		state_cache->IASetIndexBuffer(geometry->IndexBuffer.Get(), geometry->IndexBufferFormat, 0);
+		state_cache->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		m_MaterialTable->Bind(command.material, state_cache);
+
+		uint32_t instances = std::max(command.instance_count, 1u);
+		if (command.instance_count > 0)
+		{
+			m_DxShader->BindWorldConstants(command.constants, state_cache);
+			context->DrawIndexedInstanced(command.index_count, command.instance_count, command.start_index, command.base_vertex, command.first);
+			++stats.instanced_draws;
+		}
+		else
+		{
+			m_DxShader->BindWorldConstants(command.first, state_cache);
+			context->DrawIndexed(command.index_count, command.start_index, command.base_vertex);
+		}
+
+		int state_changes = state_cache->GetStats().issued - issued;
+		stats.state_changes += state_changes;
+		stats.triangles += static_cast<int64_t>(command.index_count / 3) * instances;
+		stats.vertices += static_cast<int64_t>(command.vertex_count) * instances;
+		++stats.draws;
+
+		if (costs != nullptr)
+		{
+			uint64_t end = Profiler::Ticks();
+			costs[i] = { static_cast<uint32_t>(state_changes), static_cast<uint32_t>(std::min<uint64_t>(end - ticks, UINT32_MAX)) };
+			ticks = end;
+		}
+	}
+
+	stats.buffer_binds = state_cache->GetStats().buffer_binds - start_stats.buffer_binds;
+	stats.resource_binds = state_cache->GetStats().resource_binds - start_stats.resource_binds;
+	return stats;
+}
+
+Rove::CommandStats Rove::DxCommandBackend::ExecuteDeferred(const RenderCommand* commands, size_t count, CommandCost* costs)
+{
+	size_t context_count = std::min<size_t>(m_JobSystem->GetThreadCount(), count / MIN_COMMANDS_PER_CONTEXT);
+	while (m_DeferredContexts.size() < context_count)
+	{
+		DeferredContext deferred;
+		DX::Check(m_DxRenderer->GetDevice()->CreateDeferredContext(0, deferred.context.ReleaseAndGetAddressOf()));
+		DX::Check(deferred.context.As(&deferred.context1));
+		deferred.state_cache = std::make_unique<DxStateCache>(deferred.context.Get(), deferred.context1.Get());
+		m_DeferredContexts.push_back(std::move(deferred));
+	}
+
+	CaptureFrameState();
+
+	// Each context records a contiguous range so executing the lists in order keeps the key order
+	size_t range = (count + context_count - 1) / context_count;
+	m_JobSystem->ParallelFor(static_cast<uint32_t>(context_count), [&](uint32_t index)
+	{
+		DeferredContext& deferred = m_DeferredContexts[index];
+		size_t first = index * range;
+		size_t end = std::min(first + range, count);
+
+		deferred.state_cache->Invalidate();
+		ApplyFrameState(deferred);
+		deferred.stats = Replay(deferred.context.Get(), deferred.state_cache.get(), commands + first, end - first, costs != nullptr ? costs + first : nullptr);
+		DX::Check(deferred.context->FinishCommandList(FALSE, deferred.command_list.ReleaseAndGetAddressOf()));
+	});
+
+	CommandStats stats;
+	auto immediate = m_DxRenderer->GetDeviceContext();
+	for (size_t i = 0; i < context_count; ++i)
+	{
+		DeferredContext& deferred = m_DeferredContexts[i];
+		immediate->ExecuteCommandList(deferred.command_list.Get(), TRUE);
+		deferred.command_list.Reset();
+
+		stats.draws += deferred.stats.draws;
+		stats.instanced_draws += deferred.stats.instanced_draws;
+		stats.state_changes += deferred.stats.state_changes;
+		stats.triangles += deferred.stats.triangles;
+		stats.vertices += deferred.stats.vertices;
+		stats.buffer_binds += deferred.stats.buffer_binds;
+		stats.resource_binds += deferred.stats.resource_binds;
+	}
+
+	return stats;
+}
+
+void Rove::DxCommandBackend::CaptureFrameState()
+{
+	auto immediate = m_DxRenderer->GetDeviceContext();
+
+	immediate->OMGetRenderTargets(1, m_FrameState.render_target.ReleaseAndGetAddressOf(), m_FrameState.depth_stencil.ReleaseAndGetAddressOf());
+
+	m_FrameState.viewport_count = 1;
+	immediate->RSGetViewports(&m_FrameState.viewport_count, &m_FrameState.viewport);
+	immediate->RSGetState(m_FrameState.rasterizer_state.ReleaseAndGetAddressOf());
+
+	immediate->PSGetSamplers(0, 1, m_FrameState.sampler.ReleaseAndGetAddressOf());
+	immediate->PSGetShader(m_FrameState.pixel_shader.ReleaseAndGetAddressOf(), nullptr, nullptr);
+	immediate->VSGetConstantBuffers(0, 1, m_FrameState.camera_constants.ReleaseAndGetAddressOf());
+	immediate->PSGetConstantBuffers(4, 1, m_FrameState.cluster_constants.ReleaseAndGetAddressOf());
+
+	ID3D11ShaderResourceView* light_views[3] = {};
+	immediate->PSGetShaderResources(2, 3, light_views);
+	for (int i = 0; i < 3; ++i)
+	{
+		// The views returned by the context already hold a reference
+		m_FrameState.light_views[i].Attach(light_views[i]);
+	}
+}
+
+void Rove::DxCommandBackend::ApplyFrameState(DeferredContext& deferred)
+{
+	DxStateCache* state_cache = deferred.state_cache.get();
+
+	state_cache->OMSetRenderTargets(m_FrameState.render_target.Get(), m_FrameState.depth_stencil.Get());
+	deferred.context->RSSetViewports(m_FrameState.viewport_count, &m_FrameState.viewport);
+	state_cache->RSSetState(m_FrameState.rasterizer_state.Get());
+
+	deferred.context->PSSetSamplers(0, 1, m_FrameState.sampler.GetAddressOf());
+	state_cache->PSSetShader(m_FrameState.pixel_shader.Get());
+	state_cache->VSSetConstantBuffer(0, m_FrameState.camera_constants.Get());
+	state_cache->PSSetConstantBuffer(0, m_FrameState.camera_constants.Get());
+	state_cache->PSSetConstantBuffer(4, m_FrameState.cluster_constants.Get());
+
+	ID3D11ShaderResourceView* light_views[] = { m_FrameState.light_views[0].Get(), m_FrameState.light_views[1].Get(), m_FrameState.light_views[2].Get() };
+	state_cache->PSSetShaderResources(2, 3, light_views);
+}
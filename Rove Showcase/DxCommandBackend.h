@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Pch.h"
+#include "CommandList.h"
+#include "DxStateCache.h"
+
+namespace Rove
+{
+	// Forward declarations
+	class DxRenderer;
+	class DxShader;
+	class MaterialTable;
+	class JobSystem;
+	struct MeshGeometry;
+
+	// Replays render commands onto the immediate context, or splits them over deferred contexts recorded on the job
+	// system and executes their command lists on the immediate context in order
+	class DxCommandBackend : public CommandBackend
+	{
+	public:
+		DxCommandBackend(DxRenderer* renderer, DxShader* shader, MaterialTable* material_table, JobSystem* job_system);
+		virtual ~DxCommandBackend() = default;
+
+		CommandStats Execute(const RenderCommand* commands, size_t count, CommandCost* costs) override;
+
+		// Geometry of each id the commands refer to, must stay valid until the commands are executed
+		void SetGeometries(const MeshGeometry* const* geometries) { m_Geometries = geometries; }
+
+		// Record onto deferred contexts, the immediate context state is restored after each command list
+		bool UseDeferredContexts = false;
+
+	private:
+		DxRenderer* m_DxRenderer = nullptr;
+		DxShader* m_DxShader = nullptr;
+		MaterialTable* m_MaterialTable = nullptr;
+		JobSystem* m_JobSystem = nullptr;
+		const MeshGeometry* const* m_Geometries = nullptr;
+
+		// Deferred context with its own state cache and the command list it last recorded
+		struct DeferredContext
+		{
+			ComPtr<ID3D11DeviceContext> context = nullptr;
+			ComPtr<ID3D11DeviceContext1> context1 = nullptr;
+			std::unique_ptr<DxStateCache> state_cache = nullptr;
+			ComPtr<ID3D11CommandList> command_list = nullptr;
+			CommandStats stats;
+		};
+
+		std::vector<DeferredContext> m_DeferredContexts;
+
+		// State bound on the immediate context before the draws, deferred contexts start with nothing bound
+		struct FrameState
+		{
+			ComPtr<ID3D11RenderTargetView> render_target = nullptr;
+			ComPtr<ID3D11DepthStencilView> depth_stencil = nullptr;
+			D3D11_VIEWPORT viewport = {};
+			UINT viewport_count = 0;
+			ComPtr<ID3D11RasterizerState> rasterizer_state = nullptr;
+			ComPtr<ID3D11SamplerState> sampler = nullptr;
+			ComPtr<ID3D11PixelShader> pixel_shader = nullptr;
+			ComPtr<ID3D11Buffer> camera_constants = nullptr;
+			ComPtr<ID3D11Buffer> cluster_constants = nullptr;
+			ComPtr<ID3D11ShaderResourceView> light_views[3];
+		};
+
+		FrameState m_FrameState;
+		void CaptureFrameState();
+		void ApplyFrameState(DeferredContext& deferred);
+
+		// Binds and draws the commands on one context
+		CommandStats Replay(ID3D11DeviceContext* context, DxStateCache* state_cache, const RenderCommand* commands, size_t count, CommandCost* costs);
+
+		CommandStats ExecuteDeferred(const RenderCommand* commands, size_t count, CommandCost* costs);
+	};
+}
@@ -4,6 +4,45 @@
 #include "Application.h"
 using Rove::DX::Check;
 
+namespace
+{
+	// Bits of a texel of the formats the texture loader and the render targets use, others are taken as 32
+	uint64_t GetBitsPerPixel(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_R32G32B32A32_FLOAT:
+			return 128;
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		case DXGI_FORMAT_R16G16B16A16_UNORM:
+			return 64;
+		case DXGI_FORMAT_B5G6R5_UNORM:
+		case DXGI_FORMAT_B5G5R5A1_UNORM:
+		case DXGI_FORMAT_R16_FLOAT:
+		case DXGI_FORMAT_R16_UNORM:
+			return 16;
+		case DXGI_FORMAT_R8_UNORM:
+		case DXGI_FORMAT_A8_UNORM:
+			return 8;
+		default:
+			return 32;
+		}
+	}
+}
+
+uint64_t Rove::DX::GetTextureBytes(const D3D11_TEXTURE2D_DESC& desc)
+{
+	uint64_t bytes = 0;
+	for (UINT mip = 0; mip < desc.MipLevels; ++mip)
+	{
+		uint64_t width = std::max(desc.Width >> mip, 1u);
+		uint64_t height = std::max(desc.Height >> mip, 1u);
+		bytes += width * height * GetBitsPerPixel(desc.Format) / 8;
+	}
+
+	return bytes * desc.ArraySize * std::max(desc.SampleDesc.Count, 1u);
+}
+
 Rove::DxRenderer::DxRenderer(Window* window) : m_Window(window)
 {
 }
@@ -83,12 +122,12 @@ void Rove::DxRenderer::Resize(int width, int height)
 
 void Rove::DxRenderer::SetWireframeRasterState()
 {
-	m_DeviceContext->RSSetState(m_RasterStateWireframe.Get());
+	m_StateCache->RSSetState(m_RasterStateWireframe.Get());
 }
 
 void Rove::DxRenderer::SetSolidRasterState()
 {
-	m_DeviceContext->RSSetState(m_RasterStateSolid.Get());
+	m_StateCache->RSSetState(m_RasterStateSolid.Get());
 }
 
 void Rove::DxRenderer::CopyMsaaRenderTargetBackBuffer()
@@ -98,12 +137,12 @@ void Rove::DxRenderer::CopyMsaaRenderTargetBackBuffer()
 
 void Rove::DxRenderer::SetRenderToMsaa()
 {
-	m_DeviceContext->OMSetRenderTargets(1, m_MsaaRenderTargetView.GetAddressOf(), m_MsaaDepthStencilView.Get());
+	m_StateCache->OMSetRenderTargets(m_MsaaRenderTargetView.Get(), m_MsaaDepthStencilView.Get());
 }
 
 void Rove::DxRenderer::SetRenderToBackBuffer()
 {
-	m_DeviceContext->OMSetRenderTargets(1, m_RenderTargetView.GetAddressOf(), m_DepthStencilView.Get());
+	m_StateCache->OMSetRenderTargets(m_RenderTargetView.Get(), m_DepthStencilView.Get());
 }
 
 void Rove::DxRenderer::CreateDeviceAndContext()
@@ -132,6 +171,17 @@ void Rove::DxRenderer::CreateDeviceAndContext()
 	{
 		throw std::exception("D3D_FEATURE_LEVEL_11_1 is not supported");
 	}
+
+	DX::Check(m_DeviceContext.As(&m_DeviceContext1));
+	m_StateCache = std::make_unique<DxStateCache>(m_DeviceContext.Get(), m_DeviceContext1.Get());
+
+	// Per draw constants are bound as offsets into one large buffer that is written without discarding
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	DX::Check(m_Device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options)));
+	if (!options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer)
+	{
+		throw std::exception("Constant buffer offsetting is not supported");
+	}
 }
 
 void Rove::DxRenderer::CreateSwapChain(int width, int height)
@@ -194,6 +244,11 @@ void Rove::DxRenderer::CreateRenderTargetAndDepthStencilView(int width, int heig
 	DX::Check(m_SwapChain->GetBuffer(0, __uuidof(ID3D11Resource), reinterpret_cast<void**>(m_BackBuffer.GetAddressOf())));
 	DX::Check(m_Device->CreateRenderTargetView(m_BackBuffer.Get(), nullptr, m_RenderTargetView.GetAddressOf()));
 
+	// Both buffers of the swap chain have the description of the back buffer
+	D3D11_TEXTURE2D_DESC back_buffer_desc = {};
+	m_BackBuffer->GetDesc(&back_buffer_desc);
+	m_SwapChainBytes.Set(DX::GetTextureBytes(back_buffer_desc) * 2);
+
 	// Describe the depth stencil view
 	D3D11_TEXTURE2D_DESC depth_desc = {};
 	depth_desc.Width = width;
@@ -209,6 +264,7 @@ void Rove::DxRenderer::CreateRenderTargetAndDepthStencilView(int width, int heig
 	// Create the depth stencil view
 	ComPtr<ID3D11Texture2D> depth_stencil = nullptr;
 	DX::Check(m_Device->CreateTexture2D(&depth_desc, nullptr, &depth_stencil));
+	m_DepthStencilBytes.Set(DX::GetTextureBytes(depth_desc));
 	DX::Check(m_Device->CreateDepthStencilView(depth_stencil.Get(), nullptr, m_DepthStencilView.GetAddressOf()));
 }
 
@@ -261,6 +317,7 @@ void Rove::DxRenderer::CreateMsaaRenderTargetView(int width, int height)
 	texture_desc.MiscFlags = 0;
 
 	DX::Check(m_Device->CreateTexture2D(&texture_desc, 0, m_MsaaTexture.ReleaseAndGetAddressOf()));
+	m_MsaaTextureBytes.Set(DX::GetTextureBytes(texture_desc));
 
 	// Create the render target view.
 	D3D11_RENDER_TARGET_VIEW_DESC target_view_desc = {};
@@ -287,6 +344,7 @@ void Rove::DxRenderer::CreateMsaaDepthStencilView(int width, int height)
 	ComPtr<ID3D11Texture2D> texture = nullptr;
 	DX::Check(m_Device->CreateTexture2D(&texture_desc, nullptr, texture.ReleaseAndGetAddressOf()));
 	DX::Check(m_Device->CreateDepthStencilView(texture.Get(), nullptr, m_MsaaDepthStencilView.ReleaseAndGetAddressOf()));
+	m_MsaaDepthStencilBytes.Set(DX::GetTextureBytes(texture_desc));
 }
 
 void Rove::DxRenderer::CreateAnisotropicFiltering()
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Pch.h"
+#include "DxStateCache.h"
+#include "MemoryTracker.h"
 
 namespace Rove
 {
@@ -16,6 +18,9 @@ namespace Rove
 			}
 #endif
 		}
+
+		// Bytes of every mip, slice and sample of a 2D texture from its descriptor
+		uint64_t GetTextureBytes(const D3D11_TEXTURE2D_DESC& desc);
 	}
 
 	// Forward declarations
@@ -46,6 +51,12 @@ namespace Rove
 		// Get Direct3D11 Device Context
 		ID3D11DeviceContext* GetDeviceContext() { return m_DeviceContext.Get(); }
 
+		// Get Direct3D11.1 Device Context for constant buffer offsets
+		ID3D11DeviceContext1* GetDeviceContext1() { return m_DeviceContext1.Get(); }
+
+		// Get the context wrapper that drops redundant pipeline state
+		DxStateCache* GetStateCache() { return m_StateCache.get(); }
+
 		// Set raster state as wireframe
 		void SetWireframeRasterState();
 
@@ -73,16 +84,20 @@ namespace Rove
 		// Device and device context
 		ComPtr<ID3D11Device> m_Device = nullptr;
 		ComPtr<ID3D11DeviceContext> m_DeviceContext = nullptr;
+		ComPtr<ID3D11DeviceContext1> m_DeviceContext1 = nullptr;
+		std::unique_ptr<DxStateCache> m_StateCache = nullptr;
 		void CreateDeviceAndContext();
 
 		// Swapchain
 		ComPtr<ID3D11Texture2D> m_BackBuffer = nullptr;
 		ComPtr<IDXGISwapChain1> m_SwapChain = nullptr;
+		CountedMemory m_SwapChainBytes = CountedMemory(MemoryTag::GpuTextures);
 		void CreateSwapChain(int width, int height);
 
 		// Render target and depth stencil view
 		ComPtr<ID3D11RenderTargetView> m_RenderTargetView = nullptr;
 		ComPtr<ID3D11DepthStencilView> m_DepthStencilView = nullptr;
+		CountedMemory m_DepthStencilBytes = CountedMemory(MemoryTag::GpuTextures);
 		void CreateRenderTargetAndDepthStencilView(int width, int height);
 
 		// Viewport
@@ -107,9 +122,11 @@ namespace Rove
 		void CreateMsaaRenderTargetView(int width, int height);
 		ComPtr<ID3D11Texture2D> m_MsaaTexture = nullptr;
 		ComPtr<ID3D11RenderTargetView> m_MsaaRenderTargetView = nullptr;
+		CountedMemory m_MsaaTextureBytes = CountedMemory(MemoryTag::GpuTextures);
 
 		void CreateMsaaDepthStencilView(int width, int height);
 		ComPtr<ID3D11DepthStencilView> m_MsaaDepthStencilView = nullptr;
+		CountedMemory m_MsaaDepthStencilBytes = CountedMemory(MemoryTag::GpuTextures);
 
 		// Texture sampling
 		ComPtr<ID3D11SamplerState> m_AnisotropicSampler = nullptr;
@@ -1,6 +1,35 @@
 #include "Pch.h"
 #include "DxShader.h"
 #include "DxRenderer.h"
+#include "LightClusters.h"
+#include "LightList.h"
+
+namespace
+{
+	// Room for 1024 draws, the ring doubles when a frame needs more
+	constexpr UINT INITIAL_WORLD_CONSTANT_BUFFER_SIZE = 1024 * Rove::DxShader::WORLD_CONSTANT_BYTES;
+
+	// Room for 4096 instances, grown the same way
+	constexpr UINT INITIAL_INSTANCE_BUFFER_SIZE = 4096 * Rove::DxShader::INSTANCE_STRIDE;
+
+	// Room for 16384 light indices, doubled when a frame needs more
+	constexpr UINT INITIAL_LIGHT_INDEX_COUNT = 16384;
+
+	// Room for 1024 point lights, doubled when the scene has more
+	constexpr UINT INITIAL_POINT_LIGHT_COUNT = 1024;
+
+	// Smallest staging buffer, enough for 1024 lights
+	constexpr UINT MIN_STAGING_BUFFER_SIZE = 1024 * sizeof(Rove::PointLightStruct);
+
+	// Shader sources the variants are compiled from, found next to the executable like the prebuilt shaders
+	const char* VERTEX_SHADER_SOURCE = "VertexShader.hlsl";
+	const char* INSTANCED_VERTEX_SHADER_SOURCE = "VertexShaderInstanced.hlsl";
+	const char* PIXEL_SHADER_SOURCE = "PixelShader.hlsl";
+	const char* SHADER_DATA_SOURCE = "ShaderData.hlsli";
+
+	// Directory the compiled variants are cached in
+	const char* SHADER_CACHE_DIRECTORY = "ShaderCache";
+}
 
 Rove::DxShader::DxShader(DxRenderer* renderer) : m_DxRenderer(renderer)
 {
@@ -9,64 +38,446 @@ Rove::DxShader::DxShader(DxRenderer* renderer) : m_DxRenderer(renderer)
 void Rove::DxShader::Load()
 {
 	CreateCameraConstantBuffer();
-	CreateWorldConstantBuffer();
-	CreatePointLightConstantBuffer();
-	CreateMaterialConstantBuffer();
+	CreateWorldConstantBuffer(INITIAL_WORLD_CONSTANT_BUFFER_SIZE);
+	CreateInstanceBuffer(INITIAL_INSTANCE_BUFFER_SIZE);
+	CreatePointLightBuffer(INITIAL_POINT_LIGHT_COUNT);
+	CreateClusterBuffers();
 
-	LoadVertexShader("VertexShader.cso");
+	LoadVertexShader("VertexShader.cso", false);
+	LoadVertexShader("VertexShaderInstanced.cso", true);
 	LoadPixelShader("PixelShader.cso");
+
+	// Editing any source changes the hash and so the names of the cached variants
+	uint64_t source_hash = ShaderVariantCache::HashFiles({ SHADER_DATA_SOURCE, VERTEX_SHADER_SOURCE, INSTANCED_VERTEX_SHADER_SOURCE, PIXEL_SHADER_SOURCE });
+	m_VariantCache = std::make_unique<ShaderVariantCache>(SHADER_CACHE_DIRECTORY, source_hash, [this](ShaderStage stage, ShaderKey key, std::vector<uint8_t>& bytecode, std::string& error)
+	{
+		return CompileVariant(stage, key, bytecode, error);
+	});
+
+	m_Variants.clear();
 }
 
 void Rove::DxShader::Apply()
 {
-	auto deviceContext = m_DxRenderer->GetDeviceContext();
+	auto state_cache = m_DxRenderer->GetStateCache();
 
 	// Bind the input layout to the pipeline's Input Assembler stage
-	deviceContext->IASetInputLayout(m_VertexLayout.Get());
+	state_cache->IASetInputLayout(m_VertexLayout.Get());
 
 	// Bind the vertex shader to the pipeline's Vertex Shader stage
-	deviceContext->VSSetShader(m_VertexShader.Get(), nullptr, 0);
+	state_cache->VSSetShader(m_VertexShader.Get());
 
 	// Bind the pixel shader to the pipeline's Pixel Shader stage
-	deviceContext->PSSetShader(m_PixelShader.Get(), nullptr, 0);
+	state_cache->PSSetShader(m_PixelShader.Get());
 
-	// Bind the world constant buffer to the vertex shader
-	deviceContext->VSSetConstantBuffers(0, 1, m_CameraConstantBuffer.GetAddressOf());
-	deviceContext->VSSetConstantBuffers(1, 1, m_WorldConstantBuffer.GetAddressOf());
+	// Bind the camera constant buffer to the vertex shader, the world constants are bound per draw
+	state_cache->VSSetConstantBuffer(0, m_CameraConstantBuffer.Get());
 
-	// Bind the light constant buffer to pixel shader
-	deviceContext->PSSetConstantBuffers(0, 1, m_CameraConstantBuffer.GetAddressOf());
-	deviceContext->PSSetConstantBuffers(2, 1, m_PointLightConstantBuffer.GetAddressOf());
+	// Bind the camera constant buffer to pixel shader
+	state_cache->PSSetConstantBuffer(0, m_CameraConstantBuffer.Get());
 
-	// Bind material buffer to pixel shader
-	deviceContext->PSSetConstantBuffers(3, 1, m_MaterialConstantBuffer.GetAddressOf());
+	// Bind the cluster grid, the light lists of the clusters and the lights
+	ID3D11ShaderResourceView* light_views[] = { m_ClusterView.Get(), m_LightIndexView.Get(), m_PointLightView.Get() };
+	state_cache->PSSetConstantBuffer(4, m_ClusterConstantBuffer.Get());
+	state_cache->PSSetShaderResources(2, 3, light_views);
 }
 
 void Rove::DxShader::UpdateCameraBuffer(const CameraBuffer& buffer)
 {
 	auto deviceContext = m_DxRenderer->GetDeviceContext();
 	deviceContext->UpdateSubresource(m_CameraConstantBuffer.Get(), 0, nullptr, &buffer, 0, 0);
+	m_UploadedBytes += sizeof(CameraBuffer);
+	m_ConstantBytes += sizeof(CameraBuffer);
+}
+
+UINT Rove::DxShader::UpdateWorldConstants(const WorldBuffer* buffers, const ObjectLightList* light_lists, size_t count)
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	// Reclaim the slices of frames the GPU has finished with
+	PollFrameQueries(false);
+
+	uint64_t size = static_cast<uint64_t>(count) * WORLD_CONSTANT_BYTES;
+	uint64_t offset = m_WorldConstantRing.Allocate(size);
+	if (offset == RingAllocator::INVALID_OFFSET)
+	{
+		// A new buffer cannot be in use so the frames in flight on the old one are left to the runtime
+		uint64_t new_size = std::max<uint64_t>(m_WorldConstantRing.GetSize() * 2, size);
+		CreateWorldConstantBuffer(static_cast<UINT>(new_size));
+		offset = m_WorldConstantRing.Allocate(size);
+	}
+
+	// The first map of a new buffer discards, after that the ring guarantees the slices are not in use
+	auto deviceContext = m_DxRenderer->GetDeviceContext();
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	DX::Check(deviceContext->Map(m_WorldConstantBuffer.Get(), 0, m_WorldConstantBufferCreated ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped));
+	m_WorldConstantBufferCreated = false;
+
+	WriteWorldConstants(static_cast<uint8_t*>(mapped.pData) + offset, buffers, light_lists, count);
+
+	deviceContext->Unmap(m_WorldConstantBuffer.Get(), 0);
+	m_UploadedBytes += size;
+	m_ConstantBytes += size;
+	return static_cast<UINT>(offset / 16);
+}
+
+void Rove::DxShader::WriteWorldConstants(uint8_t* destination, const WorldBuffer* buffers, const ObjectLightList* light_lists, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		std::memcpy(destination + i * WORLD_CONSTANT_BYTES, &buffers[i], sizeof(WorldBuffer));
+	}
+
+	static_assert(sizeof(WorldBuffer) + sizeof(ObjectLightList) <= WORLD_CONSTANT_BYTES, "Light list must fit in the world constants");
+	if (light_lists != nullptr)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			std::memcpy(destination + i * WORLD_CONSTANT_BYTES + sizeof(WorldBuffer), &light_lists[i], sizeof(ObjectLightList));
+		}
+	}
+}
+
+void Rove::DxShader::BindWorldConstants(UINT first_constant, DxStateCache* state_cache)
+{
+	state_cache->VSSetConstantBuffer1(1, m_WorldConstantBuffer.Get(), first_constant, WORLD_CONSTANTS);
+	state_cache->PSSetConstantBuffer1(1, m_WorldConstantBuffer.Get(), first_constant, WORLD_CONSTANTS);
+}
+
+UINT Rove::DxShader::UpdateInstances(const WorldBuffer* buffers, size_t count)
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	// Reclaim the instances of frames the GPU has finished with
+	PollFrameQueries(false);
+
+	uint64_t size = static_cast<uint64_t>(count) * INSTANCE_STRIDE;
+	uint64_t offset = m_InstanceRing.Allocate(size);
+	if (offset == RingAllocator::INVALID_OFFSET)
+	{
+		uint64_t new_size = std::max<uint64_t>(m_InstanceRing.GetSize() * 2, size);
+		CreateInstanceBuffer(static_cast<UINT>(new_size));
+		offset = m_InstanceRing.Allocate(size);
+	}
+
+	// Instances are tightly packed so the whole range is one copy
+	auto deviceContext = m_DxRenderer->GetDeviceContext();
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	DX::Check(deviceContext->Map(m_InstanceBuffer.Get(), 0, m_InstanceBufferCreated ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped));
+	m_InstanceBufferCreated = false;
+
+	std::memcpy(static_cast<uint8_t*>(mapped.pData) + offset, buffers, static_cast<size_t>(size));
+
+	deviceContext->Unmap(m_InstanceBuffer.Get(), 0);
+	m_UploadedBytes += size;
+	return static_cast<UINT>(offset / INSTANCE_STRIDE);
+}
+
+void Rove::DxShader::CreateVariants()
+{
+	auto device = m_DxRenderer->GetDevice();
+	for (size_t i = m_Variants.size(); i < m_VariantCache->GetVariantCount(); ++i)
+	{
+		ShaderKey key = m_VariantCache->GetKey(static_cast<uint16_t>(i));
+
+		Variant variant;
+		variant.instanced = (key & ShaderPermutation::INSTANCING) != 0;
+		variant.vertex_shader = variant.instanced ? m_InstancedVertexShader : m_VertexShader;
+		variant.vertex_layout = variant.instanced ? m_InstancedVertexLayout : m_VertexLayout;
+		variant.pixel_shader = m_PixelShader;
+
+		// Both stages come from the same sources or neither does, so their signatures always match
+		if ((key & ShaderPermutation::PERMUTATION) != 0)
+		{
+			const std::vector<uint8_t>* vertex_bytecode = m_VariantCache->GetBytecode(ShaderStage::Vertex, key);
+			const std::vector<uint8_t>* pixel_bytecode = m_VariantCache->GetBytecode(ShaderStage::Pixel, key);
+			if (vertex_bytecode != nullptr && pixel_bytecode != nullptr)
+			{
+				DX::Check(device->CreateVertexShader(vertex_bytecode->data(), vertex_bytecode->size(), nullptr, variant.vertex_shader.ReleaseAndGetAddressOf()));
+				CreateInputLayout(vertex_bytecode->data(), vertex_bytecode->size(), variant.instanced, variant.vertex_layout);
+				DX::Check(device->CreatePixelShader(pixel_bytecode->data(), pixel_bytecode->size(), nullptr, variant.pixel_shader.ReleaseAndGetAddressOf()));
+			}
+		}
+
+		m_Variants.push_back(std::move(variant));
+	}
+}
+
+void Rove::DxShader::ApplyVariant(uint16_t variant, DxStateCache* state_cache)
+{
+	const Variant& shaders = m_Variants[variant];
+	if (shaders.instanced)
+	{
+		// The instance stream is bound from the start of the ring, draws select their range by the start instance
+		state_cache->IASetVertexBuffer(1, m_InstanceBuffer.Get(), INSTANCE_STRIDE, 0);
+	}
+
+	state_cache->IASetInputLayout(shaders.vertex_layout.Get());
+	state_cache->VSSetShader(shaders.vertex_shader.Get());
+	state_cache->PSSetShader(shaders.pixel_shader.Get());
+}
+
+bool Rove::DxShader::CompileVariant(ShaderStage stage, ShaderKey key, std::vector<uint8_t>& bytecode, std::string& error)
+{
+	bool vertex = stage == ShaderStage::Vertex;
+	std::filesystem::path path = PIXEL_SHADER_SOURCE;
+	if (vertex)
+	{
+		path = (key & ShaderPermutation::INSTANCING) != 0 ? INSTANCED_VERTEX_SHADER_SOURCE : VERTEX_SHADER_SOURCE;
+	}
+
+	// Without the sources the variant falls back to the uber shaders
+	if (!std::filesystem::exists(path))
+	{
+		error = path.string() + " not found";
+		return false;
+	}
+
+	std::vector<std::pair<std::string, std::string>> defines = ShaderPermutation::GetDefines(key);
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (auto& define : defines)
+	{
+		macros.push_back({ define.first.c_str(), define.second.c_str() });
+	}
+
+	macros.push_back({ nullptr, nullptr });
+
+	ComPtr<ID3DBlob> blob = nullptr;
+	ComPtr<ID3DBlob> errors = nullptr;
+	UINT flags = D3DCOMPILE_ENABLE_STRICTNESS | D3DCOMPILE_OPTIMIZATION_LEVEL3;
+	HRESULT hr = D3DCompileFromFile(path.wstring().c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, "main", vertex ? "vs_5_0" : "ps_5_0", flags, 0, blob.GetAddressOf(), errors.GetAddressOf());
+	if (FAILED(hr))
+	{
+		error = errors != nullptr ? static_cast<const char*>(errors->GetBufferPointer()) : "D3DCompileFromFile failed";
+		return false;
+	}
+
+	const uint8_t* data = static_cast<const uint8_t*>(blob->GetBufferPointer());
+	bytecode.assign(data, data + blob->GetBufferSize());
+	return true;
+}
+
+void Rove::DxShader::FinishFrame()
+{
+	// Reusing a query still in flight would lose its frame, wait for it first
+	if (m_FrameFence >= MAX_FRAMES_IN_FLIGHT && m_CompletedFence <= m_FrameFence - MAX_FRAMES_IN_FLIGHT)
+	{
+		PollFrameQueries(true);
+	}
+
+	++m_FrameFence;
+	m_DxRenderer->GetDeviceContext()->End(m_FrameQueries[m_FrameFence % MAX_FRAMES_IN_FLIGHT].Get());
+	m_WorldConstantRing.FinishFrame(m_FrameFence);
+	m_InstanceRing.FinishFrame(m_FrameFence);
 }
 
-void Rove::DxShader::UpdateWorldConstantBuffer(const WorldBuffer& worldBuffer)
+void Rove::DxShader::PollFrameQueries(bool wait)
 {
 	auto deviceContext = m_DxRenderer->GetDeviceContext();
-	deviceContext->UpdateSubresource(m_WorldConstantBuffer.Get(), 0, nullptr, &worldBuffer, 0, 0);
+
+	// Queries complete in order so stop at the first one still pending, waiting only blocks on the oldest
+	while (m_CompletedFence < m_FrameFence)
+	{
+		ID3D11Query* query = m_FrameQueries[(m_CompletedFence + 1) % MAX_FRAMES_IN_FLIGHT].Get();
+		HRESULT hr = deviceContext->GetData(query, nullptr, 0, wait ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH);
+		if (hr == S_OK)
+		{
+			++m_CompletedFence;
+			wait = false;
+		}
+		else if (!wait)
+		{
+			break;
+		}
+	}
+
+	m_WorldConstantRing.ReleaseCompletedFrames(m_CompletedFence);
+	m_InstanceRing.ReleaseCompletedFrames(m_CompletedFence);
 }
 
-void Rove::DxShader::UpdatePointLightBuffer(const PointLightBuffer& buffer)
+void Rove::DxShader::UpdatePointLights(LightList& lights)
 {
+	auto start = std::chrono::high_resolution_clock::now();
 	auto deviceContext = m_DxRenderer->GetDeviceContext();
-	deviceContext->UpdateSubresource(m_PointLightConstantBuffer.Get(), 0, nullptr, &buffer, 0, 0);
+	m_LightUploadStats = LightUploadStats();
+
+	// Grow to the next power of two, the lights already on the GPU are copied across so only the dirty ones are uploaded
+	if (lights.Size() > m_PointLightCapacity)
+	{
+		UINT capacity = m_PointLightCapacity;
+		while (capacity < lights.Size())
+		{
+			capacity *= 2;
+		}
+
+		ComPtr<ID3D11Buffer> old_buffer = m_PointLightBuffer;
+		CreatePointLightBuffer(capacity);
+		deviceContext->CopySubresourceRegion(m_PointLightBuffer.Get(), 0, 0, 0, 0, old_buffer.Get(), 0, nullptr);
+	}
+
+	const std::vector<LightRange>& ranges = lights.GetDirtyRanges();
+	m_LightUploadStats.light_count = static_cast<int>(lights.Size());
+	m_LightUploadStats.dirty_lights = static_cast<int>(lights.GetDirtyCount());
+	m_LightUploadStats.ranges = static_cast<int>(ranges.size());
+
+	if (!ranges.empty())
+	{
+		UINT size = 0;
+		for (const LightRange& range : ranges)
+		{
+			size += range.count * sizeof(PointLightStruct);
+		}
+
+		// Pack the ranges one after another into the staging buffer
+		ID3D11Buffer* staging = AcquireStagingBuffer(size);
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		DX::Check(deviceContext->Map(staging, 0, D3D11_MAP_WRITE, 0, &mapped));
+
+		PointLightStruct* destination = static_cast<PointLightStruct*>(mapped.pData);
+		for (const LightRange& range : ranges)
+		{
+			for (uint32_t i = range.first; i < range.first + range.count; ++i)
+			{
+				const DirectX::XMFLOAT4& sphere = lights.GetSpheres()[i];
+				destination->position = DirectX::XMFLOAT3(sphere.x, sphere.y, sphere.z);
+				destination->radius = sphere.w;
+				destination->diffuse = lights.GetDiffuse()[i];
+				destination->ambient = lights.GetAmbient()[i];
+				destination->specular = lights.GetSpecular()[i];
+				++destination;
+			}
+		}
+
+		deviceContext->Unmap(staging, 0);
+
+		// One copy for each range into its place in the light buffer
+		UINT source_offset = 0;
+		for (const LightRange& range : ranges)
+		{
+			D3D11_BOX box = {};
+			box.left = source_offset;
+			box.right = source_offset + range.count * sizeof(PointLightStruct);
+			box.bottom = 1;
+			box.back = 1;
+
+			deviceContext->CopySubresourceRegion(m_PointLightBuffer.Get(), 0, range.first * sizeof(PointLightStruct), 0, 0, staging, 0, &box);
+			source_offset = box.right;
+		}
+
+		m_LightUploadStats.bytes += size;
+		m_UploadedBytes += size;
+	}
+
+	lights.ClearDirty();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_LightUploadStats.staging_buffers = static_cast<int>(m_StagingBuffers.size());
+	m_LightUploadStats.microseconds = std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+ID3D11Buffer* Rove::DxShader::AcquireStagingBuffer(UINT size)
+{
+	// Mapping a staging buffer the GPU still copies from would stall, so only buffers of completed frames are reused
+	PollFrameQueries(false);
+
+	StagingBuffer* staging = nullptr;
+	for (StagingBuffer& buffer : m_StagingBuffers)
+	{
+		if (buffer.fence <= m_CompletedFence && buffer.size >= size)
+		{
+			staging = &buffer;
+			break;
+		}
+	}
+
+	if (staging == nullptr)
+	{
+		UINT buffer_size = MIN_STAGING_BUFFER_SIZE;
+		while (buffer_size < size)
+		{
+			buffer_size *= 2;
+		}
+
+		D3D11_BUFFER_DESC bd = {};
+		bd.Usage = D3D11_USAGE_STAGING;
+		bd.ByteWidth = buffer_size;
+		bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+		m_StagingBuffers.emplace_back();
+		staging = &m_StagingBuffers.back();
+		staging->size = buffer_size;
+		DX::Check(m_DxRenderer->GetDevice()->CreateBuffer(&bd, nullptr, staging->buffer.ReleaseAndGetAddressOf()));
+		staging->bytes.Set(bd.ByteWidth);
+	}
+
+	// The copies are recorded in the frame that finishes with the next fence
+	staging->fence = m_FrameFence + 1;
+	return staging->buffer.Get();
 }
 
-void Rove::DxShader::UpdateMaterialBuffer(const MaterialBuffer& buffer)
+void Rove::DxShader::UpdateLightClusters(const LightClusters* clusters, int width, int height)
 {
 	auto deviceContext = m_DxRenderer->GetDeviceContext();
-	deviceContext->UpdateSubresource(m_MaterialConstantBuffer.Get(), 0, nullptr, &buffer, 0, 0);
+
+	ClusterBuffer cluster_buffer = {};
+	cluster_buffer.grid[0] = LightClusters::GRID_X;
+	cluster_buffer.grid[1] = LightClusters::GRID_Y;
+	cluster_buffer.grid[2] = LightClusters::GRID_Z;
+	cluster_buffer.screen_width = static_cast<float>(width);
+	cluster_buffer.screen_height = static_cast<float>(height);
+	cluster_buffer.per_object_lights = clusters == nullptr ? 1 : 0;
+	if (clusters != nullptr)
+	{
+		cluster_buffer.depth_scale = clusters->GetDepthScale();
+		cluster_buffer.depth_bias = clusters->GetDepthBias();
+	}
+
+	deviceContext->UpdateSubresource(m_ClusterConstantBuffer.Get(), 0, nullptr, &cluster_buffer, 0, 0);
+	m_UploadedBytes += sizeof(cluster_buffer);
+	m_ConstantBytes += sizeof(cluster_buffer);
+	if (clusters == nullptr)
+	{
+		return;
+	}
+
+	// Light ranges of the clusters
+	const std::vector<LightCluster>& ranges = clusters->GetClusters();
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	DX::Check(deviceContext->Map(m_ClusterBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+	std::memcpy(mapped.pData, ranges.data(), ranges.size() * sizeof(LightCluster));
+	deviceContext->Unmap(m_ClusterBuffer.Get(), 0);
+	m_UploadedBytes += ranges.size() * sizeof(LightCluster);
+
+	// Grow the index buffer to the next power of two when the list outgrew it, the views bound to the pixel shader change
+	const std::vector<uint32_t>& indices = clusters->GetLightIndices();
+	if (indices.size() > m_LightIndexCapacity)
+	{
+		UINT capacity = m_LightIndexCapacity;
+		while (capacity < indices.size())
+		{
+			capacity *= 2;
+		}
+
+		CreateStructuredBuffer(sizeof(uint32_t), capacity, D3D11_USAGE_DYNAMIC, m_LightIndexBuffer, m_LightIndexView, m_LightIndexBytes);
+		m_LightIndexCapacity = capacity;
+	}
+
+	if (!indices.empty())
+	{
+		DX::Check(deviceContext->Map(m_LightIndexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+		std::memcpy(mapped.pData, indices.data(), indices.size() * sizeof(uint32_t));
+		deviceContext->Unmap(m_LightIndexBuffer.Get(), 0);
+		m_UploadedBytes += indices.size() * sizeof(uint32_t);
+	}
 }
 
-void Rove::DxShader::LoadVertexShader(std::string&& vertex_shader_path)
+void Rove::DxShader::LoadVertexShader(std::string&& vertex_shader_path, bool instanced)
 {
 	auto device = m_DxRenderer->GetDevice();
 
@@ -82,19 +493,36 @@ void Rove::DxShader::LoadVertexShader(std::string&& vertex_shader_path)
 	std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
 
 	// Create the vertex shader
-	DX::Check(device->CreateVertexShader(data.data(), data.size(), nullptr, m_VertexShader.ReleaseAndGetAddressOf()));
+	ComPtr<ID3D11VertexShader>& vertex_shader = instanced ? m_InstancedVertexShader : m_VertexShader;
+	DX::Check(device->CreateVertexShader(data.data(), data.size(), nullptr, vertex_shader.ReleaseAndGetAddressOf()));
 
-	// Describe the memory layout
+	ComPtr<ID3D11InputLayout>& vertex_layout = instanced ? m_InstancedVertexLayout : m_VertexLayout;
+	CreateInputLayout(data.data(), data.size(), instanced, vertex_layout);
+}
+
+void Rove::DxShader::CreateInputLayout(const void* bytecode, size_t size, bool instanced, ComPtr<ID3D11InputLayout>& vertex_layout)
+{
+	auto device = m_DxRenderer->GetDevice();
+
+	// Describe the memory layout, the instanced shader also reads the world constants from the second slot per instance
 	D3D11_INPUT_ELEMENT_DESC layout[] =
 	{
 		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 32, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLDINVERSE", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 64, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLDINVERSE", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 80, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLDINVERSE", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 96, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLDINVERSE", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 112, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
 	};
 
-	UINT numElements = ARRAYSIZE(layout);
-	DX::Check(device->CreateInputLayout(layout, numElements, data.data(), data.size(), m_VertexLayout.ReleaseAndGetAddressOf()));
+	UINT numElements = instanced ? ARRAYSIZE(layout) : 4;
+	DX::Check(device->CreateInputLayout(layout, numElements, bytecode, size, vertex_layout.ReleaseAndGetAddressOf()));
 }
 
 void Rove::DxShader::LoadPixelShader(std::string&& pixel_shader_path)
@@ -128,43 +556,99 @@ void Rove::DxShader::CreateCameraConstantBuffer()
 	//bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 
 	DX::Check(device->CreateBuffer(&bd, nullptr, m_CameraConstantBuffer.ReleaseAndGetAddressOf()));
+	m_CameraConstantBytes.Set(bd.ByteWidth);
 }
 
-void Rove::DxShader::CreateWorldConstantBuffer()
+void Rove::DxShader::CreateWorldConstantBuffer(UINT size)
 {
 	auto device = m_DxRenderer->GetDevice();
 
-	// Create world constant buffer
+	// Create world constant ring, large enough for every draw of a frame
 	D3D11_BUFFER_DESC bd = {};
-	bd.Usage = D3D11_USAGE_DEFAULT;
-	bd.ByteWidth = sizeof(WorldBuffer);
+	bd.Usage = D3D11_USAGE_DYNAMIC;
+	bd.ByteWidth = size;
 	bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 
 	DX::Check(device->CreateBuffer(&bd, nullptr, m_WorldConstantBuffer.ReleaseAndGetAddressOf()));
+	m_WorldConstantBytes.Set(bd.ByteWidth);
+	m_WorldConstantRing.Reset(size);
+	m_WorldConstantBufferCreated = true;
+
+	// Frame fence queries
+	if (m_FrameQueries[0] == nullptr)
+	{
+		D3D11_QUERY_DESC query_desc = {};
+		query_desc.Query = D3D11_QUERY_EVENT;
+
+		for (ComPtr<ID3D11Query>& query : m_FrameQueries)
+		{
+			DX::Check(device->CreateQuery(&query_desc, query.ReleaseAndGetAddressOf()));
+		}
+	}
 }
 
-void Rove::DxShader::CreatePointLightConstantBuffer()
+void Rove::DxShader::CreateInstanceBuffer(UINT size)
 {
 	auto device = m_DxRenderer->GetDevice();
 
-	// Create point light constant buffer
+	// Create instance ring, large enough for every instance of a frame
 	D3D11_BUFFER_DESC bd = {};
-	bd.Usage = D3D11_USAGE_DEFAULT;
-	bd.ByteWidth = sizeof(PointLightBuffer);
-	bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bd.Usage = D3D11_USAGE_DYNAMIC;
+	bd.ByteWidth = size;
+	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	DX::Check(device->CreateBuffer(&bd, nullptr, m_InstanceBuffer.ReleaseAndGetAddressOf()));
+	m_InstanceBytes.Set(bd.ByteWidth);
+	m_InstanceRing.Reset(size);
+	m_InstanceBufferCreated = true;
+}
 
-	DX::Check(device->CreateBuffer(&bd, nullptr, m_PointLightConstantBuffer.ReleaseAndGetAddressOf()));
+void Rove::DxShader::CreatePointLightBuffer(UINT capacity)
+{
+	CreateStructuredBuffer(sizeof(PointLightStruct), capacity, D3D11_USAGE_DEFAULT, m_PointLightBuffer, m_PointLightView, m_PointLightBytes);
+	m_PointLightCapacity = capacity;
 }
 
-void Rove::DxShader::CreateMaterialConstantBuffer()
+void Rove::DxShader::CreateClusterBuffers()
 {
 	auto device = m_DxRenderer->GetDevice();
 
-	// Create point light constant buffer
+	// Create cluster grid constant buffer
 	D3D11_BUFFER_DESC bd = {};
 	bd.Usage = D3D11_USAGE_DEFAULT;
-	bd.ByteWidth = sizeof(MaterialBuffer);
+	bd.ByteWidth = sizeof(ClusterBuffer);
 	bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
 
-	DX::Check(device->CreateBuffer(&bd, nullptr, m_MaterialConstantBuffer.ReleaseAndGetAddressOf()));
+	DX::Check(device->CreateBuffer(&bd, nullptr, m_ClusterConstantBuffer.ReleaseAndGetAddressOf()));
+	m_ClusterConstantBytes.Set(bd.ByteWidth);
+
+	CreateStructuredBuffer(sizeof(LightCluster), LightClusters::CLUSTER_COUNT, D3D11_USAGE_DYNAMIC, m_ClusterBuffer, m_ClusterView, m_ClusterBytes);
+	CreateStructuredBuffer(sizeof(uint32_t), INITIAL_LIGHT_INDEX_COUNT, D3D11_USAGE_DYNAMIC, m_LightIndexBuffer, m_LightIndexView, m_LightIndexBytes);
+	m_LightIndexCapacity = INITIAL_LIGHT_INDEX_COUNT;
+}
+
+void Rove::DxShader::CreateStructuredBuffer(UINT stride, UINT count, D3D11_USAGE usage, ComPtr<ID3D11Buffer>& buffer, ComPtr<ID3D11ShaderResourceView>& view, CountedMemory& bytes)
+{
+	auto device = m_DxRenderer->GetDevice();
+
+	// Create a structured buffer, dynamic ones are rewritten with Map each frame and default ones by copies
+	D3D11_BUFFER_DESC bd = {};
+	bd.Usage = usage;
+	bd.ByteWidth = stride * count;
+	bd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	bd.CPUAccessFlags = usage == D3D11_USAGE_DYNAMIC ? D3D11_CPU_ACCESS_WRITE : 0;
+	bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	bd.StructureByteStride = stride;
+
+	DX::Check(device->CreateBuffer(&bd, nullptr, buffer.ReleaseAndGetAddressOf()));
+	bytes.Set(bd.ByteWidth);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
+	srv_desc.Format = DXGI_FORMAT_UNKNOWN;
+	srv_desc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srv_desc.Buffer.NumElements = count;
+
+	DX::Check(device->CreateShaderResourceView(buffer.Get(), &srv_desc, view.ReleaseAndGetAddressOf()));
 }
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "Pch.h"
+#include "RingAllocator.h"
+#include "ObjectLights.h"
+#include "ShaderVariantCache.h"
+#include "MemoryTracker.h"
 
 namespace Rove
 {
@@ -18,25 +22,42 @@ namespace Rove
 		DirectX::XMMATRIX worldInverse;
 	};
 
+	// Point light as the shader reads it from the structured buffer
 	struct PointLightStruct
 	{
 		DirectX::XMFLOAT3 position;
-		float padding;
+		float radius;
 
 		DirectX::XMFLOAT4 diffuse;
 		DirectX::XMFLOAT4 ambient;
 		DirectX::XMFLOAT4 specular;
 	};
 
-	struct PointLightBuffer
+	// Lights written to the point light buffer by the last upload
+	struct LightUploadStats
 	{
-		int lightCount;
-		DirectX::XMFLOAT3 padding;
+		int light_count = 0;
+		int dirty_lights = 0;
+		int ranges = 0;
+		UINT bytes = 0;
+		int staging_buffers = 0;
+		double microseconds = 0.0;
+	};
 
-		PointLightStruct pointLight[255];
+	// Cluster grid constants, the pixel shader finds its cluster from the screen position and the view depth
+	struct ClusterBuffer
+	{
+		uint32_t grid[3];
+		float depth_scale;
+		float screen_width;
+		float screen_height;
+		float depth_bias;
+
+		// Non zero when the draws are shaded with their own light lists instead of the clusters
+		uint32_t per_object_lights;
 	};
 
-	// Material
+	// Material constants, each material in the table has its own immutable buffer
 	struct MaterialBuffer
 	{
 		int diffuse_texture;
@@ -49,6 +70,9 @@ namespace Rove
 	};
 
 	class DxRenderer;
+	class DxStateCache;
+	class LightClusters;
+	class LightList;
 
 	class DxShader
 	{
@@ -62,43 +86,158 @@ namespace Rove
 		// Update camera buffer
 		void UpdateCameraBuffer(const CameraBuffer& buffer);
 
-		// Set world constant buffer from camera
-		void UpdateWorldConstantBuffer(const WorldBuffer& worldBuffer);
+		// Each draw gets a 256 byte slice of the world constant ring, which is 16 shader constants
+		static constexpr UINT WORLD_CONSTANT_BYTES = 256;
+		static constexpr UINT WORLD_CONSTANTS = WORLD_CONSTANT_BYTES / 16;
 
-		// Update camera buffer
-		void UpdatePointLightBuffer(const PointLightBuffer& buffer);
+		// Writes the world constants of a frame into the ring with a single map, returns the first shader constant of the
+		// first buffer and each buffer after it is WORLD_CONSTANTS further on. The light list of each draw follows its
+		// world matrices when lists are given.
+		UINT UpdateWorldConstants(const WorldBuffer* buffers, const ObjectLightList* light_lists, size_t count);
+
+		// Writes world constants in the layout of the ring, WORLD_CONSTANT_BYTES for each buffer
+		static void WriteWorldConstants(uint8_t* destination, const WorldBuffer* buffers, const ObjectLightList* light_lists, size_t count);
+
+		// Binds the world constants starting at a shader constant to the vertex and pixel shaders of the context behind a
+		// state cache, the pixel shader reads the light list of the draw from them
+		void BindWorldConstants(UINT first_constant, DxStateCache* state_cache);
+
+		// Instanced draws read the world constants of each instance from a vertex stream instead of the constant buffer
+		static constexpr UINT INSTANCE_STRIDE = sizeof(WorldBuffer);
+
+		// Writes the world constants of every instance drawn this frame into the instance ring with a single map, returns
+		// the index of the first instance to pass as the start instance location
+		UINT UpdateInstances(const WorldBuffer* buffers, size_t count);
+
+		// Index of the shader variant of a key, stored in the draw commands
+		uint16_t GetVariant(ShaderKey key) { return m_VariantCache->GetVariant(key); }
+
+		// Creates the shaders of the variants added since the last call from the variant cache. A variant the cache cannot
+		// load or compile, or an uber key, uses the prebuilt uber shaders.
+		void CreateVariants();
+
+		// Binds the shaders and input layout of a variant, instanced variants also bind the instance stream
+		void ApplyVariant(uint16_t variant, DxStateCache* state_cache);
+
+		// Variants created and the lookups, loads and compiles of the variant cache
+		size_t GetVariantCount() const { return m_Variants.size(); }
+		const ShaderCacheStats& GetShaderCacheStats() const { return m_VariantCache->GetStats(); }
+
+		// Fences the world constants written this frame so the ring reuses them once the GPU is done
+		void FinishFrame();
+
+		// Copies the lights changed since the last upload into the point light buffer through the staging ring, the buffer
+		// grows to hold every light
+		void UpdatePointLights(LightList& lights);
+
+		// Result of the last point light upload
+		const LightUploadStats& GetLightUploadStats() const { return m_LightUploadStats; }
+
+		// Uploads the light range of every cluster and the packed light indices, the index buffer grows when a frame needs more.
+		// Without clusters the pixel shader reads the light list of each draw from its world constants instead.
+		void UpdateLightClusters(const LightClusters* clusters, int width, int height);
+
+		// Bytes written into constant, instance and light buffers since the shader was created
+		uint64_t GetUploadedBytes() const { return m_UploadedBytes; }
+
+		// Bytes of those written into constant buffers
+		uint64_t GetConstantBytes() const { return m_ConstantBytes; }
 
-		// Update material buffer
-		void UpdateMaterialBuffer(const MaterialBuffer& buffer);
-		
 	private:
 		DxRenderer* m_DxRenderer = nullptr;
 
 		// Vertex shader
 		ComPtr<ID3D11VertexShader> m_VertexShader = nullptr;
-		void LoadVertexShader(std::string&& vertex_shader_path);
+		void LoadVertexShader(std::string&& vertex_shader_path, bool instanced);
 
 		// Vertex shader input layout
 		ComPtr<ID3D11InputLayout> m_VertexLayout = nullptr;
+
+		// Instanced vertex shader and its input layout with the instance stream in the second slot
+		ComPtr<ID3D11VertexShader> m_InstancedVertexShader = nullptr;
+		ComPtr<ID3D11InputLayout> m_InstancedVertexLayout = nullptr;
 		void LoadPixelShader(std::string&& pixel_shader_path);
 
 		// Pixel shader
 		ComPtr<ID3D11PixelShader> m_PixelShader = nullptr;
 
+		// Input layout of the vertex stream, with the instance stream in the second slot when instanced
+		void CreateInputLayout(const void* bytecode, size_t size, bool instanced, ComPtr<ID3D11InputLayout>& vertex_layout);
+
+		// Shader variants by index, the bytecode is compiled from the shader sources and cached on disk
+		struct Variant
+		{
+			bool instanced = false;
+			ComPtr<ID3D11VertexShader> vertex_shader;
+			ComPtr<ID3D11InputLayout> vertex_layout;
+			ComPtr<ID3D11PixelShader> pixel_shader;
+		};
+
+		std::unique_ptr<ShaderVariantCache> m_VariantCache;
+		std::vector<Variant> m_Variants;
+		bool CompileVariant(ShaderStage stage, ShaderKey key, std::vector<uint8_t>& bytecode, std::string& error);
+
 		// Camera constant buffer
 		ComPtr<ID3D11Buffer> m_CameraConstantBuffer = nullptr;
+		CountedMemory m_CameraConstantBytes = CountedMemory(MemoryTag::GpuBuffers);
 		void CreateCameraConstantBuffer();
 
-		// World constant buffer
+		// World constant ring, a dynamic buffer written with no overwrite while the ring tracks what the GPU still reads
 		ComPtr<ID3D11Buffer> m_WorldConstantBuffer = nullptr;
-		void CreateWorldConstantBuffer();
-
-		// Point light constant buffer
-		ComPtr<ID3D11Buffer> m_PointLightConstantBuffer = nullptr;
-		void CreatePointLightConstantBuffer();
-
-		// Material buffer
-		ComPtr<ID3D11Buffer> m_MaterialConstantBuffer = nullptr;
-		void CreateMaterialConstantBuffer();
+		CountedMemory m_WorldConstantBytes = CountedMemory(MemoryTag::GpuBuffers);
+		RingAllocator m_WorldConstantRing;
+		bool m_WorldConstantBufferCreated = false;
+		void CreateWorldConstantBuffer(UINT size);
+
+		// Instance ring, a dynamic vertex buffer written the same way as the world constant ring
+		ComPtr<ID3D11Buffer> m_InstanceBuffer = nullptr;
+		CountedMemory m_InstanceBytes = CountedMemory(MemoryTag::GpuBuffers);
+		RingAllocator m_InstanceRing = RingAllocator(0, INSTANCE_STRIDE);
+		bool m_InstanceBufferCreated = false;
+		void CreateInstanceBuffer(UINT size);
+
+		// Event queries marking the end of each frame in flight
+		static constexpr uint64_t MAX_FRAMES_IN_FLIGHT = 8;
+		ComPtr<ID3D11Query> m_FrameQueries[MAX_FRAMES_IN_FLIGHT];
+		uint64_t m_FrameFence = 0;
+		uint64_t m_CompletedFence = 0;
+		void PollFrameQueries(bool wait);
+
+		// Point light structured buffer, only written by copies from the staging ring
+		ComPtr<ID3D11Buffer> m_PointLightBuffer = nullptr;
+		ComPtr<ID3D11ShaderResourceView> m_PointLightView = nullptr;
+		CountedMemory m_PointLightBytes = CountedMemory(MemoryTag::GpuBuffers);
+		UINT m_PointLightCapacity = 0;
+		LightUploadStats m_LightUploadStats;
+		uint64_t m_UploadedBytes = 0;
+		uint64_t m_ConstantBytes = 0;
+		void CreatePointLightBuffer(UINT capacity);
+
+		// Staging buffers the dirty lights are packed into, each is reused once the frame that copied from it completed
+		struct StagingBuffer
+		{
+			ComPtr<ID3D11Buffer> buffer;
+			UINT size = 0;
+			uint64_t fence = 0;
+			CountedMemory bytes = CountedMemory(MemoryTag::GpuBuffers);
+		};
+
+		std::vector<StagingBuffer> m_StagingBuffers;
+		ID3D11Buffer* AcquireStagingBuffer(UINT size);
+
+		// Cluster grid constants and the structured buffers of the cluster ranges and light indices, all rewritten each frame
+		ComPtr<ID3D11Buffer> m_ClusterConstantBuffer = nullptr;
+		CountedMemory m_ClusterConstantBytes = CountedMemory(MemoryTag::GpuBuffers);
+		ComPtr<ID3D11Buffer> m_ClusterBuffer = nullptr;
+		ComPtr<ID3D11ShaderResourceView> m_ClusterView = nullptr;
+		CountedMemory m_ClusterBytes = CountedMemory(MemoryTag::GpuBuffers);
+		ComPtr<ID3D11Buffer> m_LightIndexBuffer = nullptr;
+		ComPtr<ID3D11ShaderResourceView> m_LightIndexView = nullptr;
+		CountedMemory m_LightIndexBytes = CountedMemory(MemoryTag::GpuBuffers);
+		UINT m_LightIndexCapacity = 0;
+		void CreateClusterBuffers();
+
+		// Creates or replaces a structured buffer and its view and counts its bytes
+		void CreateStructuredBuffer(UINT stride, UINT count, D3D11_USAGE usage, ComPtr<ID3D11Buffer>& buffer, ComPtr<ID3D11ShaderResourceView>& view, CountedMemory& bytes);
 	};
 }
\ No newline at end of file
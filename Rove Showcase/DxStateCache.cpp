@@ -0,0 +1,119 @@
+#include "Pch.h"
+#include "DxStateCache.h"
+
+Rove::DxStateCache::DxStateCache(ID3D11DeviceContext* context, ID3D11DeviceContext1* context1) : m_Context(context), m_Context1(context1)
+{
+}
+
+void Rove::DxStateCache::IASetInputLayout(ID3D11InputLayout* layout)
+{
+	if (m_Tracker.SetInputLayout(layout))
+	{
+		m_Context->IASetInputLayout(layout);
+	}
+}
+
+void Rove::DxStateCache::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	if (m_Tracker.SetPrimitiveTopology(static_cast<uint32_t>(topology)))
+	{
+		m_Context->IASetPrimitiveTopology(topology);
+	}
+}
+
+void Rove::DxStateCache::IASetVertexBuffer(UINT slot, ID3D11Buffer* buffer, UINT stride, UINT offset)
+{
+	if (m_Tracker.SetVertexBuffer(slot, buffer, stride, offset))
+	{
+		m_Context->IASetVertexBuffers(slot, 1, &buffer, &stride, &offset);
+	}
+}
+
+void Rove::DxStateCache::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	if (m_Tracker.SetIndexBuffer(buffer, static_cast<uint32_t>(format), offset))
+	{
+		m_Context->IASetIndexBuffer(buffer, format, offset);
+	}
+}
+
+void Rove::DxStateCache::VSSetShader(ID3D11VertexShader* shader)
+{
+	if (m_Tracker.SetShader(ShaderStage::Vertex, shader))
+	{
+		m_Context->VSSetShader(shader, nullptr, 0);
+	}
+}
+
+void Rove::DxStateCache::PSSetShader(ID3D11PixelShader* shader)
+{
+	if (m_Tracker.SetShader(ShaderStage::Pixel, shader))
+	{
+		m_Context->PSSetShader(shader, nullptr, 0);
+	}
+}
+
+void Rove::DxStateCache::VSSetConstantBuffer(UINT slot, ID3D11Buffer* buffer)
+{
+	if (m_Tracker.SetConstantBuffer(ShaderStage::Vertex, slot, buffer, 0, 0))
+	{
+		m_Context->VSSetConstantBuffers(slot, 1, &buffer);
+	}
+}
+
+void Rove::DxStateCache::VSSetConstantBuffer1(UINT slot, ID3D11Buffer* buffer, UINT first_constant, UINT constant_count)
+{
+	if (m_Tracker.SetConstantBuffer(ShaderStage::Vertex, slot, buffer, first_constant, constant_count))
+	{
+		m_Context1->VSSetConstantBuffers1(slot, 1, &buffer, &first_constant, &constant_count);
+	}
+}
+
+void Rove::DxStateCache::PSSetConstantBuffer(UINT slot, ID3D11Buffer* buffer)
+{
+	if (m_Tracker.SetConstantBuffer(ShaderStage::Pixel, slot, buffer, 0, 0))
+	{
+		m_Context->PSSetConstantBuffers(slot, 1, &buffer);
+	}
+}
+
+void Rove::DxStateCache::PSSetConstantBuffer1(UINT slot, ID3D11Buffer* buffer, UINT first_constant, UINT constant_count)
+{
+	if (m_Tracker.SetConstantBuffer(ShaderStage::Pixel, slot, buffer, first_constant, constant_count))
+	{
+		m_Context1->PSSetConstantBuffers1(slot, 1, &buffer, &first_constant, &constant_count);
+	}
+}
+
+void Rove::DxStateCache::PSSetShaderResources(UINT start_slot, UINT count, ID3D11ShaderResourceView* const* views)
+{
+	// Every slot is tracked, one call covers the first to the last that changed
+	SlotRange range = m_Tracker.SetShaderResources(ShaderStage::Pixel, start_slot, count, views);
+	if (range.count > 0)
+	{
+		m_Context->PSSetShaderResources(range.first, range.count, views + (range.first - start_slot));
+	}
+}
+
+void Rove::DxStateCache::OMSetRenderTargets(ID3D11RenderTargetView* render_target, ID3D11DepthStencilView* depth_stencil)
+{
+	if (m_Tracker.SetRenderTargets(render_target, depth_stencil))
+	{
+		m_Context->OMSetRenderTargets(1, &render_target, depth_stencil);
+	}
+}
+
+void Rove::DxStateCache::RSSetState(ID3D11RasterizerState* state)
+{
+	if (m_Tracker.SetRasterizerState(state))
+	{
+		m_Context->RSSetState(state);
+	}
+}
+
+void Rove::DxStateCache::BeginFrame()
+{
+	m_FrameStats = m_Tracker.GetStats();
+	m_Tracker.ResetStats();
+	m_Tracker.Invalidate();
+}
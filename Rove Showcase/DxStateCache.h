@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Pch.h"
+#include "StateTracker.h"
+
+namespace Rove
+{
+	// Direct3D11 device context wrapper that drops bindings of state that is already bound. The pipeline state of the
+	// renderer goes through it so callers can bind everything they need without comparing against the previous draw.
+	class DxStateCache
+	{
+	public:
+		DxStateCache(ID3D11DeviceContext* context, ID3D11DeviceContext1* context1);
+		virtual ~DxStateCache() = default;
+
+		// Input assembler
+		void IASetInputLayout(ID3D11InputLayout* layout);
+		void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+		void IASetVertexBuffer(UINT slot, ID3D11Buffer* buffer, UINT stride, UINT offset);
+		void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+
+		// Shaders
+		void VSSetShader(ID3D11VertexShader* shader);
+		void PSSetShader(ID3D11PixelShader* shader);
+
+		// Constant buffers, the offset variant binds a range of constants
+		void VSSetConstantBuffer(UINT slot, ID3D11Buffer* buffer);
+		void VSSetConstantBuffer1(UINT slot, ID3D11Buffer* buffer, UINT first_constant, UINT constant_count);
+		void PSSetConstantBuffer(UINT slot, ID3D11Buffer* buffer);
+		void PSSetConstantBuffer1(UINT slot, ID3D11Buffer* buffer, UINT first_constant, UINT constant_count);
+
+		// Shader resources, only the changed range of slots is bound
+		void PSSetShaderResources(UINT start_slot, UINT count, ID3D11ShaderResourceView* const* views);
+
+		// Output merger and rasterizer
+		void OMSetRenderTargets(ID3D11RenderTargetView* render_target, ID3D11DepthStencilView* depth_stencil);
+		void RSSetState(ID3D11RasterizerState* state);
+
+		// Forgets the tracked state, call when state may have been bound without going through the cache
+		void Invalidate() { m_Tracker.Invalidate(); }
+
+		// Forgets the tracked state and keeps the counters of the frame that ended for display
+		void BeginFrame();
+
+		// Counters of the current frame
+		const StateCacheStats& GetStats() const { return m_Tracker.GetStats(); }
+
+		// Counters of the last complete frame
+		const StateCacheStats& GetFrameStats() const { return m_FrameStats; }
+
+	private:
+		ID3D11DeviceContext* m_Context = nullptr;
+		ID3D11DeviceContext1* m_Context1 = nullptr;
+
+		StateTracker m_Tracker;
+		StateCacheStats m_FrameStats;
+	};
+}
@@ -0,0 +1,604 @@
+#include "Pch.h"
+#include "DynamicBvh.h"
+
+namespace
+{
+	DirectX::XMFLOAT3 Min(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+	{
+		return DirectX::XMFLOAT3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z));
+	}
+
+	DirectX::XMFLOAT3 Max(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+	{
+		return DirectX::XMFLOAT3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z));
+	}
+
+	// Half of the surface area, used as the insertion cost
+	float HalfArea(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max)
+	{
+		float x = max.x - min.x;
+		float y = max.y - min.y;
+		float z = max.z - min.z;
+		return x * y + y * z + z * x;
+	}
+
+	bool Contains(const DirectX::XMFLOAT3& outer_min, const DirectX::XMFLOAT3& outer_max, const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max)
+	{
+		return outer_min.x <= min.x && outer_min.y <= min.y && outer_min.z <= min.z &&
+			max.x <= outer_max.x && max.y <= outer_max.y && max.z <= outer_max.z;
+	}
+
+	bool Overlaps(const DirectX::XMFLOAT3& a_min, const DirectX::XMFLOAT3& a_max, const DirectX::XMFLOAT3& b_min, const DirectX::XMFLOAT3& b_max)
+	{
+		return a_min.x <= b_max.x && a_min.y <= b_max.y && a_min.z <= b_max.z &&
+			b_min.x <= a_max.x && b_min.y <= a_max.y && b_min.z <= a_max.z;
+	}
+
+	// Slab test, returns the entry distance or a negative value on a miss
+	float IntersectRay(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& inverse_direction, float max_distance)
+	{
+		float tx1 = (min.x - origin.x) * inverse_direction.x;
+		float tx2 = (max.x - origin.x) * inverse_direction.x;
+		float tmin = std::min(tx1, tx2);
+		float tmax = std::max(tx1, tx2);
+
+		float ty1 = (min.y - origin.y) * inverse_direction.y;
+		float ty2 = (max.y - origin.y) * inverse_direction.y;
+		tmin = std::max(tmin, std::min(ty1, ty2));
+		tmax = std::min(tmax, std::max(ty1, ty2));
+
+		float tz1 = (min.z - origin.z) * inverse_direction.z;
+		float tz2 = (max.z - origin.z) * inverse_direction.z;
+		tmin = std::max(tmin, std::min(tz1, tz2));
+		tmax = std::min(tmax, std::max(tz1, tz2));
+
+		if (tmax < std::max(tmin, 0.0f) || tmin > max_distance)
+		{
+			return -1.0f;
+		}
+
+		return std::max(tmin, 0.0f);
+	}
+}
+
+Rove::DynamicBvh::DynamicBvh(float margin) : m_Margin(margin)
+{
+}
+
+int Rove::DynamicBvh::CreateProxy(const DirectX::BoundingBox& box, uint64_t user_data)
+{
+	int proxy = AllocateNode();
+
+	// Enlarge the bounds so small movements do not restructure the tree
+	Node& node = m_Nodes[proxy];
+	node.min = DirectX::XMFLOAT3(box.Center.x - box.Extents.x - m_Margin, box.Center.y - box.Extents.y - m_Margin, box.Center.z - box.Extents.z - m_Margin);
+	node.max = DirectX::XMFLOAT3(box.Center.x + box.Extents.x + m_Margin, box.Center.y + box.Extents.y + m_Margin, box.Center.z + box.Extents.z + m_Margin);
+	node.user_data = user_data;
+	node.height = 0;
+
+	InsertLeaf(proxy);
+	++m_ProxyCount;
+
+	return proxy;
+}
+
+void Rove::DynamicBvh::DestroyProxy(int proxy)
+{
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	--m_ProxyCount;
+}
+
+bool Rove::DynamicBvh::MoveProxy(int proxy, const DirectX::BoundingBox& box)
+{
+	DirectX::XMFLOAT3 min(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z);
+	DirectX::XMFLOAT3 max(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z);
+
+	// Still inside the fat bounds so nothing to do
+	if (Contains(m_Nodes[proxy].min, m_Nodes[proxy].max, min, max))
+	{
+		return false;
+	}
+
+	RemoveLeaf(proxy);
+
+	Node& node = m_Nodes[proxy];
+	node.min = DirectX::XMFLOAT3(min.x - m_Margin, min.y - m_Margin, min.z - m_Margin);
+	node.max = DirectX::XMFLOAT3(max.x + m_Margin, max.y + m_Margin, max.z + m_Margin);
+
+	InsertLeaf(proxy);
+	return true;
+}
+
+void Rove::DynamicBvh::Clear()
+{
+	m_Nodes.clear();
+	m_Root = -1;
+	m_FreeList = -1;
+	m_ProxyCount = 0;
+}
+
+void Rove::DynamicBvh::QueryFrustum(const Frustum& frustum, std::vector<int>& inside, std::vector<int>& intersecting) const
+{
+	if (m_Root == -1)
+	{
+		return;
+	}
+
+	const DirectX::XMFLOAT4* planes = frustum.GetPlanes();
+
+	// Each stack entry packs the node index with a mask of the planes that still need testing
+	constexpr int all_planes = 0x3F;
+	m_Stack.clear();
+	m_Stack.push_back((m_Root << 6) | all_planes);
+
+	while (!m_Stack.empty())
+	{
+		int entry = m_Stack.back();
+		m_Stack.pop_back();
+
+		int index = entry >> 6;
+		int mask = entry & all_planes;
+		const Node& node = m_Nodes[index];
+
+		DirectX::XMFLOAT3 center((node.min.x + node.max.x) * 0.5f, (node.min.y + node.max.y) * 0.5f, (node.min.z + node.max.z) * 0.5f);
+		DirectX::XMFLOAT3 extents((node.max.x - node.min.x) * 0.5f, (node.max.y - node.min.y) * 0.5f, (node.max.z - node.min.z) * 0.5f);
+
+		bool outside = false;
+		for (int p = 0; p < 6; ++p)
+		{
+			if ((mask & (1 << p)) == 0)
+			{
+				continue;
+			}
+
+			const DirectX::XMFLOAT4& plane = planes[p];
+			float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			float radius = std::abs(plane.x) * extents.x + std::abs(plane.y) * extents.y + std::abs(plane.z) * extents.z;
+
+			if (distance + radius < 0.0f)
+			{
+				outside = true;
+				break;
+			}
+
+			// Completely on the inside of this plane so the children can skip it
+			if (distance - radius >= 0.0f)
+			{
+				mask &= ~(1 << p);
+			}
+		}
+
+		if (outside)
+		{
+			continue;
+		}
+
+		if (mask == 0)
+		{
+			CollectLeaves(index, inside);
+		}
+		else if (node.IsLeaf())
+		{
+			intersecting.push_back(index);
+		}
+		else
+		{
+			m_Stack.push_back((node.child1 << 6) | mask);
+			m_Stack.push_back((node.child2 << 6) | mask);
+		}
+	}
+}
+
+void Rove::DynamicBvh::QueryAabb(const DirectX::BoundingBox& box, std::vector<int>& results) const
+{
+	if (m_Root == -1)
+	{
+		return;
+	}
+
+	DirectX::XMFLOAT3 min(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z);
+	DirectX::XMFLOAT3 max(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z);
+
+	m_Stack.clear();
+	m_Stack.push_back(m_Root);
+
+	while (!m_Stack.empty())
+	{
+		int index = m_Stack.back();
+		m_Stack.pop_back();
+
+		const Node& node = m_Nodes[index];
+		if (!Overlaps(node.min, node.max, min, max))
+		{
+			continue;
+		}
+
+		if (node.IsLeaf())
+		{
+			results.push_back(index);
+		}
+		else
+		{
+			m_Stack.push_back(node.child1);
+			m_Stack.push_back(node.child2);
+		}
+	}
+}
+
+void Rove::DynamicBvh::QuerySphere(const DirectX::BoundingSphere& sphere, std::vector<int>& results) const
+{
+	if (m_Root == -1)
+	{
+		return;
+	}
+
+	const float radius_squared = sphere.Radius * sphere.Radius;
+
+	m_Stack.clear();
+	m_Stack.push_back(m_Root);
+
+	while (!m_Stack.empty())
+	{
+		int index = m_Stack.back();
+		m_Stack.pop_back();
+
+		// Squared distance from the sphere centre to the closest point of the box
+		const Node& node = m_Nodes[index];
+		float dx = std::max({ node.min.x - sphere.Center.x, 0.0f, sphere.Center.x - node.max.x });
+		float dy = std::max({ node.min.y - sphere.Center.y, 0.0f, sphere.Center.y - node.max.y });
+		float dz = std::max({ node.min.z - sphere.Center.z, 0.0f, sphere.Center.z - node.max.z });
+		if (dx * dx + dy * dy + dz * dz > radius_squared)
+		{
+			continue;
+		}
+
+		if (node.IsLeaf())
+		{
+			results.push_back(index);
+		}
+		else
+		{
+			m_Stack.push_back(node.child1);
+			m_Stack.push_back(node.child2);
+		}
+	}
+}
+
+void Rove::DynamicBvh::QueryRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float max_distance,
+								const std::function<float(int proxy, float max_distance)>& callback) const
+{
+	if (m_Root == -1)
+	{
+		return;
+	}
+
+	DirectX::XMFLOAT3 inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	if (IntersectRay(m_Nodes[m_Root].min, m_Nodes[m_Root].max, origin, inverse_direction, max_distance) < 0.0f)
+	{
+		return;
+	}
+
+	m_Stack.clear();
+	m_Stack.push_back(m_Root);
+
+	while (!m_Stack.empty())
+	{
+		int index = m_Stack.back();
+		m_Stack.pop_back();
+
+		const Node& node = m_Nodes[index];
+		if (node.IsLeaf())
+		{
+			max_distance = std::min(max_distance, callback(index, max_distance));
+			continue;
+		}
+
+		float distance1 = IntersectRay(m_Nodes[node.child1].min, m_Nodes[node.child1].max, origin, inverse_direction, max_distance);
+		float distance2 = IntersectRay(m_Nodes[node.child2].min, m_Nodes[node.child2].max, origin, inverse_direction, max_distance);
+
+		// Push the far child first so the near child is visited first
+		if (distance1 >= 0.0f && distance2 >= 0.0f)
+		{
+			bool child1_first = distance1 <= distance2;
+			m_Stack.push_back(child1_first ? node.child2 : node.child1);
+			m_Stack.push_back(child1_first ? node.child1 : node.child2);
+		}
+		else if (distance1 >= 0.0f)
+		{
+			m_Stack.push_back(node.child1);
+		}
+		else if (distance2 >= 0.0f)
+		{
+			m_Stack.push_back(node.child2);
+		}
+	}
+}
+
+int Rove::DynamicBvh::AllocateNode()
+{
+	if (m_FreeList == -1)
+	{
+		m_Nodes.emplace_back();
+		return static_cast<int>(m_Nodes.size() - 1);
+	}
+
+	int node = m_FreeList;
+	m_FreeList = m_Nodes[node].parent;
+	m_Nodes[node] = Node();
+	return node;
+}
+
+void Rove::DynamicBvh::FreeNode(int node)
+{
+	m_Nodes[node].parent = m_FreeList;
+	m_Nodes[node].height = -1;
+	m_FreeList = node;
+}
+
+void Rove::DynamicBvh::InsertLeaf(int leaf)
+{
+	if (m_Root == -1)
+	{
+		m_Root = leaf;
+		m_Nodes[leaf].parent = -1;
+		return;
+	}
+
+	// Find the best sibling by walking down the cheapest branch
+	const DirectX::XMFLOAT3 leaf_min = m_Nodes[leaf].min;
+	const DirectX::XMFLOAT3 leaf_max = m_Nodes[leaf].max;
+
+	int index = m_Root;
+	while (!m_Nodes[index].IsLeaf())
+	{
+		const Node& node = m_Nodes[index];
+
+		float area = HalfArea(node.min, node.max);
+		float combined_area = HalfArea(Min(node.min, leaf_min), Max(node.max, leaf_max));
+
+		// Cost of creating a new parent for this node and the new leaf
+		float cost = 2.0f * combined_area;
+
+		// Minimum cost of pushing the leaf further down the tree
+		float inheritance_cost = 2.0f * (combined_area - area);
+
+		auto child_cost = [&](int child)
+		{
+			const Node& child_node = m_Nodes[child];
+			float child_area = HalfArea(Min(child_node.min, leaf_min), Max(child_node.max, leaf_max));
+			if (!child_node.IsLeaf())
+			{
+				child_area -= HalfArea(child_node.min, child_node.max);
+			}
+
+			return child_area + inheritance_cost;
+		};
+
+		float cost1 = child_cost(node.child1);
+		float cost2 = child_cost(node.child2);
+
+		if (cost < cost1 && cost < cost2)
+		{
+			break;
+		}
+
+		index = cost1 < cost2 ? node.child1 : node.child2;
+	}
+
+	int sibling = index;
+
+	// Create a new parent
+	int old_parent = m_Nodes[sibling].parent;
+	int new_parent = AllocateNode();
+	m_Nodes[new_parent].parent = old_parent;
+	m_Nodes[new_parent].min = Min(leaf_min, m_Nodes[sibling].min);
+	m_Nodes[new_parent].max = Max(leaf_max, m_Nodes[sibling].max);
+	m_Nodes[new_parent].height = m_Nodes[sibling].height + 1;
+	m_Nodes[new_parent].child1 = sibling;
+	m_Nodes[new_parent].child2 = leaf;
+	m_Nodes[sibling].parent = new_parent;
+	m_Nodes[leaf].parent = new_parent;
+
+	if (old_parent != -1)
+	{
+		if (m_Nodes[old_parent].child1 == sibling)
+		{
+			m_Nodes[old_parent].child1 = new_parent;
+		}
+		else
+		{
+			m_Nodes[old_parent].child2 = new_parent;
+		}
+	}
+	else
+	{
+		m_Root = new_parent;
+	}
+
+	// Walk back up the tree fixing heights and bounds
+	index = m_Nodes[leaf].parent;
+	while (index != -1)
+	{
+		index = Balance(index);
+		Refit(index);
+		index = m_Nodes[index].parent;
+	}
+}
+
+void Rove::DynamicBvh::RemoveLeaf(int leaf)
+{
+	if (leaf == m_Root)
+	{
+		m_Root = -1;
+		return;
+	}
+
+	int parent = m_Nodes[leaf].parent;
+	int grand_parent = m_Nodes[parent].parent;
+	int sibling = m_Nodes[parent].child1 == leaf ? m_Nodes[parent].child2 : m_Nodes[parent].child1;
+
+	if (grand_parent != -1)
+	{
+		// Destroy the parent and connect the sibling to the grand parent
+		if (m_Nodes[grand_parent].child1 == parent)
+		{
+			m_Nodes[grand_parent].child1 = sibling;
+		}
+		else
+		{
+			m_Nodes[grand_parent].child2 = sibling;
+		}
+
+		m_Nodes[sibling].parent = grand_parent;
+		FreeNode(parent);
+
+		// Adjust ancestor bounds
+		int index = grand_parent;
+		while (index != -1)
+		{
+			index = Balance(index);
+			Refit(index);
+			index = m_Nodes[index].parent;
+		}
+	}
+	else
+	{
+		m_Root = sibling;
+		m_Nodes[sibling].parent = -1;
+		FreeNode(parent);
+	}
+}
+
+int Rove::DynamicBvh::Balance(int a)
+{
+	Node& node_a = m_Nodes[a];
+	if (node_a.IsLeaf() || node_a.height < 2)
+	{
+		return a;
+	}
+
+	int b = node_a.child1;
+	int c = node_a.child2;
+	int balance = m_Nodes[c].height - m_Nodes[b].height;
+
+	// Rotate C up
+	if (balance > 1)
+	{
+		int f = m_Nodes[c].child1;
+		int g = m_Nodes[c].child2;
+
+		m_Nodes[c].child1 = a;
+		m_Nodes[c].parent = node_a.parent;
+		node_a.parent = c;
+
+		int c_parent = m_Nodes[c].parent;
+		if (c_parent != -1)
+		{
+			if (m_Nodes[c_parent].child1 == a)
+			{
+				m_Nodes[c_parent].child1 = c;
+			}
+			else
+			{
+				m_Nodes[c_parent].child2 = c;
+			}
+		}
+		else
+		{
+			m_Root = c;
+		}
+
+		// Keep the taller grandchild under C
+		if (m_Nodes[f].height > m_Nodes[g].height)
+		{
+			m_Nodes[c].child2 = f;
+			node_a.child2 = g;
+			m_Nodes[g].parent = a;
+		}
+		else
+		{
+			m_Nodes[c].child2 = g;
+			node_a.child2 = f;
+			m_Nodes[f].parent = a;
+		}
+
+		Refit(a);
+		Refit(c);
+		return c;
+	}
+
+	// Rotate B up
+	if (balance < -1)
+	{
+		int d = m_Nodes[b].child1;
+		int e = m_Nodes[b].child2;
+
+		m_Nodes[b].child1 = a;
+		m_Nodes[b].parent = node_a.parent;
+		node_a.parent = b;
+
+		int b_parent = m_Nodes[b].parent;
+		if (b_parent != -1)
+		{
+			if (m_Nodes[b_parent].child1 == a)
+			{
+				m_Nodes[b_parent].child1 = b;
+			}
+			else
+			{
+				m_Nodes[b_parent].child2 = b;
+			}
+		}
+		else
+		{
+			m_Root = b;
+		}
+
+		// Keep the taller grandchild under B
+		if (m_Nodes[d].height > m_Nodes[e].height)
+		{
+			m_Nodes[b].child2 = d;
+			node_a.child1 = e;
+			m_Nodes[e].parent = a;
+		}
+		else
+		{
+			m_Nodes[b].child2 = e;
+			node_a.child1 = d;
+			m_Nodes[d].parent = a;
+		}
+
+		Refit(a);
+		Refit(b);
+		return b;
+	}
+
+	return a;
+}
+
+void Rove::DynamicBvh::Refit(int index)
+{
+	Node& node = m_Nodes[index];
+	const Node& child1 = m_Nodes[node.child1];
+	const Node& child2 = m_Nodes[node.child2];
+
+	node.min = Min(child1.min, child2.min);
+	node.max = Max(child1.max, child2.max);
+	node.height = 1 + std::max(child1.height, child2.height);
+}
+
+void Rove::DynamicBvh::CollectLeaves(int node, std::vector<int>& results) const
+{
+	// The tree is balanced so the recursion depth is bounded by its height
+	const Node& current = m_Nodes[node];
+	if (current.IsLeaf())
+	{
+		results.push_back(node);
+		return;
+	}
+
+	CollectLeaves(current.child1, results);
+	CollectLeaves(current.child2, results);
+}
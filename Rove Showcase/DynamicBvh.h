@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Pch.h"
+#include "Frustum.h"
+
+namespace Rove
+{
+	// Dynamic bounding volume hierarchy over world space bounding boxes. Leaves store enlarged (fat) bounds so small
+	// movements only need a containment check, larger ones remove and re-insert the leaf and rebalance the ancestors.
+	class DynamicBvh
+	{
+	public:
+		DynamicBvh(float margin = 0.1f);
+		virtual ~DynamicBvh() = default;
+
+		// Insert bounds and return a proxy id
+		int CreateProxy(const DirectX::BoundingBox& box, uint64_t user_data);
+
+		// Remove a proxy
+		void DestroyProxy(int proxy);
+
+		// Update the bounds of a proxy, returns true if the tree had to be restructured
+		bool MoveProxy(int proxy, const DirectX::BoundingBox& box);
+
+		// Remove all proxies
+		void Clear();
+
+		// User data stored with a proxy
+		uint64_t GetUserData(int proxy) const { return m_Nodes[proxy].user_data; }
+		void SetUserData(int proxy, uint64_t user_data) { m_Nodes[proxy].user_data = user_data; }
+
+		// Hierarchical frustum test. Proxies of subtrees completely inside the frustum are written to inside, leaves that
+		// straddle a plane are written to intersecting so their exact bounds can be tested by the caller
+		void QueryFrustum(const Frustum& frustum, std::vector<int>& inside, std::vector<int>& intersecting) const;
+
+		// Proxies whose bounds overlap a box
+		void QueryAabb(const DirectX::BoundingBox& box, std::vector<int>& results) const;
+
+		// Proxies whose bounds overlap a sphere
+		void QuerySphere(const DirectX::BoundingSphere& sphere, std::vector<int>& results) const;
+
+		// Casts a ray through the tree in front to back order. The callback receives the proxy and the current maximum
+		// distance and returns the new maximum distance, which lets closest hit queries prune the remaining nodes.
+		void QueryRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float max_distance,
+					  const std::function<float(int proxy, float max_distance)>& callback) const;
+
+		// Number of proxies in the tree
+		int GetProxyCount() const { return m_ProxyCount; }
+
+		// Height of the tree
+		int GetHeight() const { return m_Root == -1 ? 0 : m_Nodes[m_Root].height; }
+
+	private:
+		struct Node
+		{
+			DirectX::XMFLOAT3 min;
+			DirectX::XMFLOAT3 max;
+
+			// Parent when in the tree, next free node when in the free list
+			int parent = -1;
+			int child1 = -1;
+			int child2 = -1;
+
+			// Leaf = 0, free node = -1
+			int height = -1;
+
+			uint64_t user_data = 0;
+
+			bool IsLeaf() const { return child1 == -1; }
+		};
+
+		std::vector<Node> m_Nodes;
+		int m_Root = -1;
+		int m_FreeList = -1;
+		int m_ProxyCount = 0;
+
+		// Absolute margin added to every side of a leaf
+		float m_Margin = 0.1f;
+
+		int AllocateNode();
+		void FreeNode(int node);
+
+		void InsertLeaf(int leaf);
+		void RemoveLeaf(int leaf);
+
+		// Performs a left or right rotation if the node is imbalanced, returns the new root of the subtree
+		int Balance(int node);
+
+		// Recalculates the bounds and height from the children
+		void Refit(int node);
+
+		// Appends every leaf below a node
+		void CollectLeaves(int node, std::vector<int>& results) const;
+
+		// Traversal stack reused by the queries
+		mutable std::vector<int> m_Stack;
+	};
+}
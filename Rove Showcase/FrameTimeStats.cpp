@@ -0,0 +1,145 @@
+#include "Pch.h"
+#include "FrameTimeStats.h"
+
+namespace
+{
+	// Histogram edges from 0.01 ms to 1 s, each 1% above the one before
+	constexpr double MIN_MILLISECONDS = 0.01;
+	constexpr double MAX_MILLISECONDS = 1000.0;
+	constexpr double BIN_RATIO = 1.01;
+	const double LOG_BIN_RATIO = std::log(BIN_RATIO);
+	const size_t EDGE_COUNT = static_cast<size_t>(std::ceil(std::log(MAX_MILLISECONDS / MIN_MILLISECONDS) / LOG_BIN_RATIO));
+}
+
+Rove::FrameTimeStats::FrameTimeStats() : m_Samples(CAPACITY, 0.0f), m_Bins(EDGE_COUNT + 2, 0)
+{
+}
+
+void Rove::FrameTimeStats::Add(double milliseconds)
+{
+	float sample = static_cast<float>(milliseconds);
+
+	// The oldest frame leaves the window once the ring is full
+	if (m_Count == CAPACITY)
+	{
+		float oldest = m_Samples[m_Next];
+		m_Sum -= oldest;
+		--m_Bins[GetBin(oldest)];
+		m_Stutters -= oldest > m_Budget ? 1 : 0;
+	}
+	else
+	{
+		++m_Count;
+	}
+
+	m_Samples[m_Next] = sample;
+	m_Next = (m_Next + 1) % CAPACITY;
+	m_Sum += sample;
+	++m_Bins[GetBin(sample)];
+
+	if (sample > m_Budget)
+	{
+		++m_Stutters;
+		++m_TotalStutters;
+	}
+
+	// A new frame removes every smaller one from the maximum queue, and the front leaves once it is out of the window
+	while (!m_MaxQueue.empty() && m_MaxQueue.back().second <= sample)
+	{
+		m_MaxQueue.pop_back();
+	}
+
+	m_MaxQueue.emplace_back(m_Added, sample);
+	++m_Added;
+	while (m_MaxQueue.front().first < m_Added - m_Count)
+	{
+		m_MaxQueue.pop_front();
+	}
+}
+
+void Rove::FrameTimeStats::Reset()
+{
+	std::fill(m_Samples.begin(), m_Samples.end(), 0.0f);
+	std::fill(m_Bins.begin(), m_Bins.end(), 0);
+	m_MaxQueue.clear();
+	m_Next = 0;
+	m_Count = 0;
+	m_Added = 0;
+	m_Sum = 0.0;
+	m_Stutters = 0;
+	m_TotalStutters = 0;
+}
+
+void Rove::FrameTimeStats::SetBudget(double milliseconds)
+{
+	m_Budget = milliseconds;
+	m_Stutters = 0;
+	for (size_t i = 0; i < m_Count; ++i)
+	{
+		m_Stutters += m_Samples[i] > m_Budget ? 1 : 0;
+	}
+}
+
+double Rove::FrameTimeStats::GetPercentile(double fraction) const
+{
+	if (m_Count == 0)
+	{
+		return 0.0;
+	}
+
+	// Nearest rank, the first bin reaching it holds the value
+	size_t rank = std::max<size_t>(static_cast<size_t>(std::ceil(fraction * m_Count)), 1);
+	size_t seen = 0;
+	double max = m_MaxQueue.front().second;
+	for (size_t bin = 0; bin < m_Bins.size(); ++bin)
+	{
+		seen += m_Bins[bin];
+		if (seen >= rank)
+		{
+			return bin == m_Bins.size() - 1 ? max : std::min(GetBinValue(bin), max);
+		}
+	}
+
+	return max;
+}
+
+Rove::FrameTimeSummary Rove::FrameTimeStats::GetSummary() const
+{
+	FrameTimeSummary summary;
+	summary.count = m_Count;
+	summary.stutters = m_Stutters;
+	summary.total_stutters = m_TotalStutters;
+	if (m_Count == 0)
+	{
+		return summary;
+	}
+
+	summary.average = m_Sum / m_Count;
+	summary.p50 = GetPercentile(0.50);
+	summary.p95 = GetPercentile(0.95);
+	summary.p99 = GetPercentile(0.99);
+	summary.max = m_MaxQueue.front().second;
+	return summary;
+}
+
+size_t Rove::FrameTimeStats::GetBin(double milliseconds)
+{
+	if (milliseconds < MIN_MILLISECONDS)
+	{
+		return 0;
+	}
+
+	size_t edge = static_cast<size_t>(std::log(milliseconds / MIN_MILLISECONDS) / LOG_BIN_RATIO);
+	return std::min(edge + 1, EDGE_COUNT + 1);
+}
+
+double Rove::FrameTimeStats::GetBinValue(size_t bin)
+{
+	if (bin == 0)
+	{
+		return MIN_MILLISECONDS;
+	}
+
+	// Geometric middle of the bin
+	return MIN_MILLISECONDS * std::pow(BIN_RATIO, static_cast<double>(bin - 1) + 0.5);
+}
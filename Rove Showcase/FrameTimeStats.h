@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Pch.h"
+
+namespace Rove
+{
+	// Frame times of the samples in the window, in milliseconds
+	struct FrameTimeSummary
+	{
+		size_t count = 0;
+		double average = 0.0;
+		double p50 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+
+		// Frames over the budget in the window and since the last reset
+		int stutters = 0;
+		int64_t total_stutters = 0;
+	};
+
+	// Keeps the last frame times in a fixed ring and their statistics up to date as each frame is added. Every sample
+	// is also counted in a histogram with bins 1% apart, the sample leaving the ring is taken out again, so percentiles
+	// are read from the bins without sorting and are within 1% of the exact value. The maximum is kept exactly with a
+	// queue of the samples no later sample is larger than.
+	class FrameTimeStats
+	{
+	public:
+		static constexpr size_t CAPACITY = 10000;
+
+		FrameTimeStats();
+		virtual ~FrameTimeStats() = default;
+
+		// Adds the time of a frame
+		void Add(double milliseconds);
+
+		// Forgets every frame and the total stutter count
+		void Reset();
+
+		// Frames longer than the budget are counted as stutters, changing it recounts the frames in the window
+		void SetBudget(double milliseconds);
+		double GetBudget() const { return m_Budget; }
+
+		// Time under which a fraction of the frames in the window fall
+		double GetPercentile(double fraction) const;
+
+		// Statistics of the frames in the window
+		FrameTimeSummary GetSummary() const;
+
+		// Frames in the window
+		size_t Size() const { return m_Count; }
+
+		// Ring of the frames, the oldest is at GetOffset once the ring is full
+		const float* GetData() const { return m_Samples.data(); }
+		size_t GetOffset() const { return m_Count == CAPACITY ? m_Next : 0; }
+
+	private:
+		std::vector<float> m_Samples;
+		size_t m_Next = 0;
+		size_t m_Count = 0;
+		uint64_t m_Added = 0;
+		double m_Sum = 0.0;
+
+		// Samples per bin, bin 0 holds everything below the first edge and the last everything above the last edge
+		std::vector<uint32_t> m_Bins;
+		static size_t GetBin(double milliseconds);
+		static double GetBinValue(size_t bin);
+
+		// Frames that may still become the maximum, by the index they were added at, falling in value
+		std::deque<std::pair<uint64_t, float>> m_MaxQueue;
+
+		double m_Budget = 1000.0 / 60.0;
+		int m_Stutters = 0;
+		int64_t m_TotalStutters = 0;
+	};
+}
@@ -0,0 +1,223 @@
+#include "Pch.h"
+#include "Frustum.h"
+
+void Rove::BoundsSoA::Clear()
+{
+	center_x.clear();
+	center_y.clear();
+	center_z.clear();
+	extent_x.clear();
+	extent_y.clear();
+	extent_z.clear();
+}
+
+void Rove::BoundsSoA::Reserve(size_t count)
+{
+	center_x.reserve(count);
+	center_y.reserve(count);
+	center_z.reserve(count);
+	extent_x.reserve(count);
+	extent_y.reserve(count);
+	extent_z.reserve(count);
+}
+
+void Rove::BoundsSoA::Add(const DirectX::BoundingBox& box)
+{
+	center_x.push_back(box.Center.x);
+	center_y.push_back(box.Center.y);
+	center_z.push_back(box.Center.z);
+	extent_x.push_back(box.Extents.x);
+	extent_y.push_back(box.Extents.y);
+	extent_z.push_back(box.Extents.z);
+}
+
+void Rove::BoundsSoA::Set(size_t index, const DirectX::BoundingBox& box)
+{
+	center_x[index] = box.Center.x;
+	center_y[index] = box.Center.y;
+	center_z[index] = box.Center.z;
+	extent_x[index] = box.Extents.x;
+	extent_y[index] = box.Extents.y;
+	extent_z[index] = box.Extents.z;
+}
+
+DirectX::BoundingBox Rove::BoundsSoA::Get(size_t index) const
+{
+	DirectX::BoundingBox box;
+	box.Center = DirectX::XMFLOAT3(center_x[index], center_y[index], center_z[index]);
+	box.Extents = DirectX::XMFLOAT3(extent_x[index], extent_y[index], extent_z[index]);
+	return box;
+}
+
+void Rove::Frustum::Extract(const DirectX::XMMATRIX& view_projection)
+{
+	// The rows of the transposed matrix are the columns of the view projection matrix
+	DirectX::XMMATRIX m = DirectX::XMMatrixTranspose(view_projection);
+
+	DirectX::XMVECTOR planes[6] =
+	{
+		DirectX::XMVectorAdd(m.r[3], m.r[0]),      // Left
+		DirectX::XMVectorSubtract(m.r[3], m.r[0]), // Right
+		DirectX::XMVectorAdd(m.r[3], m.r[1]),      // Bottom
+		DirectX::XMVectorSubtract(m.r[3], m.r[1]), // Top
+		m.r[2],                                    // Near - Direct3D clip space depth starts at 0
+		DirectX::XMVectorSubtract(m.r[3], m.r[2]), // Far
+	};
+
+	for (int i = 0; i < 6; ++i)
+	{
+		DirectX::XMStoreFloat4(&m_Planes[i], DirectX::XMPlaneNormalize(planes[i]));
+	}
+}
+
+size_t Rove::Frustum::Cull(const BoundsSoA& bounds, std::vector<uint32_t>& visible) const
+{
+	const size_t count = bounds.Size();
+	visible.resize(count);
+
+	const float* cx = bounds.center_x.data();
+	const float* cy = bounds.center_y.data();
+	const float* cz = bounds.center_z.data();
+	const float* ex = bounds.extent_x.data();
+	const float* ey = bounds.extent_y.data();
+	const float* ez = bounds.extent_z.data();
+
+	size_t visible_count = 0;
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	// Test 8 boxes at a time
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+
+		__m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+		__m256 abs_x[6], abs_y[6], abs_z[6];
+		for (int p = 0; p < 6; ++p)
+		{
+			plane_x[p] = _mm256_set1_ps(m_Planes[p].x);
+			plane_y[p] = _mm256_set1_ps(m_Planes[p].y);
+			plane_z[p] = _mm256_set1_ps(m_Planes[p].z);
+			plane_w[p] = _mm256_set1_ps(m_Planes[p].w);
+			abs_x[p] = _mm256_andnot_ps(sign_mask, plane_x[p]);
+			abs_y[p] = _mm256_andnot_ps(sign_mask, plane_y[p]);
+			abs_z[p] = _mm256_andnot_ps(sign_mask, plane_z[p]);
+		}
+
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 center_x = _mm256_loadu_ps(cx + i);
+			__m256 center_y = _mm256_loadu_ps(cy + i);
+			__m256 center_z = _mm256_loadu_ps(cz + i);
+			__m256 extent_x = _mm256_loadu_ps(ex + i);
+			__m256 extent_y = _mm256_loadu_ps(ey + i);
+			__m256 extent_z = _mm256_loadu_ps(ez + i);
+
+			__m256 outside = zero;
+			for (int p = 0; p < 6; ++p)
+			{
+				// Signed distance of the centre plus the projected radius of the box onto the plane normal
+				__m256 distance = _mm256_fmadd_ps(plane_x[p], center_x, plane_w[p]);
+				distance = _mm256_fmadd_ps(plane_y[p], center_y, distance);
+				distance = _mm256_fmadd_ps(plane_z[p], center_z, distance);
+				distance = _mm256_fmadd_ps(abs_x[p], extent_x, distance);
+				distance = _mm256_fmadd_ps(abs_y[p], extent_y, distance);
+				distance = _mm256_fmadd_ps(abs_z[p], extent_z, distance);
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, zero, _CMP_LT_OQ));
+			}
+
+			// Branchless compaction of the visible indices
+			int mask = ~_mm256_movemask_ps(outside) & 0xFF;
+			for (int j = 0; j < 8; ++j)
+			{
+				visible[visible_count] = static_cast<uint32_t>(i + j);
+				visible_count += (mask >> j) & 1;
+			}
+		}
+	}
+#endif
+
+	// Test 4 boxes at a time
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+		__m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+		__m128 abs_x[6], abs_y[6], abs_z[6];
+		for (int p = 0; p < 6; ++p)
+		{
+			plane_x[p] = _mm_set1_ps(m_Planes[p].x);
+			plane_y[p] = _mm_set1_ps(m_Planes[p].y);
+			plane_z[p] = _mm_set1_ps(m_Planes[p].z);
+			plane_w[p] = _mm_set1_ps(m_Planes[p].w);
+			abs_x[p] = _mm_andnot_ps(sign_mask, plane_x[p]);
+			abs_y[p] = _mm_andnot_ps(sign_mask, plane_y[p]);
+			abs_z[p] = _mm_andnot_ps(sign_mask, plane_z[p]);
+		}
+
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 center_x = _mm_loadu_ps(cx + i);
+			__m128 center_y = _mm_loadu_ps(cy + i);
+			__m128 center_z = _mm_loadu_ps(cz + i);
+			__m128 extent_x = _mm_loadu_ps(ex + i);
+			__m128 extent_y = _mm_loadu_ps(ey + i);
+			__m128 extent_z = _mm_loadu_ps(ez + i);
+
+			__m128 outside = zero;
+			for (int p = 0; p < 6; ++p)
+			{
+				__m128 distance = _mm_add_ps(_mm_mul_ps(plane_x[p], center_x), plane_w[p]);
+				distance = _mm_add_ps(_mm_mul_ps(plane_y[p], center_y), distance);
+				distance = _mm_add_ps(_mm_mul_ps(plane_z[p], center_z), distance);
+				distance = _mm_add_ps(_mm_mul_ps(abs_x[p], extent_x), distance);
+				distance = _mm_add_ps(_mm_mul_ps(abs_y[p], extent_y), distance);
+				distance = _mm_add_ps(_mm_mul_ps(abs_z[p], extent_z), distance);
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+			}
+
+			int mask = ~_mm_movemask_ps(outside) & 0xF;
+			for (int j = 0; j < 4; ++j)
+			{
+				visible[visible_count] = static_cast<uint32_t>(i + j);
+				visible_count += (mask >> j) & 1;
+			}
+		}
+	}
+
+	// Remaining boxes
+	for (; i < count; ++i)
+	{
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; ++p)
+		{
+			const DirectX::XMFLOAT4& plane = m_Planes[p];
+			float distance = plane.x * cx[i] + plane.y * cy[i] + plane.z * cz[i] + plane.w;
+			float radius = std::abs(plane.x) * ex[i] + std::abs(plane.y) * ey[i] + std::abs(plane.z) * ez[i];
+			outside = distance + radius < 0.0f;
+		}
+
+		if (!outside)
+		{
+			visible[visible_count++] = static_cast<uint32_t>(i);
+		}
+	}
+
+	visible.resize(visible_count);
+	return visible_count;
+}
+
+bool Rove::Frustum::Intersects(const DirectX::BoundingBox& box) const
+{
+	for (const DirectX::XMFLOAT4& plane : m_Planes)
+	{
+		float distance = plane.x * box.Center.x + plane.y * box.Center.y + plane.z * box.Center.z + plane.w;
+		float radius = std::abs(plane.x) * box.Extents.x + std::abs(plane.y) * box.Extents.y + std::abs(plane.z) * box.Extents.z;
+		if (distance + radius < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
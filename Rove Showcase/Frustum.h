@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Pch.h"
+
+namespace Rove
+{
+	// Axis aligned bounding boxes stored as a structure of arrays so they can be tested several at a time
+	struct BoundsSoA
+	{
+		std::vector<float> center_x;
+		std::vector<float> center_y;
+		std::vector<float> center_z;
+
+		std::vector<float> extent_x;
+		std::vector<float> extent_y;
+		std::vector<float> extent_z;
+
+		// Remove all bounds
+		void Clear();
+
+		// Reserve space for a number of bounds
+		void Reserve(size_t count);
+
+		// Append a bounding box
+		void Add(const DirectX::BoundingBox& box);
+
+		// Overwrite the bounding box at an index
+		void Set(size_t index, const DirectX::BoundingBox& box);
+
+		// Get the bounding box at an index
+		DirectX::BoundingBox Get(size_t index) const;
+
+		// Number of bounds
+		size_t Size() const { return center_x.size(); }
+	};
+
+	// View frustum
+	class Frustum
+	{
+	public:
+		Frustum() = default;
+		virtual ~Frustum() = default;
+
+		// Extracts the six planes from a combined view projection matrix
+		void Extract(const DirectX::XMMATRIX& view_projection);
+
+		// Tests every bound and writes the indices of the visible ones, returns the visible count
+		size_t Cull(const BoundsSoA& bounds, std::vector<uint32_t>& visible) const;
+
+		// Tests a single bounding box
+		bool Intersects(const DirectX::BoundingBox& box) const;
+
+		// Get the planes, pointing into the frustum
+		const DirectX::XMFLOAT4* GetPlanes() const { return m_Planes; }
+
+	private:
+		// Left, right, bottom, top, near and far planes
+		DirectX::XMFLOAT4 m_Planes[6] = {};
+	};
+}
@@ -0,0 +1,158 @@
+#include "Pch.h"
+#include "GeometryPool.h"
+#include "DxRenderer.h"
+#include "Model.h"
+#include "MemoryTracker.h"
+
+namespace
+{
+	// Elements in a new pool buffer, a mesh larger than this gets a buffer of its own size
+	constexpr uint64_t VERTEX_BLOCK_ELEMENTS = 256 * 1024;
+	constexpr uint64_t INDEX_BLOCK_ELEMENTS = 1024 * 1024;
+}
+
+Rove::GeometryPool::GeometryPool(DxRenderer* renderer) : m_DxRenderer(renderer)
+{
+	m_Vertices.stride = sizeof(Vertex);
+	m_Vertices.bind_flags = D3D11_BIND_VERTEX_BUFFER;
+	m_Vertices.block_elements = VERTEX_BLOCK_ELEMENTS;
+
+	m_Indices16.stride = sizeof(USHORT);
+	m_Indices16.bind_flags = D3D11_BIND_INDEX_BUFFER;
+	m_Indices16.block_elements = INDEX_BLOCK_ELEMENTS;
+
+	m_Indices32.stride = sizeof(UINT);
+	m_Indices32.bind_flags = D3D11_BIND_INDEX_BUFFER;
+	m_Indices32.block_elements = INDEX_BLOCK_ELEMENTS;
+}
+
+Rove::GeometryPool::~GeometryPool()
+{
+	for (const Pool* pool : { &m_Vertices, &m_Indices16, &m_Indices32 })
+	{
+		for (const Block& block : pool->blocks)
+		{
+			if (block.buffer != nullptr)
+			{
+				MemoryTracker::Freed(MemoryTag::GpuBuffers, block.allocator.GetSize() * pool->stride);
+			}
+		}
+	}
+}
+
+void Rove::GeometryPool::Add(MeshGeometry& geometry, const std::vector<Vertex>& vertices, const void* indices, UINT index_count, DXGI_FORMAT format)
+{
+	uint64_t vertex_offset = 0;
+	geometry.VertexBlock = Allocate(m_Vertices, vertices.data(), vertices.size(), &vertex_offset);
+	geometry.VertexCount = static_cast<UINT>(vertices.size());
+	geometry.BaseVertexLocation = static_cast<INT>(vertex_offset);
+	geometry.VertexBuffer = m_Vertices.blocks.empty() ? nullptr : m_Vertices.blocks[geometry.VertexBlock].buffer;
+
+	// Meshes with an index format that cannot be drawn keep no indices
+	if (format == DXGI_FORMAT_R16_UINT || format == DXGI_FORMAT_R32_UINT)
+	{
+		Pool& index_pool = GetIndexPool(format);
+
+		uint64_t index_offset = 0;
+		geometry.IndexBlock = Allocate(index_pool, indices, index_count, &index_offset);
+		geometry.IndexCount = index_count;
+		geometry.StartIndexLocation = static_cast<UINT>(index_offset);
+		geometry.IndexBuffer = index_pool.blocks.empty() ? nullptr : index_pool.blocks[geometry.IndexBlock].buffer;
+		geometry.IndexBufferFormat = format;
+	}
+
+	geometry.Pool = this;
+}
+
+void Rove::GeometryPool::Remove(MeshGeometry& geometry)
+{
+	if (geometry.VertexCount > 0)
+	{
+		m_Vertices.blocks[geometry.VertexBlock].allocator.Free(geometry.BaseVertexLocation, geometry.VertexCount);
+	}
+
+	if (geometry.IndexCount > 0)
+	{
+		GetIndexPool(geometry.IndexBufferFormat).blocks[geometry.IndexBlock].allocator.Free(geometry.StartIndexLocation, geometry.IndexCount);
+	}
+
+	geometry.Pool = nullptr;
+}
+
+Rove::GeometryPoolStats Rove::GeometryPool::GetStats() const
+{
+	GeometryPoolStats stats;
+	for (const Pool* pool : { &m_Vertices, &m_Indices16, &m_Indices32 })
+	{
+		for (const Block& block : pool->blocks)
+		{
+			const OffsetAllocator& allocator = block.allocator;
+			stats.buffer_count += 1;
+			stats.capacity_bytes += allocator.GetSize() * pool->stride;
+			stats.used_bytes += (allocator.GetSize() - allocator.GetFreeSize()) * pool->stride;
+			stats.free_ranges += allocator.GetFreeRangeCount();
+		}
+	}
+
+	return stats;
+}
+
+Rove::GeometryPool::Pool& Rove::GeometryPool::GetIndexPool(DXGI_FORMAT format)
+{
+	return format == DXGI_FORMAT_R16_UINT ? m_Indices16 : m_Indices32;
+}
+
+uint32_t Rove::GeometryPool::Allocate(Pool& pool, const void* data, uint64_t count, uint64_t* offset)
+{
+	*offset = 0;
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	// First buffer with a free range large enough
+	uint32_t block_index = 0;
+	for (; block_index < pool.blocks.size(); ++block_index)
+	{
+		*offset = pool.blocks[block_index].allocator.Allocate(count);
+		if (*offset != OffsetAllocator::INVALID_OFFSET)
+		{
+			break;
+		}
+	}
+
+	if (block_index == pool.blocks.size())
+	{
+		Block block;
+		block.allocator.Reset(std::max(pool.block_elements, count));
+
+		if (m_DxRenderer != nullptr)
+		{
+			// Default usage so each mesh can be written into its range
+			D3D11_BUFFER_DESC bd = {};
+			bd.Usage = D3D11_USAGE_DEFAULT;
+			bd.ByteWidth = static_cast<UINT>(block.allocator.GetSize() * pool.stride);
+			bd.BindFlags = pool.bind_flags;
+
+			DX::Check(m_DxRenderer->GetDevice()->CreateBuffer(&bd, nullptr, block.buffer.ReleaseAndGetAddressOf()));
+			MemoryTracker::Allocated(MemoryTag::GpuBuffers, bd.ByteWidth);
+		}
+
+		*offset = block.allocator.Allocate(count);
+		pool.blocks.push_back(block);
+	}
+
+	// Upload into the range
+	if (m_DxRenderer != nullptr)
+	{
+		D3D11_BOX box = {};
+		box.left = static_cast<UINT>(*offset * pool.stride);
+		box.right = static_cast<UINT>((*offset + count) * pool.stride);
+		box.bottom = 1;
+		box.back = 1;
+
+		m_DxRenderer->GetDeviceContext()->UpdateSubresource(pool.blocks[block_index].buffer.Get(), 0, &box, data, 0, 0);
+	}
+
+	return block_index;
+}
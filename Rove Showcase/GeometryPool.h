@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Pch.h"
+#include "OffsetAllocator.h"
+
+namespace Rove
+{
+	// Forward declarations
+	class DxRenderer;
+	struct MeshGeometry;
+	struct Vertex;
+
+	// Usage of the pool buffers
+	struct GeometryPoolStats
+	{
+		int buffer_count = 0;
+		uint64_t used_bytes = 0;
+		uint64_t capacity_bytes = 0;
+		size_t free_ranges = 0;
+	};
+
+	// Vertex and index data of every mesh of the scene held in a few large buffers, one set for vertices and one for each
+	// index format. A mesh is a range in each and is drawn with its base vertex and start index, so consecutive draws
+	// keep the same buffers bound. A new buffer is only created when no existing one has a free range large enough.
+	class GeometryPool
+	{
+	public:
+		// Without a renderer the ranges are still allocated but nothing is uploaded
+		GeometryPool(DxRenderer* renderer);
+		virtual ~GeometryPool();
+
+		// Copies the vertices and indices of a geometry into the pool and points the geometry at its ranges
+		void Add(MeshGeometry& geometry, const std::vector<Vertex>& vertices, const void* indices, UINT index_count, DXGI_FORMAT format);
+
+		// Returns the ranges of a geometry for reuse
+		void Remove(MeshGeometry& geometry);
+
+		// Usage of every pool buffer
+		GeometryPoolStats GetStats() const;
+
+	private:
+		DxRenderer* m_DxRenderer = nullptr;
+
+		// Buffer with its own allocator counting elements
+		struct Block
+		{
+			ComPtr<ID3D11Buffer> buffer;
+			OffsetAllocator allocator;
+		};
+
+		// Blocks holding one kind of element
+		struct Pool
+		{
+			std::vector<Block> blocks;
+			UINT stride = 0;
+			UINT bind_flags = 0;
+			uint64_t block_elements = 0;
+		};
+
+		Pool m_Vertices;
+		Pool m_Indices16;
+		Pool m_Indices32;
+
+		Pool& GetIndexPool(DXGI_FORMAT format);
+
+		// Allocates and uploads a range of elements, returns the block index and writes the first element
+		uint32_t Allocate(Pool& pool, const void* data, uint64_t count, uint64_t* offset);
+	};
+}
@@ -3,6 +3,8 @@
 #include "Model.h"
 #include "TextureLoader\WICTextureLoader.h"
 #include "DxRenderer.h"
+#include "Profiler.h"
+#include "JobSystem.h"
 using namespace simdjson;
 using namespace simdjson::dom;
 
@@ -24,11 +26,67 @@ namespace
 		return dataTypes[type];
 	}
 
+	// FNV-1a over eight bytes at a time, the tail is folded in byte by byte
+	uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+	{
+		constexpr uint64_t prime = 1099511628211ull;
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+		size_t i = 0;
+		for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+		{
+			uint64_t word;
+			std::memcpy(&word, bytes + i, sizeof(uint64_t));
+			hash = (hash ^ word) * prime;
+		}
+
+		for (; i < size; ++i)
+		{
+			hash = (hash ^ bytes[i]) * prime;
+		}
+
+		return hash;
+	}
+
+	int GetComponentCount(Rove::AccessorDataType type)
+	{
+		switch (type)
+		{
+		case Rove::AccessorDataType::SCALAR: return 1;
+		case Rove::AccessorDataType::VEC2: return 2;
+		case Rove::AccessorDataType::VEC3: return 3;
+		case Rove::AccessorDataType::VEC4: return 4;
+		default: return 0;
+		}
+	}
+
+	int GetComponentSize(Rove::ComponentDataType type)
+	{
+		switch (type)
+		{
+		case Rove::ComponentDataType::SIGNED_BYTE:
+		case Rove::ComponentDataType::UNSIGNED_BYTE: return 1;
+		case Rove::ComponentDataType::SIGNED_SHORT:
+		case Rove::ComponentDataType::UNSIGNED_SHORT: return 2;
+		case Rove::ComponentDataType::UNSIGNED_INT:
+		case Rove::ComponentDataType::FLOAT: return 4;
+		default: return 0;
+		}
+	}
+
 	template <typename TDataType>
-	std::vector<TDataType> ReinterpretBuffer(std::vector<char> buffer, int64_t count)
+	TDataType ReadComponent(const char* data)
 	{
-		TDataType* data = reinterpret_cast<TDataType*>(buffer.data());
-		return std::vector<TDataType>(data, data + count);
+		TDataType value;
+		std::memcpy(&value, data, sizeof(TDataType));
+		return value;
+	}
+
+	template <typename TDataType>
+	Rove::TaggedVector<TDataType, Rove::MemoryTag::Loader> ReinterpretBuffer(const Rove::LoaderBuffer& buffer, int64_t count)
+	{
+		const TDataType* data = reinterpret_cast<const TDataType*>(buffer.data());
+		return Rove::TaggedVector<TDataType, Rove::MemoryTag::Loader>(data, data + count);
 	}
 }
 
@@ -70,14 +128,22 @@ namespace Json
 	constexpr std::string_view Textures = "textures";
 	constexpr std::string_view Images = "images";
 	constexpr std::string_view Source = "source";
+	constexpr std::string_view ByteStride = "byteStride";
+	constexpr std::string_view Extensions = "extensions";
+	constexpr std::string_view MeshGpuInstancing = "EXT_mesh_gpu_instancing";
+	constexpr std::string_view InstanceTranslation = "TRANSLATION";
+	constexpr std::string_view InstanceRotation = "ROTATION";
+	constexpr std::string_view InstanceScale = "SCALE";
 }
 
-Rove::GltfLoader::GltfLoader(DxRenderer* renderer, DxShader* shader) : m_DxRenderer(renderer), m_DxShader(shader)
+Rove::GltfLoader::GltfLoader(DxRenderer* renderer, DxShader* shader, MaterialTable* material_table, GeometryPool* geometry_pool, JobSystem* job_system) : m_DxRenderer(renderer), m_DxShader(shader), m_MaterialTable(material_table), m_GeometryPool(geometry_pool), m_JobSystem(job_system)
 {
 }
 
 std::vector<std::unique_ptr<Rove::Model>> Rove::GltfLoader::Load(const std::filesystem::path& path)
 {
+	ROVE_PROFILE_ZONE("Load glTF");
+
 	HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
 
 	m_Path = path;
@@ -91,7 +157,7 @@ std::vector<std::unique_ptr<Rove::Model>> Rove::GltfLoader::Load(const std::file
 	for (element node : document[Json::Nodes])
 	{
 		// Model* model = new Model(m_DxRenderer, m_DxShader);
-		std::unique_ptr<Model> model = std::make_unique<Model>(m_DxRenderer, m_DxShader);
+		std::unique_ptr<Model> model = std::make_unique<Model>(m_DxRenderer, m_DxShader, m_MaterialTable);
 
 		// Check if node is valid
 		simdjson_result<int64_t> mesh_index = node[Json::Mesh].get_int64();
@@ -115,39 +181,68 @@ std::vector<std::unique_ptr<Rove::Model>> Rove::GltfLoader::Load(const std::file
 
 		// We only care about the first primitive as we don't care about trying to render other primitives and we assume its a triangle list
 		simdjson_result<element> primitive = mesh[Json::Primitives].at(0);
-		simdjson_result<element> attribute = primitive[Json::Attributes];
 
-		// Position vertices
-		LoadVertices(document.value(), attribute.value(), model.get());
+		// Geometry
+		model->Geometry = LoadGeometry(document.value(), mesh_index.value(), primitive.value());
 
-		// Indices
-		simdjson_result<int64_t> indices_index = primitive[Json::Indices].get_int64();
-		simdjson_result<element> index_accessor = document[Json::Accessors].at(indices_index.value());
-		LoadIndices(document.value(), index_accessor.value(), model.get());
+		// Instances
+		LoadInstances(document.value(), node, model.get());
 
 		// Material
+		Material model_material;
+		ComPtr<ID3D11ShaderResourceView> diffuse_texture = nullptr;
+		ComPtr<ID3D11ShaderResourceView> normal_texture = nullptr;
+
 		simdjson_result<int64_t> material_index = primitive[Json::Material].get_int64();
 		if (material_index.error() == simdjson::SUCCESS)
 		{
 			simdjson_result<element> material = document[Json::Materials].at(material_index.value());
 
 			// Properties
-			model->Material.metallicFactor = static_cast<float>(material[Json::PbrMetallicRoughness][Json::MetallicFactor].get_double());
-			model->Material.roughnessFactor = static_cast<float>(material[Json::PbrMetallicRoughness][Json::RoughnessFactor].get_double());
+			model_material.metallicFactor = static_cast<float>(material[Json::PbrMetallicRoughness][Json::MetallicFactor].get_double());
+			model_material.roughnessFactor = static_cast<float>(material[Json::PbrMetallicRoughness][Json::RoughnessFactor].get_double());
 
 			// Diffuse texture
-			LoadDiffuseTexture(document.value(), material.value(), model.get());
+			diffuse_texture = LoadDiffuseTexture(document.value(), material.value());
 
 			// Normal texture
-			LoadNormalTexture(document.value(), material.value(), model.get());
+			normal_texture = LoadNormalTexture(document.value(), material.value());
 		}
 
+		// Models with the same material share one entry in the table
+		model->MaterialIndex = m_MaterialTable->Add(model_material, diffuse_texture.Get(), normal_texture.Get());
+
 		// Assign model
 		model->World = world;
 		model->Name = name.value();
 		models.push_back(std::move(model));
 	}
 
+	// Build the triangle hierarchies of the distinct geometry on the job system, one job per geometry
+	std::vector<MeshGeometry*> geometries;
+	for (auto& geometry : m_GeometryByHash)
+	{
+		geometries.push_back(geometry.second.get());
+	}
+
+	auto build_bvh = [&geometries](uint32_t index)
+	{
+		geometries[index]->Bvh.Build(geometries[index]->Positions, geometries[index]->Indices);
+		geometries[index]->CountCpuBytes();
+	};
+
+	if (m_JobSystem != nullptr)
+	{
+		m_JobSystem->ParallelFor(static_cast<uint32_t>(geometries.size()), build_bvh);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < geometries.size(); ++i)
+		{
+			build_bvh(i);
+		}
+	}
+
 	CoUninitialize();
 	return models;
 }
@@ -180,9 +275,195 @@ DirectX::XMMATRIX Rove::GltfLoader::ApplyWorldTransformation(simdjson::dom::elem
 	return world;
 }
 
-void Rove::GltfLoader::LoadVertices(simdjson::dom::element& document, simdjson::dom::element& attribute, Model* model)
+std::shared_ptr<Rove::MeshGeometry> Rove::GltfLoader::LoadGeometry(simdjson::dom::element& document, int64_t mesh_index, simdjson::dom::element& primitive)
 {
+	// Nodes referencing the same mesh share its geometry
+	auto mesh = m_Meshes.find(mesh_index);
+	if (mesh != m_Meshes.end())
+	{
+		return mesh->second;
+	}
+
+	std::shared_ptr<MeshGeometry> geometry = std::make_shared<MeshGeometry>();
+
+	// Position vertices
 	std::vector<Vertex> vertices;
+	simdjson_result<element> attribute = primitive[Json::Attributes];
+	LoadVertices(document, attribute.value(), vertices, geometry.get());
+
+	// Indices
+	simdjson_result<int64_t> indices_index = primitive[Json::Indices].get_int64();
+	simdjson_result<element> index_accessor = document[Json::Accessors].at(indices_index.value());
+	ComponentDataType index_data_type = ComponentDataType::UNKNOWN;
+	LoaderBuffer index_data = LoadIndices(document, index_accessor.value(), &index_data_type, geometry.get());
+
+	// Exporters often write a copy of the mesh for every node, the hash covers every vertex attribute and the positions
+	// and indices are compared to rule out a collision
+	geometry->Hash = HashBytes(index_data.data(), index_data.size(), HashBytes(vertices.data(), vertices.size() * sizeof(Vertex)));
+
+	auto range = m_GeometryByHash.equal_range(geometry->Hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		const MeshGeometry* existing = it->second.get();
+		if (existing->Indices == geometry->Indices && existing->Positions.size() == geometry->Positions.size() &&
+			std::memcmp(existing->Positions.data(), geometry->Positions.data(), geometry->Positions.size() * sizeof(DirectX::XMFLOAT3)) == 0)
+		{
+			m_Meshes.emplace(mesh_index, it->second);
+			return it->second;
+		}
+	}
+
+	// Local bounds used for culling
+	DirectX::BoundingBox::CreateFromPoints(geometry->Bounds, geometry->Positions.size(), geometry->Positions.data(), sizeof(DirectX::XMFLOAT3));
+
+	// New geometry gets its own ranges in the pool buffers
+	DXGI_FORMAT index_format = DXGI_FORMAT_UNKNOWN;
+	if (index_data_type == ComponentDataType::UNSIGNED_SHORT)
+	{
+		index_format = DXGI_FORMAT_R16_UINT;
+	}
+	else if (index_data_type == ComponentDataType::UNSIGNED_INT)
+	{
+		index_format = DXGI_FORMAT_R32_UINT;
+	}
+
+	m_GeometryPool->Add(*geometry, vertices, index_data.data(), static_cast<UINT>(geometry->Indices.size()), index_format);
+	geometry->Vertices = std::move(vertices);
+
+	m_GeometryByHash.emplace(geometry->Hash, geometry);
+	m_Meshes.emplace(mesh_index, geometry);
+	return geometry;
+}
+
+void Rove::GltfLoader::LoadInstances(simdjson::dom::element& document, simdjson::dom::element& node, Model* model)
+{
+	simdjson_result<element> attributes = node[Json::Extensions][Json::MeshGpuInstancing][Json::Attributes];
+	if (attributes.error() != simdjson::SUCCESS)
+	{
+		return;
+	}
+
+	// Every attribute is optional, instances past the end of one keep its identity value
+	AccessorView translation, rotation, scale;
+	std::pair<std::string_view, AccessorView*> views[] =
+	{
+		{ Json::InstanceTranslation, &translation },
+		{ Json::InstanceRotation, &rotation },
+		{ Json::InstanceScale, &scale },
+	};
+
+	int64_t count = 0;
+	for (auto& view : views)
+	{
+		simdjson_result<int64_t> accessor_index = attributes[view.first].get_int64();
+		if (accessor_index.error() == simdjson::SUCCESS)
+		{
+			*view.second = GetAccessorView(document, accessor_index.value());
+			count = std::max(count, view.second->count);
+		}
+	}
+
+	// Each instance is scaled, rotated and translated before the node transformation
+	model->Instances.resize(count);
+	for (int64_t i = 0; i < count; ++i)
+	{
+		DirectX::XMVECTOR t = DirectX::XMVectorZero();
+		if (i < translation.count)
+		{
+			t = DirectX::XMVectorSet(translation.Read(i, 0), translation.Read(i, 1), translation.Read(i, 2), 0.0f);
+		}
+
+		DirectX::XMVECTOR r = DirectX::XMQuaternionIdentity();
+		if (i < rotation.count)
+		{
+			r = DirectX::XMVectorSet(rotation.Read(i, 0), rotation.Read(i, 1), rotation.Read(i, 2), rotation.Read(i, 3));
+		}
+
+		DirectX::XMVECTOR s = DirectX::XMVectorSplatOne();
+		if (i < scale.count)
+		{
+			s = DirectX::XMVectorSet(scale.Read(i, 0), scale.Read(i, 1), scale.Read(i, 2), 0.0f);
+		}
+
+		model->Instances[i] = DirectX::XMMatrixAffineTransformation(s, DirectX::XMVectorZero(), r, t);
+	}
+}
+
+const Rove::LoaderBuffer& Rove::GltfLoader::LoadBuffer(simdjson::dom::element& document, int64_t buffer_index)
+{
+	auto it = m_Buffers.find(buffer_index);
+	if (it != m_Buffers.end())
+	{
+		return it->second;
+	}
+
+	simdjson_result<element> buffer = document[Json::Buffers].at(buffer_index);
+	int64_t byte_length = buffer[Json::ByteLength].get_int64().value();
+	std::string_view buffer_uri = buffer[Json::Uri].get_string();
+
+	std::filesystem::path binary_path = m_Path.parent_path();
+	binary_path.append(buffer_uri);
+
+	LoaderBuffer& data = m_Buffers[buffer_index];
+	data.resize(byte_length);
+
+	std::ifstream file(binary_path.string(), std::fstream::in | std::fstream::binary);
+	file.read(data.data(), byte_length);
+	return data;
+}
+
+Rove::AccessorView Rove::GltfLoader::GetAccessorView(simdjson::dom::element& document, int64_t accessor_index)
+{
+	simdjson_result<element> accessor = document[Json::Accessors].at(accessor_index);
+
+	AccessorView view;
+	view.count = accessor[Json::Count].get_int64().value();
+	view.component_type = static_cast<ComponentDataType>(accessor[Json::ComponentType].get_int64().value());
+
+	simdjson_result<int64_t> accessor_offset = accessor[Json::ByteOffset].get_int64();
+	int64_t element_size = GetComponentCount(GetAccessorType(accessor[Json::Type].get_string())) * GetComponentSize(view.component_type);
+
+	// The view stride is only given for interleaved data
+	simdjson_result<element> buffer_view = document[Json::BufferViews].at(accessor[Json::BufferView].get_int64().value());
+	simdjson_result<int64_t> view_offset = buffer_view[Json::ByteOffset].get_int64();
+	simdjson_result<int64_t> view_stride = buffer_view[Json::ByteStride].get_int64();
+	view.stride = view_stride.error() == simdjson::SUCCESS ? view_stride.value() : element_size;
+
+	int64_t offset = (view_offset.error() == simdjson::SUCCESS ? view_offset.value() : 0) + (accessor_offset.error() == simdjson::SUCCESS ? accessor_offset.value() : 0);
+	const LoaderBuffer& data = LoadBuffer(document, buffer_view[Json::Buffer].get_int64().value());
+
+	if (element_size == 0 || (view.count > 0 && offset + view.stride * (view.count - 1) + element_size > static_cast<int64_t>(data.size())))
+	{
+		throw std::exception("Accessor does not fit in its buffer");
+	}
+
+	view.data = data.data() + offset;
+	return view;
+}
+
+float Rove::AccessorView::Read(int64_t element, int component) const
+{
+	const char* value = data + element * stride;
+
+	switch (component_type)
+	{
+	case ComponentDataType::FLOAT:
+		return ReadComponent<float>(value + component * sizeof(float));
+	case ComponentDataType::SIGNED_BYTE:
+		return std::max(ReadComponent<int8_t>(value + component) / 127.0f, -1.0f);
+	case ComponentDataType::UNSIGNED_BYTE:
+		return ReadComponent<uint8_t>(value + component) / 255.0f;
+	case ComponentDataType::SIGNED_SHORT:
+		return std::max(ReadComponent<int16_t>(value + component * sizeof(int16_t)) / 32767.0f, -1.0f);
+	case ComponentDataType::UNSIGNED_SHORT:
+		return ReadComponent<uint16_t>(value + component * sizeof(uint16_t)) / 65535.0f;
+	default:
+		return 0.0f;
+	}
+}
+
+void Rove::GltfLoader::LoadVertices(simdjson::dom::element& document, simdjson::dom::element& attribute, std::vector<Vertex>& vertices, MeshGeometry* geometry)
+{
 
 	// Position
 	{
@@ -195,16 +476,19 @@ void Rove::GltfLoader::LoadVertices(simdjson::dom::element& document, simdjson::
 		simdjson_result<element> accessor = document[Json::Accessors].at(accessor_index.value());
 
 		int64_t count = 0;
-		std::vector<char> buffer = BufferAccessor(document, accessor.value(), nullptr, nullptr, &count);
-		std::vector<Vec3<float>> data = ReinterpretBuffer<Vec3<float>>(buffer, count);
+		LoaderBuffer buffer = BufferAccessor(document, accessor.value(), nullptr, nullptr, &count);
+		TaggedVector<Vec3<float>, MemoryTag::Loader> data = ReinterpretBuffer<Vec3<float>>(buffer, count);
 		vertices.resize(count);
 
+		geometry->Positions.resize(count);
+
 		for (int64_t i = 0; i < count; ++i)
 		{
 			Vec3<float> position = data[i];
 			vertices[i].x = position.x;
 			vertices[i].y = position.y;
 			vertices[i].z = position.z;
+			geometry->Positions[i] = DirectX::XMFLOAT3(position.x, position.y, position.z);
 		}
 	}
 
@@ -215,8 +499,8 @@ void Rove::GltfLoader::LoadVertices(simdjson::dom::element& document, simdjson::
 		{
 			simdjson_result<element> accessor = document[Json::Accessors].at(accessor_index.value());
 			int64_t count = 0;
-			std::vector<char> buffer = BufferAccessor(document, accessor.value(), nullptr, nullptr, &count);
-			std::vector<Vec3<float>> data = ReinterpretBuffer<Vec3<float>>(buffer, count);
+			LoaderBuffer buffer = BufferAccessor(document, accessor.value(), nullptr, nullptr, &count);
+			TaggedVector<Vec3<float>, MemoryTag::Loader> data = ReinterpretBuffer<Vec3<float>>(buffer, count);
 
 			for (int64_t i = 0; i < count; ++i)
 			{
@@ -236,8 +520,8 @@ void Rove::GltfLoader::LoadVertices(simdjson::dom::element& document, simdjson::
 			simdjson_result<element> accessor = document[Json::Accessors].at(accessor_index.value());
 
 			int64_t count = 0;
-			std::vector<char> buffer = BufferAccessor(document, accessor.value(), nullptr, nullptr, &count);
-			std::vector<Vec4<float>> data = ReinterpretBuffer<Vec4<float>>(buffer, count);
+			LoaderBuffer buffer = BufferAccessor(document, accessor.value(), nullptr, nullptr, &count);
+			TaggedVector<Vec4<float>, MemoryTag::Loader> data = ReinterpretBuffer<Vec4<float>>(buffer, count);
 
 			for (int64_t i = 0; i < count; ++i)
 			{
@@ -257,8 +541,8 @@ void Rove::GltfLoader::LoadVertices(simdjson::dom::element& document, simdjson::
 			simdjson_result<element> accessor = document[Json::Accessors].at(accessor_index.value());
 
 			int64_t count = 0;
-			std::vector<char> buffer = BufferAccessor(document, accessor.value(), nullptr, nullptr, &count);
-			std::vector<Vec2<float>> data = ReinterpretBuffer<Vec2<float>>(buffer, count);
+			LoaderBuffer buffer = BufferAccessor(document, accessor.value(), nullptr, nullptr, &count);
+			TaggedVector<Vec2<float>, MemoryTag::Loader> data = ReinterpretBuffer<Vec2<float>>(buffer, count);
 
 			for (int64_t i = 0; i < count; ++i)
 			{
@@ -268,35 +552,36 @@ void Rove::GltfLoader::LoadVertices(simdjson::dom::element& document, simdjson::
 			}
 		}
 	}
-
-	model->CreateVertexBuffer(vertices);
 }
 
-void Rove::GltfLoader::LoadIndices(simdjson::dom::element& document, simdjson::dom::element& accessor, Model* model)
+Rove::LoaderBuffer Rove::GltfLoader::LoadIndices(simdjson::dom::element& document, simdjson::dom::element& accessor, ComponentDataType* component_data_type, MeshGeometry* geometry)
 {
 	int64_t count = 0;
-	ComponentDataType component_data_type = ComponentDataType::UNKNOWN;
-	std::vector<char> indices_buffer = BufferAccessor(document, accessor, &component_data_type, nullptr, &count);
+	LoaderBuffer indices_buffer = BufferAccessor(document, accessor, component_data_type, nullptr, &count);
 
-	if (component_data_type == ComponentDataType::UNSIGNED_SHORT)
+	if (*component_data_type == ComponentDataType::UNSIGNED_SHORT)
 	{
 		USHORT* data = reinterpret_cast<USHORT*>(indices_buffer.data());
-		model->CreateIndexBuffer(data, static_cast<UINT>(count), sizeof(USHORT), DXGI_FORMAT_R16_UINT);
+		geometry->Indices.assign(data, data + count);
+		indices_buffer.resize(count * sizeof(USHORT));
 	}
-	else if (component_data_type == ComponentDataType::UNSIGNED_INT)
+	else if (*component_data_type == ComponentDataType::UNSIGNED_INT)
 	{
 		UINT* data = reinterpret_cast<UINT*>(indices_buffer.data());
-		model->CreateIndexBuffer(data, static_cast<UINT>(count), sizeof(UINT), DXGI_FORMAT_R32_UINT);
+		geometry->Indices.assign(data, data + count);
+		indices_buffer.resize(count * sizeof(UINT));
 	}
+
+	return indices_buffer;
 }
 
-void Rove::GltfLoader::LoadDiffuseTexture(simdjson::dom::element& document, simdjson::dom::element& node, Model* model)
+ComPtr<ID3D11ShaderResourceView> Rove::GltfLoader::LoadDiffuseTexture(simdjson::dom::element& document, simdjson::dom::element& node)
 {
 	simdjson_result<int64_t> texture_index = node[Json::PbrMetallicRoughness][Json::BaseColorTexture][Json::Index].get_int64();
-	if (texture_index.error() != simdjson::SUCCESS)
+	if (texture_index.error() != simdjson::SUCCESS || m_DxRenderer == nullptr)
 	{
-		// No diffuse texture detected
-		return;
+		// No diffuse texture detected or loading headless
+		return nullptr;
 	}
 
 	simdjson_result<int64_t> image_index = document[Json::Textures].at(texture_index.value())[Json::Source].get_int64();
@@ -306,18 +591,16 @@ void Rove::GltfLoader::LoadDiffuseTexture(simdjson::dom::element& document, simd
 	std::filesystem::path texture_path = m_Path.parent_path();
 	texture_path.append(uri);
 
-	ComPtr<ID3D11Resource> resource = nullptr;
-	DX::Check(DirectX::CreateWICTextureFromFile(m_DxRenderer->GetDevice(), m_DxRenderer->GetDeviceContext(), texture_path.wstring().c_str(), resource.ReleaseAndGetAddressOf(), model->m_DiffuseTexture.ReleaseAndGetAddressOf()));
-	model->Material.diffuse_texture = true;
+	return LoadTexture(texture_path);
 }
 
-void Rove::GltfLoader::LoadNormalTexture(simdjson::dom::element& document, simdjson::dom::element& node, Model* model)
+ComPtr<ID3D11ShaderResourceView> Rove::GltfLoader::LoadNormalTexture(simdjson::dom::element& document, simdjson::dom::element& node)
 {
 	simdjson_result<int64_t> texture_index = node[Json::NormalTexture][Json::Index].get_int64();
-	if (texture_index.error() != simdjson::SUCCESS)
+	if (texture_index.error() != simdjson::SUCCESS || m_DxRenderer == nullptr)
 	{
-		// No normal texture detected
-		return;
+		// No normal texture detected or loading headless
+		return nullptr;
 	}
 
 	simdjson_result<int64_t> image_index = document[Json::Textures].at(texture_index.value())[Json::Source].get_int64();
@@ -327,12 +610,29 @@ void Rove::GltfLoader::LoadNormalTexture(simdjson::dom::element& document, simdj
 	std::filesystem::path texture_path = m_Path.parent_path();
 	texture_path.append(uri);
 
+	return LoadTexture(texture_path);
+}
+
+ComPtr<ID3D11ShaderResourceView> Rove::GltfLoader::LoadTexture(const std::filesystem::path& path)
+{
+	ROVE_PROFILE_ZONE("Load texture");
+
+	// Models using the same image share the view so the render queue can group them
+	auto it = m_Textures.find(path);
+	if (it != m_Textures.end())
+	{
+		return it->second;
+	}
+
 	ComPtr<ID3D11Resource> resource = nullptr;
-	DX::Check(DirectX::CreateWICTextureFromFile(m_DxRenderer->GetDevice(), m_DxRenderer->GetDeviceContext(), texture_path.wstring().c_str(), resource.ReleaseAndGetAddressOf(), model->m_NormalTexture.ReleaseAndGetAddressOf()));
-	model->Material.normal_texture = true;
+	ComPtr<ID3D11ShaderResourceView> texture = nullptr;
+	DX::Check(DirectX::CreateWICTextureFromFile(m_DxRenderer->GetDevice(), m_DxRenderer->GetDeviceContext(), path.wstring().c_str(), resource.ReleaseAndGetAddressOf(), texture.ReleaseAndGetAddressOf()));
+
+	m_Textures[path] = texture;
+	return texture;
 }
 
-std::vector<char> Rove::GltfLoader::BufferAccessor(simdjson::dom::element& document, simdjson::dom::element& accessor, ComponentDataType* componentDataType, AccessorDataType* accessorDataType, int64_t* count)
+Rove::LoaderBuffer Rove::GltfLoader::BufferAccessor(simdjson::dom::element& document, simdjson::dom::element& accessor, ComponentDataType* componentDataType, AccessorDataType* accessorDataType, int64_t* count)
 {
 	// Accessor
 	*count = accessor[Json::Count].get_int64();
@@ -366,7 +666,7 @@ std::vector<char> Rove::GltfLoader::BufferAccessor(simdjson::dom::element& docum
 	std::ifstream file(binary_path.string(), std::fstream::in | std::fstream::binary);
 	file.seekg(byte_offset);
 
-	std::vector<char> data;
+	LoaderBuffer data;
 	data.resize(byte_length);
 	file.read(data.data(), byte_length);
 
@@ -3,12 +3,19 @@
 #include "Pch.h"
 #include "simdjson\simdjson.h"
 #include "Model.h"
+#include "MemoryTracker.h"
 
 namespace Rove
 {
 	class Model;
 	class DxRenderer;
 	class DxShader;
+	class MaterialTable;
+	class GeometryPool;
+	class JobSystem;
+
+	// File data and scratch of the loader, counted under the loader tag
+	using LoaderBuffer = TaggedVector<char, MemoryTag::Loader>;
 
 	enum class ComponentDataType
 	{
@@ -54,15 +61,30 @@ namespace Rove
 		TDataType y;
 	};
 
+	// Elements of an accessor read in place from a loaded buffer, nothing is copied
+	struct AccessorView
+	{
+		const char* data = nullptr;
+		int64_t count = 0;
+		int64_t stride = 0;
+		ComponentDataType component_type = ComponentDataType::UNKNOWN;
+
+		// Reads one component of an element as a float, integers are normalised to [0, 1] or [-1, 1]
+		float Read(int64_t element, int component) const;
+	};
+
 	class GltfLoader
 	{
 	private: 
 		// Dependencies
 		DxRenderer* m_DxRenderer = nullptr;
 		DxShader* m_DxShader = nullptr;
+		MaterialTable* m_MaterialTable = nullptr;
+		GeometryPool* m_GeometryPool = nullptr;
+		JobSystem* m_JobSystem = nullptr;
 
 	public:
-		GltfLoader(DxRenderer* renderer, DxShader* shader);
+		GltfLoader(DxRenderer* renderer, DxShader* shader, MaterialTable* material_table, GeometryPool* geometry_pool, JobSystem* job_system);
 		virtual ~GltfLoader() = default;
 
 		std::vector<std::unique_ptr<Rove::Model>> Load(const std::filesystem::path& path);
@@ -72,10 +94,27 @@ namespace Rove
 
 		DirectX::XMMATRIX ApplyWorldTransformation(simdjson::dom::element& node);
 
-		void LoadVertices(simdjson::dom::element& document, simdjson::dom::element& attribute, Model* model);
-		void LoadIndices(simdjson::dom::element& document, simdjson::dom::element& accessor, Model* model);
-		void LoadDiffuseTexture(simdjson::dom::element& document, simdjson::dom::element& node, Model* model);
-		void LoadNormalTexture(simdjson::dom::element& document, simdjson::dom::element& node, Model* model);
-		std::vector<char> BufferAccessor(simdjson::dom::element& document, simdjson::dom::element& accessor, ComponentDataType* componentDataType, AccessorDataType* accessorDataType, int64_t* count);
+		// Geometry already loaded from this file by mesh index and by the hash of its data
+		std::map<int64_t, std::shared_ptr<MeshGeometry>> m_Meshes;
+		std::multimap<uint64_t, std::shared_ptr<MeshGeometry>> m_GeometryByHash;
+		std::shared_ptr<MeshGeometry> LoadGeometry(simdjson::dom::element& document, int64_t mesh_index, simdjson::dom::element& primitive);
+
+		// Reads the EXT_mesh_gpu_instancing transformations of a node into the model
+		void LoadInstances(simdjson::dom::element& document, simdjson::dom::element& node, Model* model);
+
+		// Binary buffers of this file by index, each is read once and accessor views point into it
+		std::map<int64_t, LoaderBuffer> m_Buffers;
+		const LoaderBuffer& LoadBuffer(simdjson::dom::element& document, int64_t buffer_index);
+		AccessorView GetAccessorView(simdjson::dom::element& document, int64_t accessor_index);
+
+		void LoadVertices(simdjson::dom::element& document, simdjson::dom::element& attribute, std::vector<Vertex>& vertices, MeshGeometry* geometry);
+		LoaderBuffer LoadIndices(simdjson::dom::element& document, simdjson::dom::element& accessor, ComponentDataType* component_data_type, MeshGeometry* geometry);
+		ComPtr<ID3D11ShaderResourceView> LoadDiffuseTexture(simdjson::dom::element& document, simdjson::dom::element& node);
+		ComPtr<ID3D11ShaderResourceView> LoadNormalTexture(simdjson::dom::element& document, simdjson::dom::element& node);
+
+		// Textures loaded from this file by path
+		std::map<std::filesystem::path, ComPtr<ID3D11ShaderResourceView>> m_Textures;
+		ComPtr<ID3D11ShaderResourceView> LoadTexture(const std::filesystem::path& path);
+		LoaderBuffer BufferAccessor(simdjson::dom::element& document, simdjson::dom::element& accessor, ComponentDataType* componentDataType, AccessorDataType* accessorDataType, int64_t* count);
 	};
 }
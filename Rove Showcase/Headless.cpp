@@ -0,0 +1,968 @@
+#include "Pch.h"
+#include "Headless.h"
+#include "Scene.h"
+#include "Camera.h"
+#include "CameraPath.h"
+#include "JobSystem.h"
+#include "CommandList.h"
+#include "RenderQueue.h"
+#include "DxShader.h"
+#include "StateTracker.h"
+#include "LightClusters.h"
+#include "MaterialTable.h"
+#include "ShaderVariantCache.h"
+#include "Profiler.h"
+#include "FrameTimeStats.h"
+#include "TraceCapture.h"
+#include "HitchDetector.h"
+#include "MemoryTracker.h"
+
+int Rove::RunOcclusionTest(const std::filesystem::path& scene_path, const std::filesystem::path& camera_path, std::ostream& output)
+{
+	JobSystem job_system;
+	Scene scene(nullptr, nullptr, &job_system);
+	scene.AddObject(scene_path);
+
+	CameraPath path;
+	path.Load(camera_path);
+	if (path.Size() == 0)
+	{
+		throw std::exception("Camera path has no frames");
+	}
+
+	Camera camera(1280, 720);
+
+	output << "frame,total,frustum_visible,occluded,visible,occluders,occluder_triangles,culling_us,occlusion_us\n";
+
+	int64_t total_frustum_visible = 0;
+	int64_t total_occluded = 0;
+	double total_occlusion_microseconds = 0.0;
+	double max_occlusion_microseconds = 0.0;
+	FrameTimeStats cull_times;
+
+	for (size_t frame = 0; frame < path.Size(); ++frame)
+	{
+		path.Apply(frame, camera);
+		scene.Cull(camera);
+
+		const CullingStats& stats = scene.GetCullingStats();
+		int frustum_visible = stats.visible_models + stats.occluded_models;
+
+		output << frame << ',' << stats.total_models << ',' << frustum_visible << ',' << stats.occluded_models << ',' << stats.visible_models << ','
+			<< stats.occluder_count << ',' << stats.occluder_triangles << ',' << stats.culling_microseconds << ',' << stats.occlusion_microseconds << '\n';
+
+		total_frustum_visible += frustum_visible;
+		total_occluded += stats.occluded_models;
+		total_occlusion_microseconds += stats.occlusion_microseconds;
+		max_occlusion_microseconds = std::max(max_occlusion_microseconds, stats.occlusion_microseconds);
+		cull_times.Add((stats.culling_microseconds + stats.occlusion_microseconds) / 1000.0);
+	}
+
+	double frames = static_cast<double>(path.Size());
+	output << "# frames " << path.Size() << ", threads " << job_system.GetThreadCount() << '\n';
+	output << "# occluded " << total_occluded << " of " << total_frustum_visible << " frustum visible models ("
+		<< (total_frustum_visible > 0 ? 100.0 * total_occluded / total_frustum_visible : 0.0) << "%)\n";
+	output << "# occlusion average " << total_occlusion_microseconds / frames << " us, max " << max_occlusion_microseconds << " us\n";
+
+	FrameTimeSummary cull_summary = cull_times.GetSummary();
+	output << "# cull p50 " << cull_summary.p50 << " ms, p95 " << cull_summary.p95 << " ms, p99 " << cull_summary.p99 << " ms, max " << cull_summary.max << " ms\n";
+
+	return 0;
+}
+
+int Rove::RunCommandBenchmark(uint32_t draw_count, std::ostream& output)
+{
+	constexpr int ITERATIONS = 50;
+	constexpr uint32_t GEOMETRY_COUNT = 512;
+	constexpr uint32_t MATERIAL_COUNT = 256;
+
+	// Draws in scene order with the keys the render queue would give them
+	struct Draw
+	{
+		uint64_t key;
+		uint32_t geometry;
+		uint32_t material;
+	};
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+	std::vector<Draw> draws(draw_count);
+	for (uint32_t i = 0; i < draw_count; ++i)
+	{
+		draws[i].geometry = random() % GEOMETRY_COUNT;
+		draws[i].material = random() % MATERIAL_COUNT;
+		draws[i].key = RenderQueue::MakeKey(RenderQueue::PASS_OPAQUE, draws[i].material, draws[i].geometry, depth(random));
+	}
+
+	auto record = [&](uint32_t first, uint32_t end, std::vector<RenderCommand>& commands)
+	{
+		for (uint32_t i = first; i < end; ++i)
+		{
+			RenderCommand command = {};
+			command.key = draws[i].key;
+			command.geometry = draws[i].geometry;
+			command.material = draws[i].material;
+			command.first = i;
+
+			// Every draw is a cube of 12 triangles
+			command.index_count = 36;
+			command.vertex_count = 24;
+			commands.push_back(command);
+		}
+	};
+
+	JobSystem job_system;
+	CommandRecorder recorder;
+	NullCommandBackend backend;
+	CommandStats stats;
+
+	double serial_microseconds = 0.0;
+	double parallel_microseconds = 0.0;
+	double merge_microseconds = 0.0;
+	double replay_microseconds = 0.0;
+	bool ordered = true;
+
+	for (int iteration = 0; iteration < ITERATIONS; ++iteration)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		recorder.Begin();
+		recorder.Record(nullptr, draw_count, record);
+		auto serial_end = std::chrono::high_resolution_clock::now();
+
+		recorder.Begin();
+		recorder.Record(&job_system, draw_count, record);
+		auto parallel_end = std::chrono::high_resolution_clock::now();
+
+		recorder.Merge();
+		auto merge_end = std::chrono::high_resolution_clock::now();
+
+		const std::vector<RenderCommand>& commands = recorder.GetCommands();
+		stats = backend.Execute(commands.data(), commands.size(), nullptr);
+		auto replay_end = std::chrono::high_resolution_clock::now();
+
+		serial_microseconds += std::chrono::duration<double, std::micro>(serial_end - start).count();
+		parallel_microseconds += std::chrono::duration<double, std::micro>(parallel_end - serial_end).count();
+		merge_microseconds += std::chrono::duration<double, std::micro>(merge_end - parallel_end).count();
+		replay_microseconds += std::chrono::duration<double, std::micro>(replay_end - merge_end).count();
+
+		ordered = ordered && commands.size() == draw_count && std::is_sorted(commands.begin(), commands.end(), [](const RenderCommand& a, const RenderCommand& b)
+		{
+			return a.key < b.key;
+		});
+	}
+
+	output << "# draws " << draw_count << ", buffers " << recorder.GetBufferCount() << ", threads " << job_system.GetThreadCount() << '\n';
+	output << "# record one thread " << serial_microseconds / ITERATIONS << " us, job system " << parallel_microseconds / ITERATIONS << " us\n";
+	output << "# merge " << merge_microseconds / ITERATIONS << " us, null replay " << replay_microseconds / ITERATIONS << " us\n";
+	output << "# replay " << stats.draws << " draws, " << stats.state_changes << " state changes, " << stats.buffer_binds << " buffer binds\n";
+
+	if (!ordered)
+	{
+		output << "# merged commands are not in key order\n";
+		return 1;
+	}
+
+	return 0;
+}
+
+int Rove::RunLightClusterTest(uint32_t light_count, std::ostream& output)
+{
+	constexpr int ITERATIONS = 100;
+	constexpr int SAMPLE_COUNT = 20000;
+
+	Camera camera(1280, 720);
+	DirectX::XMMATRIX view = camera.GetView();
+	float fov_y = DirectX::XMConvertToRadians(camera.GetFieldOfView());
+
+	// Lights spread around the orbit of the camera, some behind it and some past the far plane
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> radius(0.5f, 6.0f);
+	std::vector<DirectX::XMFLOAT4> lights(light_count);
+	for (DirectX::XMFLOAT4& light : lights)
+	{
+		light = DirectX::XMFLOAT4(position(random), position(random), position(random), radius(random));
+	}
+
+	JobSystem job_system;
+	LightClusters serial(nullptr);
+	LightClusters clusters(&job_system);
+	serial.SetProjection(fov_y, camera.GetAspectRatio(), Camera::NEAR_PLANE, Camera::FAR_PLANE);
+	clusters.SetProjection(fov_y, camera.GetAspectRatio(), Camera::NEAR_PLANE, Camera::FAR_PLANE);
+
+	double serial_microseconds = 0.0;
+	double parallel_microseconds = 0.0;
+	for (int iteration = 0; iteration < ITERATIONS; ++iteration)
+	{
+		serial.Build(view, lights.data(), lights.size());
+		clusters.Build(view, lights.data(), lights.size());
+		serial_microseconds += serial.GetStats().build_microseconds;
+		parallel_microseconds += clusters.GetStats().build_microseconds;
+	}
+
+	bool same = serial.GetLightIndices() == clusters.GetLightIndices();
+
+	// View space spheres for the brute force test
+	std::vector<DirectX::BoundingSphere> spheres(light_count);
+	for (uint32_t i = 0; i < light_count; ++i)
+	{
+		DirectX::XMStoreFloat3(&spheres[i].Center, DirectX::XMVector3Transform(DirectX::XMLoadFloat4(&lights[i]), view));
+		spheres[i].Radius = lights[i].w;
+	}
+
+	// Points found the way the pixel shader finds its cluster, every light reaching a point has to be in the list of its
+	// cluster and every light in a list has to touch the bounds of the cluster
+	const float tan_half_y = std::tan(fov_y * 0.5f);
+	const float tan_half_x = tan_half_y * camera.GetAspectRatio();
+	const std::vector<LightCluster>& ranges = clusters.GetClusters();
+	const std::vector<uint32_t>& indices = clusters.GetLightIndices();
+
+	std::uniform_real_distribution<float> screen(-0.999f, 0.999f);
+	std::uniform_real_distribution<float> log_depth(std::log(Camera::NEAR_PLANE), std::log(Camera::FAR_PLANE));
+	int missing = 0;
+	int outside = 0;
+	for (int sample = 0; sample < SAMPLE_COUNT; ++sample)
+	{
+		float ndc_x = screen(random);
+		float ndc_y = screen(random);
+		float depth = std::exp(log_depth(random));
+		DirectX::XMVECTOR point = DirectX::XMVectorSet(ndc_x * depth * tan_half_x, ndc_y * depth * tan_half_y, depth, 0.0f);
+
+		uint32_t column = static_cast<uint32_t>((ndc_x + 1.0f) * 0.5f * LightClusters::GRID_X);
+		uint32_t row = static_cast<uint32_t>((1.0f - ndc_y) * 0.5f * LightClusters::GRID_Y);
+		int slice = static_cast<int>(std::floor(std::log(depth) * clusters.GetDepthScale() + clusters.GetDepthBias()));
+		slice = std::clamp(slice, 0, static_cast<int>(LightClusters::GRID_Z) - 1);
+		uint32_t cluster = (slice * LightClusters::GRID_Y + row) * LightClusters::GRID_X + column;
+
+		const LightCluster& range = ranges[cluster];
+		auto first = indices.begin() + range.offset;
+		auto last = first + range.count;
+
+		for (uint32_t i = 0; i < light_count; ++i)
+		{
+			float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(point, DirectX::XMLoadFloat3(&spheres[i].Center))));
+			if (distance < spheres[i].Radius * 0.999f && !std::binary_search(first, last, i))
+			{
+				++missing;
+			}
+		}
+
+		DirectX::BoundingBox bounds = clusters.GetClusterBounds(cluster);
+		for (auto it = first; it != last; ++it)
+		{
+			DirectX::BoundingSphere sphere = spheres[*it];
+			sphere.Radius = sphere.Radius * 1.001f + 0.001f;
+			if (!bounds.Intersects(sphere))
+			{
+				++outside;
+			}
+		}
+	}
+
+	const LightClusterStats& stats = clusters.GetStats();
+	output << "# lights " << light_count << ", visible " << stats.visible_lights << ", indices " << stats.index_count << ", max per cluster " << stats.max_cluster_lights << ", threads " << job_system.GetThreadCount() << '\n';
+	output << "# build one thread " << serial_microseconds / ITERATIONS << " us, job system " << parallel_microseconds / ITERATIONS << " us\n";
+	output << "# samples " << SAMPLE_COUNT << ", missing lights " << missing << ", lights outside their cluster " << outside << '\n';
+
+	if (!same || missing > 0 || outside > 0)
+	{
+		output << "# light lists do not match\n";
+		return 1;
+	}
+
+	return 0;
+}
+
+int Rove::RunObjectLightTest(std::ostream& output)
+{
+	constexpr uint32_t OBJECT_COUNT = 256;
+	constexpr uint32_t LIGHT_COUNT = 64;
+
+	// Lights on the positive x half of the scene, the objects on the other half past every light have none in range
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-40.0f, 40.0f);
+	std::uniform_real_distribution<float> radius(2.0f, 10.0f);
+	std::vector<DirectX::XMFLOAT4> lights(LIGHT_COUNT);
+	for (DirectX::XMFLOAT4& light : lights)
+	{
+		light = DirectX::XMFLOAT4(std::abs(position(random)), position(random), position(random), radius(random));
+	}
+
+	// The first object sits on a light so at least one draw is lit
+	std::vector<DirectX::BoundingBox> boxes(OBJECT_COUNT);
+	for (DirectX::BoundingBox& box : boxes)
+	{
+		box = DirectX::BoundingBox(DirectX::XMFLOAT3(position(random) * 2.0f, position(random), position(random)), DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f));
+	}
+
+	boxes[0].Center = DirectX::XMFLOAT3(lights[0].x, lights[0].y, lights[0].z);
+
+	ObjectLights object_lights;
+	object_lights.Begin(lights.data(), lights.size());
+
+	std::vector<ObjectLightList> light_lists(OBJECT_COUNT);
+	for (uint32_t i = 0; i < OBJECT_COUNT; ++i)
+	{
+		object_lights.Assign(boxes[i], &light_lists[i]);
+	}
+
+	// World constants laid out as they are in the ring
+	std::vector<WorldBuffer> world_buffers(OBJECT_COUNT, { DirectX::XMMatrixIdentity(), DirectX::XMMatrixIdentity() });
+	std::vector<uint8_t> constants(static_cast<size_t>(OBJECT_COUNT) * DxShader::WORLD_CONSTANT_BYTES);
+	DxShader::WriteWorldConstants(constants.data(), world_buffers.data(), light_lists.data(), OBJECT_COUNT);
+
+	// Each draw binds its slice to both stages as DxShader::BindWorldConstants does, the binding of the pixel shader
+	// must not be dropped as a repeat of the one of the vertex shader
+	StateTracker tracker;
+	int dropped = 0;
+	int wrong = 0;
+	int lit = 0;
+	int unlit = 0;
+	for (uint32_t i = 0; i < OBJECT_COUNT; ++i)
+	{
+		uint32_t first_constant = i * DxShader::WORLD_CONSTANTS;
+		tracker.SetConstantBuffer(ShaderStage::Vertex, 1, constants.data(), first_constant, DxShader::WORLD_CONSTANTS);
+		if (!tracker.SetConstantBuffer(ShaderStage::Pixel, 1, constants.data(), first_constant, DxShader::WORLD_CONSTANTS))
+		{
+			++dropped;
+		}
+
+		// Light count where the pixel shader reads cObjectLightCount in the slice
+		uint32_t light_count = 0;
+		std::memcpy(&light_count, constants.data() + first_constant * 16 + sizeof(WorldBuffer), sizeof(light_count));
+
+		uint32_t in_range = 0;
+		for (const DirectX::XMFLOAT4& light : lights)
+		{
+			in_range += boxes[i].Intersects(DirectX::BoundingSphere(DirectX::XMFLOAT3(light.x, light.y, light.z), light.w)) ? 1 : 0;
+		}
+
+		wrong += light_count != std::min(in_range, ObjectLightList::MAX_LIGHTS) ? 1 : 0;
+		lit += light_count > 0 ? 1 : 0;
+		unlit += in_range == 0 ? 1 : 0;
+	}
+
+	uint32_t first_count = 0;
+	std::memcpy(&first_count, constants.data() + sizeof(WorldBuffer), sizeof(first_count));
+
+	output << "# objects " << OBJECT_COUNT << ", lights " << LIGHT_COUNT << ", lit " << lit << ", out of range of every light " << unlit << '\n';
+	output << "# pixel shader bindings dropped " << dropped << ", wrong light counts " << wrong << '\n';
+
+	if (dropped > 0 || wrong > 0 || first_count == 0 || unlit == 0)
+	{
+		output << "# light counts seen by the pixel shader do not match\n";
+		return 1;
+	}
+
+	return 0;
+}
+
+int Rove::RunShaderCacheBenchmark(uint32_t draw_count, std::ostream& output)
+{
+	constexpr int FRAMES = 100;
+	constexpr uint32_t MATERIAL_COUNT = 256;
+
+	// Materials with and without each texture
+	std::mt19937 random(1234);
+	std::vector<Material> materials(MATERIAL_COUNT);
+	for (Material& material : materials)
+	{
+		material.diffuse_texture = random() % 4 != 0;
+		material.normal_texture = random() % 2 != 0;
+	}
+
+	// Draws with the light list sizes the per object lights give, one in eight instanced
+	struct Draw
+	{
+		uint32_t material;
+		int light_count;
+		bool instanced;
+	};
+
+	std::vector<Draw> draws(draw_count);
+	for (Draw& draw : draws)
+	{
+		draw.material = random() % MATERIAL_COUNT;
+		draw.light_count = static_cast<int>(random() % (ObjectLightList::MAX_LIGHTS + 1));
+		draw.instanced = random() % 8 == 0;
+	}
+
+	// The fake compiler writes the name of the variant as its bytecode
+	int compiles = 0;
+	auto compile = [&compiles](ShaderStage stage, ShaderKey key, std::vector<uint8_t>& bytecode, std::string&)
+	{
+		std::string name = ShaderPermutation::GetName(stage, key);
+		bytecode.assign(name.begin(), name.end());
+		++compiles;
+		return true;
+	};
+
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "RoveShaderCacheBenchmark";
+	std::filesystem::remove_all(directory);
+
+	// Every frame selects the variants again, half the frames with the light clusters
+	ShaderVariantCache cache(directory, 1, compile);
+	std::vector<uint16_t> variants(draw_count);
+	uint64_t checksum = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < FRAMES; ++frame)
+	{
+		bool clustered = frame % 2 == 1;
+		for (uint32_t i = 0; i < draw_count; ++i)
+		{
+			const Material& material = materials[draws[i].material];
+			int light_count = clustered ? -1 : draws[i].light_count;
+			variants[i] = cache.GetVariant(ShaderPermutation::MakeKey(material.normal_texture, material.diffuse_texture, light_count, draws[i].instanced, false));
+		}
+
+		checksum += variants[frame % draw_count];
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	double select_nanoseconds = std::chrono::duration<double, std::nano>(end - start).count() / (static_cast<double>(FRAMES) * draw_count);
+
+	// Loads every stage of every variant through a cache over a directory
+	auto load_all = [](ShaderVariantCache& loader, const ShaderVariantCache& source, std::vector<std::vector<uint8_t>>& bytecode)
+	{
+		bytecode.clear();
+		for (size_t i = 0; i < source.GetVariantCount(); ++i)
+		{
+			ShaderKey key = source.GetKey(static_cast<uint16_t>(i));
+			for (ShaderStage stage : { ShaderStage::Vertex, ShaderStage::Pixel })
+			{
+				const std::vector<uint8_t>* data = loader.GetBytecode(stage, key);
+				bytecode.push_back(data != nullptr ? *data : std::vector<uint8_t>());
+			}
+		}
+	};
+
+	std::vector<std::vector<uint8_t>> compiled;
+	load_all(cache, cache, compiled);
+	int first_compiles = compiles;
+
+	// A new cache over the same directory reads everything back from the disk
+	compiles = 0;
+	ShaderVariantCache reload(directory, 1, compile);
+	std::vector<std::vector<uint8_t>> reloaded;
+	load_all(reload, cache, reloaded);
+	int reload_compiles = compiles;
+
+	// Changed sources ignore the files of the old sources
+	compiles = 0;
+	ShaderVariantCache changed(directory, 2, compile);
+	std::vector<std::vector<uint8_t>> recompiled;
+	load_all(changed, cache, recompiled);
+	int changed_compiles = compiles;
+
+	std::filesystem::remove_all(directory);
+
+	const ShaderCacheStats& stats = cache.GetStats();
+	const ShaderCacheStats& reload_stats = reload.GetStats();
+	double hit_rate = stats.lookups > 0 ? 100.0 * stats.hits / stats.lookups : 0.0;
+	output << "# draws " << draw_count << ", frames " << FRAMES << ", variants " << cache.GetVariantCount() << ", checksum " << checksum << '\n';
+	output << "# select " << select_nanoseconds << " ns per draw, lookup hit rate " << hit_rate << "%\n";
+	output << "# first load " << first_compiles << " compiles, " << stats.memory_hits << " shared in memory\n";
+	output << "# reload " << reload_stats.disk_hits << " from disk, " << reload_compiles << " compiles\n";
+	output << "# changed sources " << changed_compiles << " compiles\n";
+
+	if (reloaded != compiled || recompiled != compiled || reload_compiles != 0 || changed_compiles != first_compiles)
+	{
+		output << "# variant cache does not match\n";
+		return 1;
+	}
+
+	return 0;
+}
+
+int Rove::RunProfilerBenchmark(uint32_t zone_count, std::ostream& output)
+{
+#if ROVE_PROFILER
+	Profiler& profiler = Profiler::Get();
+	profiler.SetThreadName("Main");
+
+	// Zones are opened in nested pairs like real code, the empty loop is timed first to take its cost out
+	volatile uint32_t sink = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < zone_count; i += 2)
+	{
+		sink = sink + i;
+	}
+
+	auto empty_end = std::chrono::high_resolution_clock::now();
+	profiler.MarkFrame();
+	for (uint32_t i = 0; i < zone_count; i += 2)
+	{
+		ROVE_PROFILE_ZONE("Outer");
+		{
+			ROVE_PROFILE_ZONE("Inner");
+			sink = sink + i;
+		}
+	}
+
+	auto zone_end = std::chrono::high_resolution_clock::now();
+	profiler.MarkFrame();
+
+	double empty_nanoseconds = std::chrono::duration<double, std::nano>(empty_end - start).count();
+	double zone_nanoseconds = (std::chrono::duration<double, std::nano>(zone_end - empty_end).count() - empty_nanoseconds) / zone_count;
+
+	// The newest zones of the frame must read back in order and nested
+	std::vector<ProfileFrame> frames;
+	std::vector<ProfileZone> zones;
+	profiler.GetFrames(1, frames);
+	profiler.GetZones(frames.back().start, zones);
+
+	size_t expected = std::min<size_t>(zone_count, ProfileRing::SIZE);
+	int bad_zones = 0;
+	for (size_t i = 0; i < zones.size(); ++i)
+	{
+		const ProfileZone& zone = zones[i];
+		bool inner = std::string_view(zone.name) == "Inner";
+		bad_zones += zone.end < zone.start || zone.depth != (inner ? 1u : 0u) ? 1 : 0;
+		bad_zones += i > 0 && zone.end < zones[i - 1].end ? 1 : 0;
+	}
+
+	// Every thread of the job system records into its own ring at once
+	JobSystem job_system;
+	uint32_t per_job = 1024;
+	uint32_t job_count = std::max<uint32_t>(zone_count / per_job, 1);
+	auto parallel_start = std::chrono::high_resolution_clock::now();
+	job_system.ParallelFor(job_count, [&](uint32_t)
+	{
+		for (uint32_t i = 0; i < per_job; ++i)
+		{
+			ROVE_PROFILE_ZONE("Job zone");
+		}
+	});
+
+	auto parallel_end = std::chrono::high_resolution_clock::now();
+	double parallel_nanoseconds = std::chrono::duration<double, std::nano>(parallel_end - parallel_start).count() * job_system.GetThreadCount() / (static_cast<double>(job_count) * per_job);
+
+	output << "# zones " << zone_count << ", " << zone_nanoseconds << " ns per zone on one thread\n";
+	output << "# job system " << job_system.GetThreadCount() << " threads, " << parallel_nanoseconds << " ns per zone per thread\n";
+	output << "# read back " << zones.size() << " of " << expected << " zones, " << bad_zones << " out of order, " << profiler.GetThreadCount() << " threads registered\n";
+
+	if (zones.size() != expected || bad_zones > 0)
+	{
+		output << "# profile zones do not match\n";
+		return 1;
+	}
+
+	return 0;
+#else
+	output << "# profile zones are compiled out\n";
+	return 0;
+#endif
+}
+
+int Rove::RunFrameTimeTest(uint32_t frame_count, std::ostream& output)
+{
+	constexpr uint32_t CHECK_INTERVAL = 997;
+	constexpr double BUDGET = 1000.0 / 60.0;
+
+	// Mostly around 8 ms with one frame in a hundred spiking
+	std::mt19937 random(1234);
+	std::lognormal_distribution<double> frame_time(std::log(8.0), 0.2);
+	std::uniform_real_distribution<double> spike(20.0, 120.0);
+	std::vector<double> frames(frame_count);
+	for (double& frame : frames)
+	{
+		frame = random() % 100 == 0 ? spike(random) : frame_time(random);
+	}
+
+	FrameTimeStats stats;
+	stats.SetBudget(BUDGET);
+
+	std::vector<float> window;
+	int failures = 0;
+	double add_nanoseconds = 0.0;
+	double summary_nanoseconds = 0.0;
+	int summaries = 0;
+	for (uint32_t i = 0; i < frame_count; ++i)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		stats.Add(frames[i]);
+		auto add_end = std::chrono::high_resolution_clock::now();
+		FrameTimeSummary summary = stats.GetSummary();
+		auto summary_end = std::chrono::high_resolution_clock::now();
+
+		add_nanoseconds += std::chrono::duration<double, std::nano>(add_end - start).count();
+		summary_nanoseconds += std::chrono::duration<double, std::nano>(summary_end - add_end).count();
+		++summaries;
+
+		if (i % CHECK_INTERVAL != 0 && i != frame_count - 1)
+		{
+			continue;
+		}
+
+		// Nearest rank percentiles of the window, the histogram bins are 1% wide
+		size_t first = i + 1 > FrameTimeStats::CAPACITY ? i + 1 - FrameTimeStats::CAPACITY : 0;
+		window.clear();
+		int stutters = 0;
+		for (size_t j = first; j <= i; ++j)
+		{
+			window.push_back(static_cast<float>(frames[j]));
+			stutters += window.back() > BUDGET ? 1 : 0;
+		}
+
+		std::sort(window.begin(), window.end());
+		auto exact = [&window](double fraction)
+		{
+			size_t rank = std::max<size_t>(static_cast<size_t>(std::ceil(fraction * window.size())), 1);
+			return static_cast<double>(window[rank - 1]);
+		};
+
+		auto close = [](double value, double expected) { return std::abs(value - expected) <= expected * 0.01 + 1e-6; };
+		if (!close(summary.p50, exact(0.50)) || !close(summary.p95, exact(0.95)) || !close(summary.p99, exact(0.99)) ||
+			summary.max != window.back() || summary.stutters != stutters || summary.count != window.size())
+		{
+			output << "# frame " << i << ": p50 " << summary.p50 << " / " << exact(0.50) << ", p95 " << summary.p95 << " / " << exact(0.95)
+				<< ", p99 " << summary.p99 << " / " << exact(0.99) << ", max " << summary.max << " / " << window.back()
+				<< ", stutters " << summary.stutters << " / " << stutters << '\n';
+			++failures;
+		}
+	}
+
+	FrameTimeSummary summary = stats.GetSummary();
+	output << "# frames " << frame_count << ", window " << summary.count << ", stutters " << summary.stutters << " in the window, " << summary.total_stutters << " in total\n";
+	output << "# p50 " << summary.p50 << " ms, p95 " << summary.p95 << " ms, p99 " << summary.p99 << " ms, max " << summary.max << " ms\n";
+	output << "# add " << add_nanoseconds / frame_count << " ns, summary " << summary_nanoseconds / summaries << " ns\n";
+
+	if (failures > 0)
+	{
+		output << "# " << failures << " checks do not match\n";
+		return 1;
+	}
+
+	return 0;
+}
+
+int Rove::RunTraceCaptureBenchmark(uint32_t frame_count, std::ostream& output)
+{
+#if ROVE_PROFILER
+	constexpr int ROUNDS = 4;
+	constexpr uint32_t MAIN_ZONES = 200;
+	constexpr uint32_t JOBS = 64;
+	constexpr uint32_t JOB_ZONES = 10;
+	constexpr uint32_t WORK = 2000;
+
+	Profiler& profiler = Profiler::Get();
+	profiler.SetThreadName("Main");
+	JobSystem job_system;
+
+	// A frame of short zones doing a little arithmetic each, as the renderer records
+	volatile double sink = 0.0;
+	auto work = [&sink]()
+	{
+		double value = 1.0;
+		for (uint32_t i = 0; i < WORK; ++i)
+		{
+			value = value * 1.0000001 + 0.5;
+		}
+
+		sink = sink + value;
+	};
+
+	auto run_frame = [&]()
+	{
+		for (uint32_t i = 0; i < MAIN_ZONES; ++i)
+		{
+			ROVE_PROFILE_ZONE("Main zone");
+			work();
+		}
+
+		job_system.ParallelFor(JOBS, [&](uint32_t)
+		{
+			for (uint32_t i = 0; i < JOB_ZONES; ++i)
+			{
+				ROVE_PROFILE_ZONE("Job zone");
+				work();
+			}
+		});
+	};
+
+	// Rounds alternate so both see the same machine state
+	FrameTimeStats base_times;
+	FrameTimeStats capture_times;
+	TraceCapture capture;
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "rove_trace_benchmark.json";
+	for (int round = 0; round < ROUNDS * 2; ++round)
+	{
+		bool capturing = round % 2 == 1;
+		if (capturing)
+		{
+			capture.Start(frame_count, path);
+		}
+
+		FrameTimeStats& times = capturing ? capture_times : base_times;
+		for (uint32_t frame = 0; frame < frame_count; ++frame)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			profiler.MarkFrame();
+			capture.EndFrame();
+			ROVE_PROFILE_COUNTER("Frame", frame);
+			run_frame();
+			auto end = std::chrono::high_resolution_clock::now();
+			times.Add(std::chrono::duration<double, std::milli>(end - start).count());
+		}
+
+		// The last frame ends at the next mark
+		profiler.MarkFrame();
+		capture.EndFrame();
+		capture.Wait();
+	}
+
+	FrameTimeSummary base = base_times.GetSummary();
+	FrameTimeSummary captured = capture_times.GetSummary();
+	TraceCaptureStats stats = capture.GetStats();
+	double overhead = (captured.p50 / base.p50 - 1.0) * 100.0;
+
+	output << "# frames " << frame_count << " x " << ROUNDS << ", " << MAIN_ZONES + JOBS * JOB_ZONES << " zones a frame on " << job_system.GetThreadCount() << " threads\n";
+	output << "# p50 " << base.p50 << " ms without capture, " << captured.p50 << " ms with capture, " << overhead << "% overhead\n";
+	output << "# p99 " << base.p99 << " ms without capture, " << captured.p99 << " ms with capture\n";
+	output << "# last capture " << stats.frames << " frames, " << stats.events << " events, " << stats.bytes << " bytes\n";
+
+	// Every event is on a line of its own, the process name comes first and the array is closed
+	std::ifstream file(path, std::fstream::in | std::fstream::binary);
+	std::string line;
+	size_t events = 0;
+	uint32_t frames = 0;
+	bool closed = false;
+	while (std::getline(file, line))
+	{
+		events += line.find("\"ph\":") != std::string::npos ? 1 : 0;
+		frames += line.find("\"cat\":\"frame\"") != std::string::npos ? 1 : 0;
+		closed = line == "]}";
+	}
+
+	file.close();
+	std::filesystem::remove(path);
+
+	if (stats.frames != frame_count || frames != frame_count || events != stats.events + 1 || !closed)
+	{
+		output << "# trace file holds " << frames << " frames and " << events << " events\n";
+		return 1;
+	}
+
+	return 0;
+#else
+	output << "# profile zones are compiled out\n";
+	return 0;
+#endif
+}
+
+int Rove::RunHitchTest(std::ostream& output)
+{
+#if ROVE_PROFILER
+	constexpr double FRAME_MILLISECONDS = 2.0;
+	constexpr double HITCH_MILLISECONDS = 60.0;
+	constexpr uint32_t FRAME_COUNT = 700;
+	const std::vector<uint32_t> hitch_frames = { 150, 250, 600 };
+
+	Profiler& profiler = Profiler::Get();
+	profiler.SetThreadName("Main");
+
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "rove_hitch_test";
+	std::filesystem::remove_all(directory);
+
+	HitchDetector detector;
+	detector.ThresholdMilliseconds = 20.0f;
+	detector.SecondsBefore = 0.2f;
+	detector.SecondsAfter = 0.1f;
+	detector.MinimumInterval = 0.5f;
+	detector.Directory = directory;
+
+	// Frames spin for their length so the times do not depend on the scheduler waking the thread
+	double watch_nanoseconds = 0.0;
+	profiler.MarkFrame();
+	for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame)
+	{
+		bool hitch = std::find(hitch_frames.begin(), hitch_frames.end(), frame) != hitch_frames.end();
+		uint64_t length = static_cast<uint64_t>((hitch ? HITCH_MILLISECONDS : FRAME_MILLISECONDS) * 1000000.0);
+		uint64_t start = Profiler::Now();
+		{
+			ROVE_PROFILE_ZONE("Frame work");
+			while (Profiler::Now() - start < length)
+			{
+			}
+		}
+
+		ROVE_PROFILE_COUNTER("Frame", frame);
+		profiler.MarkFrame();
+
+		auto watch_start = std::chrono::high_resolution_clock::now();
+		detector.EndFrame();
+		auto watch_end = std::chrono::high_resolution_clock::now();
+		watch_nanoseconds += std::chrono::duration<double, std::nano>(watch_end - watch_start).count();
+	}
+
+	detector.Clear();
+	while (detector.IsReporting())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	const HitchStats& stats = detector.GetStats();
+	output << "# " << stats.hitches << " hitches, " << stats.saved_reports << " reports saved, " << stats.skipped_hitches << " skipped, " << stats.failed_reports << " failed\n";
+	output << "# watching " << watch_nanoseconds / FRAME_COUNT / 1000.0 << " us a frame\n";
+
+	// Each report holds one long frame with the frames of the seconds before and after it
+	int failures = stats.hitches != 3 || stats.saved_reports != 2 || stats.skipped_hitches != 1 ? 1 : 0;
+	for (const auto& entry : std::filesystem::directory_iterator(directory))
+	{
+		std::ifstream file(entry.path(), std::fstream::in | std::fstream::binary);
+		std::string line;
+		int before = 0;
+		int after = 0;
+		int hitches = 0;
+		bool closed = false;
+		while (std::getline(file, line))
+		{
+			closed = line == "]}";
+			size_t duration = line.find("\"dur\":");
+			if (line.find("\"cat\":\"frame\"") == std::string::npos || duration == std::string::npos)
+			{
+				continue;
+			}
+
+			bool hitch = std::stod(line.substr(duration + 6)) > detector.ThresholdMilliseconds * 1000.0;
+			hitches += hitch ? 1 : 0;
+			before += !hitch && hitches == 0 ? 1 : 0;
+			after += !hitch && hitches > 0 ? 1 : 0;
+		}
+
+		output << "# " << entry.path().filename().string() << ": " << before << " frames before, " << hitches << " hitch, " << after << " after\n";
+
+		// Allow for the frame times stretching on a busy machine
+		int expected_before = static_cast<int>(detector.SecondsBefore * 1000.0 / FRAME_MILLISECONDS / 2.0);
+		int expected_after = static_cast<int>(detector.SecondsAfter * 1000.0 / FRAME_MILLISECONDS / 2.0);
+		failures += hitches != 1 || before < expected_before || after < expected_after || !closed ? 1 : 0;
+	}
+
+	std::filesystem::remove_all(directory);
+	if (failures > 0)
+	{
+		output << "# hitch reports do not match\n";
+		return 1;
+	}
+
+	return 0;
+#else
+	output << "# profile zones are compiled out\n";
+	return 0;
+#endif
+}
+
+int Rove::RunMemoryTest(std::ostream& output)
+{
+#if ROVE_MEMORY_TRACKING
+	constexpr uint32_t THREAD_COUNT = 4;
+	constexpr uint32_t ALLOCATIONS = 100000;
+	constexpr size_t ALLOCATION_BYTES = 64;
+	constexpr size_t VECTOR_VALUES = 1000;
+	constexpr size_t ARENA_BYTES = 1 << 20;
+	constexpr uint32_t ITERATIONS = 1000000;
+
+	MemoryTracker& tracker = MemoryTracker::Get();
+	tracker.Update();
+	MemoryTagStats before = tracker.GetStats(MemoryTag::Loader);
+
+	// Each thread frees half of its allocations and hands the rest to the main thread
+	std::vector<std::vector<void*>> handed(THREAD_COUNT);
+	std::vector<std::thread> threads;
+	for (uint32_t i = 0; i < THREAD_COUNT; ++i)
+	{
+		threads.emplace_back([&handed, i]()
+		{
+			TaggedAllocator& allocator = TaggedAllocator::Get(MemoryTag::Loader);
+			std::vector<void*> blocks(ALLOCATIONS);
+			for (void*& block : blocks)
+			{
+				block = allocator.Allocate(ALLOCATION_BYTES);
+			}
+
+			for (uint32_t j = 0; j < ALLOCATIONS / 2; ++j)
+			{
+				allocator.Free(blocks[j]);
+			}
+
+			handed[i].assign(blocks.begin() + ALLOCATIONS / 2, blocks.end());
+
+			// Containers count through the same allocator
+			TaggedVector<int, MemoryTag::Loader> values(VECTOR_VALUES);
+		});
+	}
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	tracker.Update();
+	MemoryTagStats held = tracker.GetStats(MemoryTag::Loader);
+
+	for (std::vector<void*>& blocks : handed)
+	{
+		for (void* block : blocks)
+		{
+			TaggedAllocator::Get(MemoryTag::Loader).Free(block);
+		}
+	}
+
+	tracker.Update();
+	MemoryTagStats after = tracker.GetStats(MemoryTag::Loader);
+
+	int64_t held_allocations = THREAD_COUNT * (ALLOCATIONS / 2);
+	int64_t held_bytes = held_allocations * ALLOCATION_BYTES;
+	output << "# " << THREAD_COUNT << " threads held " << held.bytes - before.bytes << " / " << held_bytes << " bytes in " << held.allocations - before.allocations << " / " << held_allocations << " allocations\n";
+	output << "# peak " << held.peak_bytes << " bytes, " << after.bytes - before.bytes << " bytes and " << after.allocations - before.allocations << " allocations left\n";
+
+	int failures = 0;
+	failures += held.bytes - before.bytes != held_bytes || held.allocations - before.allocations != held_allocations ? 1 : 0;
+	failures += held.total_allocations - before.total_allocations != THREAD_COUNT * (ALLOCATIONS + 1) ? 1 : 0;
+	failures += held.peak_bytes < static_cast<int64_t>(ALLOCATIONS * ALLOCATION_BYTES) ? 1 : 0;
+	failures += after.bytes != before.bytes || after.allocations != before.allocations ? 1 : 0;
+
+	// Frame arena blocks are counted under the frame tag until the arena is destroyed
+	int64_t frame_before = tracker.GetStats(MemoryTag::Frame).bytes;
+	{
+		FrameArena arena(ARENA_BYTES);
+		tracker.Update();
+		failures += tracker.GetStats(MemoryTag::Frame).bytes - frame_before != static_cast<int64_t>(ARENA_BYTES) ? 1 : 0;
+	}
+
+	tracker.Update();
+	failures += tracker.GetStats(MemoryTag::Frame).bytes != frame_before ? 1 : 0;
+
+	// Cost of counting, the pointers are kept in a volatile so the pairs are not removed
+	void* volatile sink = nullptr;
+	auto tagged_start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < ITERATIONS; ++i)
+	{
+		sink = TaggedAllocator::Get(MemoryTag::Loader).Allocate(ALLOCATION_BYTES);
+		TaggedAllocator::Get(MemoryTag::Loader).Free(sink);
+	}
+
+	auto heap_start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < ITERATIONS; ++i)
+	{
+		sink = _aligned_malloc(ALLOCATION_BYTES + 16, 16);
+		_aligned_free(sink);
+	}
+
+	auto heap_end = std::chrono::high_resolution_clock::now();
+	double tagged_nanoseconds = std::chrono::duration<double, std::nano>(heap_start - tagged_start).count() / ITERATIONS;
+	double heap_nanoseconds = std::chrono::duration<double, std::nano>(heap_end - heap_start).count() / ITERATIONS;
+	output << "# allocate and free " << tagged_nanoseconds << " ns counted, " << heap_nanoseconds << " ns from the heap\n";
+
+	if (failures > 0)
+	{
+		output << "# memory counters do not match\n";
+		return 1;
+	}
+
+	return 0;
+#else
+	output << "# memory tracking is compiled out\n";
+	return 0;
+#endif
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Pch.h"
+
+namespace Rove
+{
+	// Loads a scene without a window or device, replays a recorded camera path through the culling and writes the
+	// results of every frame as CSV followed by a summary. Returns the process exit code.
+	int RunOcclusionTest(const std::filesystem::path& scene_path, const std::filesystem::path& camera_path, std::ostream& output);
+
+	// Records a number of draws with random keys into command buffers on one thread and on the job system, merges them
+	// and replays them on the null backend, then writes the average time of each step. Returns the process exit code.
+	int RunCommandBenchmark(uint32_t draw_count, std::ostream& output);
+
+	// Assigns a number of random point lights to the clusters of a camera on one thread and on the job system, checks
+	// the light lists of random points against a brute force test and writes the average build times. Returns the
+	// process exit code.
+	int RunLightClusterTest(uint32_t light_count, std::ostream& output);
+
+	// Assigns random point lights to random objects, writes the light lists into world constants as the scene does and
+	// binds the slice of each draw to the vertex and pixel shaders through a state tracker. Checks the pixel shader
+	// binding is issued and the light count in its slice matches a brute force test. Returns the process exit code.
+	int RunObjectLightTest(std::ostream& output);
+
+	// Selects the shader variant of a number of random draws every frame the way the scene does and writes the time per
+	// draw and the hit rate of the variant lookups, then loads the bytecode of every variant through a fake compiler,
+	// again from the disk cache it wrote and once more after the sources changed. Returns the process exit code.
+	int RunShaderCacheBenchmark(uint32_t draw_count, std::ostream& output);
+
+	// Times a number of profile zones on one thread and on every thread of the job system, checks the zones of the last
+	// frame can be read back and writes the cost of a zone. Returns the process exit code.
+	int RunProfilerBenchmark(uint32_t zone_count, std::ostream& output);
+
+	// Adds a number of random frame times with occasional spikes to the frame time statistics and checks the
+	// percentiles, maximum and stutter count of the window against a sorted copy every so often, then writes the cost of
+	// adding a frame and reading the summary. Returns the process exit code.
+	int RunFrameTimeTest(uint32_t frame_count, std::ostream& output);
+
+	// Runs frames of zones on the main thread and the job system with and without a trace capture and writes the median
+	// frame time of each and the capture overhead, then checks the trace file holds every frame and event. Returns the
+	// process exit code.
+	int RunTraceCaptureBenchmark(uint32_t frame_count, std::ostream& output);
+
+	// Runs short frames with a few long ones through the hitch detector, the second hitch falls inside the minimum
+	// interval. Checks a report is saved for the others holding the frames before and after the hitch and writes the
+	// cost of watching a frame. Returns the process exit code.
+	int RunHitchTest(std::ostream& output);
+
+	// Allocates and frees through the tagged allocators on several threads, some memory freed by another thread than
+	// the one that allocated it, and checks the summed counters and peaks. Writes the cost of an allocation counted
+	// against one straight from the heap. Returns the process exit code.
+	int RunMemoryTest(std::ostream& output);
+}
@@ -0,0 +1,142 @@
+#include "Pch.h"
+#include "HitchDetector.h"
+
+namespace
+{
+	constexpr double NANOSECONDS_PER_SECOND = 1000000000.0;
+	constexpr double NANOSECONDS_PER_MILLISECOND = 1000000.0;
+}
+
+Rove::HitchDetector::~HitchDetector()
+{
+	Clear();
+	m_Writer.Wait();
+}
+
+void Rove::HitchDetector::EndFrame()
+{
+	if (!Enabled)
+	{
+		Clear();
+		return;
+	}
+
+	ROVE_PROFILE_ZONE("Hitch detector");
+
+	// Start from now when enabled, not from whatever the rings still hold
+	if (!m_CursorValid)
+	{
+		Profiler::Get().GetCursor(m_Cursor);
+		m_CursorValid = true;
+	}
+
+	std::unique_ptr<TraceBatch> batch = m_Writer.AcquireBatch();
+	batch->Collect(m_Cursor);
+	uint64_t now = batch->time;
+
+	// The window before a hitch is measured back from the start of the frame so the hitch itself does not shorten it
+	uint64_t frame_start = batch->frames.empty() ? now : batch->frames.front().start;
+	double longest = 0.0;
+	for (const ProfileFrame& frame : batch->frames)
+	{
+		longest = std::max(longest, (frame.end - frame.start) / NANOSECONDS_PER_MILLISECOND);
+	}
+
+	m_Window.push_back(std::move(batch));
+
+	// Collecting the frames after a hitch, a later hitch in them is part of the same report
+	if (m_HitchTime != 0)
+	{
+		m_HitchMilliseconds = std::max(m_HitchMilliseconds, longest);
+		if (now - m_HitchTime >= static_cast<uint64_t>(SecondsAfter * NANOSECONDS_PER_SECOND))
+		{
+			SaveReport();
+		}
+
+		return;
+	}
+
+	// Drop the frames older than the window
+	uint64_t window = static_cast<uint64_t>(SecondsBefore * NANOSECONDS_PER_SECOND);
+	while (m_Window.size() > 1 && frame_start > m_Window.front()->time && frame_start - m_Window.front()->time > window)
+	{
+		m_Writer.ReleaseBatch(std::move(m_Window.front()));
+		m_Window.pop_front();
+	}
+
+	if (longest > ThresholdMilliseconds)
+	{
+		++m_Stats.hitches;
+
+		bool limited = m_ReportTime != 0 && now - m_ReportTime < static_cast<uint64_t>(MinimumInterval * NANOSECONDS_PER_SECOND);
+		if (limited || m_Writer.IsWriting())
+		{
+			++m_Stats.skipped_hitches;
+			return;
+		}
+
+		m_HitchTime = now;
+		m_HitchMilliseconds = longest;
+		if (SecondsAfter <= 0.0f)
+		{
+			SaveReport();
+		}
+	}
+}
+
+void Rove::HitchDetector::Clear()
+{
+	for (std::unique_ptr<TraceBatch>& batch : m_Window)
+	{
+		m_Writer.ReleaseBatch(std::move(batch));
+	}
+
+	m_Window.clear();
+	m_CursorValid = false;
+	m_HitchTime = 0;
+}
+
+void Rove::HitchDetector::SaveReport()
+{
+	ROVE_PROFILE_ZONE("Save hitch");
+
+	// Named by the time and the length of the hitch
+	std::time_t time = std::time(nullptr);
+	std::tm local_time = {};
+	localtime_s(&local_time, &time);
+
+	char time_text[32];
+	std::strftime(time_text, sizeof(time_text), "%Y%m%d_%H%M%S", &local_time);
+
+	char file_name[64];
+	std::snprintf(file_name, sizeof(file_name), "hitch_%s_%i_%.0fms.json", time_text, m_Stats.saved_reports + 1, m_HitchMilliseconds);
+
+	try
+	{
+		std::filesystem::create_directories(Directory);
+		const TraceBatch& first = *m_Window.front();
+		m_Writer.Open(Directory / file_name, first.frames.empty() ? first.time : first.frames.front().start);
+	}
+	catch (const std::exception&)
+	{
+		// A report that cannot be written is dropped, the detector keeps watching
+		++m_Stats.failed_reports;
+		Clear();
+		m_ReportTime = Profiler::Now();
+		return;
+	}
+
+	for (std::unique_ptr<TraceBatch>& batch : m_Window)
+	{
+		m_Writer.Write(std::move(batch));
+	}
+
+	m_Writer.Close();
+	m_Window.clear();
+
+	++m_Stats.saved_reports;
+	m_Stats.last_hitch_milliseconds = m_HitchMilliseconds;
+	m_Stats.last_report = Directory / file_name;
+	m_ReportTime = Profiler::Now();
+	m_HitchTime = 0;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Pch.h"
+#include "TraceWriter.h"
+
+namespace Rove
+{
+	// Hitches seen and reports saved since start up
+	struct HitchStats
+	{
+		int hitches = 0;
+		int saved_reports = 0;
+
+		// Hitches inside the interval after a saved report or while a report was still being written
+		int skipped_hitches = 0;
+		int failed_reports = 0;
+
+		// Longest frame of the last report and its file
+		double last_hitch_milliseconds = 0.0;
+		std::filesystem::path last_report;
+	};
+
+	// Keeps the zones, counters and frames of the last few seconds at all times. When a frame takes longer than the
+	// threshold the window is frozen once the frames after it are in and written to a Chrome trace file on the trace
+	// writer thread. Reports are rate limited so repeated hitches do not flood the disk.
+	class HitchDetector
+	{
+	public:
+		HitchDetector() = default;
+		virtual ~HitchDetector();
+
+		// Keep the window and watch for hitches, a disabled detector holds no window
+		bool Enabled = true;
+
+		// Frames longer than this are hitches
+		float ThresholdMilliseconds = 50.0f;
+
+		// Seconds kept before a hitch and collected after it
+		float SecondsBefore = 3.0f;
+		float SecondsAfter = 1.0f;
+
+		// Least seconds from one report to the next
+		float MinimumInterval = 30.0f;
+
+		// Folder the reports are written to, created with the first report
+		std::filesystem::path Directory = "Hitches";
+
+		// Adds what was recorded in the frame that just ended to the window, called from the main loop once a frame
+		// after Profiler::MarkFrame
+		void EndFrame();
+
+		// Frees the window, reports being written are finished
+		void Clear();
+
+		// A report is being collected or written
+		bool IsReporting() const { return m_HitchTime != 0 || m_Writer.IsWriting(); }
+
+		const HitchStats& GetStats() const { return m_Stats; }
+
+	private:
+		TraceWriter m_Writer;
+		ProfileCursor m_Cursor;
+		bool m_CursorValid = false;
+
+		// Batches of the last frames, oldest first
+		std::deque<std::unique_ptr<TraceBatch>> m_Window;
+
+		// End of the hitch frame being reported and when the last report was saved, in nanoseconds of the profiler clock
+		uint64_t m_HitchTime = 0;
+		uint64_t m_ReportTime = 0;
+		double m_HitchMilliseconds = 0.0;
+
+		// Hands the window to the writer
+		void SaveReport();
+
+		HitchStats m_Stats;
+	};
+}
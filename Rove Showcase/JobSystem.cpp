@@ -0,0 +1,112 @@
+#include "Pch.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+Rove::JobSystem::JobSystem(unsigned worker_count)
+{
+	if (worker_count == 0)
+	{
+		unsigned cores = std::thread::hardware_concurrency();
+		worker_count = cores > 1 ? cores - 1 : 0;
+	}
+
+	for (unsigned i = 0; i < worker_count; ++i)
+	{
+		m_Workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+Rove::JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Quit = true;
+	}
+
+	m_WorkReady.notify_all();
+	for (std::thread& worker : m_Workers)
+	{
+		worker.join();
+	}
+}
+
+void Rove::JobSystem::ParallelFor(uint32_t count, const std::function<void(uint32_t index)>& job)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// Not worth waking the workers for a single job
+	if (count == 1 || m_Workers.empty())
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			job(i);
+		}
+
+		return;
+	}
+
+	std::lock_guard<std::mutex> submit_lock(m_SubmitMutex);
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Job = &job;
+		m_JobCount = count;
+		m_NextIndex = 0;
+		m_BusyWorkers = static_cast<unsigned>(m_Workers.size());
+		++m_Generation;
+	}
+
+	m_WorkReady.notify_all();
+	RunJobs();
+
+	// Every worker has to leave the batch before the job goes out of scope
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_WorkDone.wait(lock, [this]() { return m_BusyWorkers == 0; });
+	m_Job = nullptr;
+}
+
+void Rove::JobSystem::WorkerLoop(unsigned index)
+{
+#if ROVE_PROFILER
+	Profiler::Get().SetThreadName("Worker " + std::to_string(index));
+#endif
+
+	uint64_t generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WorkReady.wait(lock, [this, generation]() { return m_Quit || m_Generation != generation; });
+			if (m_Quit)
+			{
+				return;
+			}
+
+			generation = m_Generation;
+		}
+
+		RunJobs();
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (--m_BusyWorkers == 0)
+			{
+				m_WorkDone.notify_one();
+			}
+		}
+	}
+}
+
+void Rove::JobSystem::RunJobs()
+{
+	ROVE_PROFILE_ZONE("Jobs");
+
+	for (uint32_t i = m_NextIndex++; i < m_JobCount; i = m_NextIndex++)
+	{
+		(*m_Job)(i);
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// Only the standard library so code recording on the job system stays free of a graphics API
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Rove
+{
+	// Fixed pool of worker threads that run indexed jobs in parallel with the calling thread
+	class JobSystem
+	{
+	public:
+		// A worker count of 0 creates one worker per core minus the calling thread
+		JobSystem(unsigned worker_count = 0);
+		virtual ~JobSystem();
+
+		// Runs the job once for every index from 0 to count and returns when all have finished. The calling thread takes
+		// jobs as well. Jobs must not call ParallelFor themselves.
+		void ParallelFor(uint32_t count, const std::function<void(uint32_t index)>& job);
+
+		// Number of threads that run jobs, including the calling thread
+		unsigned GetThreadCount() const { return static_cast<unsigned>(m_Workers.size()) + 1; }
+
+	private:
+		std::vector<std::thread> m_Workers;
+
+		// Serialises callers from different threads
+		std::mutex m_SubmitMutex;
+
+		// Wakes the workers for a new batch and signals when they have all left it
+		std::mutex m_Mutex;
+		std::condition_variable m_WorkReady;
+		std::condition_variable m_WorkDone;
+		uint64_t m_Generation = 0;
+		unsigned m_BusyWorkers = 0;
+		bool m_Quit = false;
+
+		// Current batch
+		const std::function<void(uint32_t index)>* m_Job = nullptr;
+		uint32_t m_JobCount = 0;
+		std::atomic<uint32_t> m_NextIndex = 0;
+
+		void WorkerLoop(unsigned index);
+		void RunJobs();
+	};
+}
@@ -0,0 +1,284 @@
+#include "Pch.h"
+#include "LightClusters.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+Rove::LightClusters::LightClusters(JobSystem* job_system) : m_JobSystem(job_system)
+{
+	m_MinX.resize(CLUSTER_COUNT);
+	m_MaxX.resize(CLUSTER_COUNT);
+	m_MinY.resize(CLUSTER_COUNT);
+	m_MaxY.resize(CLUSTER_COUNT);
+	m_Clusters.resize(CLUSTER_COUNT);
+}
+
+void Rove::LightClusters::SetProjection(float fov_y_radians, float aspect_ratio, float near_plane, float far_plane)
+{
+	if (fov_y_radians == m_FovY && aspect_ratio == m_AspectRatio && near_plane == m_NearPlane && far_plane == m_FarPlane)
+	{
+		return;
+	}
+
+	m_FovY = fov_y_radians;
+	m_AspectRatio = aspect_ratio;
+	m_NearPlane = near_plane;
+	m_FarPlane = far_plane;
+
+	m_TanHalfY = std::tan(fov_y_radians * 0.5f);
+	m_TanHalfX = m_TanHalfY * aspect_ratio;
+
+	// Slices grow with depth so each covers a similar share of the screen
+	float log_range = std::log(far_plane / near_plane);
+	m_DepthScale = static_cast<float>(GRID_Z) / log_range;
+	m_DepthBias = -m_DepthScale * std::log(near_plane);
+
+	for (uint32_t z = 0; z < GRID_Z; ++z)
+	{
+		float near_z = near_plane * std::pow(far_plane / near_plane, static_cast<float>(z) / GRID_Z);
+		float far_z = near_plane * std::pow(far_plane / near_plane, static_cast<float>(z + 1) / GRID_Z);
+		m_SliceNear[z] = near_z;
+		m_SliceFar[z] = far_z;
+
+		for (uint32_t y = 0; y < GRID_Y; ++y)
+		{
+			// Rows start at the top of the screen
+			float top = (1.0f - 2.0f * y / GRID_Y) * m_TanHalfY;
+			float bottom = (1.0f - 2.0f * (y + 1) / GRID_Y) * m_TanHalfY;
+
+			for (uint32_t x = 0; x < GRID_X; ++x)
+			{
+				float left = (-1.0f + 2.0f * x / GRID_X) * m_TanHalfX;
+				float right = (-1.0f + 2.0f * (x + 1) / GRID_X) * m_TanHalfX;
+
+				// The tile widens with depth so the bounds take the widest of the near and far side
+				uint32_t cluster = (z * GRID_Y + y) * GRID_X + x;
+				m_MinX[cluster] = std::min(left * near_z, left * far_z);
+				m_MaxX[cluster] = std::max(right * near_z, right * far_z);
+				m_MinY[cluster] = std::min(bottom * near_z, bottom * far_z);
+				m_MaxY[cluster] = std::max(top * near_z, top * far_z);
+			}
+		}
+	}
+}
+
+void Rove::LightClusters::Build(const DirectX::XMMATRIX& view, const DirectX::XMFLOAT4* lights, size_t count)
+{
+	ROVE_PROFILE_ZONE("Light clusters");
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_ViewX.resize(count);
+	m_ViewY.resize(count);
+	m_ViewZ.resize(count);
+	m_Radius.resize(count);
+	m_FirstSlice.resize(count);
+	m_LastSlice.resize(count);
+
+	// Move the lights into view space and find the slices their depth range covers
+	for (size_t i = 0; i < count; ++i)
+	{
+		DirectX::XMFLOAT3 position;
+		DirectX::XMStoreFloat3(&position, DirectX::XMVector3Transform(DirectX::XMLoadFloat4(&lights[i]), view));
+
+		float radius = lights[i].w;
+		m_ViewX[i] = position.x;
+		m_ViewY[i] = position.y;
+		m_ViewZ[i] = position.z;
+		m_Radius[i] = radius;
+
+		// Lights outside the frustum are not given to any slice
+		TileRect rect;
+		if (position.z + radius < m_NearPlane || position.z - radius > m_FarPlane || !GetTileRect(position.x, position.y, position.z, radius, m_NearPlane, m_FarPlane, &rect))
+		{
+			m_FirstSlice[i] = 1;
+			m_LastSlice[i] = 0;
+			continue;
+		}
+
+		m_FirstSlice[i] = GetSlice(std::max(position.z - radius, m_NearPlane));
+		m_LastSlice[i] = GetSlice(std::min(position.z + radius, m_FarPlane));
+	}
+
+	// Each slice gets the lights whose depth range reaches it
+	for (Slice& slice : m_Slices)
+	{
+		slice.lights.clear();
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		for (int slice = m_FirstSlice[i]; slice <= m_LastSlice[i]; ++slice)
+		{
+			m_Slices[slice].lights.push_back(static_cast<uint32_t>(i));
+		}
+	}
+
+	if (m_JobSystem != nullptr)
+	{
+		m_JobSystem->ParallelFor(GRID_Z, [this](uint32_t slice) { BuildSlice(slice); });
+	}
+	else
+	{
+		for (uint32_t slice = 0; slice < GRID_Z; ++slice)
+		{
+			BuildSlice(slice);
+		}
+	}
+
+	// Pack the slices one after another
+	m_LightIndices.clear();
+	int max_cluster_lights = 0;
+	for (uint32_t slice = 0; slice < GRID_Z; ++slice)
+	{
+		const Slice& data = m_Slices[slice];
+		uint32_t offset = static_cast<uint32_t>(m_LightIndices.size());
+		for (uint32_t i = 0; i < GRID_X * GRID_Y; ++i)
+		{
+			m_Clusters[slice * GRID_X * GRID_Y + i] = { offset, data.counts[i] };
+			offset += data.counts[i];
+			max_cluster_lights = std::max(max_cluster_lights, static_cast<int>(data.counts[i]));
+		}
+
+		m_LightIndices.insert(m_LightIndices.end(), data.indices.begin(), data.indices.end());
+	}
+
+	int visible_lights = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		visible_lights += m_FirstSlice[i] <= m_LastSlice[i] ? 1 : 0;
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	m_Stats.light_count = static_cast<int>(count);
+	m_Stats.visible_lights = visible_lights;
+	m_Stats.index_count = m_LightIndices.size();
+	m_Stats.max_cluster_lights = max_cluster_lights;
+	m_Stats.build_microseconds = std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+DirectX::BoundingBox Rove::LightClusters::GetClusterBounds(uint32_t cluster) const
+{
+	uint32_t slice = cluster / (GRID_X * GRID_Y);
+	DirectX::XMFLOAT3 minimum(m_MinX[cluster], m_MinY[cluster], m_SliceNear[slice]);
+	DirectX::XMFLOAT3 maximum(m_MaxX[cluster], m_MaxY[cluster], m_SliceFar[slice]);
+
+	DirectX::BoundingBox bounds;
+	bounds.Center = DirectX::XMFLOAT3((minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, (minimum.z + maximum.z) * 0.5f);
+	bounds.Extents = DirectX::XMFLOAT3((maximum.x - minimum.x) * 0.5f, (maximum.y - minimum.y) * 0.5f, (maximum.z - minimum.z) * 0.5f);
+	return bounds;
+}
+
+int Rove::LightClusters::GetSlice(float depth) const
+{
+	int slice = static_cast<int>(std::floor(std::log(depth) * m_DepthScale + m_DepthBias));
+	return std::clamp(slice, 0, static_cast<int>(GRID_Z) - 1);
+}
+
+bool Rove::LightClusters::GetTileRect(float cx, float cy, float cz, float radius, float near_z, float far_z, TileRect* rect) const
+{
+	// Screen rectangle of the sphere's box within a depth range, each side divided by the nearest or furthest depth
+	// whichever makes it widest
+	float z_min = std::max(cz - radius, near_z);
+	float z_max = std::min(cz + radius, far_z);
+	float x_lo = cx - radius;
+	float x_hi = cx + radius;
+	float y_lo = cy - radius;
+	float y_hi = cy + radius;
+
+	float min_x = (x_lo >= 0.0f ? x_lo / z_max : x_lo / z_min) / m_TanHalfX;
+	float max_x = (x_hi >= 0.0f ? x_hi / z_min : x_hi / z_max) / m_TanHalfX;
+	float min_y = (y_lo >= 0.0f ? y_lo / z_max : y_lo / z_min) / m_TanHalfY;
+	float max_y = (y_hi >= 0.0f ? y_hi / z_min : y_hi / z_max) / m_TanHalfY;
+	if (max_x < -1.0f || min_x > 1.0f || max_y < -1.0f || min_y > 1.0f)
+	{
+		return false;
+	}
+
+	rect->first_column = std::clamp(static_cast<int>((min_x + 1.0f) * 0.5f * GRID_X), 0, static_cast<int>(GRID_X) - 1);
+	rect->last_column = std::clamp(static_cast<int>((max_x + 1.0f) * 0.5f * GRID_X), 0, static_cast<int>(GRID_X) - 1);
+	rect->first_row = std::clamp(static_cast<int>((1.0f - max_y) * 0.5f * GRID_Y), 0, static_cast<int>(GRID_Y) - 1);
+	rect->last_row = std::clamp(static_cast<int>((1.0f - min_y) * 0.5f * GRID_Y), 0, static_cast<int>(GRID_Y) - 1);
+	return true;
+}
+
+void Rove::LightClusters::BuildSlice(uint32_t slice)
+{
+	Slice& data = m_Slices[slice];
+	data.pairs.clear();
+
+	const float near_z = m_SliceNear[slice];
+	const float far_z = m_SliceFar[slice];
+	const uint32_t slice_first = slice * GRID_X * GRID_Y;
+	const __m128 zero = _mm_setzero_ps();
+
+	for (uint32_t i : data.lights)
+	{
+		const float cx = m_ViewX[i];
+		const float cy = m_ViewY[i];
+		const float cz = m_ViewZ[i];
+		const float radius = m_Radius[i];
+
+		// Depth distance is the same for every cluster of the slice
+		float dz = std::max(std::max(near_z - cz, cz - far_z), 0.0f);
+		if (dz * dz > radius * radius)
+		{
+			continue;
+		}
+
+		TileRect rect;
+		if (!GetTileRect(cx, cy, cz, radius, near_z, far_z, &rect))
+		{
+			continue;
+		}
+
+		const __m128 center_x = _mm_set1_ps(cx);
+		const __m128 center_y = _mm_set1_ps(cy);
+		const __m128 distance_z = _mm_set1_ps(dz * dz);
+		const __m128 radius_squared = _mm_set1_ps(radius * radius);
+
+		// Sphere against the boxes of 4 clusters of a row at a time
+		for (int row = rect.first_row; row <= rect.last_row; ++row)
+		{
+			uint32_t row_first = slice_first + row * GRID_X;
+			for (int column = rect.first_column & ~3; column <= rect.last_column; column += 4)
+			{
+				uint32_t cluster = row_first + column;
+				__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_MinX[cluster]), center_x), _mm_sub_ps(center_x, _mm_loadu_ps(&m_MaxX[cluster]))), zero);
+				__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_MinY[cluster]), center_y), _mm_sub_ps(center_y, _mm_loadu_ps(&m_MaxY[cluster]))), zero);
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), distance_z);
+
+				int mask = _mm_movemask_ps(_mm_cmple_ps(distance, radius_squared));
+				for (int j = 0; j < 4; ++j)
+				{
+					int lane_column = column + j;
+					if ((mask >> j) & 1 && lane_column >= rect.first_column && lane_column <= rect.last_column)
+					{
+						data.pairs.emplace_back(static_cast<uint16_t>(row * GRID_X + lane_column), i);
+					}
+				}
+			}
+		}
+	}
+
+	// Counting sort by cluster keeps the lights of each cluster in index order
+	uint32_t offsets[GRID_X * GRID_Y];
+	std::fill(std::begin(data.counts), std::end(data.counts), 0);
+	for (const auto& pair : data.pairs)
+	{
+		++data.counts[pair.first];
+	}
+
+	uint32_t offset = 0;
+	for (uint32_t i = 0; i < GRID_X * GRID_Y; ++i)
+	{
+		offsets[i] = offset;
+		offset += data.counts[i];
+	}
+
+	data.indices.resize(data.pairs.size());
+	for (const auto& pair : data.pairs)
+	{
+		data.indices[offsets[pair.first]++] = pair.second;
+	}
+}
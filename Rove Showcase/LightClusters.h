@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Pch.h"
+
+namespace Rove
+{
+	// Forward declarations
+	class JobSystem;
+
+	// Range of the light index list read by one cluster
+	struct LightCluster
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	// Result of the last build
+	struct LightClusterStats
+	{
+		int light_count = 0;
+		int visible_lights = 0;
+		size_t index_count = 0;
+		int max_cluster_lights = 0;
+		double build_microseconds = 0.0;
+	};
+
+	// Splits the view frustum into a grid of clusters, screen tiles across and exponential depth slices in, and finds
+	// the point lights whose range reaches each cluster. The indices of the lights of every cluster are packed into one
+	// list so a pixel only loops over the lights of its own cluster. Each depth slice is built by a job and the lights
+	// are tested against four clusters of a tile row at a time.
+	class LightClusters
+	{
+	public:
+		LightClusters(JobSystem* job_system);
+		virtual ~LightClusters() = default;
+
+		// Grid size, the width is a multiple of 4 so a tile row is tested in groups of 4
+		static constexpr uint32_t GRID_X = 16;
+		static constexpr uint32_t GRID_Y = 9;
+		static constexpr uint32_t GRID_Z = 24;
+		static constexpr uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+		// Recomputes the view space bounds of the clusters, does nothing when the projection is unchanged
+		void SetProjection(float fov_y_radians, float aspect_ratio, float near_plane, float far_plane);
+
+		// Assigns every light to the clusters its sphere touches, each light is the world space position in xyz and the
+		// radius in w
+		void Build(const DirectX::XMMATRIX& view, const DirectX::XMFLOAT4* lights, size_t count);
+
+		// Light index range of every cluster, x fastest then y from the top of the screen then depth
+		const std::vector<LightCluster>& GetClusters() const { return m_Clusters; }
+
+		// Light indices of every cluster packed together
+		const std::vector<uint32_t>& GetLightIndices() const { return m_LightIndices; }
+
+		// The depth slice of a view depth is floor(log(depth) * scale + bias)
+		float GetDepthScale() const { return m_DepthScale; }
+		float GetDepthBias() const { return m_DepthBias; }
+
+		// View space bounds of a cluster
+		DirectX::BoundingBox GetClusterBounds(uint32_t cluster) const;
+
+		// Result of the last build
+		const LightClusterStats& GetStats() const { return m_Stats; }
+
+	private:
+		JobSystem* m_JobSystem = nullptr;
+
+		// Projection the bounds were built for
+		float m_FovY = 0.0f;
+		float m_AspectRatio = 0.0f;
+		float m_NearPlane = 0.0f;
+		float m_FarPlane = 0.0f;
+		float m_DepthScale = 0.0f;
+		float m_DepthBias = 0.0f;
+
+		// Tangents of the half field of view, a view space point at depth z is at the edge of the screen when x equals
+		// z times the tangent
+		float m_TanHalfX = 0.0f;
+		float m_TanHalfY = 0.0f;
+
+		// View space bounds of every cluster as a structure of arrays, the depth is shared by a slice
+		std::vector<float> m_MinX;
+		std::vector<float> m_MaxX;
+		std::vector<float> m_MinY;
+		std::vector<float> m_MaxY;
+		float m_SliceNear[GRID_Z] = {};
+		float m_SliceFar[GRID_Z] = {};
+
+		// View space spheres of the lights and the range of slices they touch
+		std::vector<float> m_ViewX;
+		std::vector<float> m_ViewY;
+		std::vector<float> m_ViewZ;
+		std::vector<float> m_Radius;
+		std::vector<int> m_FirstSlice;
+		std::vector<int> m_LastSlice;
+
+		// Lights reaching each slice, the cluster and light pairs found by its job, then sorted into its index list
+		struct Slice
+		{
+			std::vector<uint32_t> lights;
+			std::vector<std::pair<uint16_t, uint32_t>> pairs;
+			std::vector<uint32_t> indices;
+			uint32_t counts[GRID_X * GRID_Y];
+		};
+
+		Slice m_Slices[GRID_Z];
+
+		std::vector<LightCluster> m_Clusters;
+		std::vector<uint32_t> m_LightIndices;
+		LightClusterStats m_Stats;
+
+		// Depth slice of a view depth clamped to the grid
+		int GetSlice(float depth) const;
+
+		// Columns and rows of the tiles a sphere can touch within a depth range
+		struct TileRect
+		{
+			int first_column;
+			int last_column;
+			int first_row;
+			int last_row;
+		};
+
+		// Finds the tiles the box of a view space sphere covers, returns false when it is off the screen
+		bool GetTileRect(float cx, float cy, float cz, float radius, float near_z, float far_z, TileRect* rect) const;
+
+		// Tests the lights touching a slice against its clusters
+		void BuildSlice(uint32_t slice);
+	};
+}
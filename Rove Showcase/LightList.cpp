@@ -0,0 +1,120 @@
+#include "Pch.h"
+#include "LightList.h"
+
+uint32_t Rove::LightList::Add(const PointLight& light)
+{
+	uint32_t index = static_cast<uint32_t>(m_Spheres.size());
+	m_Spheres.emplace_back(light.Position.x, light.Position.y, light.Position.z, light.Radius);
+	m_Diffuse.push_back(light.DiffuseColour);
+	m_Ambient.push_back(light.AmbientColour);
+	m_Specular.push_back(light.SpecularColour);
+	m_Dirty.push_back(0);
+
+	MarkDirty(index);
+	return index;
+}
+
+void Rove::LightList::Clear()
+{
+	m_Spheres.clear();
+	m_Diffuse.clear();
+	m_Ambient.clear();
+	m_Specular.clear();
+	m_Dirty.clear();
+	m_DirtyLights.clear();
+	m_DirtyRanges.clear();
+}
+
+Rove::PointLight Rove::LightList::Get(uint32_t index) const
+{
+	PointLight light;
+	light.Position = DirectX::XMFLOAT3(m_Spheres[index].x, m_Spheres[index].y, m_Spheres[index].z);
+	light.Radius = m_Spheres[index].w;
+	light.DiffuseColour = m_Diffuse[index];
+	light.AmbientColour = m_Ambient[index];
+	light.SpecularColour = m_Specular[index];
+	return light;
+}
+
+void Rove::LightList::SetPosition(uint32_t index, const DirectX::XMFLOAT3& position)
+{
+	m_Spheres[index].x = position.x;
+	m_Spheres[index].y = position.y;
+	m_Spheres[index].z = position.z;
+	MarkDirty(index);
+}
+
+void Rove::LightList::SetRadius(uint32_t index, float radius)
+{
+	m_Spheres[index].w = radius;
+	MarkDirty(index);
+}
+
+void Rove::LightList::SetDiffuse(uint32_t index, const DirectX::XMFLOAT4& colour)
+{
+	m_Diffuse[index] = colour;
+	MarkDirty(index);
+}
+
+void Rove::LightList::SetAmbient(uint32_t index, const DirectX::XMFLOAT4& colour)
+{
+	m_Ambient[index] = colour;
+	MarkDirty(index);
+}
+
+void Rove::LightList::SetSpecular(uint32_t index, const DirectX::XMFLOAT4& colour)
+{
+	m_Specular[index] = colour;
+	MarkDirty(index);
+}
+
+void Rove::LightList::MarkAllDirty()
+{
+	for (uint32_t i = 0; i < m_Spheres.size(); ++i)
+	{
+		MarkDirty(i);
+	}
+}
+
+const std::vector<Rove::LightRange>& Rove::LightList::GetDirtyRanges()
+{
+	m_DirtyRanges.clear();
+	std::sort(m_DirtyLights.begin(), m_DirtyLights.end());
+
+	for (uint32_t index : m_DirtyLights)
+	{
+		if (!m_DirtyRanges.empty())
+		{
+			LightRange& last = m_DirtyRanges.back();
+			if (index <= last.first + last.count + MERGE_GAP)
+			{
+				last.count = index - last.first + 1;
+				continue;
+			}
+		}
+
+		m_DirtyRanges.push_back({ index, 1 });
+	}
+
+	return m_DirtyRanges;
+}
+
+void Rove::LightList::ClearDirty()
+{
+	for (uint32_t index : m_DirtyLights)
+	{
+		m_Dirty[index] = 0;
+	}
+
+	m_DirtyLights.clear();
+	m_DirtyRanges.clear();
+}
+
+void Rove::LightList::MarkDirty(uint32_t index)
+{
+	if (m_Dirty[index] == 0)
+	{
+		m_Dirty[index] = 1;
+		m_DirtyLights.push_back(index);
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Pch.h"
+#include "PointLight.h"
+
+namespace Rove
+{
+	// Consecutive lights to upload together
+	struct LightRange
+	{
+		uint32_t first;
+		uint32_t count;
+	};
+
+	// Every point light of the scene stored as a structure of arrays, one array for each property. Setting a property
+	// marks only that light so a frame uploads the ranges that changed instead of the whole list.
+	class LightList
+	{
+	public:
+		LightList() = default;
+		virtual ~LightList() = default;
+
+		// Dirty lights closer than this are merged into one range, copying a few clean lights is cheaper than another copy
+		static constexpr uint32_t MERGE_GAP = 8;
+
+		// Appends a light and returns its index
+		uint32_t Add(const PointLight& light);
+
+		// Removes every light
+		void Clear();
+
+		// Number of lights
+		size_t Size() const { return m_Spheres.size(); }
+
+		// Copy of a light
+		PointLight Get(uint32_t index) const;
+
+		// Change one property of a light
+		void SetPosition(uint32_t index, const DirectX::XMFLOAT3& position);
+		void SetRadius(uint32_t index, float radius);
+		void SetDiffuse(uint32_t index, const DirectX::XMFLOAT4& colour);
+		void SetAmbient(uint32_t index, const DirectX::XMFLOAT4& colour);
+		void SetSpecular(uint32_t index, const DirectX::XMFLOAT4& colour);
+
+		// Position in xyz and radius in w of every light
+		const DirectX::XMFLOAT4* GetSpheres() const { return m_Spheres.data(); }
+		const DirectX::XMFLOAT4* GetDiffuse() const { return m_Diffuse.data(); }
+		const DirectX::XMFLOAT4* GetAmbient() const { return m_Ambient.data(); }
+		const DirectX::XMFLOAT4* GetSpecular() const { return m_Specular.data(); }
+
+		// Marks every light, used when the copy on the GPU is lost
+		void MarkAllDirty();
+
+		// Ranges covering the lights changed since the last ClearDirty, in index order
+		const std::vector<LightRange>& GetDirtyRanges();
+
+		// Number of lights changed since the last ClearDirty
+		size_t GetDirtyCount() const { return m_DirtyLights.size(); }
+
+		// Forgets the changes once they are uploaded
+		void ClearDirty();
+
+	private:
+		std::vector<DirectX::XMFLOAT4> m_Spheres;
+		std::vector<DirectX::XMFLOAT4> m_Diffuse;
+		std::vector<DirectX::XMFLOAT4> m_Ambient;
+		std::vector<DirectX::XMFLOAT4> m_Specular;
+
+		// Flag per light and the list of flagged lights, so a frame only visits what changed
+		std::vector<uint8_t> m_Dirty;
+		std::vector<uint32_t> m_DirtyLights;
+		std::vector<LightRange> m_DirtyRanges;
+
+		void MarkDirty(uint32_t index);
+	};
+}
@@ -1,5 +1,93 @@
 #include "Pch.h"
+#include <iostream>
 #include "Application.h"
+#include "Headless.h"
+
+namespace
+{
+	// The application uses the windows subsystem so borrow the console of the parent process for headless reports
+	void AttachParentConsole()
+	{
+		if (AttachConsole(ATTACH_PARENT_PROCESS))
+		{
+			FILE* stream = nullptr;
+			freopen_s(&stream, "CONOUT$", "w", stdout);
+			freopen_s(&stream, "CONOUT$", "w", stderr);
+		}
+	}
+
+	// Count argument of a headless mode or its default when not given
+	uint32_t GetCount(const std::vector<std::string>& arguments, size_t index, uint32_t default_count)
+	{
+		return index < arguments.size() ? static_cast<uint32_t>(std::stoul(arguments[index])) : default_count;
+	}
+
+	// Mode run without a window from a command line flag, given the arguments after the flag
+	struct HeadlessMode
+	{
+		const char* flag;
+		size_t required_arguments;
+		int (*run)(const std::vector<std::string>& arguments);
+	};
+
+	const HeadlessMode HEADLESS_MODES[] =
+	{
+		// --occlusion-test <scene.gltf> <camera_path.txt> [report.csv]
+		{ "--occlusion-test", 2, [](const std::vector<std::string>& arguments)
+		{
+			if (arguments.size() >= 3)
+			{
+				std::ofstream report(arguments[2]);
+				return Rove::RunOcclusionTest(arguments[0], arguments[1], report);
+			}
+
+			return Rove::RunOcclusionTest(arguments[0], arguments[1], std::cout);
+		} },
+
+		// --command-benchmark [draw_count]
+		{ "--command-benchmark", 0, [](const std::vector<std::string>& arguments) { return Rove::RunCommandBenchmark(GetCount(arguments, 0, 100000), std::cout); } },
+
+		// --light-cluster-test [light_count]
+		{ "--light-cluster-test", 0, [](const std::vector<std::string>& arguments) { return Rove::RunLightClusterTest(GetCount(arguments, 0, 4096), std::cout); } },
+
+		// --object-light-test
+		{ "--object-light-test", 0, [](const std::vector<std::string>&) { return Rove::RunObjectLightTest(std::cout); } },
+
+		// --shader-cache-benchmark [draw_count]
+		{ "--shader-cache-benchmark", 0, [](const std::vector<std::string>& arguments) { return Rove::RunShaderCacheBenchmark(GetCount(arguments, 0, 10000), std::cout); } },
+
+		// --profiler-benchmark [zone_count]
+		{ "--profiler-benchmark", 0, [](const std::vector<std::string>& arguments) { return Rove::RunProfilerBenchmark(GetCount(arguments, 0, 1000000), std::cout); } },
+
+		// --frame-time-test [frame_count]
+		{ "--frame-time-test", 0, [](const std::vector<std::string>& arguments) { return Rove::RunFrameTimeTest(GetCount(arguments, 0, 100000), std::cout); } },
+
+		// --trace-capture-benchmark [frame_count]
+		{ "--trace-capture-benchmark", 0, [](const std::vector<std::string>& arguments) { return Rove::RunTraceCaptureBenchmark(GetCount(arguments, 0, 200), std::cout); } },
+
+		// --hitch-test
+		{ "--hitch-test", 0, [](const std::vector<std::string>&) { return Rove::RunHitchTest(std::cout); } },
+
+		// --memory-test
+		{ "--memory-test", 0, [](const std::vector<std::string>&) { return Rove::RunMemoryTest(std::cout); } },
+	};
+
+	// Runs a headless mode with its report on the console of the parent process
+	int RunHeadlessMode(const HeadlessMode& mode, const std::vector<std::string>& arguments)
+	{
+		AttachParentConsole();
+
+		try
+		{
+			return mode.run(arguments);
+		}
+		catch (const std::exception& ex)
+		{
+			std::cerr << ex.what() << std::endl;
+			return -1;
+		}
+	}
+}
 
 int main(int argc, char** argv)
 {
@@ -8,9 +96,30 @@ int main(int argc, char** argv)
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
+	// Headless modes: <flag> [arguments]
+	if (argc >= 2)
+	{
+		std::vector<std::string> arguments(argv + 2, argv + argc);
+		for (const HeadlessMode& mode : HEADLESS_MODES)
+		{
+			if (std::string(argv[1]) == mode.flag && arguments.size() >= mode.required_arguments)
+			{
+				return RunHeadlessMode(mode, arguments);
+			}
+		}
+	}
+
 	try
 	{
 		auto application = std::make_unique<Rove::Application>();
+
+		// Trace capture from start up: --capture-frames <frame_count> [trace.json]
+		if (argc >= 3 && std::string(argv[1]) == "--capture-frames")
+		{
+			std::filesystem::path path = argc >= 4 ? argv[3] : "trace.json";
+			application->StartTraceCapture(static_cast<uint32_t>(std::stoul(argv[2])), path);
+		}
+
 		return application->Run();
 	}
 	catch (const std::exception& ex)
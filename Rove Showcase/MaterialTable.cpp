@@ -0,0 +1,173 @@
+#include "Pch.h"
+#include "MaterialTable.h"
+#include "DxRenderer.h"
+#include "DxShader.h"
+#include "MemoryTracker.h"
+
+namespace
+{
+	// Bytes of the 2D texture behind a view
+	uint64_t GetTextureBytes(ID3D11ShaderResourceView* view)
+	{
+		ComPtr<ID3D11Resource> resource = nullptr;
+		view->GetResource(resource.GetAddressOf());
+
+		ComPtr<ID3D11Texture2D> texture = nullptr;
+		if (FAILED(resource.As(&texture)))
+		{
+			return 0;
+		}
+
+		D3D11_TEXTURE2D_DESC desc = {};
+		texture->GetDesc(&desc);
+		return Rove::DX::GetTextureBytes(desc);
+	}
+}
+
+Rove::MaterialTable::MaterialTable(DxRenderer* renderer) : m_DxRenderer(renderer)
+{
+}
+
+Rove::MaterialTable::~MaterialTable()
+{
+	Clear();
+}
+
+uint32_t Rove::MaterialTable::Add(const Material& material, ID3D11ShaderResourceView* diffuse_texture, ID3D11ShaderResourceView* normal_texture)
+{
+	Entry entry;
+	entry.material = material;
+	entry.material.diffuse_texture = diffuse_texture != nullptr;
+	entry.material.normal_texture = normal_texture != nullptr;
+	entry.diffuse_texture = diffuse_texture;
+	entry.normal_texture = normal_texture;
+
+	auto it = m_Lookup.find(MakeKey(entry));
+	if (it != m_Lookup.end())
+	{
+		return it->second;
+	}
+
+	if (m_Materials.size() >= MAX_MATERIALS)
+	{
+		throw std::exception("Too many materials");
+	}
+
+	CreateConstantBuffer(entry);
+	if (entry.constants != nullptr)
+	{
+		MemoryTracker::Allocated(MemoryTag::GpuBuffers, sizeof(MaterialBuffer));
+	}
+
+	entry.texture_bytes = CountTexture(diffuse_texture) + CountTexture(normal_texture);
+
+	uint32_t index = static_cast<uint32_t>(m_Materials.size());
+	m_Lookup.emplace(MakeKey(entry), index);
+	m_Materials.push_back(std::move(entry));
+	return index;
+}
+
+void Rove::MaterialTable::Update(uint32_t index, const Material& material)
+{
+	Entry& entry = m_Materials[index];
+
+	// Only the factors can be edited, the texture flags follow the textures
+	auto it = m_Lookup.find(MakeKey(entry));
+	if (it != m_Lookup.end() && it->second == index)
+	{
+		m_Lookup.erase(it);
+	}
+
+	entry.material.metallicFactor = material.metallicFactor;
+	entry.material.roughnessFactor = material.roughnessFactor;
+	m_Lookup.emplace(MakeKey(entry), index);
+
+	CreateConstantBuffer(entry);
+}
+
+void Rove::MaterialTable::Bind(uint32_t index, DxStateCache* state_cache) const
+{
+	const Entry& entry = m_Materials[index];
+
+	// Bind textures to the pixel shader, materials sharing a texture leave it bound
+	ID3D11ShaderResourceView* textures[] = { entry.diffuse_texture.Get(), entry.normal_texture.Get() };
+	state_cache->PSSetShaderResources(0, 2, textures);
+
+	// Bind material buffer to the pixel shader
+	state_cache->PSSetConstantBuffer(3, entry.constants.Get());
+}
+
+uint64_t Rove::MaterialTable::GetGpuBytes(uint32_t index) const
+{
+	const Entry& entry = m_Materials[index];
+	return entry.texture_bytes + (entry.constants != nullptr ? sizeof(MaterialBuffer) : 0);
+}
+
+void Rove::MaterialTable::Clear()
+{
+	for (const Entry& entry : m_Materials)
+	{
+		if (entry.constants != nullptr)
+		{
+			MemoryTracker::Freed(MemoryTag::GpuBuffers, sizeof(MaterialBuffer));
+		}
+	}
+
+	for (auto& texture : m_TextureBytes)
+	{
+		MemoryTracker::Freed(MemoryTag::GpuTextures, texture.second);
+	}
+
+	m_Materials.clear();
+	m_Lookup.clear();
+	m_TextureBytes.clear();
+}
+
+uint64_t Rove::MaterialTable::CountTexture(ID3D11ShaderResourceView* texture)
+{
+	if (texture == nullptr)
+	{
+		return 0;
+	}
+
+	auto it = m_TextureBytes.find(texture);
+	if (it != m_TextureBytes.end())
+	{
+		return it->second;
+	}
+
+	uint64_t bytes = GetTextureBytes(texture);
+	MemoryTracker::Allocated(MemoryTag::GpuTextures, bytes);
+	m_TextureBytes.emplace(texture, bytes);
+	return bytes;
+}
+
+Rove::MaterialTable::Key Rove::MaterialTable::MakeKey(const Entry& entry)
+{
+	return Key(entry.material.metallicFactor, entry.material.roughnessFactor, entry.diffuse_texture.Get(), entry.normal_texture.Get());
+}
+
+void Rove::MaterialTable::CreateConstantBuffer(Entry& entry)
+{
+	if (m_DxRenderer == nullptr)
+	{
+		return;
+	}
+
+	MaterialBuffer material_buffer = {};
+	material_buffer.diffuse_texture = static_cast<int>(entry.material.diffuse_texture);
+	material_buffer.normal_texture = static_cast<int>(entry.material.normal_texture);
+	material_buffer.metallicFactor = entry.material.metallicFactor;
+	material_buffer.roughnessFactor = entry.material.roughnessFactor;
+
+	// Immutable as it is written once, an edit replaces the whole buffer
+	D3D11_BUFFER_DESC bd = {};
+	bd.Usage = D3D11_USAGE_IMMUTABLE;
+	bd.ByteWidth = sizeof(MaterialBuffer);
+	bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = &material_buffer;
+
+	DX::Check(m_DxRenderer->GetDevice()->CreateBuffer(&bd, &data, entry.constants.ReleaseAndGetAddressOf()));
+}
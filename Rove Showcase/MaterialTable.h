@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Pch.h"
+
+namespace Rove
+{
+	// Forward declarations
+	class DxRenderer;
+	class DxStateCache;
+
+	// Material
+	struct Material
+	{
+		bool diffuse_texture = false;
+		bool normal_texture = false;
+		float metallicFactor = 0.0f;
+		float roughnessFactor = 0.5f;
+	};
+
+	// Every distinct material of the scene, models refer to them by index. Materials with the same values and textures
+	// are stored once and each keeps an immutable constant buffer, so binding a material never uploads anything.
+	class MaterialTable
+	{
+	public:
+		// Most materials, the sort key and the draw commands hold 20 bits of material index
+		static constexpr uint32_t MAX_MATERIALS = 1 << 20;
+
+		// Without a renderer only the values are kept
+		MaterialTable(DxRenderer* renderer);
+		virtual ~MaterialTable();
+
+		// Returns the index of a material with the same values and textures, adding it if there is none. Throws when the
+		// table already holds MAX_MATERIALS.
+		uint32_t Add(const Material& material, ID3D11ShaderResourceView* diffuse_texture, ID3D11ShaderResourceView* normal_texture);
+
+		// Changes the values of a material and recreates only its constant buffer, every model using it changes
+		void Update(uint32_t index, const Material& material);
+
+		// Binds the constants and textures of a material to the pixel shader of the context behind a state cache
+		void Bind(uint32_t index, DxStateCache* state_cache) const;
+
+		// Values of a material
+		const Material& Get(uint32_t index) const { return m_Materials[index].material; }
+
+		// Number of materials
+		size_t Size() const { return m_Materials.size(); }
+
+		// Bytes of the constant buffer and textures of a material from their descriptors, textures may be shared
+		uint64_t GetGpuBytes(uint32_t index) const;
+
+		// Removes every material
+		void Clear();
+
+	private:
+		DxRenderer* m_DxRenderer = nullptr;
+
+		struct Entry
+		{
+			Material material;
+			ComPtr<ID3D11ShaderResourceView> diffuse_texture;
+			ComPtr<ID3D11ShaderResourceView> normal_texture;
+			ComPtr<ID3D11Buffer> constants;
+
+			// Bytes of both textures
+			uint64_t texture_bytes = 0;
+		};
+
+		std::vector<Entry> m_Materials;
+
+		// Bytes of each distinct texture the materials hold, counted under the GPU texture tag once however many
+		// materials share it
+		std::map<ID3D11ShaderResourceView*, uint64_t> m_TextureBytes;
+		uint64_t CountTexture(ID3D11ShaderResourceView* texture);
+
+		// Index of each distinct material by its values and textures
+		using Key = std::tuple<float, float, ID3D11ShaderResourceView*, ID3D11ShaderResourceView*>;
+		std::map<Key, uint32_t> m_Lookup;
+		static Key MakeKey(const Entry& entry);
+
+		void CreateConstantBuffer(Entry& entry);
+	};
+}
@@ -0,0 +1,133 @@
+#include "Pch.h"
+#include "MemoryTracker.h"
+
+thread_local Rove::MemoryCounters* Rove::MemoryTracker::s_ThreadCounters = nullptr;
+
+namespace
+{
+	// Least space in front of an allocation, its size and the offset back to the start of the block
+	constexpr size_t HEADER_BYTES = 2 * sizeof(size_t);
+}
+
+const char* Rove::GetMemoryTagName(MemoryTag tag)
+{
+	switch (tag)
+	{
+	case MemoryTag::Loader:
+		return "Loader";
+	case MemoryTag::Geometry:
+		return "Geometry";
+	case MemoryTag::Frame:
+		return "Frame";
+	case MemoryTag::ImGui:
+		return "ImGui";
+	case MemoryTag::GpuBuffers:
+		return "GPU buffers";
+	case MemoryTag::GpuTextures:
+		return "GPU textures";
+	default:
+		return "Unknown";
+	}
+}
+
+Rove::MemoryTracker& Rove::MemoryTracker::Get()
+{
+	static MemoryTracker tracker;
+	return tracker;
+}
+
+Rove::MemoryTracker::MemoryTracker()
+{
+	m_SharedCounters.shared = true;
+}
+
+Rove::MemoryCounters* Rove::MemoryTracker::RegisterThread()
+{
+	std::lock_guard<std::mutex> lock(m_RegisterMutex);
+	uint32_t index = m_ThreadCount.load(std::memory_order_relaxed);
+	if (index == MAX_THREADS)
+	{
+		return &m_SharedCounters;
+	}
+
+	// Not counted itself as the counters are what counts
+	m_Counters[index] = new MemoryCounters();
+	m_ThreadCount.store(index + 1, std::memory_order_release);
+	return m_Counters[index];
+}
+
+void Rove::MemoryTracker::Update()
+{
+	uint32_t thread_count = GetThreadCount();
+	for (size_t tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
+	{
+		MemoryTagStats stats;
+		int64_t thread_peak = 0;
+		for (uint32_t i = 0; i <= thread_count; ++i)
+		{
+			const MemoryCounters& counters = i < thread_count ? *m_Counters[i] : m_SharedCounters;
+			stats.bytes += counters.bytes[tag].load(std::memory_order_relaxed);
+			stats.allocations += counters.allocations[tag].load(std::memory_order_relaxed);
+			stats.total_allocations += counters.total_allocations[tag].load(std::memory_order_relaxed);
+			thread_peak = std::max(thread_peak, counters.peak_bytes[tag].load(std::memory_order_relaxed));
+		}
+
+		stats.peak_bytes = std::max({ m_Stats[tag].peak_bytes, stats.bytes, thread_peak });
+		m_Stats[tag] = stats;
+	}
+}
+
+void Rove::MemoryTracker::ResetPeaks()
+{
+	// Thread peaks are only written by their threads, lowering them here may lose a peak being raised meanwhile
+	uint32_t thread_count = GetThreadCount();
+	for (size_t tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
+	{
+		for (uint32_t i = 0; i < thread_count; ++i)
+		{
+			m_Counters[i]->peak_bytes[tag].store(0, std::memory_order_relaxed);
+		}
+
+		m_Stats[tag].peak_bytes = m_Stats[tag].bytes;
+	}
+}
+
+Rove::TaggedAllocator& Rove::TaggedAllocator::Get(MemoryTag tag)
+{
+	static TaggedAllocator allocators[] = { MemoryTag::Loader, MemoryTag::Geometry, MemoryTag::Frame, MemoryTag::ImGui, MemoryTag::GpuBuffers, MemoryTag::GpuTextures };
+	static_assert(std::size(allocators) == MEMORY_TAG_COUNT, "Every tag needs an allocator");
+	return allocators[static_cast<size_t>(tag)];
+}
+
+void* Rove::TaggedAllocator::Allocate(size_t size, size_t alignment)
+{
+	// The header is a multiple of the alignment so the memory after it stays aligned
+	alignment = std::max(alignment, alignof(size_t));
+	size_t header = std::max(alignment, HEADER_BYTES);
+
+	uint8_t* block = static_cast<uint8_t*>(_aligned_malloc(size + header, alignment));
+	if (block == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+
+	uint8_t* memory = block + header;
+	size_t* fields = reinterpret_cast<size_t*>(memory) - 2;
+	fields[0] = size;
+	fields[1] = header;
+
+	MemoryTracker::Allocated(m_Tag, size);
+	return memory;
+}
+
+void Rove::TaggedAllocator::Free(void* memory)
+{
+	if (memory == nullptr)
+	{
+		return;
+	}
+
+	size_t* fields = static_cast<size_t*>(memory) - 2;
+	MemoryTracker::Freed(m_Tag, fields[0]);
+	_aligned_free(static_cast<uint8_t*>(memory) - fields[1]);
+}
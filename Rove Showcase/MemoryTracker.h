@@ -0,0 +1,286 @@
+#pragma once
+
+#include "Pch.h"
+
+// Define ROVE_MEMORY_TRACKING as 0 to stop counting, the tagged allocators still allocate
+#ifndef ROVE_MEMORY_TRACKING
+#define ROVE_MEMORY_TRACKING 1
+#endif
+
+namespace Rove
+{
+	// Subsystem memory is counted under
+	enum class MemoryTag : uint32_t
+	{
+		// File buffers and scratch while loading a model
+		Loader,
+
+		// Vertex, position and index copies kept on the CPU for ray queries, occlusion and static batching
+		Geometry,
+
+		// Per frame arenas of the scene
+		Frame,
+
+		// Dear ImGui and ImPlot
+		ImGui,
+
+		// GPU resources counted by the size in their descriptors
+		GpuBuffers,
+		GpuTextures,
+
+		Count
+	};
+
+	constexpr size_t MEMORY_TAG_COUNT = static_cast<size_t>(MemoryTag::Count);
+
+	// Name of a tag shown in the memory panel
+	const char* GetMemoryTagName(MemoryTag tag);
+
+	// Memory of a tag summed over every thread
+	struct MemoryTagStats
+	{
+		int64_t bytes = 0;
+		int64_t allocations = 0;
+
+		// Highest bytes seen, see MemoryTracker::Update
+		int64_t peak_bytes = 0;
+
+		// Allocations made since start up
+		int64_t total_allocations = 0;
+	};
+
+	// Counters of one thread, only written by that thread so counting never takes a lock or a locked instruction. The
+	// counters of a thread go negative when it frees memory another thread allocated, only their sum is meaningful.
+	struct alignas(64) MemoryCounters
+	{
+		std::atomic<int64_t> bytes[MEMORY_TAG_COUNT] = {};
+		std::atomic<int64_t> allocations[MEMORY_TAG_COUNT] = {};
+		std::atomic<int64_t> total_allocations[MEMORY_TAG_COUNT] = {};
+
+		// Highest bytes of this thread alone, catches the peaks of a load that is over before the next update
+		std::atomic<int64_t> peak_bytes[MEMORY_TAG_COUNT] = {};
+
+		// Threads past the limit share one set of counters and update it with atomic adds
+		bool shared = false;
+
+		void Add(MemoryTag tag, int64_t bytes, int64_t allocations)
+		{
+			size_t index = static_cast<size_t>(tag);
+			if (shared)
+			{
+				this->bytes[index].fetch_add(bytes, std::memory_order_relaxed);
+				this->allocations[index].fetch_add(allocations, std::memory_order_relaxed);
+				this->total_allocations[index].fetch_add(allocations > 0 ? allocations : 0, std::memory_order_relaxed);
+				return;
+			}
+
+			int64_t total = this->bytes[index].load(std::memory_order_relaxed) + bytes;
+			this->bytes[index].store(total, std::memory_order_relaxed);
+			this->allocations[index].store(this->allocations[index].load(std::memory_order_relaxed) + allocations, std::memory_order_relaxed);
+			if (allocations > 0)
+			{
+				this->total_allocations[index].store(this->total_allocations[index].load(std::memory_order_relaxed) + allocations, std::memory_order_relaxed);
+			}
+
+			if (total > peak_bytes[index].load(std::memory_order_relaxed))
+			{
+				peak_bytes[index].store(total, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	// Counts the bytes and allocations of every tag in counters kept per thread. Tagged allocators count their memory
+	// here and GPU resources are counted when they are created and released. The counters of every thread are summed
+	// once a frame for the memory panel.
+	class MemoryTracker
+	{
+	public:
+		// Most threads with counters of their own
+		static constexpr uint32_t MAX_THREADS = 64;
+
+		// The tracker of the process
+		static MemoryTracker& Get();
+
+		// Counts memory allocated or freed under a tag
+		static void Allocated(MemoryTag tag, size_t bytes)
+		{
+#if ROVE_MEMORY_TRACKING
+			GetThreadCounters()->Add(tag, static_cast<int64_t>(bytes), 1);
+#endif
+		}
+
+		static void Freed(MemoryTag tag, size_t bytes)
+		{
+#if ROVE_MEMORY_TRACKING
+			GetThreadCounters()->Add(tag, -static_cast<int64_t>(bytes), -1);
+#endif
+		}
+
+		// Counts a change in the size of an allocation already counted under a tag
+		static void Resized(MemoryTag tag, size_t old_bytes, size_t new_bytes)
+		{
+#if ROVE_MEMORY_TRACKING
+			GetThreadCounters()->Add(tag, static_cast<int64_t>(new_bytes) - static_cast<int64_t>(old_bytes), 0);
+#endif
+		}
+
+		// Sums the counters of every thread and raises the peaks, called from the main loop once a frame. A peak is the
+		// highest sum seen by an update or the highest bytes of a single thread, whichever is larger.
+		void Update();
+
+		// Lowers every peak to the current bytes
+		void ResetPeaks();
+
+		// Memory of a tag at the last update
+		const MemoryTagStats& GetStats(MemoryTag tag) const { return m_Stats[static_cast<size_t>(tag)]; }
+
+		// Threads with counters of their own
+		uint32_t GetThreadCount() const { return m_ThreadCount.load(std::memory_order_acquire); }
+
+	private:
+		MemoryTracker();
+
+		// Counters of the calling thread, the shared counters once every slot is taken
+		static MemoryCounters* GetThreadCounters()
+		{
+			if (s_ThreadCounters == nullptr)
+			{
+				s_ThreadCounters = Get().RegisterThread();
+			}
+
+			return s_ThreadCounters;
+		}
+
+		static thread_local MemoryCounters* s_ThreadCounters;
+		MemoryCounters* RegisterThread();
+
+		// Counters are never freed as a thread may still count while the process exits
+		std::mutex m_RegisterMutex;
+		MemoryCounters* m_Counters[MAX_THREADS] = {};
+		std::atomic<uint32_t> m_ThreadCount = 0;
+		MemoryCounters m_SharedCounters;
+
+		MemoryTagStats m_Stats[MEMORY_TAG_COUNT];
+	};
+
+	// Bytes of one resource counted under a tag as a single allocation, for memory allocated elsewhere such as by the
+	// graphics driver. Setting the bytes of a resource recreated at another size counts the change, setting zero or
+	// destroying the counter frees it.
+	class CountedMemory
+	{
+	public:
+		CountedMemory(MemoryTag tag) : m_Tag(tag) {}
+		~CountedMemory() { Set(0); }
+
+		CountedMemory(CountedMemory&& other) noexcept : m_Tag(other.m_Tag), m_Bytes(other.m_Bytes) { other.m_Bytes = 0; }
+		CountedMemory(const CountedMemory&) = delete;
+		CountedMemory& operator=(const CountedMemory&) = delete;
+
+		void Set(uint64_t bytes)
+		{
+			if (m_Bytes == 0 && bytes > 0)
+			{
+				MemoryTracker::Allocated(m_Tag, static_cast<size_t>(bytes));
+			}
+			else if (m_Bytes > 0 && bytes == 0)
+			{
+				MemoryTracker::Freed(m_Tag, static_cast<size_t>(m_Bytes));
+			}
+			else if (m_Bytes > 0)
+			{
+				MemoryTracker::Resized(m_Tag, static_cast<size_t>(m_Bytes), static_cast<size_t>(bytes));
+			}
+
+			m_Bytes = bytes;
+		}
+
+		uint64_t Get() const { return m_Bytes; }
+
+	private:
+		MemoryTag m_Tag;
+		uint64_t m_Bytes = 0;
+	};
+
+	// Allocator interface of the memory counted by tag
+	class Allocator
+	{
+	public:
+		virtual ~Allocator() = default;
+
+		// Returns memory of at least the size aligned to a power of two
+		virtual void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) = 0;
+
+		// Frees memory of this allocator, null is ignored
+		virtual void Free(void* memory) = 0;
+	};
+
+	// Heap allocator counting its memory under a tag. The size and offset of an allocation are kept in front of it, so
+	// it can be freed from the pointer alone as Dear ImGui does.
+	class TaggedAllocator : public Allocator
+	{
+	public:
+		TaggedAllocator(MemoryTag tag) : m_Tag(tag) {}
+		virtual ~TaggedAllocator() = default;
+
+		// The allocator of a tag
+		static TaggedAllocator& Get(MemoryTag tag);
+
+		void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) override;
+		void Free(void* memory) override;
+
+		MemoryTag GetTag() const { return m_Tag; }
+
+	private:
+		MemoryTag m_Tag;
+	};
+
+	// Frees memory of a unique pointer through its allocator
+	struct AllocatorDeleter
+	{
+		Allocator* allocator = nullptr;
+
+		void operator()(void* memory) const
+		{
+			allocator->Free(memory);
+		}
+	};
+
+	// Standard library allocator for containers counted under a tag
+	template <typename T, MemoryTag Tag>
+	class TaggedStlAllocator
+	{
+	public:
+		using value_type = T;
+
+		template <typename U>
+		struct rebind
+		{
+			using other = TaggedStlAllocator<U, Tag>;
+		};
+
+		TaggedStlAllocator() = default;
+
+		template <typename U>
+		TaggedStlAllocator(const TaggedStlAllocator<U, Tag>&) {}
+
+		T* allocate(size_t count)
+		{
+			return static_cast<T*>(TaggedAllocator::Get(Tag).Allocate(count * sizeof(T), std::max(alignof(T), alignof(std::max_align_t))));
+		}
+
+		void deallocate(T* memory, size_t)
+		{
+			TaggedAllocator::Get(Tag).Free(memory);
+		}
+
+		template <typename U>
+		bool operator==(const TaggedStlAllocator<U, Tag>&) const { return true; }
+
+		template <typename U>
+		bool operator!=(const TaggedStlAllocator<U, Tag>&) const { return false; }
+	};
+
+	// Vector counted under a tag
+	template <typename T, MemoryTag Tag>
+	using TaggedVector = std::vector<T, TaggedStlAllocator<T, Tag>>;
+}
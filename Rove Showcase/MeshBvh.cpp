@@ -0,0 +1,417 @@
+#include "Pch.h"
+#include "MeshBvh.h"
+
+namespace
+{
+	// Number of bins used to evaluate the split candidates on each axis
+	constexpr int BIN_COUNT = 16;
+
+	// Subtrees with more triangles than this are built on their own thread
+	constexpr uint32_t PARALLEL_THRESHOLD = 16384;
+
+	struct Bin
+	{
+		DirectX::XMFLOAT3 min = DirectX::XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		DirectX::XMFLOAT3 max = DirectX::XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		uint32_t count = 0;
+
+		void Grow(const DirectX::XMFLOAT3& point_min, const DirectX::XMFLOAT3& point_max)
+		{
+			min = DirectX::XMFLOAT3(std::min(min.x, point_min.x), std::min(min.y, point_min.y), std::min(min.z, point_min.z));
+			max = DirectX::XMFLOAT3(std::max(max.x, point_max.x), std::max(max.y, point_max.y), std::max(max.z, point_max.z));
+		}
+
+		float Area() const
+		{
+			if (count == 0)
+			{
+				return 0.0f;
+			}
+
+			float x = max.x - min.x;
+			float y = max.y - min.y;
+			float z = max.z - min.z;
+			return x * y + y * z + z * x;
+		}
+	};
+
+	float GetAxis(const DirectX::XMFLOAT3& v, int axis)
+	{
+		return reinterpret_cast<const float*>(&v)[axis];
+	}
+
+	// Slab test against a node, returns the entry distance or FLT_MAX on a miss
+	float IntersectNode(const Rove::MeshBvhNode& node, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& inverse_direction, float max_distance)
+	{
+		float tx1 = (node.min[0] - origin.x) * inverse_direction.x;
+		float tx2 = (node.max[0] - origin.x) * inverse_direction.x;
+		float tmin = std::min(tx1, tx2);
+		float tmax = std::max(tx1, tx2);
+
+		float ty1 = (node.min[1] - origin.y) * inverse_direction.y;
+		float ty2 = (node.max[1] - origin.y) * inverse_direction.y;
+		tmin = std::max(tmin, std::min(ty1, ty2));
+		tmax = std::min(tmax, std::max(ty1, ty2));
+
+		float tz1 = (node.min[2] - origin.z) * inverse_direction.z;
+		float tz2 = (node.max[2] - origin.z) * inverse_direction.z;
+		tmin = std::max(tmin, std::min(tz1, tz2));
+		tmax = std::min(tmax, std::max(tz1, tz2));
+
+		if (tmax >= std::max(tmin, 0.0f) && tmin < max_distance)
+		{
+			return tmin;
+		}
+
+		return FLT_MAX;
+	}
+}
+
+void Rove::MeshBvh::Build(const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<uint32_t>& indices)
+{
+	const uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+
+	m_Nodes.clear();
+	m_Triangles.clear();
+	m_NodeCount = 0;
+
+	if (triangle_count == 0)
+	{
+		return;
+	}
+
+	// Triangle bounds and centroids
+	std::vector<BuildTriangle> build(triangle_count);
+	for (uint32_t i = 0; i < triangle_count; ++i)
+	{
+		const DirectX::XMFLOAT3& a = positions[indices[i * 3 + 0]];
+		const DirectX::XMFLOAT3& b = positions[indices[i * 3 + 1]];
+		const DirectX::XMFLOAT3& c = positions[indices[i * 3 + 2]];
+
+		build[i].min = DirectX::XMFLOAT3(std::min({ a.x, b.x, c.x }), std::min({ a.y, b.y, c.y }), std::min({ a.z, b.z, c.z }));
+		build[i].max = DirectX::XMFLOAT3(std::max({ a.x, b.x, c.x }), std::max({ a.y, b.y, c.y }), std::max({ a.z, b.z, c.z }));
+		build[i].centroid = DirectX::XMFLOAT3((a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f);
+		build[i].index = i;
+	}
+
+	// A binary tree over N leaves never needs more than 2N - 1 nodes, nodes are handed out in sibling pairs
+	m_Nodes.resize(static_cast<size_t>(triangle_count) * 2);
+	std::atomic<uint32_t> next_node = 2;
+
+	MeshBvhNode& root = m_Nodes[0];
+	root.left_first = 0;
+	root.count = triangle_count;
+	UpdateBounds(0, build);
+	Subdivide(0, build, next_node, 0);
+
+	m_NodeCount = next_node.load();
+	m_Nodes.resize(m_NodeCount);
+	m_Nodes.shrink_to_fit();
+
+	// Store the triangles in leaf order so each leaf reads a contiguous range
+	m_Triangles.resize(triangle_count);
+	for (uint32_t i = 0; i < triangle_count; ++i)
+	{
+		uint32_t triangle = build[i].index;
+		const DirectX::XMFLOAT3& a = positions[indices[triangle * 3 + 0]];
+		const DirectX::XMFLOAT3& b = positions[indices[triangle * 3 + 1]];
+		const DirectX::XMFLOAT3& c = positions[indices[triangle * 3 + 2]];
+
+		m_Triangles[i].v0 = a;
+		m_Triangles[i].edge1 = DirectX::XMFLOAT3(b.x - a.x, b.y - a.y, b.z - a.z);
+		m_Triangles[i].edge2 = DirectX::XMFLOAT3(c.x - a.x, c.y - a.y, c.z - a.z);
+		m_Triangles[i].index = triangle;
+	}
+}
+
+bool Rove::MeshBvh::Intersect(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float max_distance, MeshHit& hit) const
+{
+	if (m_NodeCount == 0)
+	{
+		return false;
+	}
+
+	DirectX::XMFLOAT3 inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	if (IntersectNode(m_Nodes[0], origin, inverse_direction, max_distance) == FLT_MAX)
+	{
+		return false;
+	}
+
+	bool found = false;
+
+	// Tree depth is bounded by the 64 entry stack as leaves are never deeper than log2 of the triangle count plus the
+	// splits the heuristic decides to make
+	uint32_t stack[64];
+	int stack_size = 0;
+	uint32_t node_index = 0;
+
+	while (true)
+	{
+		const MeshBvhNode& node = m_Nodes[node_index];
+
+		if (node.IsLeaf())
+		{
+			for (uint32_t i = node.left_first; i < node.left_first + node.count; ++i)
+			{
+				// Moller-Trumbore ray triangle intersection
+				const Triangle& triangle = m_Triangles[i];
+
+				DirectX::XMFLOAT3 p(
+					direction.y * triangle.edge2.z - direction.z * triangle.edge2.y,
+					direction.z * triangle.edge2.x - direction.x * triangle.edge2.z,
+					direction.x * triangle.edge2.y - direction.y * triangle.edge2.x);
+
+				float determinant = triangle.edge1.x * p.x + triangle.edge1.y * p.y + triangle.edge1.z * p.z;
+				if (std::abs(determinant) < 1e-12f)
+				{
+					continue;
+				}
+
+				float inverse_determinant = 1.0f / determinant;
+				DirectX::XMFLOAT3 s(origin.x - triangle.v0.x, origin.y - triangle.v0.y, origin.z - triangle.v0.z);
+
+				float u = (s.x * p.x + s.y * p.y + s.z * p.z) * inverse_determinant;
+				if (u < 0.0f || u > 1.0f)
+				{
+					continue;
+				}
+
+				DirectX::XMFLOAT3 q(
+					s.y * triangle.edge1.z - s.z * triangle.edge1.y,
+					s.z * triangle.edge1.x - s.x * triangle.edge1.z,
+					s.x * triangle.edge1.y - s.y * triangle.edge1.x);
+
+				float v = (direction.x * q.x + direction.y * q.y + direction.z * q.z) * inverse_determinant;
+				if (v < 0.0f || u + v > 1.0f)
+				{
+					continue;
+				}
+
+				float t = (triangle.edge2.x * q.x + triangle.edge2.y * q.y + triangle.edge2.z * q.z) * inverse_determinant;
+				if (t > 0.0f && t < max_distance)
+				{
+					max_distance = t;
+					hit.triangle = triangle.index;
+					hit.distance = t;
+					hit.barycentric_u = 1.0f - u - v;
+					hit.barycentric_v = u;
+					hit.barycentric_w = v;
+					found = true;
+				}
+			}
+
+			if (stack_size == 0)
+			{
+				break;
+			}
+
+			node_index = stack[--stack_size];
+			continue;
+		}
+
+		// Visit the nearest child first and defer the other
+		uint32_t child1 = node.left_first;
+		uint32_t child2 = node.left_first + 1;
+		float distance1 = IntersectNode(m_Nodes[child1], origin, inverse_direction, max_distance);
+		float distance2 = IntersectNode(m_Nodes[child2], origin, inverse_direction, max_distance);
+
+		if (distance1 > distance2)
+		{
+			std::swap(distance1, distance2);
+			std::swap(child1, child2);
+		}
+
+		if (distance1 == FLT_MAX)
+		{
+			if (stack_size == 0)
+			{
+				break;
+			}
+
+			node_index = stack[--stack_size];
+		}
+		else
+		{
+			node_index = child1;
+			if (distance2 != FLT_MAX && stack_size < 64)
+			{
+				stack[stack_size++] = child2;
+			}
+		}
+	}
+
+	return found;
+}
+
+void Rove::MeshBvh::Subdivide(uint32_t node_index, std::vector<BuildTriangle>& build, std::atomic<uint32_t>& next_node, int depth)
+{
+	MeshBvhNode& node = m_Nodes[node_index];
+	const uint32_t first = node.left_first;
+	const uint32_t count = node.count;
+
+	if (count <= 2 || depth >= 60)
+	{
+		return;
+	}
+
+	// Bounds of the centroids decide the bin ranges
+	DirectX::XMFLOAT3 centroid_min(FLT_MAX, FLT_MAX, FLT_MAX);
+	DirectX::XMFLOAT3 centroid_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		const DirectX::XMFLOAT3& c = build[i].centroid;
+		centroid_min = DirectX::XMFLOAT3(std::min(centroid_min.x, c.x), std::min(centroid_min.y, c.y), std::min(centroid_min.z, c.z));
+		centroid_max = DirectX::XMFLOAT3(std::max(centroid_max.x, c.x), std::max(centroid_max.y, c.y), std::max(centroid_max.z, c.z));
+	}
+
+	// Evaluate the split planes between the bins on every axis
+	int best_axis = -1;
+	int best_split = 0;
+	float best_cost = FLT_MAX;
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float axis_min = GetAxis(centroid_min, axis);
+		float axis_max = GetAxis(centroid_max, axis);
+		if (axis_max <= axis_min)
+		{
+			continue;
+		}
+
+		Bin bins[BIN_COUNT];
+		float scale = BIN_COUNT / (axis_max - axis_min);
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			const BuildTriangle& triangle = build[i];
+			int bin = std::min(BIN_COUNT - 1, static_cast<int>((GetAxis(triangle.centroid, axis) - axis_min) * scale));
+			bins[bin].count++;
+			bins[bin].Grow(triangle.min, triangle.max);
+		}
+
+		// Sweep from both sides to get the area and count to the left and right of each plane
+		float left_area[BIN_COUNT - 1], right_area[BIN_COUNT - 1];
+		uint32_t left_count[BIN_COUNT - 1], right_count[BIN_COUNT - 1];
+
+		Bin left_box, right_box;
+		for (int i = 0; i < BIN_COUNT - 1; ++i)
+		{
+			left_box.count += bins[i].count;
+			if (bins[i].count > 0)
+			{
+				left_box.Grow(bins[i].min, bins[i].max);
+			}
+
+			left_count[i] = left_box.count;
+			left_area[i] = left_box.Area();
+
+			const Bin& right_bin = bins[BIN_COUNT - 1 - i];
+			right_box.count += right_bin.count;
+			if (right_bin.count > 0)
+			{
+				right_box.Grow(right_bin.min, right_bin.max);
+			}
+
+			right_count[BIN_COUNT - 2 - i] = right_box.count;
+			right_area[BIN_COUNT - 2 - i] = right_box.Area();
+		}
+
+		for (int i = 0; i < BIN_COUNT - 1; ++i)
+		{
+			float cost = left_count[i] * left_area[i] + right_count[i] * right_area[i];
+			if (left_count[i] > 0 && right_count[i] > 0 && cost < best_cost)
+			{
+				best_cost = cost;
+				best_axis = axis;
+				best_split = i;
+			}
+		}
+	}
+
+	// Keep as a leaf if splitting is not cheaper than intersecting every triangle
+	float x = node.max[0] - node.min[0];
+	float y = node.max[1] - node.min[1];
+	float z = node.max[2] - node.min[2];
+	float leaf_cost = count * (x * y + y * z + z * x);
+	if (best_axis == -1 || best_cost >= leaf_cost)
+	{
+		return;
+	}
+
+	// Partition the build triangles in place
+	float axis_min = GetAxis(centroid_min, best_axis);
+	float scale = BIN_COUNT / (GetAxis(centroid_max, best_axis) - axis_min);
+
+	uint32_t i = first;
+	uint32_t j = first + count - 1;
+	while (i <= j)
+	{
+		int bin = std::min(BIN_COUNT - 1, static_cast<int>((GetAxis(build[i].centroid, best_axis) - axis_min) * scale));
+		if (bin <= best_split)
+		{
+			++i;
+		}
+		else
+		{
+			std::swap(build[i], build[j]);
+			if (j == 0)
+			{
+				break;
+			}
+
+			--j;
+		}
+	}
+
+	uint32_t left_count = i - first;
+	if (left_count == 0 || left_count == count)
+	{
+		return;
+	}
+
+	// Sibling nodes are allocated together so the right child is always left + 1
+	uint32_t left_child = next_node.fetch_add(2);
+	uint32_t right_child = left_child + 1;
+
+	m_Nodes[left_child].left_first = first;
+	m_Nodes[left_child].count = left_count;
+	m_Nodes[right_child].left_first = i;
+	m_Nodes[right_child].count = count - left_count;
+
+	node.left_first = left_child;
+	node.count = 0;
+
+	UpdateBounds(left_child, build);
+	UpdateBounds(right_child, build);
+
+	// Both children touch disjoint ranges of the build triangles and disjoint nodes so the larger ones can be built in parallel
+	if (left_count > PARALLEL_THRESHOLD && count - left_count > PARALLEL_THRESHOLD)
+	{
+		auto left_task = std::async(std::launch::async, [&]() { Subdivide(left_child, build, next_node, depth + 1); });
+		Subdivide(right_child, build, next_node, depth + 1);
+		left_task.wait();
+	}
+	else
+	{
+		Subdivide(left_child, build, next_node, depth + 1);
+		Subdivide(right_child, build, next_node, depth + 1);
+	}
+}
+
+void Rove::MeshBvh::UpdateBounds(uint32_t node_index, const std::vector<BuildTriangle>& build)
+{
+	MeshBvhNode& node = m_Nodes[node_index];
+	node.min[0] = node.min[1] = node.min[2] = FLT_MAX;
+	node.max[0] = node.max[1] = node.max[2] = -FLT_MAX;
+
+	for (uint32_t i = node.left_first; i < node.left_first + node.count; ++i)
+	{
+		const BuildTriangle& triangle = build[i];
+		node.min[0] = std::min(node.min[0], triangle.min.x);
+		node.min[1] = std::min(node.min[1], triangle.min.y);
+		node.min[2] = std::min(node.min[2], triangle.min.z);
+		node.max[0] = std::max(node.max[0], triangle.max.x);
+		node.max[1] = std::max(node.max[1], triangle.max.y);
+		node.max[2] = std::max(node.max[2], triangle.max.z);
+	}
+}
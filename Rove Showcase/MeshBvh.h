@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Pch.h"
+
+namespace Rove
+{
+	// Compact 32 byte node, interior nodes store the index of their left child (the right child follows it) and a count
+	// of 0, leaves store the first triangle and the triangle count
+	struct MeshBvhNode
+	{
+		float min[3];
+		uint32_t left_first;
+		float max[3];
+		uint32_t count;
+
+		bool IsLeaf() const { return count > 0; }
+	};
+
+	static_assert(sizeof(MeshBvhNode) == 32, "MeshBvhNode must be 32 bytes");
+
+	// Closest ray hit against a mesh
+	struct MeshHit
+	{
+		// Index of the triangle in the mesh index buffer, divided by 3
+		uint32_t triangle = 0;
+
+		// Ray parameter of the hit
+		float distance = 0.0f;
+
+		// Barycentric weights of the three triangle vertices
+		float barycentric_u = 0.0f;
+		float barycentric_v = 0.0f;
+		float barycentric_w = 0.0f;
+	};
+
+	// Triangle bounding volume hierarchy built with a binned surface area heuristic
+	class MeshBvh
+	{
+	public:
+		MeshBvh() = default;
+		virtual ~MeshBvh() = default;
+
+		// Builds the hierarchy, large subtrees are built on worker threads
+		void Build(const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<uint32_t>& indices);
+
+		// Finds the closest triangle hit along a ray up to the maximum distance
+		bool Intersect(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float max_distance, MeshHit& hit) const;
+
+		// Number of nodes
+		size_t GetNodeCount() const { return m_NodeCount; }
+
+		// Number of triangles
+		size_t GetTriangleCount() const { return m_Triangles.size(); }
+
+		// Bytes held by the nodes and triangles
+		size_t GetMemoryBytes() const { return m_Nodes.capacity() * sizeof(MeshBvhNode) + m_Triangles.capacity() * sizeof(Triangle); }
+
+	private:
+		// Triangle stored as a vertex and two edges for the intersection test, in leaf order
+		struct Triangle
+		{
+			DirectX::XMFLOAT3 v0;
+			DirectX::XMFLOAT3 edge1;
+			DirectX::XMFLOAT3 edge2;
+			uint32_t index;
+		};
+
+		// Per triangle data only needed while building, partitioned in place so each node reads a contiguous range
+		struct BuildTriangle
+		{
+			DirectX::XMFLOAT3 min;
+			DirectX::XMFLOAT3 max;
+			DirectX::XMFLOAT3 centroid;
+			uint32_t index;
+		};
+
+		std::vector<MeshBvhNode> m_Nodes;
+		std::vector<Triangle> m_Triangles;
+		size_t m_NodeCount = 0;
+
+		// Splits a node, returns after the whole subtree has been built
+		void Subdivide(uint32_t node_index, std::vector<BuildTriangle>& build, std::atomic<uint32_t>& next_node, int depth);
+
+		// Recalculates the bounds of a node from its triangles
+		void UpdateBounds(uint32_t node_index, const std::vector<BuildTriangle>& build);
+	};
+}
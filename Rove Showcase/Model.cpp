@@ -5,7 +5,7 @@
 #include "Application.h"
 #include "GltfLoader.h"
 
-Rove::Object::Object(DxRenderer* renderer, DxShader* shader) : m_DxRenderer(renderer), m_DxShader(shader)
+Rove::Object::Object(DxRenderer* renderer, DxShader* shader, MaterialTable* material_table, GeometryPool* geometry_pool, JobSystem* job_system) : m_DxRenderer(renderer), m_DxShader(shader), m_MaterialTable(material_table), m_GeometryPool(geometry_pool), m_JobSystem(job_system)
 {
 }
 
@@ -15,112 +15,199 @@ void Rove::Object::LoadFile(const std::filesystem::path& path)
 	m_Models.clear();
 
 	// Load new data
-	GltfLoader loader(m_DxRenderer, m_DxShader);
+	GltfLoader loader(m_DxRenderer, m_DxShader, m_MaterialTable, m_GeometryPool, m_JobSystem);
 	m_Models = loader.Load(path);
 
 	// Set filename
 	Filename = path.filename().string();
+
+	// World constants and bounds need rebuilding for the new models
+	m_WorldBuffers.clear();
+	m_WorldBounds.Clear();
+	m_InstanceWorldBuffers.clear();
+	m_InstanceBounds.clear();
+	m_TransformDirty = true;
+}
+
+DirectX::XMMATRIX Rove::Object::GetTransform()
+{
+	DirectX::XMMATRIX transform = DirectX::XMMatrixScaling(Scale.x, Scale.y, Scale.z);
+	transform *= DirectX::XMMatrixRotationRollPitchYaw(Rotation.x, Rotation.y, Rotation.z);
+	transform *= DirectX::XMMatrixTranslation(Position.x, Position.y, Position.z);
+	return transform;
+}
+
+bool Rove::Object::IsTransformDirty() const
+{
+	auto equal = [](const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	};
+
+	return m_TransformDirty || !equal(m_WorldPosition, Position) || !equal(m_WorldRotation, Rotation) || !equal(m_WorldScale, Scale);
 }
 
-void Rove::Object::Render()
+void Rove::Object::GetWorlds(std::vector<DirectX::XMMATRIX>& worlds)
 {
+	DirectX::XMMATRIX transform = GetTransform();
+	for (auto& model : m_Models)
+	{
+		worlds.push_back(model->World * transform);
+	}
+
+	// Instances follow the models so they are inverted in the same batch
 	for (auto& model : m_Models)
 	{
-		model->Render(Position, Rotation, Scale);
+		DirectX::XMMATRIX node = model->World * transform;
+		for (const DirectX::XMMATRIX& instance : model->Instances)
+		{
+			worlds.push_back(instance * node);
+		}
 	}
 }
 
-std::vector<Rove::Material*> Rove::Object::GetMaterials()
+size_t Rove::Object::SetWorlds(const DirectX::XMMATRIX* worlds, const WorldBuffer* world_buffers)
 {
-	std::vector<Material*> materials;
-	for (auto& model : m_Models)
+	m_WorldBuffers.assign(world_buffers, world_buffers + m_Models.size());
+	m_InstanceWorldBuffers.resize(m_Models.size());
+	m_InstanceBounds.resize(m_Models.size());
+
+	m_WorldBounds.Clear();
+	m_WorldBounds.Reserve(m_Models.size());
+
+	size_t next = m_Models.size();
+	for (size_t i = 0; i < m_Models.size(); ++i)
 	{
-		materials.push_back(&model->Material);
+		const Model* model = m_Models[i].get();
+		size_t instance_count = model->Instances.size();
+
+		m_InstanceWorldBuffers[i].assign(world_buffers + next, world_buffers + next + instance_count);
+
+		BoundsSoA& instance_bounds = m_InstanceBounds[i];
+		instance_bounds.Clear();
+		instance_bounds.Reserve(instance_count);
+
+		DirectX::BoundingBox world_bounds;
+		for (size_t j = 0; j < instance_count; ++j)
+		{
+			DirectX::BoundingBox bounds;
+			model->Geometry->Bounds.Transform(bounds, worlds[next + j]);
+			instance_bounds.Add(bounds);
+
+			if (j == 0)
+			{
+				world_bounds = bounds;
+			}
+			else
+			{
+				DirectX::BoundingBox::CreateMerged(world_bounds, world_bounds, bounds);
+			}
+		}
+
+		if (instance_count == 0)
+		{
+			model->Geometry->Bounds.Transform(world_bounds, worlds[i]);
+		}
+
+		m_WorldBounds.Add(world_bounds);
+		next += instance_count;
 	}
 
-	return materials;
+	m_WorldPosition = Position;
+	m_WorldRotation = Rotation;
+	m_WorldScale = Scale;
+	m_TransformDirty = false;
+
+	return next;
 }
 
-Rove::Model::Model(DxRenderer* renderer, DxShader* shader) : m_DxRenderer(renderer), m_DxShader(shader)
+DirectX::XMMATRIX Rove::Object::GetWorld(size_t model) const
 {
+	return DirectX::XMMatrixTranspose(m_WorldBuffers[model].world);
 }
 
-void Rove::Model::Render(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& rotation, const DirectX::XMFLOAT3& scale)
+std::vector<uint32_t> Rove::Object::GetMaterials()
 {
-	auto d3dDeviceContext = m_DxRenderer->GetDeviceContext();
-
-	// We need the stride and offset for the vertex
-	UINT vertex_stride = sizeof(Vertex);
-	UINT vertex_offset = 0u;
-
-	// Bind the vertex buffer to the pipeline's Input Assembler stage
-	d3dDeviceContext->IASetVertexBuffers(0, 1, m_VertexBuffer.GetAddressOf(), &vertex_stride, &vertex_offset);
-
-	// Bind the index buffer to the pipeline's Input Assembler stage
-	d3dDeviceContext->IASetIndexBuffer(m_IndexBuffer.Get(), m_IndexBufferFormat, 0);
-
-	// Bind the geometry topology to the pipeline's Input Assembler stage
-	d3dDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-	// Bind texture to the pixel shader
-	m_DxRenderer->GetDeviceContext()->PSSetShaderResources(0, 1, m_DiffuseTexture.GetAddressOf());
-	m_DxRenderer->GetDeviceContext()->PSSetShaderResources(1, 1, m_NormalTexture.GetAddressOf());
-
-	// Apply local transformations
-	DirectX::XMMATRIX world = World;
-	world *= DirectX::XMMatrixScaling(scale.x, scale.y, scale.z);
-	world *= DirectX::XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
-	world *= DirectX::XMMatrixTranslation(position.x, position.y, position.z);
-
-	Rove::WorldBuffer world_buffer = {};
-	world_buffer.world = DirectX::XMMatrixTranspose(world);
-	world_buffer.worldInverse = DirectX::XMMatrixInverse(nullptr, world);
-	m_DxShader->UpdateWorldConstantBuffer(world_buffer);
-
-	// Apply materials
-	Rove::MaterialBuffer material_buffer = {};
-	material_buffer.diffuse_texture = static_cast<int>(Material.diffuse_texture);
-	material_buffer.normal_texture = static_cast<int>(Material.normal_texture);
-	material_buffer.metallicFactor = Material.metallicFactor;
-	material_buffer.roughnessFactor = Material.roughnessFactor;
-	m_DxShader->UpdateMaterialBuffer(material_buffer);
-
-	// Render geometry
-	d3dDeviceContext->DrawIndexed(m_IndexCount, 0, 0);
+	std::vector<uint32_t> materials;
+	for (auto& model : m_Models)
+	{
+		materials.push_back(model->MaterialIndex);
+	}
+
+	// Models share materials so each index is listed once
+	std::sort(materials.begin(), materials.end());
+	materials.erase(std::unique(materials.begin(), materials.end()), materials.end());
+	return materials;
 }
 
-void Rove::Model::CreateVertexBuffer(const std::vector<Vertex>& vertices)
+Rove::Model::Model(DxRenderer* renderer, DxShader* shader, MaterialTable* material_table) : m_DxRenderer(renderer), m_DxShader(shader), m_MaterialTable(material_table)
 {
-	auto d3dDevice = m_DxRenderer->GetDevice();
+}
 
-	// Create vertex buffer
-	D3D11_BUFFER_DESC vertex_buffer_desc = {};
-	vertex_buffer_desc.Usage = D3D11_USAGE_DEFAULT;
-	vertex_buffer_desc.ByteWidth = static_cast<UINT>(sizeof(Vertex) * vertices.size());
-	vertex_buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+int Rove::Model::CountStateChanges(const Model* previous, const Model* next)
+{
+	if (previous == nullptr)
+	{
+		return 6;
+	}
 
-	D3D11_SUBRESOURCE_DATA vertex_subdata = {};
-	vertex_subdata.pSysMem = vertices.data();
+	const MeshGeometry* a = previous->Geometry.get();
+	const MeshGeometry* b = next->Geometry.get();
 
-	DX::Check(d3dDevice->CreateBuffer(&vertex_buffer_desc, &vertex_subdata, m_VertexBuffer.ReleaseAndGetAddressOf()));
+	int state_changes = 0;
+	state_changes += a->VertexBuffer.Get() != b->VertexBuffer.Get() ? 1 : 0;
+	state_changes += a->IndexBuffer.Get() != b->IndexBuffer.Get() || a->IndexBufferFormat != b->IndexBufferFormat ? 1 : 0;
+	state_changes += previous->MaterialIndex != next->MaterialIndex ? 3 : 0;
+	return state_changes;
 }
 
-void Rove::Model::CreateIndexBuffer(void* indices, UINT count, int64_t size, DXGI_FORMAT format)
+uint64_t Rove::Model::EstimateGpuBytes() const
 {
-	// Set number of vertices
-	m_IndexCount = count;
+	uint64_t bytes = Geometry != nullptr ? Geometry->GetGpuBytes() : 0;
+	if (m_MaterialTable != nullptr && MaterialIndex < m_MaterialTable->Size())
+	{
+		bytes += m_MaterialTable->GetGpuBytes(MaterialIndex);
+	}
 
-	// Set data type format
-	m_IndexBufferFormat = format;
+	return bytes;
+}
 
-	// Create index buffer
-	D3D11_BUFFER_DESC index_buffer_desc = {};
-	index_buffer_desc.Usage = D3D11_USAGE_IMMUTABLE;
-	index_buffer_desc.ByteWidth = static_cast<UINT>(size * count);
-	index_buffer_desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+Rove::MeshGeometry::~MeshGeometry()
+{
+	if (Pool != nullptr)
+	{
+		Pool->Remove(*this);
+	}
 
-	D3D11_SUBRESOURCE_DATA index_subdata = {};
-	index_subdata.pSysMem = indices;
+	// Geometry that was never counted, or counted as empty, holds no allocation
+	if (CpuBytes > 0)
+	{
+		MemoryTracker::Freed(MemoryTag::Geometry, CpuBytes);
+	}
+}
 
-	DX::Check(m_DxRenderer->GetDevice()->CreateBuffer(&index_buffer_desc, &index_subdata, m_IndexBuffer.ReleaseAndGetAddressOf()));
+void Rove::MeshGeometry::CountCpuBytes()
+{
+	// The CPU copies of a geometry count as one allocation, counting them again only changes its size
+	size_t bytes = Positions.capacity() * sizeof(DirectX::XMFLOAT3) + Indices.capacity() * sizeof(uint32_t) + Vertices.capacity() * sizeof(Vertex) + Bvh.GetMemoryBytes();
+	if (CpuBytes == 0 && bytes > 0)
+	{
+		MemoryTracker::Allocated(MemoryTag::Geometry, bytes);
+	}
+	else if (CpuBytes > 0 && bytes == 0)
+	{
+		MemoryTracker::Freed(MemoryTag::Geometry, CpuBytes);
+	}
+	else if (CpuBytes > 0)
+	{
+		MemoryTracker::Resized(MemoryTag::Geometry, CpuBytes, bytes);
+	}
+
+	CpuBytes = bytes;
+}
+
+uint64_t Rove::MeshGeometry::GetGpuBytes() const
+{
+	uint64_t index_size = IndexBufferFormat == DXGI_FORMAT_R16_UINT ? sizeof(USHORT) : sizeof(UINT);
+	return static_cast<uint64_t>(VertexCount) * sizeof(Vertex) + IndexCount * index_size;
 }
@@ -1,12 +1,19 @@
 #pragma once
 
 #include "Pch.h"
+#include "Frustum.h"
+#include "MeshBvh.h"
+#include "MaterialTable.h"
+#include "DxShader.h"
+#include "GeometryPool.h"
+#include "MemoryTracker.h"
 
 namespace Rove
 {
 	// Forward declarations
 	class DxRenderer;
 	class DxShader;
+	class JobSystem;
 
 	struct Colour
 	{
@@ -38,13 +45,68 @@ namespace Rove
 		float tangent_z = 0;
 	};
 
-	// Material
-	struct Material
+	// Vertex and index data of a mesh, shared by every model that draws the same geometry
+	struct MeshGeometry
 	{
-		bool diffuse_texture = false;
-		bool normal_texture = false;
-		float metallicFactor = 0.0f;
-		float roughnessFactor = 0.5f;
+		// Returns the ranges to the geometry pool and the counted CPU memory to the geometry tag
+		~MeshGeometry();
+
+		// Local space bounding box of the vertices
+		DirectX::BoundingBox Bounds;
+
+		// Local space positions and triangle indices kept on the CPU for ray queries
+		std::vector<DirectX::XMFLOAT3> Positions;
+		std::vector<uint32_t> Indices;
+
+		// Triangle hierarchy over the positions
+		MeshBvh Bvh;
+
+		// Local space vertices kept on the CPU for static batching
+		std::vector<Vertex> Vertices;
+
+		// Counts the positions, indices, vertices and triangle hierarchy under the geometry tag once they are filled in.
+		// The vectors are shared with the ray, occlusion and batching code as plain vectors so they are counted here
+		// rather than through an allocator.
+		void CountCpuBytes();
+		size_t CpuBytes = 0;
+
+		// Bytes of the ranges in the pool buffers
+		uint64_t GetGpuBytes() const;
+
+		// Hash of the vertex and index data used to find identical meshes
+		uint64_t Hash = 0;
+
+		// Number of vertices and indices to draw
+		UINT VertexCount = 0;
+		UINT IndexCount = 0;
+
+		// Ranges in the geometry pool, the buffers are shared with the other geometry in them
+		GeometryPool* Pool = nullptr;
+		uint32_t VertexBlock = 0;
+		uint32_t IndexBlock = 0;
+		INT BaseVertexLocation = 0;
+		UINT StartIndexLocation = 0;
+
+		// Pool buffers holding the ranges, left empty when loading headless
+		ComPtr<ID3D11Buffer> VertexBuffer = nullptr;
+		ComPtr<ID3D11Buffer> IndexBuffer = nullptr;
+		DXGI_FORMAT IndexBufferFormat = DXGI_FORMAT_UNKNOWN;
+	};
+
+	// Submission cost of a model in the last frame it was rendered, a draw shared by an instanced batch is split evenly
+	// between its models
+	struct ModelStats
+	{
+		// Scene frame the stats were taken in, models not rendered in the current frame were culled
+		uint64_t frame = 0;
+
+		int draws = 0;
+		int64_t triangles = 0;
+		int64_t vertices = 0;
+		float state_changes = 0.0f;
+
+		// CPU time binding and issuing the draw
+		double submit_microseconds = 0.0;
 	};
 
 	// Rendering Model
@@ -52,39 +114,40 @@ namespace Rove
 	{
 		DxRenderer* m_DxRenderer = nullptr;
 		DxShader* m_DxShader = nullptr;
+		MaterialTable* m_MaterialTable = nullptr;
 
 	public: 
-		Model(DxRenderer* renderer, DxShader* shader);
+		Model(DxRenderer* renderer, DxShader* shader, MaterialTable* material_table);
 		virtual ~Model() = default;
 
-		void Render(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& rotation, const DirectX::XMFLOAT3& scale);
+		// Number of state changes needed to render the next model after the previous one
+		static int CountStateChanges(const Model* previous, const Model* next);
 
-		// World transformation
-		DirectX::XMMATRIX World = DirectX::XMMatrixIdentity();
+		// Id used by the render queue to group models sharing geometry, assigned by the scene
+		uint32_t GeometryId = 0;
 
-		// Model name
-		std::string Name;
+		// World transformation, call Object::MarkTransformDirty after editing it
+		DirectX::XMMATRIX World = DirectX::XMMatrixIdentity();
 
-		// Material
-		Material Material;
+		// Geometry, models created from the same mesh or from meshes with identical data share it
+		std::shared_ptr<MeshGeometry> Geometry;
 
-		// Number of indices to draw
-		UINT m_IndexCount = 0;
+		// Transformations of the EXT_mesh_gpu_instancing instances, each applied before the node transformation. Empty
+		// when the model is drawn once.
+		std::vector<DirectX::XMMATRIX> Instances;
 
-		// Vertex buffer
-		ComPtr<ID3D11Buffer> m_VertexBuffer = nullptr;
-		void CreateVertexBuffer(const std::vector<Vertex>& vertices);
+		// Model name
+		std::string Name;
 
-		// Index buffer
-		ComPtr<ID3D11Buffer> m_IndexBuffer = nullptr;
-		void CreateIndexBuffer(void* indices, UINT count, int64_t size, DXGI_FORMAT format);
+		// Index of the material in the material table
+		uint32_t MaterialIndex = 0;
 
-		// Texture
-		ComPtr<ID3D11ShaderResourceView> m_DiffuseTexture = nullptr;
-		ComPtr<ID3D11ShaderResourceView> m_NormalTexture = nullptr;
+		// Submission cost, filled in by the scene while rendering
+		ModelStats Stats;
 
-	private:
-		DXGI_FORMAT m_IndexBufferFormat;
+		// Estimated GPU memory of the geometry and material from the buffer and texture descriptors, both may be shared
+		// with other models
+		uint64_t EstimateGpuBytes() const;
 	};
 
 	// Object
@@ -92,24 +155,25 @@ namespace Rove
 	{
 		DxRenderer* m_DxRenderer = nullptr;
 		DxShader* m_DxShader = nullptr;
+		MaterialTable* m_MaterialTable = nullptr;
+		GeometryPool* m_GeometryPool = nullptr;
+		JobSystem* m_JobSystem = nullptr;
 
 	public:
-		Object(DxRenderer* renderer, DxShader* shader);
+		// Without a renderer only the CPU side data is loaded, which is enough for headless tests
+		Object(DxRenderer* renderer, DxShader* shader, MaterialTable* material_table, GeometryPool* geometry_pool, JobSystem* job_system);
 		virtual ~Object() = default;
 
 		// Loads a GLTF file
 		void LoadFile(const std::filesystem::path& path);
 
-		// Renders the object
-		void Render();
-
 		// World 
 		DirectX::XMFLOAT3 Position;
 		DirectX::XMFLOAT3 Rotation;
 		DirectX::XMFLOAT3 Scale = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
 
-		// Materials
-		std::vector<Material*> GetMaterials();
+		// Distinct material table indices used by the models
+		std::vector<uint32_t> GetMaterials();
 
 		// Models
 		const std::vector<std::unique_ptr<Model>>& GetModels() { return m_Models; }
@@ -117,9 +181,48 @@ namespace Rove
 		// Object name
 		std::string Filename;
 
+		// Object transformation built from position, rotation and scale
+		DirectX::XMMATRIX GetTransform();
+
+		// True if the position, rotation or scale changed since the world constants were last computed
+		bool IsTransformDirty() const;
+
+		// Forces the world constants to be recomputed, needed after a model node transformation is edited
+		void MarkTransformDirty() { m_TransformDirty = true; }
+
+		// Appends the world matrix of every model built from its node and the object transformation, followed by the
+		// world matrix of every instance of the instanced models
+		void GetWorlds(std::vector<DirectX::XMMATRIX>& worlds);
+
+		// Stores the world constants computed for every model and instance and rebuilds the world space bounds, returns
+		// the number of worlds used
+		size_t SetWorlds(const DirectX::XMMATRIX* worlds, const WorldBuffer* world_buffers);
+
+		// World constants of each model, contiguous and only recomputed when the object or a node moves
+		const std::vector<WorldBuffer>& GetWorldBuffers() { return m_WorldBuffers; }
+
+		// World matrix of a model
+		DirectX::XMMATRIX GetWorld(size_t model) const;
+
+		// World space bounds of each model, an instanced model is bounded by all of its instances
+		const BoundsSoA& GetWorldBounds() { return m_WorldBounds; }
+
+		// World constants and world space bounds of the instances of a model
+		const std::vector<WorldBuffer>& GetInstanceWorldBuffers(size_t model) { return m_InstanceWorldBuffers[model]; }
+		const BoundsSoA& GetInstanceBounds(size_t model) { return m_InstanceBounds[model]; }
 
 	private:
 		// Models
 		std::vector<std::unique_ptr<Model>> m_Models;
+
+		// Cached world constants and bounds of each model with the transformation they were built from
+		std::vector<WorldBuffer> m_WorldBuffers;
+		BoundsSoA m_WorldBounds;
+		std::vector<std::vector<WorldBuffer>> m_InstanceWorldBuffers;
+		std::vector<BoundsSoA> m_InstanceBounds;
+		DirectX::XMFLOAT3 m_WorldPosition;
+		DirectX::XMFLOAT3 m_WorldRotation;
+		DirectX::XMFLOAT3 m_WorldScale;
+		bool m_TransformDirty = true;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "Pch.h"
+#include "ObjectLights.h"
+
+void Rove::ObjectLights::Begin(const DirectX::XMFLOAT4* lights, size_t count)
+{
+	m_LightCount = count;
+
+	// The padding lights have a negative range so no box ever reaches them
+	size_t padded = (count + 3) & ~static_cast<size_t>(3);
+	m_X.assign(padded, 0.0f);
+	m_Y.assign(padded, 0.0f);
+	m_Z.assign(padded, 0.0f);
+	m_RadiusSquared.assign(padded, -1.0f);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_X[i] = lights[i].x;
+		m_Y[i] = lights[i].y;
+		m_Z[i] = lights[i].z;
+		m_RadiusSquared[i] = lights[i].w * lights[i].w;
+	}
+}
+
+uint32_t Rove::ObjectLights::Assign(const DirectX::BoundingBox& box, ObjectLightList* list) const
+{
+	const __m128 center_x = _mm_set1_ps(box.Center.x);
+	const __m128 center_y = _mm_set1_ps(box.Center.y);
+	const __m128 center_z = _mm_set1_ps(box.Center.z);
+	const __m128 extent_x = _mm_set1_ps(box.Extents.x);
+	const __m128 extent_y = _mm_set1_ps(box.Extents.y);
+	const __m128 extent_z = _mm_set1_ps(box.Extents.z);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+	// Strongest lights so far, kept sorted by falling influence
+	float influences[ObjectLightList::MAX_LIGHTS];
+	uint32_t count = 0;
+	uint32_t reached = 0;
+
+	for (size_t i = 0; i < m_X.size(); i += 4)
+	{
+		// Distance from each light to the nearest point of the box, per axis the part of the offset outside the extent
+		__m128 dx = _mm_max_ps(_mm_sub_ps(_mm_andnot_ps(sign_mask, _mm_sub_ps(_mm_loadu_ps(&m_X[i]), center_x)), extent_x), zero);
+		__m128 dy = _mm_max_ps(_mm_sub_ps(_mm_andnot_ps(sign_mask, _mm_sub_ps(_mm_loadu_ps(&m_Y[i]), center_y)), extent_y), zero);
+		__m128 dz = _mm_max_ps(_mm_sub_ps(_mm_andnot_ps(sign_mask, _mm_sub_ps(_mm_loadu_ps(&m_Z[i]), center_z)), extent_z), zero);
+		__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+		__m128 radius_squared = _mm_loadu_ps(&m_RadiusSquared[i]);
+		int mask = _mm_movemask_ps(_mm_cmplt_ps(distance, radius_squared));
+		if (mask == 0)
+		{
+			continue;
+		}
+
+		alignas(16) float distances[4];
+		_mm_store_ps(distances, distance);
+
+		for (int j = 0; j < 4; ++j)
+		{
+			if (((mask >> j) & 1) == 0)
+			{
+				continue;
+			}
+
+			// Same falloff as the pixel shader at the nearest point of the box
+			uint32_t light = static_cast<uint32_t>(i + j);
+			float ratio = distances[j] / m_RadiusSquared[light];
+			float falloff = 1.0f - ratio * ratio;
+			float influence = falloff * falloff;
+			++reached;
+
+			if (count == ObjectLightList::MAX_LIGHTS && influence <= influences[count - 1])
+			{
+				continue;
+			}
+
+			// Insert in order, dropping the weakest when the list is full
+			uint32_t position = std::min(count, ObjectLightList::MAX_LIGHTS - 1);
+			while (position > 0 && influences[position - 1] < influence)
+			{
+				influences[position] = influences[position - 1];
+				list->lights[position] = list->lights[position - 1];
+				--position;
+			}
+
+			influences[position] = influence;
+			list->lights[position] = light;
+			count = std::min(count + 1, ObjectLightList::MAX_LIGHTS);
+		}
+	}
+
+	list->count = count;
+	return reached;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Pch.h"
+
+namespace Rove
+{
+	// Lights a draw is shaded with, written after the world matrices in its world constants
+	struct ObjectLightList
+	{
+		// Most lights one draw is shaded with
+		static constexpr uint32_t MAX_LIGHTS = 8;
+
+		uint32_t count;
+		uint32_t padding[3];
+		uint32_t lights[MAX_LIGHTS];
+	};
+
+	static_assert(sizeof(ObjectLightList) == 48, "ObjectLightList must match the world constant buffer");
+
+	// Finds the point lights whose range reaches a bounding box. The light spheres are kept as a structure of arrays padded
+	// to a multiple of 4 so each box is tested against 4 lights at a time, and the lights reaching it are ordered by how
+	// much they light the nearest point of the box. Only the strongest are kept when more than the list holds reach it.
+	class ObjectLights
+	{
+	public:
+		ObjectLights() = default;
+		virtual ~ObjectLights() = default;
+
+		// Takes the lights of the frame, each is the world space position in xyz and the radius in w
+		void Begin(const DirectX::XMFLOAT4* lights, size_t count);
+
+		// Fills the list with the lights reaching a world space box, strongest first, and returns how many reached it.
+		// Safe to call from several threads at once.
+		uint32_t Assign(const DirectX::BoundingBox& box, ObjectLightList* list) const;
+
+		// Number of lights given to Begin
+		size_t GetLightCount() const { return m_LightCount; }
+
+	private:
+		size_t m_LightCount = 0;
+
+		std::vector<float> m_X;
+		std::vector<float> m_Y;
+		std::vector<float> m_Z;
+		std::vector<float> m_RadiusSquared;
+	};
+}
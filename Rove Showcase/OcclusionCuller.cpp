@@ -0,0 +1,559 @@
+#include "Pch.h"
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+
+namespace
+{
+	// Rows rasterized by one job, a whole number of tiles so each band also owns its tile depths
+	constexpr int BAND_HEIGHT = 16;
+	constexpr int BAND_COUNT = Rove::OcclusionCuller::HEIGHT / BAND_HEIGHT;
+
+	constexpr int TILES_X = Rove::OcclusionCuller::WIDTH / Rove::OcclusionCuller::TILE_SIZE;
+	constexpr int TILES_Y = Rove::OcclusionCuller::HEIGHT / Rove::OcclusionCuller::TILE_SIZE;
+
+	// Work per job
+	constexpr uint32_t CANDIDATE_JOB_SIZE = 256;
+	constexpr uint32_t VERTEX_JOB_SIZE = 4096;
+	constexpr uint32_t TRIANGLE_JOB_SIZE = 2048;
+
+	static_assert(Rove::OcclusionCuller::WIDTH % 8 == 0, "Depth buffer width must be a multiple of 8");
+	static_assert(Rove::OcclusionCuller::HEIGHT % BAND_HEIGHT == 0, "Depth buffer height must be a multiple of the band height");
+	static_assert(BAND_HEIGHT % Rove::OcclusionCuller::TILE_SIZE == 0, "Band height must be a multiple of the tile size");
+}
+
+Rove::OcclusionCuller::OcclusionCuller(JobSystem* job_system) : m_JobSystem(job_system)
+{
+	m_ViewProjection = DirectX::XMMatrixIdentity();
+	m_Depth.assign(WIDTH * HEIGHT, 1.0f);
+	m_TileMaxDepth.assign(TILES_X * TILES_Y, 1.0f);
+}
+
+void Rove::OcclusionCuller::Begin(const DirectX::XMMATRIX& view_projection, const BoundsSoA& bounds)
+{
+	m_ViewProjection = view_projection;
+
+	m_Occluders.clear();
+	m_VertexCount = 0;
+	m_TriangleCount = 0;
+
+	const size_t count = bounds.Size();
+	m_Candidates.resize(count);
+	m_CandidateVisible.assign(count, 0);
+
+	uint32_t job_count = static_cast<uint32_t>((count + CANDIDATE_JOB_SIZE - 1) / CANDIDATE_JOB_SIZE);
+	Run(job_count, [&](uint32_t job)
+	{
+		size_t first = static_cast<size_t>(job) * CANDIDATE_JOB_SIZE;
+		ProjectBounds(bounds, first, std::min<size_t>(CANDIDATE_JOB_SIZE, count - first));
+	});
+}
+
+float Rove::OcclusionCuller::GetScreenCoverage(size_t candidate) const
+{
+	const ScreenBounds& bounds = m_Candidates[candidate];
+	if (bounds.crosses_near)
+	{
+		return 1.0f;
+	}
+
+	float area = static_cast<float>((bounds.max_x - bounds.min_x + 1) * (bounds.max_y - bounds.min_y + 1));
+	return area / (WIDTH * HEIGHT);
+}
+
+void Rove::OcclusionCuller::AddOccluder(size_t candidate, const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<uint32_t>& indices, const DirectX::XMMATRIX& world)
+{
+	if (candidate < m_CandidateVisible.size())
+	{
+		m_CandidateVisible[candidate] = 1;
+	}
+
+	Occluder occluder;
+	occluder.positions = positions.data();
+	occluder.vertex_count = positions.size();
+	occluder.indices = indices.data();
+	occluder.triangle_count = indices.size() / 3;
+	occluder.vertex_offset = m_VertexCount;
+	occluder.world_view_projection = world * m_ViewProjection;
+	m_Occluders.push_back(occluder);
+
+	m_VertexCount += occluder.vertex_count;
+	m_TriangleCount += occluder.triangle_count;
+}
+
+void Rove::OcclusionCuller::Cull(std::vector<uint32_t>& visible)
+{
+	visible.clear();
+
+	if (m_Occluders.empty())
+	{
+		std::fill(m_Depth.begin(), m_Depth.end(), 1.0f);
+		std::fill(m_TileMaxDepth.begin(), m_TileMaxDepth.end(), 1.0f);
+
+		for (size_t i = 0; i < m_Candidates.size(); ++i)
+		{
+			visible.push_back(static_cast<uint32_t>(i));
+		}
+
+		return;
+	}
+
+	// Split the occluders into jobs
+	m_VertexJobs.clear();
+	m_TriangleJobs.clear();
+
+	uint32_t triangle_output = 0;
+	for (uint32_t i = 0; i < m_Occluders.size(); ++i)
+	{
+		const Occluder& occluder = m_Occluders[i];
+
+		for (size_t first = 0; first < occluder.vertex_count; first += VERTEX_JOB_SIZE)
+		{
+			uint32_t count = static_cast<uint32_t>(std::min<size_t>(VERTEX_JOB_SIZE, occluder.vertex_count - first));
+			m_VertexJobs.push_back({ i, static_cast<uint32_t>(first), count, 0 });
+		}
+
+		for (size_t first = 0; first < occluder.triangle_count; first += TRIANGLE_JOB_SIZE)
+		{
+			uint32_t count = static_cast<uint32_t>(std::min<size_t>(TRIANGLE_JOB_SIZE, occluder.triangle_count - first));
+			m_TriangleJobs.push_back({ i, static_cast<uint32_t>(first), count, triangle_output });
+			triangle_output += count;
+		}
+	}
+
+	m_ClipVertices.resize(m_VertexCount);
+	m_SetupTriangles.resize(m_TriangleCount);
+	m_Bins.resize(m_TriangleJobs.size() * BAND_COUNT);
+
+	// Transform, set up and bin the occluders, then rasterize each band of rows independently
+	Run(static_cast<uint32_t>(m_VertexJobs.size()), [this](uint32_t job) { TransformVertices(m_VertexJobs[job]); });
+	Run(static_cast<uint32_t>(m_TriangleJobs.size()), [this](uint32_t job) { SetupTriangles(job); });
+	Run(BAND_COUNT, [this](uint32_t band)
+	{
+		RasterizeBand(static_cast<int>(band));
+		UpdateTileDepth(static_cast<int>(band));
+	});
+
+	// Test the candidates that are not occluders
+	const size_t count = m_Candidates.size();
+	uint32_t job_count = static_cast<uint32_t>((count + CANDIDATE_JOB_SIZE - 1) / CANDIDATE_JOB_SIZE);
+	Run(job_count, [&](uint32_t job)
+	{
+		size_t first = static_cast<size_t>(job) * CANDIDATE_JOB_SIZE;
+		size_t last = std::min<size_t>(first + CANDIDATE_JOB_SIZE, count);
+		for (size_t i = first; i < last; ++i)
+		{
+			if (m_CandidateVisible[i] == 0)
+			{
+				m_CandidateVisible[i] = TestBounds(m_Candidates[i]) ? 1 : 0;
+			}
+		}
+	});
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (m_CandidateVisible[i] != 0)
+		{
+			visible.push_back(static_cast<uint32_t>(i));
+		}
+	}
+}
+
+void Rove::OcclusionCuller::Run(uint32_t count, const std::function<void(uint32_t index)>& job)
+{
+	if (m_JobSystem != nullptr)
+	{
+		m_JobSystem->ParallelFor(count, job);
+		return;
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		job(i);
+	}
+}
+
+void Rove::OcclusionCuller::ProjectBounds(const BoundsSoA& bounds, size_t first, size_t count)
+{
+	for (size_t i = first; i < first + count; ++i)
+	{
+		ScreenBounds& screen = m_Candidates[i];
+		screen.crosses_near = false;
+
+		DirectX::XMFLOAT3 ndc_min(FLT_MAX, FLT_MAX, FLT_MAX);
+		DirectX::XMFLOAT3 ndc_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			float x = bounds.center_x[i] + ((corner & 1) ? bounds.extent_x[i] : -bounds.extent_x[i]);
+			float y = bounds.center_y[i] + ((corner & 2) ? bounds.extent_y[i] : -bounds.extent_y[i]);
+			float z = bounds.center_z[i] + ((corner & 4) ? bounds.extent_z[i] : -bounds.extent_z[i]);
+
+			DirectX::XMFLOAT4 clip;
+			DirectX::XMStoreFloat4(&clip, DirectX::XMVector3Transform(DirectX::XMVectorSet(x, y, z, 1.0f), m_ViewProjection));
+
+			// A corner in front of the near plane cannot be projected, treat the bounds as covering the screen
+			if (clip.z < 0.0f)
+			{
+				screen.crosses_near = true;
+				break;
+			}
+
+			float inverse_w = 1.0f / clip.w;
+			ndc_min = DirectX::XMFLOAT3(std::min(ndc_min.x, clip.x * inverse_w), std::min(ndc_min.y, clip.y * inverse_w), std::min(ndc_min.z, clip.z * inverse_w));
+			ndc_max = DirectX::XMFLOAT3(std::max(ndc_max.x, clip.x * inverse_w), std::max(ndc_max.y, clip.y * inverse_w), std::max(ndc_max.z, clip.z * inverse_w));
+		}
+
+		if (screen.crosses_near)
+		{
+			screen.min_x = 0;
+			screen.min_y = 0;
+			screen.max_x = WIDTH - 1;
+			screen.max_y = HEIGHT - 1;
+			screen.min_depth = 0.0f;
+			continue;
+		}
+
+		// Pixel rectangle, the y axis points down the screen
+		float min_x = (ndc_min.x * 0.5f + 0.5f) * WIDTH;
+		float max_x = (ndc_max.x * 0.5f + 0.5f) * WIDTH;
+		float min_y = (0.5f - ndc_max.y * 0.5f) * HEIGHT;
+		float max_y = (0.5f - ndc_min.y * 0.5f) * HEIGHT;
+
+		screen.min_x = static_cast<int>(std::clamp(min_x, 0.0f, WIDTH - 1.0f));
+		screen.max_x = static_cast<int>(std::clamp(max_x, 0.0f, WIDTH - 1.0f));
+		screen.min_y = static_cast<int>(std::clamp(min_y, 0.0f, HEIGHT - 1.0f));
+		screen.max_y = static_cast<int>(std::clamp(max_y, 0.0f, HEIGHT - 1.0f));
+		screen.min_depth = std::max(ndc_min.z, 0.0f);
+	}
+}
+
+void Rove::OcclusionCuller::TransformVertices(const OccluderRange& range)
+{
+	const Occluder& occluder = m_Occluders[range.occluder];
+	DirectX::XMVector3TransformStream(&m_ClipVertices[occluder.vertex_offset + range.first], sizeof(DirectX::XMFLOAT4),
+		occluder.positions + range.first, sizeof(DirectX::XMFLOAT3), range.count, occluder.world_view_projection);
+}
+
+void Rove::OcclusionCuller::SetupTriangles(uint32_t job_index)
+{
+	const OccluderRange& range = m_TriangleJobs[job_index];
+	const Occluder& occluder = m_Occluders[range.occluder];
+	const DirectX::XMFLOAT4* clip_vertices = &m_ClipVertices[occluder.vertex_offset];
+
+	std::vector<uint32_t>* bins = &m_Bins[static_cast<size_t>(job_index) * BAND_COUNT];
+	for (int band = 0; band < BAND_COUNT; ++band)
+	{
+		bins[band].clear();
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 width = _mm_set1_ps(static_cast<float>(WIDTH));
+	const __m128 height = _mm_set1_ps(static_cast<float>(HEIGHT));
+	const __m128 max_x_limit = _mm_set1_ps(WIDTH - 1.0f);
+	const __m128 max_y_limit = _mm_set1_ps(HEIGHT - 1.0f);
+
+	uint32_t output = range.output;
+	const uint32_t last = range.first + range.count;
+
+	// Set up 4 triangles at a time, lanes past the end repeat the first triangle and are masked out
+	for (uint32_t first = range.first; first < last; first += 4)
+	{
+		const uint32_t lane_count = std::min<uint32_t>(4, last - first);
+
+		// Transpose the clip space vertices so each register holds one component of 4 triangles
+		__m128 x[3], y[3], z[3], w[3];
+		for (int vertex = 0; vertex < 3; ++vertex)
+		{
+			__m128 lanes[4];
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				uint32_t triangle = first + (lane < lane_count ? lane : 0);
+				uint32_t index = occluder.indices[static_cast<size_t>(triangle) * 3 + vertex];
+				lanes[lane] = _mm_loadu_ps(&clip_vertices[index].x);
+			}
+
+			_MM_TRANSPOSE4_PS(lanes[0], lanes[1], lanes[2], lanes[3]);
+			x[vertex] = lanes[0];
+			y[vertex] = lanes[1];
+			z[vertex] = lanes[2];
+			w[vertex] = lanes[3];
+		}
+
+		// Triangles crossing the near plane are dropped rather than clipped, losing occluder area is always safe
+		__m128 valid = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(z[0], zero), _mm_cmpge_ps(z[1], zero)), _mm_cmpge_ps(z[2], zero));
+
+		// Entirely outside one side of the frustum
+		__m128 outside = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(x[0], w[0]), _mm_cmpgt_ps(x[1], w[1])), _mm_cmpgt_ps(x[2], w[2]));
+		outside = _mm_or_ps(outside, _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(x[0], _mm_sub_ps(zero, w[0])), _mm_cmplt_ps(x[1], _mm_sub_ps(zero, w[1]))), _mm_cmplt_ps(x[2], _mm_sub_ps(zero, w[2]))));
+		outside = _mm_or_ps(outside, _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(y[0], w[0]), _mm_cmpgt_ps(y[1], w[1])), _mm_cmpgt_ps(y[2], w[2])));
+		outside = _mm_or_ps(outside, _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(y[0], _mm_sub_ps(zero, w[0])), _mm_cmplt_ps(y[1], _mm_sub_ps(zero, w[1]))), _mm_cmplt_ps(y[2], _mm_sub_ps(zero, w[2]))));
+		valid = _mm_andnot_ps(outside, valid);
+
+		if (_mm_movemask_ps(valid) == 0)
+		{
+			continue;
+		}
+
+		// Pixel coordinates, the y axis points down the screen
+		__m128 sx[3], sy[3], sz[3];
+		for (int vertex = 0; vertex < 3; ++vertex)
+		{
+			__m128 inverse_w = _mm_div_ps(one, w[vertex]);
+			sx[vertex] = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(x[vertex], inverse_w), half), half), width);
+			sy[vertex] = _mm_mul_ps(_mm_sub_ps(half, _mm_mul_ps(_mm_mul_ps(y[vertex], inverse_w), half)), height);
+			sz[vertex] = _mm_mul_ps(z[vertex], inverse_w);
+		}
+
+		// Only faces the renderer draws can hide anything, it culls counter clockwise triangles
+		__m128 area = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(sx[1], sx[0]), _mm_sub_ps(sy[2], sy[0])), _mm_mul_ps(_mm_sub_ps(sx[2], sx[0]), _mm_sub_ps(sy[1], sy[0])));
+		valid = _mm_and_ps(valid, _mm_cmpgt_ps(area, zero));
+
+		// Pixel bounds clamped to the screen
+		__m128 min_x = _mm_max_ps(_mm_min_ps(_mm_min_ps(sx[0], sx[1]), sx[2]), zero);
+		__m128 max_x = _mm_min_ps(_mm_max_ps(_mm_max_ps(sx[0], sx[1]), sx[2]), max_x_limit);
+		__m128 min_y = _mm_max_ps(_mm_min_ps(_mm_min_ps(sy[0], sy[1]), sy[2]), zero);
+		__m128 max_y = _mm_min_ps(_mm_max_ps(_mm_max_ps(sy[0], sy[1]), sy[2]), max_y_limit);
+		valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmple_ps(min_x, max_x), _mm_cmple_ps(min_y, max_y)));
+
+		int mask = _mm_movemask_ps(valid);
+		if (mask == 0)
+		{
+			continue;
+		}
+
+		// Edge functions, each is the barycentric weight of the opposite vertex scaled by the area
+		__m128 edge_a[3], edge_b[3], edge_c[3];
+		for (int edge = 0; edge < 3; ++edge)
+		{
+			int from = (edge + 1) % 3;
+			int to = (edge + 2) % 3;
+			edge_a[edge] = _mm_sub_ps(sy[from], sy[to]);
+			edge_b[edge] = _mm_sub_ps(sx[to], sx[from]);
+			edge_c[edge] = _mm_sub_ps(zero, _mm_add_ps(_mm_mul_ps(edge_a[edge], sx[from]), _mm_mul_ps(edge_b[edge], sy[from])));
+		}
+
+		// Depth is linear in screen space after the perspective divide
+		__m128 inverse_area = _mm_div_ps(one, area);
+		__m128 dz1 = _mm_mul_ps(_mm_sub_ps(sz[1], sz[0]), inverse_area);
+		__m128 dz2 = _mm_mul_ps(_mm_sub_ps(sz[2], sz[0]), inverse_area);
+		__m128 depth_a = _mm_add_ps(_mm_mul_ps(dz1, edge_a[1]), _mm_mul_ps(dz2, edge_a[2]));
+		__m128 depth_b = _mm_add_ps(_mm_mul_ps(dz1, edge_b[1]), _mm_mul_ps(dz2, edge_b[2]));
+		__m128 depth_c = _mm_add_ps(sz[0], _mm_add_ps(_mm_mul_ps(dz1, edge_c[1]), _mm_mul_ps(dz2, edge_c[2])));
+
+		// Write out the valid lanes
+		alignas(16) float lane_edge_a[3][4], lane_edge_b[3][4], lane_edge_c[3][4];
+		alignas(16) float lane_depth_a[4], lane_depth_b[4], lane_depth_c[4];
+		alignas(16) int lane_min_x[4], lane_max_x[4], lane_min_y[4], lane_max_y[4];
+
+		for (int edge = 0; edge < 3; ++edge)
+		{
+			_mm_store_ps(lane_edge_a[edge], edge_a[edge]);
+			_mm_store_ps(lane_edge_b[edge], edge_b[edge]);
+			_mm_store_ps(lane_edge_c[edge], edge_c[edge]);
+		}
+
+		_mm_store_ps(lane_depth_a, depth_a);
+		_mm_store_ps(lane_depth_b, depth_b);
+		_mm_store_ps(lane_depth_c, depth_c);
+		_mm_store_si128(reinterpret_cast<__m128i*>(lane_min_x), _mm_cvttps_epi32(min_x));
+		_mm_store_si128(reinterpret_cast<__m128i*>(lane_max_x), _mm_cvttps_epi32(max_x));
+		_mm_store_si128(reinterpret_cast<__m128i*>(lane_min_y), _mm_cvttps_epi32(min_y));
+		_mm_store_si128(reinterpret_cast<__m128i*>(lane_max_y), _mm_cvttps_epi32(max_y));
+
+		for (uint32_t lane = 0; lane < lane_count; ++lane)
+		{
+			if ((mask & (1 << lane)) == 0)
+			{
+				continue;
+			}
+
+			SetupTriangle& triangle = m_SetupTriangles[output];
+			for (int edge = 0; edge < 3; ++edge)
+			{
+				triangle.edge_a[edge] = lane_edge_a[edge][lane];
+				triangle.edge_b[edge] = lane_edge_b[edge][lane];
+				triangle.edge_c[edge] = lane_edge_c[edge][lane];
+			}
+
+			triangle.depth_a = lane_depth_a[lane];
+			triangle.depth_b = lane_depth_b[lane];
+			triangle.depth_c = lane_depth_c[lane];
+			triangle.min_x = lane_min_x[lane];
+			triangle.max_x = lane_max_x[lane];
+			triangle.min_y = lane_min_y[lane];
+			triangle.max_y = lane_max_y[lane];
+
+			for (int band = triangle.min_y / BAND_HEIGHT; band <= triangle.max_y / BAND_HEIGHT; ++band)
+			{
+				bins[band].push_back(output);
+			}
+
+			++output;
+		}
+	}
+}
+
+void Rove::OcclusionCuller::RasterizeBand(int band)
+{
+	int band_min_y = band * BAND_HEIGHT;
+	int band_max_y = band_min_y + BAND_HEIGHT - 1;
+
+	std::fill(m_Depth.begin() + band_min_y * WIDTH, m_Depth.begin() + (band_max_y + 1) * WIDTH, 1.0f);
+
+	for (size_t job = 0; job < m_TriangleJobs.size(); ++job)
+	{
+		for (uint32_t triangle : m_Bins[job * BAND_COUNT + band])
+		{
+			RasterizeTriangle(m_SetupTriangles[triangle], band_min_y, band_max_y);
+		}
+	}
+}
+
+void Rove::OcclusionCuller::RasterizeTriangle(const SetupTriangle& triangle, int band_min_y, int band_max_y)
+{
+	int min_y = std::max(triangle.min_y, band_min_y);
+	int max_y = std::min(triangle.max_y, band_max_y);
+
+#if defined(__AVX2__)
+	// 8 pixels at a time
+	const int start_x = triangle.min_x & ~7;
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+
+	const __m256 edge_a0 = _mm256_set1_ps(triangle.edge_a[0]);
+	const __m256 edge_a1 = _mm256_set1_ps(triangle.edge_a[1]);
+	const __m256 edge_a2 = _mm256_set1_ps(triangle.edge_a[2]);
+	const __m256 depth_a = _mm256_set1_ps(triangle.depth_a);
+
+	for (int y = min_y; y <= max_y; ++y)
+	{
+		float pixel_y = y + 0.5f;
+		const __m256 row0 = _mm256_set1_ps(triangle.edge_b[0] * pixel_y + triangle.edge_c[0]);
+		const __m256 row1 = _mm256_set1_ps(triangle.edge_b[1] * pixel_y + triangle.edge_c[1]);
+		const __m256 row2 = _mm256_set1_ps(triangle.edge_b[2] * pixel_y + triangle.edge_c[2]);
+		const __m256 row_depth = _mm256_set1_ps(triangle.depth_b * pixel_y + triangle.depth_c);
+
+		float* row = &m_Depth[y * WIDTH];
+		for (int x = start_x; x <= triangle.max_x; x += 8)
+		{
+			__m256 pixel_x = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), offsets);
+
+			// Strictly inside, shared edges may leave gaps which only loses occlusion
+			__m256 inside = _mm256_cmp_ps(_mm256_fmadd_ps(edge_a0, pixel_x, row0), zero, _CMP_GT_OQ);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_fmadd_ps(edge_a1, pixel_x, row1), zero, _CMP_GT_OQ));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_fmadd_ps(edge_a2, pixel_x, row2), zero, _CMP_GT_OQ));
+			if (_mm256_movemask_ps(inside) == 0)
+			{
+				continue;
+			}
+
+			__m256 depth = _mm256_loadu_ps(row + x);
+			__m256 triangle_depth = _mm256_fmadd_ps(depth_a, pixel_x, row_depth);
+			_mm256_storeu_ps(row + x, _mm256_blendv_ps(depth, _mm256_min_ps(depth, triangle_depth), inside));
+		}
+	}
+#else
+	// 4 pixels at a time
+	const int start_x = triangle.min_x & ~3;
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+	const __m128 edge_a0 = _mm_set1_ps(triangle.edge_a[0]);
+	const __m128 edge_a1 = _mm_set1_ps(triangle.edge_a[1]);
+	const __m128 edge_a2 = _mm_set1_ps(triangle.edge_a[2]);
+	const __m128 depth_a = _mm_set1_ps(triangle.depth_a);
+
+	for (int y = min_y; y <= max_y; ++y)
+	{
+		float pixel_y = y + 0.5f;
+		const __m128 row0 = _mm_set1_ps(triangle.edge_b[0] * pixel_y + triangle.edge_c[0]);
+		const __m128 row1 = _mm_set1_ps(triangle.edge_b[1] * pixel_y + triangle.edge_c[1]);
+		const __m128 row2 = _mm_set1_ps(triangle.edge_b[2] * pixel_y + triangle.edge_c[2]);
+		const __m128 row_depth = _mm_set1_ps(triangle.depth_b * pixel_y + triangle.depth_c);
+
+		float* row = &m_Depth[y * WIDTH];
+		for (int x = start_x; x <= triangle.max_x; x += 4)
+		{
+			__m128 pixel_x = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), offsets);
+
+			__m128 inside = _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(edge_a0, pixel_x), row0), zero);
+			inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(edge_a1, pixel_x), row1), zero));
+			inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(edge_a2, pixel_x), row2), zero));
+			if (_mm_movemask_ps(inside) == 0)
+			{
+				continue;
+			}
+
+			__m128 depth = _mm_loadu_ps(row + x);
+			__m128 triangle_depth = _mm_min_ps(depth, _mm_add_ps(_mm_mul_ps(depth_a, pixel_x), row_depth));
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, triangle_depth), _mm_andnot_ps(inside, depth)));
+		}
+	}
+#endif
+}
+
+void Rove::OcclusionCuller::UpdateTileDepth(int band)
+{
+	int first_tile_y = band * BAND_HEIGHT / TILE_SIZE;
+	int last_tile_y = first_tile_y + BAND_HEIGHT / TILE_SIZE;
+
+	for (int tile_y = first_tile_y; tile_y < last_tile_y; ++tile_y)
+	{
+		for (int tile_x = 0; tile_x < TILES_X; ++tile_x)
+		{
+			__m128 max_depth = _mm_setzero_ps();
+			for (int y = tile_y * TILE_SIZE; y < (tile_y + 1) * TILE_SIZE; ++y)
+			{
+				const float* row = &m_Depth[y * WIDTH + tile_x * TILE_SIZE];
+				max_depth = _mm_max_ps(max_depth, _mm_max_ps(_mm_loadu_ps(row), _mm_loadu_ps(row + 4)));
+			}
+
+			// Horizontal maximum of the four lanes
+			max_depth = _mm_max_ps(max_depth, _mm_shuffle_ps(max_depth, max_depth, _MM_SHUFFLE(2, 3, 0, 1)));
+			max_depth = _mm_max_ps(max_depth, _mm_shuffle_ps(max_depth, max_depth, _MM_SHUFFLE(1, 0, 3, 2)));
+			m_TileMaxDepth[tile_y * TILES_X + tile_x] = _mm_cvtss_f32(max_depth);
+		}
+	}
+}
+
+bool Rove::OcclusionCuller::TestBounds(const ScreenBounds& bounds) const
+{
+	if (bounds.crosses_near)
+	{
+		return true;
+	}
+
+	for (int tile_y = bounds.min_y / TILE_SIZE; tile_y <= bounds.max_y / TILE_SIZE; ++tile_y)
+	{
+		for (int tile_x = bounds.min_x / TILE_SIZE; tile_x <= bounds.max_x / TILE_SIZE; ++tile_x)
+		{
+			// Every pixel of the tile is nearer than the bounds
+			if (bounds.min_depth > m_TileMaxDepth[tile_y * TILES_X + tile_x])
+			{
+				continue;
+			}
+
+			// Check the pixels of the tile under the rectangle
+			int min_x = std::max(bounds.min_x, tile_x * TILE_SIZE);
+			int max_x = std::min(bounds.max_x, tile_x * TILE_SIZE + TILE_SIZE - 1);
+			int min_y = std::max(bounds.min_y, tile_y * TILE_SIZE);
+			int max_y = std::min(bounds.max_y, tile_y * TILE_SIZE + TILE_SIZE - 1);
+
+			for (int y = min_y; y <= max_y; ++y)
+			{
+				const float* row = &m_Depth[y * WIDTH];
+				for (int x = min_x; x <= max_x; ++x)
+				{
+					if (row[x] >= bounds.min_depth)
+					{
+						return true;
+					}
+				}
+			}
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "Pch.h"
+#include "Frustum.h"
+
+namespace Rove
+{
+	// Forward declarations
+	class JobSystem;
+
+	// Software occlusion culling. Large occluders are rasterized on the CPU into a low resolution depth buffer with a
+	// max depth per tile, the projected bounds of the candidates are then tested against the tiles first and only fall
+	// back to the pixels where a tile cannot decide.
+	class OcclusionCuller
+	{
+	public:
+		OcclusionCuller(JobSystem* job_system);
+		virtual ~OcclusionCuller() = default;
+
+		// Depth buffer resolution, the width is a multiple of 8 so rows can be processed 8 pixels at a time
+		static constexpr int WIDTH = 320;
+		static constexpr int HEIGHT = 192;
+		static constexpr int TILE_SIZE = 8;
+
+		// Starts a new view, clears the occluders and projects the bounds of every candidate
+		void Begin(const DirectX::XMMATRIX& view_projection, const BoundsSoA& bounds);
+
+		// Fraction of the screen covered by the projected bounds of a candidate, 1 if the bounds cross the near plane
+		float GetScreenCoverage(size_t candidate) const;
+
+		// Adds the mesh of a candidate as an occluder, the geometry must stay alive until Cull returns. Occluders are
+		// always reported as visible.
+		void AddOccluder(size_t candidate, const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<uint32_t>& indices, const DirectX::XMMATRIX& world);
+
+		// Rasterizes the occluders and writes the indices of the candidates that may be visible
+		void Cull(std::vector<uint32_t>& visible);
+
+		// Depth buffer of the last cull, 1 is the far plane
+		const std::vector<float>& GetDepthBuffer() const { return m_Depth; }
+
+		// Number of occluders added since Begin
+		size_t GetOccluderCount() const { return m_Occluders.size(); }
+
+		// Number of occluder triangles added since Begin
+		size_t GetOccluderTriangleCount() const { return m_TriangleCount; }
+
+	private:
+		JobSystem* m_JobSystem = nullptr;
+
+		DirectX::XMMATRIX m_ViewProjection;
+
+		// Screen rectangle in pixels and nearest depth of a candidate
+		struct ScreenBounds
+		{
+			int min_x;
+			int min_y;
+			int max_x;
+			int max_y;
+			float min_depth;
+			bool crosses_near;
+		};
+
+		std::vector<ScreenBounds> m_Candidates;
+		std::vector<uint8_t> m_CandidateVisible;
+
+		struct Occluder
+		{
+			const DirectX::XMFLOAT3* positions;
+			size_t vertex_count;
+			const uint32_t* indices;
+			size_t triangle_count;
+			size_t vertex_offset;
+			DirectX::XMMATRIX world_view_projection;
+		};
+
+		std::vector<Occluder> m_Occluders;
+		size_t m_VertexCount = 0;
+		size_t m_TriangleCount = 0;
+
+		// Range of an occluder processed by one job
+		struct OccluderRange
+		{
+			uint32_t occluder;
+			uint32_t first;
+			uint32_t count;
+			uint32_t output;
+		};
+
+		std::vector<OccluderRange> m_VertexJobs;
+		std::vector<OccluderRange> m_TriangleJobs;
+
+		// Clip space positions of every occluder vertex
+		std::vector<DirectX::XMFLOAT4> m_ClipVertices;
+
+		// Edge functions and depth plane of a triangle in pixel coordinates
+		struct SetupTriangle
+		{
+			float edge_a[3];
+			float edge_b[3];
+			float edge_c[3];
+			float depth_a;
+			float depth_b;
+			float depth_c;
+			int min_x;
+			int max_x;
+			int min_y;
+			int max_y;
+		};
+
+		std::vector<SetupTriangle> m_SetupTriangles;
+
+		// Triangles overlapping each band of rows, one list per triangle job and band so setup needs no locking
+		std::vector<std::vector<uint32_t>> m_Bins;
+
+		// Depth per pixel and farthest depth per tile
+		std::vector<float> m_Depth;
+		std::vector<float> m_TileMaxDepth;
+
+		// Runs a job for each index on the job system, or in order without one
+		void Run(uint32_t count, const std::function<void(uint32_t index)>& job);
+
+		void ProjectBounds(const BoundsSoA& bounds, size_t first, size_t count);
+		void TransformVertices(const OccluderRange& range);
+		void SetupTriangles(uint32_t job_index);
+		void RasterizeBand(int band);
+		void RasterizeTriangle(const SetupTriangle& triangle, int band_min_y, int band_max_y);
+		void UpdateTileDepth(int band);
+		bool TestBounds(const ScreenBounds& bounds) const;
+	};
+}
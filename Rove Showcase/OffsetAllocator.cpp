@@ -0,0 +1,105 @@
+#include "Pch.h"
+#include "OffsetAllocator.h"
+
+Rove::OffsetAllocator::OffsetAllocator(uint64_t size)
+{
+	Reset(size);
+}
+
+void Rove::OffsetAllocator::Reset(uint64_t size)
+{
+	m_Size = size;
+	m_FreeSize = 0;
+	m_FreeByOffset.clear();
+	m_FreeBySize.clear();
+
+	if (size > 0)
+	{
+		AddFreeRange(0, size);
+	}
+}
+
+uint64_t Rove::OffsetAllocator::Allocate(uint64_t size)
+{
+	if (size == 0)
+	{
+		return INVALID_OFFSET;
+	}
+
+	// Smallest free range the allocation fits in
+	auto best = m_FreeBySize.lower_bound(size);
+	if (best == m_FreeBySize.end())
+	{
+		return INVALID_OFFSET;
+	}
+
+	uint64_t offset = best->second;
+	uint64_t range_size = best->first;
+	RemoveFreeRange(m_FreeByOffset.find(offset));
+
+	// The rest of the range stays free
+	if (range_size > size)
+	{
+		AddFreeRange(offset + size, range_size - size);
+	}
+
+	return offset;
+}
+
+void Rove::OffsetAllocator::Free(uint64_t offset, uint64_t size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	// Merge with the free range ending where this one starts
+	auto next = m_FreeByOffset.upper_bound(offset);
+	if (next != m_FreeByOffset.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			offset = previous->first;
+			size += previous->second;
+			RemoveFreeRange(previous);
+		}
+	}
+
+	// Merge with the free range starting where this one ends
+	if (next != m_FreeByOffset.end() && offset + size == next->first)
+	{
+		size += next->second;
+		RemoveFreeRange(next);
+	}
+
+	AddFreeRange(offset, size);
+}
+
+uint64_t Rove::OffsetAllocator::GetLargestFreeRange() const
+{
+	return m_FreeBySize.empty() ? 0 : m_FreeBySize.rbegin()->first;
+}
+
+void Rove::OffsetAllocator::AddFreeRange(uint64_t offset, uint64_t size)
+{
+	m_FreeByOffset.emplace(offset, size);
+	m_FreeBySize.emplace(size, offset);
+	m_FreeSize += size;
+}
+
+void Rove::OffsetAllocator::RemoveFreeRange(std::map<uint64_t, uint64_t>::iterator range)
+{
+	auto sizes = m_FreeBySize.equal_range(range->second);
+	for (auto it = sizes.first; it != sizes.second; ++it)
+	{
+		if (it->second == range->first)
+		{
+			m_FreeBySize.erase(it);
+			break;
+		}
+	}
+
+	m_FreeSize -= range->second;
+	m_FreeByOffset.erase(range);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Pch.h"
+
+namespace Rove
+{
+	// Hands out ranges of a fixed size space in any order. Free ranges are kept by offset and by size, an allocation takes
+	// the smallest range it fits in and a freed range is merged with the free ranges on either side, so the free space
+	// never splits into more ranges than there are allocations between them.
+	class OffsetAllocator
+	{
+	public:
+		// Returned when no free range is large enough
+		static constexpr uint64_t INVALID_OFFSET = UINT64_MAX;
+
+		OffsetAllocator(uint64_t size = 0);
+		virtual ~OffsetAllocator() = default;
+
+		// Frees everything and changes the size
+		void Reset(uint64_t size);
+
+		// Returns the offset of a range or INVALID_OFFSET
+		uint64_t Allocate(uint64_t size);
+
+		// Returns a range given by Allocate
+		void Free(uint64_t offset, uint64_t size);
+
+		// Total size
+		uint64_t GetSize() const { return m_Size; }
+
+		// Size not allocated
+		uint64_t GetFreeSize() const { return m_FreeSize; }
+
+		// Largest allocation that would currently succeed
+		uint64_t GetLargestFreeRange() const;
+
+		// Number of separate free ranges
+		size_t GetFreeRangeCount() const { return m_FreeByOffset.size(); }
+
+	private:
+		uint64_t m_Size = 0;
+		uint64_t m_FreeSize = 0;
+
+		// Size of every free range by its offset, and the offset by size for best fit
+		std::map<uint64_t, uint64_t> m_FreeByOffset;
+		std::multimap<uint64_t, uint64_t> m_FreeBySize;
+
+		void AddFreeRange(uint64_t offset, uint64_t size);
+		void RemoveFreeRange(std::map<uint64_t, uint64_t>::iterator range);
+	};
+}
@@ -11,8 +11,14 @@
 
 // DirectX
 #include <d3d11_4.h>
+#include <d3dcompiler.h>
 #include <DirectXColors.h>
 #include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+// SIMD intrinsics
+#include <immintrin.h>
+#include <intrin.h>
 
 // This include is requires for using DirectX smart pointers (ComPtr)
 #include <wrl\client.h>
@@ -32,11 +38,27 @@ using Microsoft::WRL::ComPtr;
 #include <string>
 #include <memory>
 #include <vector>
+#include <deque>
 #include <fstream>
 #include <filesystem>
 #include <exception>
 #include <thread>
 #include <map>
+#include <unordered_set>
+#include <tuple>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <future>
+#include <cfloat>
+#include <cstddef>
+#include <cstdio>
+#include <ctime>
+#include <charconv>
+#include <mutex>
+#include <condition_variable>
+#include <random>
 
 #include <locale>
 #include <codecvt>
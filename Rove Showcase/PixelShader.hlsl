@@ -1,32 +1,83 @@
 #include "ShaderData.hlsli"
 
-// Point lighting
-float4 CalculatePointLighting(float3 position, float3 normal)
+// Cluster of a pixel from its screen position and view depth
+uint CalculateCluster(float4 screen_position)
+{
+	uint2 tile = uint2(screen_position.xy / cScreenSize * float2(cClusterGrid.xy));
+	uint slice = uint(max(log(screen_position.w) * cClusterDepthScale + cClusterDepthBias, 0.0f));
+	tile = min(tile, cClusterGrid.xy - 1);
+	slice = min(slice, cClusterGrid.z - 1);
+
+	return (slice * cClusterGrid.y + tile.y) * cClusterGrid.x + tile.x;
+}
+
+// Adds the light of one point light
+void AddPointLight(uint i, float3 position, float3 normal, inout float4 diffuse_light, inout float4 ambient_light, inout float4 specular_light)
+{
+	float4 diffuse_light_colour = PointLights[i].lightPointDiffuse;
+	float4 ambient_light_colour = PointLights[i].lightPointAmbient;
+	float4 specular_light_colour = PointLights[i].lightPointSpecular;
+
+	// Fades to nothing at the radius
+	float3 to_light = PointLights[i].lightPointPosition.xyz - position;
+	float falloff = saturate(1.0f - pow(length(to_light) / PointLights[i].lightPointPosition.w, 4.0f));
+	float attenuation = falloff * falloff;
+
+	// Diffuse lighting
+	float3 light_vector = normalize(to_light);
+	diffuse_light += saturate(dot(light_vector, normal)) * diffuse_light_colour * attenuation;
+
+	// Ambient lighting
+	ambient_light += ambient_light_colour * attenuation;
+
+	// Specular lighting
+	float roughness = (1.0f - cRoughnessFactor); // 0.5f;
+	float3 view_direction = normalize(cCameraPosition.xyz - position);
+	float3 reflect_direction = reflect(-light_vector, normal);
+	float specular_factor = mul(pow(max(dot(view_direction, reflect_direction), 0.0), 16.0f), roughness);
+	specular_light += float4(specular_factor * specular_light_colour.xyz * attenuation, 1.0f);
+}
+
+// Point lighting from the light list of the draw or the lights of the cluster
+float4 CalculatePointLighting(float3 position, float3 normal, float4 screen_position)
 {
 	float4 diffuse_light = float4(0.0f, 0.0f, 0.0f, 1.0f);
 	float4 ambient_light = float4(0.0f, 0.0f, 0.0f, 1.0f);
 	float4 specular_light = float4(0.0f, 0.0f, 0.0f, 1.0f);
 
-	for (int i = 0; i < cLightCount; ++i)
+#if defined(PERMUTATION) && LIGHT_BUCKET > 0
+	// The loop is bounded by the light bucket of the variant so it unrolls
+	[unroll]
+	for (uint j = 0; j < LIGHT_BUCKET; ++j)
+	{
+		if (j < cObjectLightCount)
+		{
+			AddPointLight(cObjectLights[j / 4][j % 4], position, normal, diffuse_light, ambient_light, specular_light);
+		}
+	}
+#elif defined(PERMUTATION)
+	uint2 cluster = ClusterLights[CalculateCluster(screen_position)];
+	for (uint j = cluster.x; j < cluster.x + cluster.y; ++j)
+	{
+		AddPointLight(LightIndices[j], position, normal, diffuse_light, ambient_light, specular_light);
+	}
+#else
+	if (cPerObjectLights != 0)
+	{
+		for (uint j = 0; j < cObjectLightCount; ++j)
+		{
+			AddPointLight(cObjectLights[j / 4][j % 4], position, normal, diffuse_light, ambient_light, specular_light);
+		}
+	}
+	else
 	{
-		float4 diffuse_light_colour = cPointLight[i].lightPointDiffuse;
-		float4 ambient_light_colour = cPointLight[i].lightPointAmbient;
-		float4 specular_light_colour = cPointLight[i].lightPointSpecular;
-
-		// Diffuse lighting
-		float3 light_vector = normalize(cPointLight[i].lightPointPosition.xyz - position);
-		diffuse_light += saturate(dot(light_vector, normal)) * diffuse_light_colour;
-
-		// Ambient lighting
-		ambient_light += ambient_light_colour;
-
-		// Specular lighting
-		float roughness = (1.0f - cRoughnessFactor); // 0.5f;
-		float3 view_direction = normalize(cCameraPosition.xyz - position);
-		float3 reflect_direction = reflect(-light_vector, normal);
-		float specular_factor = mul(pow(max(dot(view_direction, reflect_direction), 0.0), 16.0f), roughness);
-		specular_light += float4(specular_factor * specular_light_colour.xyz, 1.0f);
+		uint2 cluster = ClusterLights[CalculateCluster(screen_position)];
+		for (uint j = cluster.x; j < cluster.x + cluster.y; ++j)
+		{
+			AddPointLight(LightIndices[j], position, normal, diffuse_light, ambient_light, specular_light);
+		}
 	}
+#endif
 
 	return diffuse_light + ambient_light + specular_light;
 }
@@ -60,16 +111,32 @@ float4 main(PixelInput input) : SV_TARGET
 
 	// Calculate normals from sampling the normal map
 	float3 bumped_normal = input.normal;
+#if defined(PERMUTATION)
+#if HAS_NORMAL_MAP
+	bumped_normal = CalculateNormalsFromNormalMap(input);
+#endif
+#else
 	if (cMaterialNormalTexture == 1)
 	{
 		bumped_normal = CalculateNormalsFromNormalMap(input);
 	}
+#endif
 
 	// Calculate directional light
-	float4 light_colour = CalculatePointLighting(input.position, bumped_normal);
-
-	// Apply diffuse texture
-	float4 diffuse_texture = TextureDiffuse.Sample(SamplerStateAnisotropic, input.tex_coord);
+	float4 light_colour = CalculatePointLighting(input.position, bumped_normal, input.positionClipSpace);
+
+	// Apply diffuse texture, materials without one are left white
+	float4 diffuse_texture = float4(1.0f, 1.0f, 1.0f, 1.0f);
+#if defined(PERMUTATION)
+#if HAS_DIFFUSE_MAP
+	diffuse_texture = TextureDiffuse.Sample(SamplerStateAnisotropic, input.tex_coord);
+#endif
+#else
+	if (cMaterialDiffuseTetxure == 1)
+	{
+		diffuse_texture = TextureDiffuse.Sample(SamplerStateAnisotropic, input.tex_coord);
+	}
+#endif
 
 	return light_colour * diffuse_texture;
 }
\ No newline at end of file
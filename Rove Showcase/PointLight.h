@@ -22,6 +22,9 @@ namespace Rove
 		// Specular light
 		DirectX::XMFLOAT4 SpecularColour = DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
 
+		// Distance the light reaches, it fades out to nothing at the radius
+		float Radius = 50.0f;
+
 	private:
 
 	};
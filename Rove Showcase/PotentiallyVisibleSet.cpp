@@ -0,0 +1,302 @@
+#include "Pch.h"
+#include "PotentiallyVisibleSet.h"
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+#include "Camera.h"
+
+namespace
+{
+	// Added to the field of view of the camera the sets are built with
+	constexpr float FOV_MARGIN_DEGREES = 10.0f;
+
+	// Occluder limits per sample, higher than the per frame limits as the sets are only built once
+	constexpr float MIN_OCCLUDER_COVERAGE = 0.02f;
+	constexpr int MAX_OCCLUDERS = 64;
+	constexpr size_t MAX_OCCLUDER_TRIANGLES = 131072;
+
+	// Header word of the encoding: a run of empty or full words followed by a number of literal words
+	constexpr uint64_t RUN_FULL_BIT = 1ull << 63;
+	constexpr uint64_t MAX_RUN = 0x7FFFFFFF;
+	constexpr uint64_t MAX_LITERALS = 0xFFFFFFFF;
+
+	constexpr int PITCH_CELLS = Rove::PotentiallyVisibleSet::PITCH_CELLS;
+	constexpr int YAW_CELLS = Rove::PotentiallyVisibleSet::YAW_CELLS;
+
+	// Samples are taken on the cell corners, which are shared between cells, followed by the cell centres
+	constexpr int CORNER_SAMPLES = (PITCH_CELLS + 1) * YAW_CELLS;
+	constexpr int SAMPLE_COUNT = CORNER_SAMPLES + PITCH_CELLS * YAW_CELLS;
+
+	void SampleOrientation(int sample, float* pitch_radians, float* yaw_radians)
+	{
+		const float pitch_step = 2.0f * Rove::Camera::MAX_PITCH_RADIANS / PITCH_CELLS;
+		const float yaw_step = DirectX::XM_2PI / YAW_CELLS;
+
+		float offset = 0.0f;
+		if (sample >= CORNER_SAMPLES)
+		{
+			sample -= CORNER_SAMPLES;
+			offset = 0.5f;
+		}
+
+		*pitch_radians = -Rove::Camera::MAX_PITCH_RADIANS + (sample / YAW_CELLS + offset) * pitch_step;
+		*yaw_radians = (sample % YAW_CELLS + offset) * yaw_step;
+	}
+
+	bool IsRunWord(uint64_t word)
+	{
+		return word == 0 || word == ~0ull;
+	}
+
+	void Encode(const std::vector<uint64_t>& words, std::vector<uint64_t>& stream)
+	{
+		size_t i = 0;
+		while (i < words.size())
+		{
+			uint64_t run_value = IsRunWord(words[i]) ? words[i] : 0;
+			uint64_t run = 0;
+			while (i < words.size() && words[i] == run_value && run < MAX_RUN)
+			{
+				++i;
+				++run;
+			}
+
+			size_t literal_start = i;
+			while (i < words.size() && !IsRunWord(words[i]) && i - literal_start < MAX_LITERALS)
+			{
+				++i;
+			}
+
+			stream.push_back((run_value & RUN_FULL_BIT) | (run << 32) | static_cast<uint64_t>(i - literal_start));
+			stream.insert(stream.end(), words.begin() + literal_start, words.begin() + i);
+		}
+	}
+}
+
+void Rove::PotentiallyVisibleSet::Build(const BoundsSoA& bounds, const std::vector<VisibilityModel>& models, Camera& camera, JobSystem* job_system)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	Invalidate();
+	m_ModelCount = bounds.Size();
+	m_WordCount = (m_ModelCount + 63) / 64;
+
+	// Every sample is rendered with the camera projection widened by the margin
+	Camera sample_camera = camera;
+	sample_camera.SetFov(std::min(camera.GetFieldOfView() + FOV_MARGIN_DEGREES, 179.0f));
+	m_TanHalfFov = std::tan(DirectX::XMConvertToRadians(sample_camera.GetFieldOfView()) * 0.5f);
+	m_AspectRatio = sample_camera.GetAspectRatio();
+
+	std::vector<uint64_t> samples(static_cast<size_t>(SAMPLE_COUNT) * m_WordCount, 0);
+
+	// One job per thread, each with its own depth buffer, takes every nth sample
+	const uint32_t thread_count = job_system != nullptr ? job_system->GetThreadCount() : 1;
+	auto sample_job = [&](uint32_t thread)
+	{
+		OcclusionCuller culler(nullptr);
+		Camera local_camera = sample_camera;
+
+		std::vector<uint32_t> frustum_visible;
+		BoundsSoA candidate_bounds;
+		std::vector<uint32_t> occluder_order;
+		std::vector<uint32_t> visible;
+
+		for (int sample = static_cast<int>(thread); sample < SAMPLE_COUNT; sample += thread_count)
+		{
+			float pitch_radians, yaw_radians;
+			SampleOrientation(sample, &pitch_radians, &yaw_radians);
+			local_camera.SetRotation(pitch_radians, yaw_radians);
+
+			local_camera.GetFrustum().Cull(bounds, frustum_visible);
+
+			candidate_bounds.Clear();
+			for (uint32_t model : frustum_visible)
+			{
+				candidate_bounds.Add(bounds.Get(model));
+			}
+
+			culler.Begin(local_camera.GetViewProjection(), candidate_bounds);
+
+			// Largest models on screen become occluders while they fit in the budget
+			occluder_order.clear();
+			for (uint32_t i = 0; i < frustum_visible.size(); ++i)
+			{
+				if (culler.GetScreenCoverage(i) >= MIN_OCCLUDER_COVERAGE)
+				{
+					occluder_order.push_back(i);
+				}
+			}
+
+			std::sort(occluder_order.begin(), occluder_order.end(), [&culler](uint32_t a, uint32_t b)
+			{
+				return culler.GetScreenCoverage(a) > culler.GetScreenCoverage(b);
+			});
+
+			size_t occluder_triangles = 0;
+			int occluder_count = 0;
+			for (uint32_t candidate : occluder_order)
+			{
+				if (occluder_count == MAX_OCCLUDERS)
+				{
+					break;
+				}
+
+				const VisibilityModel& model = models[frustum_visible[candidate]];
+				size_t triangle_count = model.indices != nullptr ? model.indices->size() / 3 : 0;
+				if (triangle_count == 0 || occluder_triangles + triangle_count > MAX_OCCLUDER_TRIANGLES)
+				{
+					continue;
+				}
+
+				culler.AddOccluder(candidate, *model.positions, *model.indices, model.world);
+				occluder_triangles += triangle_count;
+				++occluder_count;
+			}
+
+			culler.Cull(visible);
+
+			uint64_t* words = samples.data() + static_cast<size_t>(sample) * m_WordCount;
+			for (uint32_t candidate : visible)
+			{
+				uint32_t model = frustum_visible[candidate];
+				words[model / 64] |= 1ull << (model % 64);
+			}
+		}
+	};
+
+	if (job_system != nullptr)
+	{
+		job_system->ParallelFor(thread_count, sample_job);
+	}
+	else
+	{
+		sample_job(0);
+	}
+
+	// A cell sees what its four corners and its centre see
+	std::map<std::vector<uint64_t>, uint32_t> unique_sets;
+	std::vector<uint64_t> cell_words(m_WordCount);
+	std::vector<uint64_t> encoded;
+	m_CellOffsets.resize(static_cast<size_t>(PITCH_CELLS) * YAW_CELLS);
+
+	for (int pitch = 0; pitch < PITCH_CELLS; ++pitch)
+	{
+		for (int yaw = 0; yaw < YAW_CELLS; ++yaw)
+		{
+			const int next_yaw = (yaw + 1) % YAW_CELLS;
+			const int cell_samples[5] =
+			{
+				pitch * YAW_CELLS + yaw,
+				pitch * YAW_CELLS + next_yaw,
+				(pitch + 1) * YAW_CELLS + yaw,
+				(pitch + 1) * YAW_CELLS + next_yaw,
+				CORNER_SAMPLES + pitch * YAW_CELLS + yaw,
+			};
+
+			std::fill(cell_words.begin(), cell_words.end(), 0);
+			for (int sample : cell_samples)
+			{
+				const uint64_t* words = samples.data() + static_cast<size_t>(sample) * m_WordCount;
+				for (size_t i = 0; i < m_WordCount; ++i)
+				{
+					cell_words[i] |= words[i];
+				}
+			}
+
+			encoded.clear();
+			Encode(cell_words, encoded);
+
+			// Neighbouring cells often see the same models so identical sets are only stored once
+			auto it = unique_sets.find(encoded);
+			if (it == unique_sets.end())
+			{
+				it = unique_sets.emplace(encoded, static_cast<uint32_t>(m_Stream.size())).first;
+				m_Stream.insert(m_Stream.end(), encoded.begin(), encoded.end());
+			}
+
+			m_CellOffsets[static_cast<size_t>(pitch) * YAW_CELLS + yaw] = it->second;
+		}
+	}
+
+	m_UniqueSetCount = unique_sets.size();
+	m_Valid = true;
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_BuildMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void Rove::PotentiallyVisibleSet::Invalidate()
+{
+	m_Valid = false;
+	m_ModelCount = 0;
+	m_WordCount = 0;
+	m_UniqueSetCount = 0;
+	m_Stream.clear();
+	m_CellOffsets.clear();
+}
+
+bool Rove::PotentiallyVisibleSet::Covers(Camera& camera) const
+{
+	// Both the vertical and the horizontal extent must fit inside the build projection
+	float tan_half_fov = std::tan(DirectX::XMConvertToRadians(camera.GetFieldOfView()) * 0.5f);
+	return tan_half_fov <= m_TanHalfFov && tan_half_fov * camera.GetAspectRatio() <= m_TanHalfFov * m_AspectRatio;
+}
+
+int Rove::PotentiallyVisibleSet::GetCell(float pitch_radians, float yaw_radians) const
+{
+	float pitch = (pitch_radians + Camera::MAX_PITCH_RADIANS) / (2.0f * Camera::MAX_PITCH_RADIANS);
+	int pitch_cell = std::clamp(static_cast<int>(pitch * PITCH_CELLS), 0, PITCH_CELLS - 1);
+
+	// Yaw keeps accumulating as the camera spins so wrap it first
+	float yaw = std::fmod(yaw_radians, DirectX::XM_2PI);
+	if (yaw < 0.0f)
+	{
+		yaw += DirectX::XM_2PI;
+	}
+
+	int yaw_cell = static_cast<int>(yaw / DirectX::XM_2PI * YAW_CELLS) % YAW_CELLS;
+
+	return pitch_cell * YAW_CELLS + yaw_cell;
+}
+
+void Rove::PotentiallyVisibleSet::GatherNeighbourhood(int cell, std::vector<uint64_t>& words) const
+{
+	words.assign(m_WordCount, 0);
+
+	// The camera can sit anywhere in its cell so the cells around it are included as well
+	const int pitch_cell = cell / YAW_CELLS;
+	const int yaw_cell = cell % YAW_CELLS;
+
+	for (int pitch = std::max(pitch_cell - 1, 0); pitch <= std::min(pitch_cell + 1, PITCH_CELLS - 1); ++pitch)
+	{
+		for (int offset = -1; offset <= 1; ++offset)
+		{
+			int yaw = (yaw_cell + offset + YAW_CELLS) % YAW_CELLS;
+			Decode(m_CellOffsets[static_cast<size_t>(pitch) * YAW_CELLS + yaw], words);
+		}
+	}
+}
+
+void Rove::PotentiallyVisibleSet::Decode(uint32_t offset, std::vector<uint64_t>& words) const
+{
+	size_t position = offset;
+	size_t word = 0;
+
+	while (word < m_WordCount)
+	{
+		uint64_t header = m_Stream[position++];
+		size_t run = static_cast<size_t>((header >> 32) & MAX_RUN);
+		size_t literals = static_cast<size_t>(header & MAX_LITERALS);
+
+		if ((header & RUN_FULL_BIT) != 0)
+		{
+			std::fill(words.begin() + word, words.begin() + word + run, ~0ull);
+		}
+
+		word += run;
+
+		for (size_t i = 0; i < literals; ++i)
+		{
+			words[word++] |= m_Stream[position++];
+		}
+	}
+}
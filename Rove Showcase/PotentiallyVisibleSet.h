@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Pch.h"
+#include "Frustum.h"
+
+namespace Rove
+{
+	// Forward declarations
+	class Camera;
+	class JobSystem;
+
+	// Geometry of a model used as an occluder while the sets are built
+	struct VisibilityModel
+	{
+		const std::vector<DirectX::XMFLOAT3>* positions = nullptr;
+		const std::vector<uint32_t>* indices = nullptr;
+		DirectX::XMMATRIX world;
+	};
+
+	// Precomputed visibility for the orbit camera. The eye is always on a sphere around the origin looking at it, so the
+	// viewpoint is only the pitch and yaw. The sphere is split into cells and the models seen from the corners and centre
+	// of every cell are stored as a run length encoded bitset, identical cells share their encoding.
+	class PotentiallyVisibleSet
+	{
+	public:
+		PotentiallyVisibleSet() = default;
+		virtual ~PotentiallyVisibleSet() = default;
+
+		// Cell resolution, yaw wraps around and pitch covers the range the camera allows
+		static constexpr int PITCH_CELLS = 16;
+		static constexpr int YAW_CELLS = 32;
+
+		// Samples every cell with a CPU depth buffer using the projection of the camera. The bounds and models are parallel
+		// and bit i of a set refers to model i. The field of view is widened so the sets stay valid while the camera zooms
+		// out a little.
+		void Build(const BoundsSoA& bounds, const std::vector<VisibilityModel>& models, Camera& camera, JobSystem* job_system);
+
+		// Discards the sets, called when the scene changes
+		void Invalidate();
+
+		// Sets have been built for the current scene
+		bool IsValid() const { return m_Valid; }
+
+		// The camera field of view fits inside the one the sets were built with
+		bool Covers(Camera& camera) const;
+
+		// Cell of a camera orientation
+		int GetCell(float pitch_radians, float yaw_radians) const;
+
+		// Writes the union of the sets of a cell and its neighbours as one bit per model
+		void GatherNeighbourhood(int cell, std::vector<uint64_t>& words) const;
+
+		// Number of models the sets were built for
+		size_t GetModelCount() const { return m_ModelCount; }
+
+		// Number of distinct sets after identical cells were merged
+		size_t GetUniqueSetCount() const { return m_UniqueSetCount; }
+
+		// Size of the encoded sets and of the same sets stored as plain bitsets
+		size_t GetCompressedBytes() const { return m_Stream.size() * sizeof(uint64_t); }
+		size_t GetUncompressedBytes() const { return static_cast<size_t>(PITCH_CELLS) * YAW_CELLS * m_WordCount * sizeof(uint64_t); }
+
+		// Time taken by the last build
+		double GetBuildMilliseconds() const { return m_BuildMilliseconds; }
+
+	private:
+		bool m_Valid = false;
+		size_t m_ModelCount = 0;
+		size_t m_WordCount = 0;
+		size_t m_UniqueSetCount = 0;
+		double m_BuildMilliseconds = 0.0;
+
+		// Projection the sets were built with
+		float m_TanHalfFov = 0.0f;
+		float m_AspectRatio = 0.0f;
+
+		// Encoded sets and the offset of the set of every cell
+		std::vector<uint64_t> m_Stream;
+		std::vector<uint32_t> m_CellOffsets;
+
+		// Ors the set starting at an offset into a plain bitset
+		void Decode(uint32_t offset, std::vector<uint64_t>& words) const;
+	};
+}
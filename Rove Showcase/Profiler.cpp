@@ -0,0 +1,238 @@
+#include "Pch.h"
+#include "Profiler.h"
+
+namespace
+{
+	// The rate is measured over this long at start up and then again every second over the whole run
+	constexpr uint64_t INITIAL_CALIBRATION_NANOSECONDS = 1000000;
+	constexpr uint64_t CALIBRATION_INTERVAL_NANOSECONDS = 1000000000;
+}
+
+thread_local Rove::ProfileRing* Rove::Profiler::s_ThreadRing = nullptr;
+
+Rove::ProfileRing::ProfileRing(uint32_t index) : m_Index(index), m_Zones(std::make_unique<ProfileZone[]>(SIZE))
+{
+	std::snprintf(Name, sizeof(Name), "Thread %u", index);
+}
+
+void Rove::ProfileRing::Collect(uint64_t since, std::vector<ProfileZone>& zones) const
+{
+	// Zones are pushed as they end so their end times only grow, the zones wanted are the newest ones
+	uint64_t head = m_Head.load(std::memory_order_acquire);
+	uint64_t oldest = head > SIZE ? head - SIZE : 0;
+	uint64_t first = head;
+	while (first > oldest && m_Zones[(first - 1) & (SIZE - 1)].end >= since)
+	{
+		--first;
+	}
+
+	Copy(first, head, zones);
+}
+
+void Rove::ProfileRing::CollectFrom(uint64_t& cursor, std::vector<ProfileZone>& zones) const
+{
+	uint64_t head = m_Head.load(std::memory_order_acquire);
+	uint64_t oldest = head > SIZE ? head - SIZE : 0;
+	Copy(std::max(cursor, oldest), head, zones);
+	cursor = head;
+}
+
+void Rove::ProfileRing::Copy(uint64_t first, uint64_t head, std::vector<ProfileZone>& zones) const
+{
+	size_t begin = zones.size();
+	for (uint64_t i = first; i < head; ++i)
+	{
+		zones.push_back(m_Zones[i & (SIZE - 1)]);
+		zones.back().thread = m_Index;
+	}
+
+	// Drop the zones the writer reused while they were copied, including the slot of the zone it may be writing at the head
+	uint64_t after = m_Head.load(std::memory_order_acquire);
+	uint64_t valid = after + 1 > SIZE ? after + 1 - SIZE : 0;
+	if (valid > first)
+	{
+		size_t overwritten = static_cast<size_t>(std::min(valid - first, head - first));
+		zones.erase(zones.begin() + begin, zones.begin() + begin + overwritten);
+	}
+}
+
+Rove::Profiler& Rove::Profiler::Get()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+Rove::Profiler::Profiler()
+{
+	m_BaseTicks = Ticks();
+	m_BaseTime = Now();
+
+	while (Now() - m_BaseTime < INITIAL_CALIBRATION_NANOSECONDS)
+	{
+	}
+
+	Calibrate();
+}
+
+void Rove::Profiler::Calibrate()
+{
+	// The longer the span the more exact the rate, so it is always measured from the start
+	uint64_t ticks = Ticks();
+	uint64_t time = Now();
+	if (ticks > m_BaseTicks)
+	{
+		m_NanosecondsPerTick.store(static_cast<double>(time - m_BaseTime) / static_cast<double>(ticks - m_BaseTicks), std::memory_order_relaxed);
+	}
+
+	m_CalibrationTime = time;
+}
+
+uint64_t Rove::Profiler::ToNanoseconds(uint64_t ticks) const
+{
+	double offset = static_cast<double>(static_cast<int64_t>(ticks - m_BaseTicks)) * m_NanosecondsPerTick.load(std::memory_order_relaxed);
+	return m_BaseTime + static_cast<int64_t>(offset);
+}
+
+uint64_t Rove::Profiler::ToTicks(uint64_t nanoseconds) const
+{
+	double offset = static_cast<double>(static_cast<int64_t>(nanoseconds - m_BaseTime)) / m_NanosecondsPerTick.load(std::memory_order_relaxed);
+	return m_BaseTicks + static_cast<int64_t>(offset);
+}
+
+Rove::ProfileRing* Rove::Profiler::RegisterThread()
+{
+	std::lock_guard<std::mutex> lock(m_RegisterMutex);
+	uint32_t index = m_ThreadCount.load(std::memory_order_relaxed);
+	if (index == MAX_THREADS)
+	{
+		return nullptr;
+	}
+
+	m_Rings[index] = std::make_unique<ProfileRing>(index);
+	m_ThreadCount.store(index + 1, std::memory_order_release);
+	return m_Rings[index].get();
+}
+
+void Rove::Profiler::SetThreadName(const std::string& name)
+{
+	ProfileRing* ring = GetThreadRing();
+	if (ring != nullptr)
+	{
+		std::snprintf(ring->Name, sizeof(ring->Name), "%s", name.c_str());
+	}
+}
+
+void Rove::Profiler::MarkFrame()
+{
+	uint64_t now = Ticks();
+	if (Now() - m_CalibrationTime > CALIBRATION_INTERVAL_NANOSECONDS)
+	{
+		Calibrate();
+	}
+
+	if (m_FrameStart != 0)
+	{
+		m_Frames[m_FrameCount % FRAME_HISTORY] = { m_FrameCount, m_FrameStart, now };
+		++m_FrameCount;
+	}
+
+	m_FrameStart = now;
+}
+
+void Rove::Profiler::GetFrames(uint32_t count, std::vector<ProfileFrame>& frames) const
+{
+	frames.clear();
+	uint64_t available = std::min<uint64_t>(m_FrameCount, FRAME_HISTORY);
+	for (uint64_t i = m_FrameCount - std::min<uint64_t>(count, available); i < m_FrameCount; ++i)
+	{
+		ProfileFrame frame = m_Frames[i % FRAME_HISTORY];
+		frame.start = ToNanoseconds(frame.start);
+		frame.end = ToNanoseconds(frame.end);
+		frames.push_back(frame);
+	}
+}
+
+void Rove::Profiler::GetZones(uint64_t since, std::vector<ProfileZone>& zones) const
+{
+	zones.clear();
+	uint64_t since_ticks = ToTicks(since);
+	uint32_t thread_count = GetThreadCount();
+	for (uint32_t i = 0; i < thread_count; ++i)
+	{
+		m_Rings[i]->Collect(since_ticks, zones);
+	}
+
+	for (ProfileZone& zone : zones)
+	{
+		zone.start = ToNanoseconds(zone.start);
+		zone.end = ToNanoseconds(zone.end);
+	}
+}
+
+void Rove::Profiler::Counter(const char* name, double value)
+{
+	if (IsEnabled())
+	{
+		m_Counters[m_CounterCount % COUNTER_HISTORY] = { name, Ticks(), value };
+		++m_CounterCount;
+	}
+}
+
+void Rove::Profiler::CollectZones(ProfileCursor& cursor, std::vector<ProfileZone>& zones) const
+{
+	zones.clear();
+	uint32_t thread_count = GetThreadCount();
+	cursor.zones.resize(thread_count, 0);
+	for (uint32_t i = 0; i < thread_count; ++i)
+	{
+		m_Rings[i]->CollectFrom(cursor.zones[i], zones);
+	}
+
+	for (ProfileZone& zone : zones)
+	{
+		zone.start = ToNanoseconds(zone.start);
+		zone.end = ToNanoseconds(zone.end);
+	}
+}
+
+void Rove::Profiler::CollectCounters(ProfileCursor& cursor, std::vector<ProfileCounter>& counters) const
+{
+	counters.clear();
+	uint64_t oldest = m_CounterCount > COUNTER_HISTORY ? m_CounterCount - COUNTER_HISTORY : 0;
+	for (uint64_t i = std::max(cursor.counters, oldest); i < m_CounterCount; ++i)
+	{
+		ProfileCounter counter = m_Counters[i % COUNTER_HISTORY];
+		counter.time = ToNanoseconds(counter.time);
+		counters.push_back(counter);
+	}
+
+	cursor.counters = m_CounterCount;
+}
+
+void Rove::Profiler::CollectFrames(ProfileCursor& cursor, std::vector<ProfileFrame>& frames) const
+{
+	frames.clear();
+	uint64_t oldest = m_FrameCount > FRAME_HISTORY ? m_FrameCount - FRAME_HISTORY : 0;
+	for (uint64_t i = std::max(cursor.frames, oldest); i < m_FrameCount; ++i)
+	{
+		ProfileFrame frame = m_Frames[i % FRAME_HISTORY];
+		frame.start = ToNanoseconds(frame.start);
+		frame.end = ToNanoseconds(frame.end);
+		frames.push_back(frame);
+	}
+
+	cursor.frames = std::max(cursor.frames, m_FrameCount);
+}
+
+void Rove::Profiler::GetCursor(ProfileCursor& cursor) const
+{
+	uint32_t thread_count = GetThreadCount();
+	cursor.zones.resize(thread_count);
+	for (uint32_t i = 0; i < thread_count; ++i)
+	{
+		cursor.zones[i] = m_Rings[i]->GetHead();
+	}
+
+	cursor.counters = m_CounterCount;
+	cursor.frames = m_FrameStart != 0 ? m_FrameCount + 1 : m_FrameCount;
+}
@@ -0,0 +1,259 @@
+#pragma once
+
+#include "Pch.h"
+
+// Define ROVE_PROFILER as 0 to compile every profile zone out
+#ifndef ROVE_PROFILER
+#define ROVE_PROFILER 1
+#endif
+
+#define ROVE_PROFILE_CONCAT_INNER(a, b) a##b
+#define ROVE_PROFILE_CONCAT(a, b) ROVE_PROFILE_CONCAT_INNER(a, b)
+
+#if ROVE_PROFILER
+// Times the rest of the enclosing scope, the name must be a string literal
+#define ROVE_PROFILE_ZONE(name) ::Rove::ProfileScope ROVE_PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+
+// Records the value of a counter from the main thread, the name must be a string literal
+#define ROVE_PROFILE_COUNTER(name, value) ::Rove::Profiler::Get().Counter(name, static_cast<double>(value))
+#else
+#define ROVE_PROFILE_ZONE(name) ((void)0)
+#define ROVE_PROFILE_COUNTER(name, value) ((void)0)
+#endif
+
+namespace Rove
+{
+	// Completed zone, the times are nanoseconds of the profiler clock once collected
+	struct ProfileZone
+	{
+		const char* name;
+		uint64_t start;
+		uint64_t end;
+
+		// Zones open on the same thread when it started
+		uint32_t depth;
+
+		// Index of the thread that timed it, filled in when the zones are collected
+		uint32_t thread;
+	};
+
+	// Start and end of a frame of the main loop
+	struct ProfileFrame
+	{
+		uint64_t index;
+		uint64_t start;
+		uint64_t end;
+	};
+
+	// Value of a counter at a time, nanoseconds of the profiler clock once collected
+	struct ProfileCounter
+	{
+		const char* name;
+		uint64_t time;
+		double value;
+	};
+
+	// Position of a reader in the zone ring of every thread, the counters and the frames
+	struct ProfileCursor
+	{
+		std::vector<uint64_t> zones;
+		uint64_t counters = 0;
+		uint64_t frames = 0;
+	};
+
+	// Zones timed by one thread in time stamp counter ticks. Only that thread writes and it publishes each zone by
+	// advancing the head, readers copy the zones behind the head and drop any the writer may have overwritten meanwhile,
+	// so neither side ever waits.
+	class ProfileRing
+	{
+	public:
+		// About 300 frames of the zones the main thread records, 1 MB a thread
+		static constexpr uint32_t SIZE = 1 << 15;
+
+		ProfileRing(uint32_t index);
+		virtual ~ProfileRing() = default;
+
+		void Push(const char* name, uint64_t start, uint64_t end, uint32_t depth)
+		{
+			uint64_t head = m_Head.load(std::memory_order_relaxed);
+			ProfileZone& zone = m_Zones[head & (SIZE - 1)];
+			zone.name = name;
+			zone.start = start;
+			zone.end = end;
+			zone.depth = depth;
+			m_Head.store(head + 1, std::memory_order_release);
+		}
+
+		// Appends the zones that ended at or after a tick, oldest first
+		void Collect(uint64_t since, std::vector<ProfileZone>& zones) const;
+
+		// Appends the zones pushed since a cursor and moves the cursor past them, zones overwritten before they were
+		// collected are skipped
+		void CollectFrom(uint64_t& cursor, std::vector<ProfileZone>& zones) const;
+
+		// Zones pushed so far, a cursor collecting only the zones after now
+		uint64_t GetHead() const { return m_Head.load(std::memory_order_acquire); }
+
+		// Zones open on the owning thread, only touched by it
+		uint32_t Depth = 0;
+
+		// Name shown in the timeline
+		char Name[32] = {};
+
+	private:
+		uint32_t m_Index = 0;
+		std::atomic<uint64_t> m_Head = 0;
+		std::unique_ptr<ProfileZone[]> m_Zones;
+
+		// Copies the zones from first up to head and drops those the writer reused meanwhile
+		void Copy(uint64_t first, uint64_t head, std::vector<ProfileZone>& zones) const;
+	};
+
+	// Collects the zones timed on every thread and the frames of the main loop. Each thread records into a ring of its
+	// own created the first time it opens a zone, so recording a zone never takes a lock. Zones are timed with the time
+	// stamp counter, which is cheaper to read than the system clock, and converted to nanoseconds when they are read
+	// with the rate measured against the steady clock.
+	class Profiler
+	{
+	public:
+		// Most threads with a ring, zones of further threads are dropped
+		static constexpr uint32_t MAX_THREADS = 64;
+
+		// Frames remembered
+		static constexpr uint32_t FRAME_HISTORY = 1024;
+
+		// Counter values remembered
+		static constexpr uint32_t COUNTER_HISTORY = 1 << 14;
+
+		// The profiler of the process
+		static Profiler& Get();
+
+		// Time stamp counter
+		static uint64_t Ticks() { return __rdtsc(); }
+
+		// Nanoseconds of the steady clock
+		static uint64_t Now()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		// Converts between ticks and nanoseconds of the steady clock
+		uint64_t ToNanoseconds(uint64_t ticks) const;
+		uint64_t ToTicks(uint64_t nanoseconds) const;
+		double GetNanosecondsPerTick() const { return m_NanosecondsPerTick.load(std::memory_order_relaxed); }
+
+		// Ring of the calling thread, null once every ring is taken
+		static ProfileRing* GetThreadRing()
+		{
+			if (s_ThreadRing == nullptr)
+			{
+				s_ThreadRing = Get().RegisterThread();
+			}
+
+			return s_ThreadRing;
+		}
+
+		// Names the calling thread in the timeline
+		void SetThreadName(const std::string& name);
+
+		// Zones are only recorded while enabled
+		void SetEnabled(bool enabled) { m_Enabled.store(enabled, std::memory_order_relaxed); }
+		bool IsEnabled() const { return m_Enabled.load(std::memory_order_relaxed); }
+
+		// Ends the previous frame and starts the next, called once a frame from the main loop. Also refines the tick rate.
+		void MarkFrame();
+
+		// Up to a number of the last completed frames, oldest first. Only safe from the thread calling MarkFrame.
+		void GetFrames(uint32_t count, std::vector<ProfileFrame>& frames) const;
+
+		// Zones of every thread that ended at or after a time
+		void GetZones(uint64_t since, std::vector<ProfileZone>& zones) const;
+
+		// Records the value of a counter at the current time while enabled. Only called from the thread calling MarkFrame.
+		void Counter(const char* name, double value);
+
+		// Zones of every thread pushed since a cursor, which is moved past the zones returned. Threads registered after the
+		// cursor was taken start from their first zone.
+		void CollectZones(ProfileCursor& cursor, std::vector<ProfileZone>& zones) const;
+
+		// Counters recorded and frames completed since a cursor, which is moved past them. Only safe from the thread
+		// calling MarkFrame.
+		void CollectCounters(ProfileCursor& cursor, std::vector<ProfileCounter>& counters) const;
+		void CollectFrames(ProfileCursor& cursor, std::vector<ProfileFrame>& frames) const;
+
+		// Cursor at the current end of every ring and the counters. The frame in progress is skipped as it started
+		// before the cursor.
+		void GetCursor(ProfileCursor& cursor) const;
+
+		// Threads with a ring and the name of each
+		uint32_t GetThreadCount() const { return m_ThreadCount.load(std::memory_order_acquire); }
+		const char* GetThreadName(uint32_t thread) const { return m_Rings[thread]->Name; }
+
+	private:
+		Profiler();
+
+		static thread_local ProfileRing* s_ThreadRing;
+		ProfileRing* RegisterThread();
+
+		std::atomic<bool> m_Enabled = true;
+
+		// Rings are only added, under the mutex, and never removed so readers index them without locking
+		std::mutex m_RegisterMutex;
+		std::unique_ptr<ProfileRing> m_Rings[MAX_THREADS];
+		std::atomic<uint32_t> m_ThreadCount = 0;
+
+		// Tick and time the rate is measured from and the nanoseconds per tick
+		uint64_t m_BaseTicks = 0;
+		uint64_t m_BaseTime = 0;
+		uint64_t m_CalibrationTime = 0;
+		std::atomic<double> m_NanosecondsPerTick = 1.0;
+		void Calibrate();
+
+		// Frames of the main loop in ticks
+		std::vector<ProfileFrame> m_Frames = std::vector<ProfileFrame>(FRAME_HISTORY);
+		uint64_t m_FrameCount = 0;
+		uint64_t m_FrameStart = 0;
+
+		// Counters of the main loop in ticks
+		std::vector<ProfileCounter> m_Counters = std::vector<ProfileCounter>(COUNTER_HISTORY);
+		uint64_t m_CounterCount = 0;
+	};
+
+	// Records the time from its construction to its destruction as a zone of the calling thread
+	class ProfileScope
+	{
+	public:
+		explicit ProfileScope(const char* name) : m_Name(name)
+		{
+			if (Profiler::Get().IsEnabled())
+			{
+				m_Ring = Profiler::GetThreadRing();
+			}
+
+			if (m_Ring != nullptr)
+			{
+				m_Depth = m_Ring->Depth++;
+				m_Start = Profiler::Ticks();
+			}
+		}
+
+		~ProfileScope()
+		{
+			if (m_Ring != nullptr)
+			{
+				uint64_t end = Profiler::Ticks();
+				--m_Ring->Depth;
+				m_Ring->Push(m_Name, m_Start, end, m_Depth);
+			}
+		}
+
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+
+	private:
+		const char* m_Name = nullptr;
+		ProfileRing* m_Ring = nullptr;
+		uint64_t m_Start = 0;
+		uint32_t m_Depth = 0;
+	};
+}
@@ -0,0 +1,155 @@
+#include "Pch.h"
+#include "RenderQueue.h"
+
+namespace
+{
+	constexpr int RADIX_BITS = 8;
+	constexpr int RADIX_SIZE = 1 << RADIX_BITS;
+	constexpr int RADIX_PASSES = 64 / RADIX_BITS;
+
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+Rove::FrameArena::FrameArena(size_t block_size, Allocator* allocator) : m_Allocator(allocator)
+{
+	if (m_Allocator == nullptr)
+	{
+		m_Allocator = &TaggedAllocator::Get(MemoryTag::Frame);
+	}
+
+	AddBlock(block_size);
+}
+
+void* Rove::FrameArena::Allocate(size_t size, size_t alignment)
+{
+	// Align the address rather than the offset as the block itself is only aligned for the allocator default
+	Block* block = &m_Blocks.back();
+	uintptr_t base = reinterpret_cast<uintptr_t>(block->memory.get());
+	size_t offset = AlignUp(base + m_Offset, alignment) - base;
+
+	if (offset + size > block->size)
+	{
+		AddBlock(std::max(block->size * 2, size + alignment));
+		block = &m_Blocks.back();
+		base = reinterpret_cast<uintptr_t>(block->memory.get());
+		offset = AlignUp(base, alignment) - base;
+	}
+
+	m_Offset = offset + size;
+	m_UsedBytes += size;
+	return block->memory.get() + offset;
+}
+
+void Rove::FrameArena::Reset()
+{
+	// Grow to what the frame needed so the next frame fits in a single block
+	if (m_Blocks.size() > 1)
+	{
+		size_t capacity = m_Capacity;
+		m_Blocks.clear();
+		m_Capacity = 0;
+		AddBlock(capacity);
+	}
+
+	m_Offset = 0;
+	m_UsedBytes = 0;
+}
+
+void Rove::FrameArena::AddBlock(size_t size)
+{
+	Block block;
+	// Left uninitialised, the memory is always written before it is read
+	block.memory = std::unique_ptr<uint8_t[], AllocatorDeleter>(static_cast<uint8_t*>(m_Allocator->Allocate(size)), AllocatorDeleter{ m_Allocator });
+	block.size = size;
+	m_Blocks.push_back(std::move(block));
+
+	m_Offset = 0;
+	m_Capacity += size;
+}
+
+uint64_t Rove::RenderQueue::MakeKey(uint32_t pass, uint32_t material_id, uint32_t geometry_id, float depth)
+{
+	const uint64_t depth_max = (1ull << DEPTH_BITS) - 1;
+	uint64_t quantized_depth = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * depth_max);
+
+	uint64_t key = static_cast<uint64_t>(pass) & ((1ull << PASS_BITS) - 1);
+	key = (key << MATERIAL_BITS) | (static_cast<uint64_t>(material_id) & ((1ull << MATERIAL_BITS) - 1));
+	key = (key << GEOMETRY_BITS) | (static_cast<uint64_t>(geometry_id) & ((1ull << GEOMETRY_BITS) - 1));
+	key = (key << DEPTH_BITS) | quantized_depth;
+	return key;
+}
+
+void Rove::RenderQueue::Begin(FrameArena& arena, size_t capacity)
+{
+	m_Arena = &arena;
+	m_Items = arena.Allocate<DrawItem>(capacity);
+	m_Count = 0;
+	m_Capacity = capacity;
+}
+
+void Rove::RenderQueue::Add(uint64_t key, uint32_t index)
+{
+	if (m_Count == m_Capacity)
+	{
+		throw std::exception("Render queue is full");
+	}
+
+	m_Items[m_Count++] = { key, index };
+}
+
+void Rove::RenderQueue::Sort()
+{
+	if (m_Count < 2)
+	{
+		return;
+	}
+
+	// Count every digit in one pass over the keys
+	uint32_t* histograms = m_Arena->Allocate<uint32_t>(RADIX_PASSES * RADIX_SIZE);
+	std::fill(histograms, histograms + RADIX_PASSES * RADIX_SIZE, 0);
+
+	for (size_t i = 0; i < m_Count; ++i)
+	{
+		uint64_t key = m_Items[i].key;
+		for (int pass = 0; pass < RADIX_PASSES; ++pass)
+		{
+			++histograms[pass * RADIX_SIZE + ((key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1))];
+		}
+	}
+
+	DrawItem* source = m_Items;
+	DrawItem* destination = m_Arena->Allocate<DrawItem>(m_Count);
+
+	for (int pass = 0; pass < RADIX_PASSES; ++pass)
+	{
+		uint32_t* histogram = histograms + pass * RADIX_SIZE;
+		const int shift = pass * RADIX_BITS;
+
+		// A digit shared by every key leaves the order unchanged
+		if (histogram[(source[0].key >> shift) & (RADIX_SIZE - 1)] == m_Count)
+		{
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (int digit = 0; digit < RADIX_SIZE; ++digit)
+		{
+			uint32_t count = histogram[digit];
+			histogram[digit] = offset;
+			offset += count;
+		}
+
+		for (size_t i = 0; i < m_Count; ++i)
+		{
+			destination[histogram[(source[i].key >> shift) & (RADIX_SIZE - 1)]++] = source[i];
+		}
+
+		std::swap(source, destination);
+	}
+
+	// Both buffers live until the arena is reset so the sorted one can be used directly
+	m_Items = source;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Pch.h"
+#include "MemoryTracker.h"
+
+namespace Rove
+{
+	// Linear allocator for memory that only lives for one frame. Allocations are a pointer bump and are all released
+	// together by Reset, the blocks are kept so a steady frame does not touch the heap.
+	class FrameArena
+	{
+	public:
+		// Blocks come from the allocator, counted under the frame tag by default
+		FrameArena(size_t block_size = 64 * 1024, Allocator* allocator = nullptr);
+		virtual ~FrameArena() = default;
+
+		// Returns uninitialised memory valid until the next reset
+		void* Allocate(size_t size, size_t alignment);
+
+		template <typename T>
+		T* Allocate(size_t count)
+		{
+			return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+		}
+
+		// Releases every allocation, blocks added during the frame are merged into one
+		void Reset();
+
+		// Bytes allocated since the last reset
+		size_t GetUsedBytes() const { return m_UsedBytes; }
+
+		// Bytes owned by the arena
+		size_t GetCapacity() const { return m_Capacity; }
+
+	private:
+		struct Block
+		{
+			std::unique_ptr<uint8_t[], AllocatorDeleter> memory;
+			size_t size;
+		};
+
+		Allocator* m_Allocator = nullptr;
+		std::vector<Block> m_Blocks;
+		size_t m_Offset = 0;
+		size_t m_UsedBytes = 0;
+		size_t m_Capacity = 0;
+
+		void AddBlock(size_t size);
+	};
+
+	// Draw identified by its sort key and an index into the caller's list of draws
+	struct DrawItem
+	{
+		uint64_t key;
+		uint32_t index;
+	};
+
+	// Draws of one frame ordered by a 64 bit key. From the most significant bit the key holds the pass, the material, the
+	// geometry buffers and the view depth, so sorting groups draws that share state and draws opaque geometry front
+	// to back within each group.
+	class RenderQueue
+	{
+	public:
+		RenderQueue() = default;
+		virtual ~RenderQueue() = default;
+
+		// Key field widths
+		static constexpr int PASS_BITS = 2;
+		static constexpr int MATERIAL_BITS = 20;
+		static constexpr int GEOMETRY_BITS = 18;
+		static constexpr int DEPTH_BITS = 24;
+
+		// Passes in draw order
+		static constexpr uint32_t PASS_OPAQUE = 0;
+
+		// Packs a key, the depth is the view depth divided by the far plane
+		static uint64_t MakeKey(uint32_t pass, uint32_t material_id, uint32_t geometry_id, float depth);
+
+		// Starts a new frame with room for a number of draws allocated from the arena
+		void Begin(FrameArena& arena, size_t capacity);
+
+		// Adds a draw
+		void Add(uint64_t key, uint32_t index);
+
+		// Orders the draws by key with a least significant digit radix sort, byte positions that are equal in every key are
+		// skipped
+		void Sort();
+
+		// Draws in submission order
+		const DrawItem* begin() const { return m_Items; }
+		const DrawItem* end() const { return m_Items + m_Count; }
+		size_t Size() const { return m_Count; }
+
+	private:
+		FrameArena* m_Arena = nullptr;
+		DrawItem* m_Items = nullptr;
+		size_t m_Count = 0;
+		size_t m_Capacity = 0;
+	};
+}
@@ -0,0 +1,82 @@
+#include "RingAllocator.h"
+
+Rove::RingAllocator::RingAllocator(uint64_t size, uint64_t alignment) : m_Alignment(alignment)
+{
+	Reset(size);
+}
+
+void Rove::RingAllocator::Reset(uint64_t size)
+{
+	m_Size = size;
+	m_Head = 0;
+	m_Tail = 0;
+	m_UsedBytes = 0;
+	m_CurrentFrameBytes = 0;
+	m_Frames.clear();
+}
+
+uint64_t Rove::RingAllocator::Allocate(uint64_t size)
+{
+	size = (size + m_Alignment - 1) & ~(m_Alignment - 1);
+	if (size == 0 || m_UsedBytes + size > m_Size)
+	{
+		return INVALID_OFFSET;
+	}
+
+	// Nothing in flight so start from the beginning again
+	if (m_UsedBytes == 0 && m_Frames.empty())
+	{
+		m_Head = 0;
+		m_Tail = 0;
+	}
+
+	if (m_Head >= m_Tail)
+	{
+		// Free space is after the head and before the tail
+		if (m_Head + size <= m_Size)
+		{
+			uint64_t offset = m_Head;
+			m_Head += size;
+			m_UsedBytes += size;
+			m_CurrentFrameBytes += size;
+			return offset;
+		}
+
+		// Skip the end of the buffer and start again from the beginning
+		if (size <= m_Tail)
+		{
+			uint64_t skipped = m_Size - m_Head;
+			m_Head = size;
+			m_UsedBytes += skipped + size;
+			m_CurrentFrameBytes += skipped + size;
+			return 0;
+		}
+	}
+	else if (m_Head + size <= m_Tail)
+	{
+		// The head has wrapped and the free space is between the head and the tail
+		uint64_t offset = m_Head;
+		m_Head += size;
+		m_UsedBytes += size;
+		m_CurrentFrameBytes += size;
+		return offset;
+	}
+
+	return INVALID_OFFSET;
+}
+
+void Rove::RingAllocator::FinishFrame(uint64_t fence)
+{
+	m_Frames.push_back({ fence, m_Head, m_CurrentFrameBytes });
+	m_CurrentFrameBytes = 0;
+}
+
+void Rove::RingAllocator::ReleaseCompletedFrames(uint64_t completed_fence)
+{
+	while (!m_Frames.empty() && m_Frames.front().fence <= completed_fence)
+	{
+		m_Tail = m_Frames.front().head;
+		m_UsedBytes -= m_Frames.front().size;
+		m_Frames.pop_front();
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// Only the standard library so the allocator builds and is tested without a graphics API
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+namespace Rove
+{
+	// Hands out ranges of a circular buffer that the GPU reads from. The ranges allocated during a frame are tagged with
+	// the fence of that frame when it finishes and their space is only reused once that fence has completed. A range
+	// never wraps, when it does not fit before the end the rest of the buffer is skipped and charged to the frame.
+	class RingAllocator
+	{
+	public:
+		// Returned when the space is still in use by frames in flight
+		static constexpr uint64_t INVALID_OFFSET = UINT64_MAX;
+
+		RingAllocator(uint64_t size = 0, uint64_t alignment = 256);
+		virtual ~RingAllocator() = default;
+
+		// Empties the ring and changes its size, which must be a multiple of the alignment
+		void Reset(uint64_t size);
+
+		// Returns the offset of an aligned range or INVALID_OFFSET
+		uint64_t Allocate(uint64_t size);
+
+		// Tags everything allocated since the last call with the fence of the frame
+		void FinishFrame(uint64_t fence);
+
+		// Frees the frames whose fence is at or below the completed value
+		void ReleaseCompletedFrames(uint64_t completed_fence);
+
+		// Total size of the ring
+		uint64_t GetSize() const { return m_Size; }
+
+		// Bytes held by frames in flight and the current frame
+		uint64_t GetUsedBytes() const { return m_UsedBytes; }
+
+		// Number of finished frames not yet released
+		size_t GetFramesInFlight() const { return m_Frames.size(); }
+
+	private:
+		uint64_t m_Size = 0;
+		uint64_t m_Alignment = 0;
+
+		// Allocations are made at the head and released from the tail
+		uint64_t m_Head = 0;
+		uint64_t m_Tail = 0;
+		uint64_t m_UsedBytes = 0;
+		uint64_t m_CurrentFrameBytes = 0;
+
+		// Head position and size of every finished frame
+		struct FrameMark
+		{
+			uint64_t fence;
+			uint64_t head;
+			uint64_t size;
+		};
+
+		std::deque<FrameMark> m_Frames;
+	};
+}
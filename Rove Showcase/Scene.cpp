@@ -0,0 +1,931 @@
+#include "Pch.h"
+#include "Scene.h"
+#include "DxRenderer.h"
+#include "DxShader.h"
+#include "Camera.h"
+#include "WorldTransforms.h"
+#include "LightList.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+namespace
+{
+	// Models covering less of the screen than this are never occluders
+	constexpr float MIN_OCCLUDER_COVERAGE = 0.05f;
+
+	// Limits on the occluders rasterized each frame
+	constexpr int MAX_OCCLUDERS = 16;
+	constexpr size_t MAX_OCCLUDER_TRIANGLES = 32768;
+
+	// Material and shader variant indices are stored in the bits the sort key and the draw commands have for them
+	static_assert(Rove::MaterialTable::MAX_MATERIALS <= (1u << Rove::RenderQueue::MATERIAL_BITS), "Materials must fit in the sort key");
+	static_assert(Rove::MaterialTable::MAX_MATERIALS <= (1u << Rove::RenderCommand::MATERIAL_BITS), "Materials must fit in a command");
+	static_assert(Rove::ShaderPermutation::KEY_COUNT <= (1u << Rove::RenderCommand::SHADER_BITS), "Shader variants must fit in a command");
+
+	// Light lists built by each job
+	constexpr uint32_t LIGHT_LISTS_PER_JOB = 256;
+
+	uint64_t PackProxy(size_t object_index, size_t model_index)
+	{
+		return (static_cast<uint64_t>(object_index) << 32) | static_cast<uint64_t>(model_index);
+	}
+
+	size_t ObjectIndex(uint64_t user_data)
+	{
+		return static_cast<size_t>(user_data >> 32);
+	}
+
+	size_t ModelIndex(uint64_t user_data)
+	{
+		return static_cast<size_t>(user_data & 0xFFFFFFFF);
+	}
+
+	// Geometry id and draw range of a command
+	void SetGeometry(Rove::RenderCommand& command, uint32_t id, const Rove::MeshGeometry* geometry)
+	{
+		command.geometry = id;
+		command.index_count = geometry->IndexCount;
+		command.start_index = geometry->StartIndexLocation;
+		command.base_vertex = geometry->BaseVertexLocation;
+		command.vertex_count = geometry->VertexCount;
+	}
+
+	// Consecutive draws in the render queue sharing geometry and material, submitted as one instanced draw. A model with
+	// its own instances is always a batch of one drawing its visible instances.
+	struct DrawBatch
+	{
+		uint32_t first;
+		uint32_t count;
+		uint32_t instance_count;
+
+		// First world constant or instance of the batch in the buffers uploaded for the frame
+		uint32_t offset;
+		bool instanced;
+
+		// World constant of an instanced batch holding only its light list
+		uint32_t constants;
+
+		// Shader variant of the batch
+		uint16_t shader;
+	};
+}
+
+Rove::Scene::Scene(DxRenderer* renderer, DxShader* shader, JobSystem* job_system) : m_DxRenderer(renderer), m_DxShader(shader), m_JobSystem(job_system), m_MaterialTable(renderer), m_GeometryPool(renderer), m_StaticBatcher(renderer, shader, &m_MaterialTable, &m_GeometryPool, job_system), m_OcclusionCuller(job_system), m_CommandBackend(renderer, shader, &m_MaterialTable, job_system)
+{
+}
+
+Rove::Object* Rove::Scene::AddObject(const std::filesystem::path& path)
+{
+	ROVE_PROFILE_ZONE("Load");
+
+	auto object = std::make_unique<Rove::Object>(m_DxRenderer, m_DxShader, &m_MaterialTable, &m_GeometryPool, m_JobSystem);
+	object->LoadFile(path);
+	AssignRenderIds(object.get());
+
+	m_Objects.push_back(std::move(object));
+	m_ObjectProxies.emplace_back();
+
+	// The new object has no world constants yet so the update computes them before the proxies are created
+	Update();
+	CreateProxies(m_Objects.size() - 1);
+	InvalidateVisibilitySets();
+
+	return m_Objects.back().get();
+}
+
+void Rove::Scene::RemoveObject(Object* object)
+{
+	auto it = std::find_if(m_Objects.begin(), m_Objects.end(), [object](const std::unique_ptr<Object>& o) { return o.get() == object; });
+	if (it == m_Objects.end())
+	{
+		return;
+	}
+
+	size_t object_index = std::distance(m_Objects.begin(), it);
+	DestroyProxies(object_index);
+	ReleaseRenderIds(object);
+	m_StaticBatcher.RemoveObject(object);
+
+	m_Objects.erase(it);
+	m_ObjectProxies.erase(m_ObjectProxies.begin() + object_index);
+
+	// The visible list refers to object indices so it is stale until the next cull
+	m_VisibleModels.clear();
+	InvalidateVisibilitySets();
+
+	// Objects after the removed one have shifted down
+	for (size_t i = object_index; i < m_Objects.size(); ++i)
+	{
+		for (size_t j = 0; j < m_ObjectProxies[i].size(); ++j)
+		{
+			m_SpatialIndex.SetUserData(m_ObjectProxies[i][j], PackProxy(i, j));
+		}
+	}
+}
+
+void Rove::Scene::Clear()
+{
+	m_StaticBatcher.Clear();
+	m_Objects.clear();
+	m_ObjectProxies.clear();
+	m_SpatialIndex.Clear();
+	m_VisibleModels.clear();
+	m_MaterialTable.Clear();
+	m_GeometryIds.clear();
+	m_FreeGeometryIds.clear();
+	m_Geometries.clear();
+	InvalidateVisibilitySets();
+}
+
+void Rove::Scene::Update()
+{
+	ROVE_PROFILE_ZONE("Update transforms");
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Only objects that moved since the last frame are gathered
+	m_DirtyObjects.clear();
+	m_DirtyWorlds.clear();
+	for (size_t i = 0; i < m_Objects.size(); ++i)
+	{
+		if (m_Objects[i]->IsTransformDirty())
+		{
+			m_DirtyObjects.push_back(i);
+			m_Objects[i]->GetWorlds(m_DirtyWorlds);
+		}
+	}
+
+	if (m_DirtyObjects.empty())
+	{
+		m_TransformStats = TransformStats();
+		return;
+	}
+
+	// Every dirty model is transposed and inverted in one batch
+	m_DirtyWorldBuffers.resize(m_DirtyWorlds.size());
+	ComputeWorldBuffers(m_DirtyWorlds.data(), m_DirtyWorldBuffers.data(), m_DirtyWorlds.size());
+
+	size_t first = 0;
+	for (size_t i : m_DirtyObjects)
+	{
+		Object* object = m_Objects[i].get();
+		first += object->SetWorlds(m_DirtyWorlds.data() + first, m_DirtyWorldBuffers.data() + first);
+		m_StaticBatcher.MarkDirty(object);
+
+		const BoundsSoA& bounds = object->GetWorldBounds();
+		const std::vector<int>& proxies = m_ObjectProxies[i];
+		for (size_t j = 0; j < proxies.size(); ++j)
+		{
+			m_SpatialIndex.MoveProxy(proxies[j], bounds.Get(j));
+		}
+	}
+
+	InvalidateVisibilitySets();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_TransformStats.updated_objects = static_cast<int>(m_DirtyObjects.size());
+	m_TransformStats.updated_models = static_cast<int>(m_DirtyWorlds.size());
+	m_TransformStats.update_microseconds = std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+void Rove::Scene::Cull(Camera& camera)
+{
+	ROVE_PROFILE_ZONE("Cull");
+
+	Update();
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_CullingStats.occluded_models = 0;
+	m_CullingStats.occluder_count = 0;
+	m_CullingStats.occluder_triangles = 0;
+	m_CullingStats.occlusion_microseconds = 0.0;
+
+	// The precomputed sets replace both culling passes while the scene is static and the projection fits
+	m_CullingStats.precomputed_visibility = EnablePrecomputedVisibility && m_PotentiallyVisibleSet.IsValid() && m_PotentiallyVisibleSet.Covers(camera);
+	if (m_CullingStats.precomputed_visibility)
+	{
+		CullPrecomputed(camera);
+
+		auto end = std::chrono::high_resolution_clock::now();
+		m_CullingStats.visible_models = static_cast<int>(m_VisibleModels.size());
+		m_CullingStats.total_models = m_SpatialIndex.GetProxyCount();
+		m_CullingStats.culling_microseconds = std::chrono::duration<double, std::micro>(end - start).count();
+		return;
+	}
+
+	m_VisibilityCell = -1;
+	const Frustum& frustum = camera.GetFrustum();
+
+	// Hierarchical cull, whole subtrees inside the frustum are accepted without testing their leaves
+	m_InsideProxies.clear();
+	m_IntersectingProxies.clear();
+	m_SpatialIndex.QueryFrustum(frustum, m_InsideProxies, m_IntersectingProxies);
+
+	m_VisibleModels.clear();
+	for (int proxy : m_InsideProxies)
+	{
+		m_VisibleModels.push_back(m_SpatialIndex.GetUserData(proxy));
+	}
+
+	// Leaves straddling a plane are tested against their exact bounds in SIMD batches
+	m_IntersectingBounds.Clear();
+	for (int proxy : m_IntersectingProxies)
+	{
+		uint64_t user_data = m_SpatialIndex.GetUserData(proxy);
+		m_IntersectingBounds.Add(m_Objects[ObjectIndex(user_data)]->GetWorldBounds().Get(ModelIndex(user_data)));
+	}
+
+	frustum.Cull(m_IntersectingBounds, m_IntersectingVisible);
+	for (uint32_t index : m_IntersectingVisible)
+	{
+		m_VisibleModels.push_back(m_SpatialIndex.GetUserData(m_IntersectingProxies[index]));
+	}
+
+	// Object order so the object transformation is only built once per object
+	std::sort(m_VisibleModels.begin(), m_VisibleModels.end());
+
+	auto frustum_end = std::chrono::high_resolution_clock::now();
+
+	if (EnableOcclusionCulling && !m_VisibleModels.empty())
+	{
+		CullOccluded(camera.GetViewProjection());
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	m_CullingStats.visible_models = static_cast<int>(m_VisibleModels.size());
+	m_CullingStats.total_models = m_SpatialIndex.GetProxyCount();
+	m_CullingStats.culling_microseconds = std::chrono::duration<double, std::micro>(end - start).count();
+	m_CullingStats.occlusion_microseconds = std::chrono::duration<double, std::micro>(end - frustum_end).count();
+}
+
+void Rove::Scene::Render(Camera& camera)
+{
+	ROVE_PROFILE_ZONE("Render");
+
+	m_FrameArena.Reset();
+	++m_FrameIndex;
+
+	// Batched models are drawn from the merged geometry of their material instead of on their own
+	const std::map<uint32_t, StaticBatch>* static_batches = nullptr;
+	if (EnableStaticBatching)
+	{
+		m_StaticBatcher.Update(m_Objects);
+		static_batches = &m_StaticBatcher.GetBatches();
+	}
+
+	// Key every visible model by its state and the view depth of its bounds centre
+	const DirectX::XMMATRIX view = camera.GetView();
+	m_RenderQueue.Begin(m_FrameArena, m_VisibleModels.size());
+
+	for (uint32_t i = 0; i < m_VisibleModels.size(); ++i)
+	{
+		uint64_t visible = m_VisibleModels[i];
+		Object* object = m_Objects[ObjectIndex(visible)].get();
+		size_t model_index = ModelIndex(visible);
+
+		const BoundsSoA& bounds = object->GetWorldBounds();
+		DirectX::XMVECTOR center = DirectX::XMVectorSet(bounds.center_x[model_index], bounds.center_y[model_index], bounds.center_z[model_index], 1.0f);
+		float depth = DirectX::XMVectorGetZ(DirectX::XMVector3Transform(center, view)) / Camera::FAR_PLANE;
+
+		const Model* model = object->GetModels()[model_index].get();
+		if (static_batches != nullptr && model->Instances.empty())
+		{
+			continue;
+		}
+
+		m_RenderQueue.Add(RenderQueue::MakeKey(RenderQueue::PASS_OPAQUE, model->MaterialIndex, model->GeometryId, depth), i);
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	if (EnableDrawSorting)
+	{
+		ROVE_PROFILE_ZONE("Sort");
+		m_RenderQueue.Sort();
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	// State changes of the scene order for comparison
+	int unsorted_state_changes = 0;
+	const Model* previous = nullptr;
+	for (uint64_t visible : m_VisibleModels)
+	{
+		const Model* model = m_Objects[ObjectIndex(visible)]->GetModels()[ModelIndex(visible)].get();
+		unsorted_state_changes += Model::CountStateChanges(previous, model);
+		previous = model;
+	}
+
+	// Sorting places models with the same material and geometry next to each other, each run becomes one draw
+	DrawBatch* batches = m_FrameArena.Allocate<DrawBatch>(m_RenderQueue.Size());
+	size_t batch_count = 0;
+	size_t instance_capacity = 0;
+	const Model* batch_model = nullptr;
+	uint32_t position = 0;
+	for (const DrawItem& item : m_RenderQueue)
+	{
+		uint64_t visible = m_VisibleModels[item.index];
+		const Model* model = m_Objects[ObjectIndex(visible)]->GetModels()[ModelIndex(visible)].get();
+
+		if (EnableInstancing && batch_model != nullptr && model->Instances.empty() && batch_model->Instances.empty() &&
+			batch_model->Geometry == model->Geometry && batch_model->MaterialIndex == model->MaterialIndex)
+		{
+			++batches[batch_count - 1].count;
+			batches[batch_count - 1].instanced = true;
+		}
+		else
+		{
+			batches[batch_count++] = { position, 1, 0, 0, !model->Instances.empty() };
+			batch_model = model;
+		}
+
+		instance_capacity += std::max<size_t>(model->Instances.size(), 1);
+		++position;
+	}
+
+	// Cached world constants gathered in submission order, single draws read them from the constant ring and instanced
+	// draws from the instance stream, each uploaded with one map. Instanced draws still get world constants of their own
+	// for their light list, and the bounds of every world constant are kept to build the lists from.
+	size_t static_batch_count = static_batches != nullptr ? static_batches->size() : 0;
+	size_t world_capacity = m_RenderQueue.Size() + batch_count + static_batch_count;
+	WorldBuffer* world_buffers = m_FrameArena.Allocate<WorldBuffer>(world_capacity);
+	DirectX::BoundingBox* light_bounds = m_FrameArena.Allocate<DirectX::BoundingBox>(world_capacity);
+	WorldBuffer* instance_buffers = m_FrameArena.Allocate<WorldBuffer>(instance_capacity);
+
+	// Batch of the first world constant or instance of each batch, to find the models of a command after the merge
+	uint32_t* world_batches = m_FrameArena.Allocate<uint32_t>(world_capacity);
+	uint32_t* instance_batches = m_FrameArena.Allocate<uint32_t>(instance_capacity);
+	size_t world_count = 0;
+	size_t instance_count = 0;
+	int visible_instances = 0;
+	int total_instances = 0;
+	const Frustum& frustum = camera.GetFrustum();
+	const DrawItem* items = m_RenderQueue.begin();
+	for (size_t i = 0; i < batch_count; ++i)
+	{
+		DrawBatch& batch = batches[i];
+		uint64_t first = m_VisibleModels[items[batch.first].index];
+		Object* object = m_Objects[ObjectIndex(first)].get();
+		batch.offset = static_cast<uint32_t>(batch.instanced ? instance_count : world_count);
+		(batch.instanced ? instance_batches : world_batches)[batch.offset] = static_cast<uint32_t>(i);
+
+		// The light list of an instanced draw covers the bounds of all its models, a model with its own instances is
+		// already bounded by all of them
+		if (batch.instanced)
+		{
+			DirectX::BoundingBox bounds = object->GetWorldBounds().Get(ModelIndex(first));
+			for (uint32_t j = batch.first + 1; j < batch.first + batch.count; ++j)
+			{
+				uint64_t visible = m_VisibleModels[items[j].index];
+				DirectX::BoundingBox::CreateMerged(bounds, bounds, m_Objects[ObjectIndex(visible)]->GetWorldBounds().Get(ModelIndex(visible)));
+			}
+
+			batch.constants = static_cast<uint32_t>(world_count);
+			light_bounds[world_count] = bounds;
+			world_buffers[world_count++] = { DirectX::XMMatrixIdentity(), DirectX::XMMatrixIdentity() };
+		}
+
+		// The instances of an instanced model are culled in SIMD batches and the visible ones compacted into the stream
+		if (!object->GetModels()[ModelIndex(first)]->Instances.empty())
+		{
+			frustum.Cull(object->GetInstanceBounds(ModelIndex(first)), m_InstanceVisible);
+
+			const std::vector<WorldBuffer>& instance_world_buffers = object->GetInstanceWorldBuffers(ModelIndex(first));
+			for (uint32_t instance : m_InstanceVisible)
+			{
+				instance_buffers[instance_count++] = instance_world_buffers[instance];
+			}
+
+			batch.instance_count = static_cast<uint32_t>(m_InstanceVisible.size());
+			visible_instances += static_cast<int>(m_InstanceVisible.size());
+			total_instances += static_cast<int>(instance_world_buffers.size());
+			continue;
+		}
+
+		batch.instance_count = batch.count;
+		for (uint32_t j = batch.first; j < batch.first + batch.count; ++j)
+		{
+			uint64_t visible = m_VisibleModels[items[j].index];
+			const WorldBuffer& world_buffer = m_Objects[ObjectIndex(visible)]->GetWorldBuffers()[ModelIndex(visible)];
+			if (batch.instanced)
+			{
+				instance_buffers[instance_count++] = world_buffer;
+			}
+			else
+			{
+				light_bounds[world_count] = m_Objects[ObjectIndex(visible)]->GetWorldBounds().Get(ModelIndex(visible));
+				world_buffers[world_count++] = world_buffer;
+			}
+		}
+	}
+
+	// Static batches are already in world space and culled as a whole, they follow the single draws in the ring
+	const StaticBatch** visible_batches = m_FrameArena.Allocate<const StaticBatch*>(static_batch_count);
+	size_t static_world_first = world_count;
+	int visible_static_batches = 0;
+	int batched_models = 0;
+	if (static_batches != nullptr)
+	{
+		for (auto& static_batch : *static_batches)
+		{
+			if (frustum.Intersects(static_batch.second.bounds))
+			{
+				light_bounds[world_count] = static_batch.second.bounds;
+				world_buffers[world_count++] = { DirectX::XMMatrixIdentity(), DirectX::XMMatrixIdentity() };
+				visible_batches[visible_static_batches++] = &static_batch.second;
+			}
+
+			batched_models += static_batch.second.model_count;
+		}
+	}
+
+	// Light list of every world constant, built on the job system with the lights tested 4 at a time
+	auto assign_start = std::chrono::high_resolution_clock::now();
+	ObjectLightList* light_lists = nullptr;
+	int object_lights = 0;
+	int truncated_light_lists = 0;
+	if (EnablePerObjectLights && m_Lights != nullptr)
+	{
+		ROVE_PROFILE_ZONE("Light lists");
+		light_lists = m_FrameArena.Allocate<ObjectLightList>(world_count);
+		uint32_t* reached = m_FrameArena.Allocate<uint32_t>(world_count);
+		m_ObjectLights.Begin(m_Lights->GetSpheres(), m_Lights->Size());
+
+		auto assign = [&](uint32_t job)
+		{
+			size_t end = std::min<size_t>(world_count, (job + 1) * static_cast<size_t>(LIGHT_LISTS_PER_JOB));
+			for (size_t i = job * static_cast<size_t>(LIGHT_LISTS_PER_JOB); i < end; ++i)
+			{
+				reached[i] = m_ObjectLights.Assign(light_bounds[i], &light_lists[i]);
+			}
+		};
+
+		uint32_t job_count = static_cast<uint32_t>((world_count + LIGHT_LISTS_PER_JOB - 1) / LIGHT_LISTS_PER_JOB);
+		if (m_JobSystem != nullptr)
+		{
+			m_JobSystem->ParallelFor(job_count, assign);
+		}
+		else
+		{
+			for (uint32_t job = 0; job < job_count; ++job)
+			{
+				assign(job);
+			}
+		}
+
+		for (size_t i = 0; i < world_count; ++i)
+		{
+			object_lights += static_cast<int>(light_lists[i].count);
+			truncated_light_lists += reached[i] > ObjectLightList::MAX_LIGHTS ? 1 : 0;
+		}
+	}
+
+	auto assign_end = std::chrono::high_resolution_clock::now();
+
+	// Shader variant of every draw from its material, its light list and the kind of draw, looked up before recording
+	// as the variant cache is not shared between threads
+	for (size_t i = 0; i < batch_count; ++i)
+	{
+		DrawBatch& batch = batches[i];
+		uint64_t visible = m_VisibleModels[items[batch.first].index];
+		const Model* model = m_Objects[ObjectIndex(visible)]->GetModels()[ModelIndex(visible)].get();
+
+		int light_count = light_lists != nullptr ? static_cast<int>(light_lists[batch.instanced ? batch.constants : batch.offset].count) : -1;
+		batch.shader = GetShaderVariant(model->MaterialIndex, light_count, batch.instanced);
+	}
+
+	uint16_t* static_batch_shaders = m_FrameArena.Allocate<uint16_t>(visible_static_batches);
+	for (int i = 0; i < visible_static_batches; ++i)
+	{
+		int light_count = light_lists != nullptr ? static_cast<int>(light_lists[static_world_first + i].count) : -1;
+		static_batch_shaders[i] = GetShaderVariant(visible_batches[i]->model->MaterialIndex, light_count, false);
+	}
+
+	m_DxShader->CreateVariants();
+
+	UINT world_constant = m_DxShader->UpdateWorldConstants(world_buffers, light_lists, world_count);
+	UINT first_instance = m_DxShader->UpdateInstances(instance_buffers, instance_count);
+
+	// Record a command for every draw on the job system, without sorting the queue position keeps the scene order
+	auto record_start = std::chrono::high_resolution_clock::now();
+	m_CommandRecorder.Begin();
+	m_CommandRecorder.Record(m_JobSystem, static_cast<uint32_t>(batch_count), [&](uint32_t begin, uint32_t end, std::vector<RenderCommand>& commands)
+	{
+		ROVE_PROFILE_ZONE("Record");
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const DrawBatch& batch = batches[i];
+			if (batch.instance_count == 0)
+			{
+				continue;
+			}
+
+			uint64_t visible = m_VisibleModels[items[batch.first].index];
+			const Model* model = m_Objects[ObjectIndex(visible)]->GetModels()[ModelIndex(visible)].get();
+
+			RenderCommand command = {};
+			command.key = EnableDrawSorting ? items[batch.first].key : batch.first;
+			SetGeometry(command, model->GeometryId, model->Geometry.get());
+			command.material = model->MaterialIndex;
+			command.shader = batch.shader;
+			command.first = batch.instanced ? first_instance + batch.offset : world_constant + batch.offset * DxShader::WORLD_CONSTANTS;
+			command.instance_count = batch.instanced ? batch.instance_count : 0;
+			command.constants = batch.instanced ? world_constant + batch.constants * DxShader::WORLD_CONSTANTS : 0;
+			commands.push_back(command);
+		}
+	});
+
+	// Static batches are not in the render queue, their geometry takes the ids after those of the models for this frame
+	uint32_t static_geometry_first = static_cast<uint32_t>(m_GeometryIds.size() + m_FreeGeometryIds.size());
+	m_Geometries.resize(static_geometry_first);
+	for (int i = 0; i < visible_static_batches; ++i)
+	{
+		m_Geometries.push_back(visible_batches[i]->model->Geometry.get());
+	}
+
+	m_CommandRecorder.Record(nullptr, static_cast<uint32_t>(visible_static_batches), [&](uint32_t begin, uint32_t end, std::vector<RenderCommand>& commands)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const Model* model = visible_batches[i]->model.get();
+
+			RenderCommand command = {};
+			command.key = EnableDrawSorting ? RenderQueue::MakeKey(RenderQueue::PASS_OPAQUE, model->MaterialIndex, 0, 0.0f) : m_RenderQueue.Size() + i;
+			SetGeometry(command, static_geometry_first + i, model->Geometry.get());
+			command.material = model->MaterialIndex;
+			command.shader = static_batch_shaders[i];
+			command.first = world_constant + static_cast<uint32_t>(static_world_first + i) * DxShader::WORLD_CONSTANTS;
+			commands.push_back(command);
+		}
+	});
+
+	m_CommandRecorder.Merge();
+	auto record_end = std::chrono::high_resolution_clock::now();
+
+	// Replay onto the immediate context, the state cache drops the bindings that match the draw before
+	const std::vector<RenderCommand>& commands = m_CommandRecorder.GetCommands();
+	m_CommandBackend.UseDeferredContexts = EnableDeferredContexts;
+	m_CommandBackend.SetGeometries(m_Geometries.data());
+	m_CommandCosts.resize(commands.size());
+	CommandStats command_stats = m_CommandBackend.Execute(commands.data(), commands.size(), m_CommandCosts.data());
+
+	m_DxShader->FinishFrame();
+
+	// Cost of each command shared between the models of its batch, static batches draw many models at once and are
+	// left out
+	double microseconds_per_tick = Profiler::Get().GetNanosecondsPerTick() / 1000.0;
+	for (size_t i = 0; i < commands.size(); ++i)
+	{
+		const RenderCommand& command = commands[i];
+		size_t world_index = (command.first - world_constant) / DxShader::WORLD_CONSTANTS;
+		if (command.instance_count == 0 && world_index >= static_world_first)
+		{
+			continue;
+		}
+
+		const DrawBatch& batch = batches[command.instance_count > 0 ? instance_batches[command.first - first_instance] : world_batches[world_index]];
+		float share = 1.0f / batch.count;
+		for (uint32_t j = batch.first; j < batch.first + batch.count; ++j)
+		{
+			uint64_t visible = m_VisibleModels[items[j].index];
+			Model* model = m_Objects[ObjectIndex(visible)]->GetModels()[ModelIndex(visible)].get();
+
+			// A model with its own instances draws every visible one, otherwise each model of the batch is one instance
+			int64_t instances = batch.count == 1 ? std::max(command.instance_count, 1u) : 1;
+			model->Stats.frame = m_FrameIndex;
+			model->Stats.draws = 1;
+			model->Stats.triangles = instances * (command.index_count / 3);
+			model->Stats.vertices = instances * command.vertex_count;
+			model->Stats.state_changes = m_CommandCosts[i].state_changes * share;
+			model->Stats.submit_microseconds = m_CommandCosts[i].ticks * microseconds_per_tick * share;
+		}
+	}
+
+	m_RenderStats.model_count = static_cast<int>(m_RenderQueue.Size()) + batched_models;
+	m_RenderStats.draw_count = command_stats.draws;
+	m_RenderStats.instanced_draws = command_stats.instanced_draws;
+	m_RenderStats.triangle_count = command_stats.triangles;
+	m_RenderStats.vertex_count = command_stats.vertices;
+	m_RenderStats.buffer_binds = command_stats.buffer_binds;
+	m_RenderStats.resource_binds = command_stats.resource_binds;
+	m_RenderStats.constant_bytes = m_DxShader->GetConstantBytes() - m_ConstantBytes;
+	m_ConstantBytes = m_DxShader->GetConstantBytes();
+	m_RenderStats.visible_instances = visible_instances;
+	m_RenderStats.total_instances = total_instances;
+	m_RenderStats.static_batches = visible_static_batches;
+	m_RenderStats.batched_models = batched_models;
+	m_RenderStats.unsorted_state_changes = unsorted_state_changes;
+	m_RenderStats.state_changes = command_stats.state_changes;
+	m_RenderStats.sort_microseconds = std::chrono::duration<double, std::micro>(end - start).count();
+	m_RenderStats.command_buffers = static_cast<int>(m_CommandRecorder.GetBufferCount());
+	m_RenderStats.record_microseconds = std::chrono::duration<double, std::micro>(record_end - record_start).count();
+	m_RenderStats.light_lists = light_lists != nullptr ? static_cast<int>(world_count) : 0;
+	m_RenderStats.object_lights = object_lights;
+	m_RenderStats.truncated_light_lists = truncated_light_lists;
+	m_RenderStats.light_assign_microseconds = std::chrono::duration<double, std::micro>(assign_end - assign_start).count();
+}
+
+void Rove::Scene::CullOccluded(const DirectX::XMMATRIX& view_projection)
+{
+	ROVE_PROFILE_ZONE("Occlusion");
+
+	// Exact bounds of the models left by the frustum
+	m_CandidateBounds.Clear();
+	for (uint64_t visible : m_VisibleModels)
+	{
+		m_CandidateBounds.Add(m_Objects[ObjectIndex(visible)]->GetWorldBounds().Get(ModelIndex(visible)));
+	}
+
+	m_OcclusionCuller.Begin(view_projection, m_CandidateBounds);
+
+	// The models covering the most screen become occluders while they fit in the triangle budget
+	m_OccluderOrder.clear();
+	for (uint32_t i = 0; i < m_VisibleModels.size(); ++i)
+	{
+		if (m_OcclusionCuller.GetScreenCoverage(i) >= MIN_OCCLUDER_COVERAGE)
+		{
+			m_OccluderOrder.push_back(i);
+		}
+	}
+
+	std::sort(m_OccluderOrder.begin(), m_OccluderOrder.end(), [this](uint32_t a, uint32_t b)
+	{
+		return m_OcclusionCuller.GetScreenCoverage(a) > m_OcclusionCuller.GetScreenCoverage(b);
+	});
+
+	size_t occluder_triangles = 0;
+	int occluder_count = 0;
+
+	for (uint32_t candidate : m_OccluderOrder)
+	{
+		if (occluder_count == MAX_OCCLUDERS)
+		{
+			break;
+		}
+
+		uint64_t visible = m_VisibleModels[candidate];
+		Model* model = m_Objects[ObjectIndex(visible)]->GetModels()[ModelIndex(visible)].get();
+
+		// Instanced models are bounded by all of their instances so their triangles cannot stand in for them
+		size_t triangle_count = model->Instances.empty() ? model->Geometry->Indices.size() / 3 : 0;
+		if (triangle_count == 0 || occluder_triangles + triangle_count > MAX_OCCLUDER_TRIANGLES)
+		{
+			continue;
+		}
+
+		m_OcclusionCuller.AddOccluder(candidate, model->Geometry->Positions, model->Geometry->Indices, m_Objects[ObjectIndex(visible)]->GetWorld(ModelIndex(visible)));
+		occluder_triangles += triangle_count;
+		++occluder_count;
+	}
+
+	m_OcclusionCuller.Cull(m_OcclusionVisible);
+
+	// The visible indices are ascending so the list can be compacted in place
+	for (size_t i = 0; i < m_OcclusionVisible.size(); ++i)
+	{
+		m_VisibleModels[i] = m_VisibleModels[m_OcclusionVisible[i]];
+	}
+
+	m_CullingStats.occluded_models = static_cast<int>(m_VisibleModels.size() - m_OcclusionVisible.size());
+	m_CullingStats.occluder_count = occluder_count;
+	m_CullingStats.occluder_triangles = static_cast<int>(occluder_triangles);
+	m_VisibleModels.resize(m_OcclusionVisible.size());
+}
+
+void Rove::Scene::BuildVisibilitySets(Camera& camera)
+{
+	Update();
+
+	// Flatten every model in object order so the sets expand to a sorted visible list
+	BoundsSoA bounds;
+	std::vector<VisibilityModel> models;
+	m_VisibilityModels.clear();
+
+	for (size_t i = 0; i < m_Objects.size(); ++i)
+	{
+		const BoundsSoA& world_bounds = m_Objects[i]->GetWorldBounds();
+		const std::vector<std::unique_ptr<Model>>& object_models = m_Objects[i]->GetModels();
+
+		for (size_t j = 0; j < object_models.size(); ++j)
+		{
+			// Instanced models are never occluders
+			VisibilityModel model;
+			if (object_models[j]->Instances.empty())
+			{
+				model.positions = &object_models[j]->Geometry->Positions;
+				model.indices = &object_models[j]->Geometry->Indices;
+			}
+
+			model.world = m_Objects[i]->GetWorld(j);
+
+			bounds.Add(world_bounds.Get(j));
+			models.push_back(model);
+			m_VisibilityModels.push_back(PackProxy(i, j));
+		}
+	}
+
+	m_PotentiallyVisibleSet.Build(bounds, models, camera, m_JobSystem);
+	m_VisibilityCell = -1;
+}
+
+void Rove::Scene::CullPrecomputed(Camera& camera)
+{
+	int cell = m_PotentiallyVisibleSet.GetCell(camera.GetPitch(), camera.GetYaw());
+	if (cell == m_VisibilityCell)
+	{
+		return;
+	}
+
+	m_VisibilityCell = cell;
+	m_PotentiallyVisibleSet.GatherNeighbourhood(cell, m_VisibilityWords);
+
+	m_VisibleModels.clear();
+	for (size_t word = 0; word < m_VisibilityWords.size(); ++word)
+	{
+		uint64_t bits = m_VisibilityWords[word];
+		for (size_t bit = 0; bits != 0; ++bit, bits >>= 1)
+		{
+			size_t index = word * 64 + bit;
+			if ((bits & 1) != 0 && index < m_VisibilityModels.size())
+			{
+				m_VisibleModels.push_back(m_VisibilityModels[index]);
+			}
+		}
+	}
+}
+
+void Rove::Scene::InvalidateVisibilitySets()
+{
+	m_PotentiallyVisibleSet.Invalidate();
+	m_VisibilityCell = -1;
+}
+
+void Rove::Scene::QueryAabb(const DirectX::BoundingBox& box, std::vector<SceneQueryResult>& results)
+{
+	m_QueryProxies.clear();
+	m_SpatialIndex.QueryAabb(box, m_QueryProxies);
+
+	for (int proxy : m_QueryProxies)
+	{
+		SceneQueryResult result = GetQueryResult(proxy);
+
+		// The index stores enlarged bounds so confirm against the exact ones
+		uint64_t user_data = m_SpatialIndex.GetUserData(proxy);
+		if (result.object->GetWorldBounds().Get(ModelIndex(user_data)).Intersects(box))
+		{
+			results.push_back(result);
+		}
+	}
+}
+
+void Rove::Scene::QuerySphere(const DirectX::BoundingSphere& sphere, std::vector<SceneQueryResult>& results)
+{
+	m_QueryProxies.clear();
+	m_SpatialIndex.QuerySphere(sphere, m_QueryProxies);
+
+	for (int proxy : m_QueryProxies)
+	{
+		SceneQueryResult result = GetQueryResult(proxy);
+
+		uint64_t user_data = m_SpatialIndex.GetUserData(proxy);
+		if (result.object->GetWorldBounds().Get(ModelIndex(user_data)).Intersects(sphere))
+		{
+			results.push_back(result);
+		}
+	}
+}
+
+bool Rove::Scene::Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float max_distance, RaycastHit& hit)
+{
+	Update();
+
+	bool found = false;
+	DirectX::XMVECTOR world_origin = DirectX::XMLoadFloat3(&origin);
+	DirectX::XMVECTOR world_direction = DirectX::XMLoadFloat3(&direction);
+
+	m_SpatialIndex.QueryRay(origin, direction, max_distance, [&](int proxy, float distance) -> float
+	{
+		SceneQueryResult result = GetQueryResult(proxy);
+
+		// Instances have no triangle hierarchy of their own so instanced models are not hit
+		if (!result.model->Instances.empty())
+		{
+			return distance;
+		}
+
+		// Bring the ray into model space, the direction is not normalised so the hit distance stays in world units
+		DirectX::XMMATRIX world_inverse = result.object->GetWorldBuffers()[ModelIndex(m_SpatialIndex.GetUserData(proxy))].worldInverse;
+
+		DirectX::XMFLOAT3 local_origin, local_direction;
+		DirectX::XMStoreFloat3(&local_origin, DirectX::XMVector3TransformCoord(world_origin, world_inverse));
+		DirectX::XMStoreFloat3(&local_direction, DirectX::XMVector3TransformNormal(world_direction, world_inverse));
+
+		MeshHit mesh_hit;
+		if (!result.model->Geometry->Bvh.Intersect(local_origin, local_direction, distance, mesh_hit))
+		{
+			return distance;
+		}
+
+		found = true;
+		hit.object = result.object;
+		hit.model = result.model;
+		hit.triangle = mesh_hit.triangle;
+		hit.distance = mesh_hit.distance;
+		hit.barycentric_u = mesh_hit.barycentric_u;
+		hit.barycentric_v = mesh_hit.barycentric_v;
+		hit.barycentric_w = mesh_hit.barycentric_w;
+		DirectX::XMStoreFloat3(&hit.position, DirectX::XMVectorMultiplyAdd(world_direction, DirectX::XMVectorReplicate(mesh_hit.distance), world_origin));
+
+		return mesh_hit.distance;
+	});
+
+	return found;
+}
+
+void Rove::Scene::CreateProxies(size_t object_index)
+{
+	Object* object = m_Objects[object_index].get();
+
+	const BoundsSoA& bounds = object->GetWorldBounds();
+	std::vector<int>& proxies = m_ObjectProxies[object_index];
+	for (size_t j = 0; j < bounds.Size(); ++j)
+	{
+		proxies.push_back(m_SpatialIndex.CreateProxy(bounds.Get(j), PackProxy(object_index, j)));
+	}
+}
+
+void Rove::Scene::AssignRenderIds(Object* object)
+{
+	for (const std::unique_ptr<Model>& model : object->GetModels())
+	{
+		auto it = m_GeometryIds.find(model->Geometry.get());
+		if (it == m_GeometryIds.end())
+		{
+			// Without freed ids every id below the number of geometries is in use
+			uint32_t id = static_cast<uint32_t>(m_GeometryIds.size());
+			if (!m_FreeGeometryIds.empty())
+			{
+				id = m_FreeGeometryIds.back();
+				m_FreeGeometryIds.pop_back();
+			}
+
+			it = m_GeometryIds.emplace(model->Geometry.get(), GeometryUse{ id, 0 }).first;
+			if (id >= m_Geometries.size())
+			{
+				m_Geometries.resize(id + 1);
+			}
+
+			m_Geometries[id] = model->Geometry.get();
+		}
+
+		++it->second.models;
+		model->GeometryId = it->second.id;
+	}
+}
+
+void Rove::Scene::ReleaseRenderIds(Object* object)
+{
+	for (const std::unique_ptr<Model>& model : object->GetModels())
+	{
+		auto it = m_GeometryIds.find(model->Geometry.get());
+		if (it != m_GeometryIds.end() && --it->second.models == 0)
+		{
+			m_FreeGeometryIds.push_back(it->second.id);
+			m_Geometries[it->second.id] = nullptr;
+			m_GeometryIds.erase(it);
+		}
+	}
+}
+
+void Rove::Scene::DestroyProxies(size_t object_index)
+{
+	for (int proxy : m_ObjectProxies[object_index])
+	{
+		m_SpatialIndex.DestroyProxy(proxy);
+	}
+
+	m_ObjectProxies[object_index].clear();
+}
+
+Rove::SceneQueryResult Rove::Scene::GetQueryResult(int proxy)
+{
+	uint64_t user_data = m_SpatialIndex.GetUserData(proxy);
+
+	SceneQueryResult result;
+	result.object = m_Objects[ObjectIndex(user_data)].get();
+	result.model = result.object->GetModels()[ModelIndex(user_data)].get();
+	return result;
+}
+
+uint16_t Rove::Scene::GetShaderVariant(uint32_t material, int light_count, bool instanced)
+{
+	ShaderKey key = ShaderPermutation::MakeUberKey(instanced, false);
+	if (EnableShaderPermutations)
+	{
+		const Material& values = m_MaterialTable.Get(material);
+		key = ShaderPermutation::MakeKey(values.normal_texture, values.diffuse_texture, light_count, instanced, false);
+	}
+
+	return m_DxShader->GetVariant(key);
+}
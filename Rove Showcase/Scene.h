@@ -0,0 +1,317 @@
+#pragma once
+
+#include "Pch.h"
+#include "Model.h"
+#include "DynamicBvh.h"
+#include "OcclusionCuller.h"
+#include "PotentiallyVisibleSet.h"
+#include "RenderQueue.h"
+#include "MaterialTable.h"
+#include "GeometryPool.h"
+#include "StaticBatcher.h"
+#include "DxCommandBackend.h"
+#include "ObjectLights.h"
+
+namespace Rove
+{
+	// Forward declarations
+	class DxRenderer;
+	class DxShader;
+	class Camera;
+	class JobSystem;
+	class LightList;
+
+	// Culling results of the last culled frame
+	struct CullingStats
+	{
+		int visible_models = 0;
+		int total_models = 0;
+		double culling_microseconds = 0.0;
+
+		// Models inside the frustum but hidden behind occluders
+		int occluded_models = 0;
+		int occluder_count = 0;
+		int occluder_triangles = 0;
+		double occlusion_microseconds = 0.0;
+
+		// The visible models came from the precomputed set of the camera cell
+		bool precomputed_visibility = false;
+	};
+
+	// Submission results of the last rendered frame
+	struct RenderStats
+	{
+		// Models submitted and the draw calls they took, models sharing geometry and material are drawn instanced
+		int model_count = 0;
+		int draw_count = 0;
+		int instanced_draws = 0;
+		int64_t triangle_count = 0;
+		int64_t vertex_count = 0;
+
+		// Instances of instanced models left by the per instance frustum cull
+		int visible_instances = 0;
+		int total_instances = 0;
+
+		// Static batches drawn and the models they replaced
+		int static_batches = 0;
+		int batched_models = 0;
+
+		// State changes the draws needed in scene order and in the order they were submitted
+		int unsorted_state_changes = 0;
+		int state_changes = 0;
+		double sort_microseconds = 0.0;
+
+		// Vertex, index and constant buffers bound, shader resources bound and bytes written into constant buffers
+		int buffer_binds = 0;
+		int resource_binds = 0;
+		uint64_t constant_bytes = 0;
+
+		// Command buffers recorded in parallel and the time to record and merge them
+		int command_buffers = 0;
+		double record_microseconds = 0.0;
+
+		// Light lists built for the draws, the lights in them and the lists that had to drop their weakest lights
+		int light_lists = 0;
+		int object_lights = 0;
+		int truncated_light_lists = 0;
+		double light_assign_microseconds = 0.0;
+	};
+
+	// World constant updates of the last scene update
+	struct TransformStats
+	{
+		// Objects and models whose world constants were recomputed, zero while nothing moves
+		int updated_objects = 0;
+		int updated_models = 0;
+		double update_microseconds = 0.0;
+	};
+
+	// Model returned by a scene query
+	struct SceneQueryResult
+	{
+		Object* object = nullptr;
+		Model* model = nullptr;
+	};
+
+	// Closest triangle hit by a scene ray
+	struct RaycastHit
+	{
+		Object* object = nullptr;
+		Model* model = nullptr;
+
+		// Index of the triangle in the model index buffer, divided by 3
+		uint32_t triangle = 0;
+
+		// World space distance along the ray and hit position
+		float distance = 0.0f;
+		DirectX::XMFLOAT3 position;
+
+		// Barycentric weights of the three triangle vertices
+		float barycentric_u = 0.0f;
+		float barycentric_v = 0.0f;
+		float barycentric_w = 0.0f;
+	};
+
+	// Holds every loaded object and keeps the world bounds of their models in a spatial index
+	class Scene
+	{
+		DxRenderer* m_DxRenderer = nullptr;
+		DxShader* m_DxShader = nullptr;
+
+	public:
+		// Without a renderer the scene can be loaded and culled but not rendered
+		Scene(DxRenderer* renderer, DxShader* shader, JobSystem* job_system);
+		virtual ~Scene() = default;
+
+		// Loads a GLTF file into a new object
+		Object* AddObject(const std::filesystem::path& path);
+
+		// Removes an object from the scene
+		void RemoveObject(Object* object);
+
+		// Removes every object
+		void Clear();
+
+		// Recomputes the world constants of every object whose transformation has changed in one batch and moves their
+		// spatial index proxies
+		void Update();
+
+		// Finds the models the camera can see, first against the frustum then against the occluders
+		void Cull(Camera& camera);
+
+		// Renders the models left by the last cull through the render queue
+		void Render(Camera& camera);
+
+		// Sort the render queue by state and depth, otherwise draws are submitted in scene order
+		bool EnableDrawSorting = true;
+
+		// Draw consecutive models sharing geometry and material with one instanced draw
+		bool EnableInstancing = true;
+
+		// Draw the models of each material as one batch with the world transformations baked into the vertices, the
+		// batches are only culled as a whole
+		bool EnableStaticBatching = false;
+
+		// Replay the recorded commands on deferred contexts built on the job system instead of the immediate context
+		bool EnableDeferredContexts = false;
+
+		// Shade each draw with the lights reaching its bounds, given to the pixel shader in its world constants, instead of
+		// the light clusters
+		bool EnablePerObjectLights = false;
+
+		// Draw with the shader variant compiled for the material textures, light list size and kind of draw instead of
+		// the uber shader branching on them
+		bool EnableShaderPermutations = true;
+
+		// Lights the per object light lists are built from, kept by the caller
+		void SetLights(const LightList* lights) { m_Lights = lights; }
+
+		// Rasterize the largest models on the CPU and skip the models hidden behind them
+		bool EnableOcclusionCulling = true;
+
+		// Precomputes the visible models from every cell around the orbit camera for the current scene and projection
+		void BuildVisibilitySets(Camera& camera);
+
+		// Submit the precomputed set of the camera cell instead of culling while the sets are valid
+		bool EnablePrecomputedVisibility = true;
+
+		// Objects
+		const std::vector<std::unique_ptr<Object>>& GetObjects() { return m_Objects; }
+
+		// Models whose bounds overlap a box
+		void QueryAabb(const DirectX::BoundingBox& box, std::vector<SceneQueryResult>& results);
+
+		// Models whose bounds overlap a sphere
+		void QuerySphere(const DirectX::BoundingSphere& sphere, std::vector<SceneQueryResult>& results);
+
+		// Finds the closest triangle along a world space ray, the model bounds are searched front to back through the
+		// spatial index and only the models the ray reaches are tested against their triangle hierarchy
+		bool Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float max_distance, RaycastHit& hit);
+
+		// Spatial index
+		const DynamicBvh& GetSpatialIndex() { return m_SpatialIndex; }
+
+		// Culling results
+		const CullingStats& GetCullingStats() { return m_CullingStats; }
+
+		// Submission results
+		const RenderStats& GetRenderStats() { return m_RenderStats; }
+
+		// World constant updates
+		const TransformStats& GetTransformStats() { return m_TransformStats; }
+
+		// Frames rendered, the frame of the model stats
+		uint64_t GetFrameIndex() const { return m_FrameIndex; }
+
+		// Materials shared by every object
+		MaterialTable& GetMaterialTable() { return m_MaterialTable; }
+
+		// Vertex and index buffers shared by every object
+		const GeometryPool& GetGeometryPool() { return m_GeometryPool; }
+
+		// Occlusion culler with the depth buffer of the last cull
+		const OcclusionCuller& GetOcclusionCuller() { return m_OcclusionCuller; }
+
+		// Precomputed visibility sets
+		const PotentiallyVisibleSet& GetPotentiallyVisibleSet() { return m_PotentiallyVisibleSet; }
+
+	private:
+		JobSystem* m_JobSystem = nullptr;
+		MaterialTable m_MaterialTable;
+
+		// Outlives the objects as their geometry returns its ranges when destroyed
+		GeometryPool m_GeometryPool;
+		std::vector<std::unique_ptr<Object>> m_Objects;
+
+		// Merged models of each material for static batching
+		StaticBatcher m_StaticBatcher;
+
+		// Spatial index over every model, the user data packs the object index and the model index
+		DynamicBvh m_SpatialIndex;
+
+		// Proxy ids of each model, parallel to m_Objects
+		std::vector<std::vector<int>> m_ObjectProxies;
+
+		void CreateProxies(size_t object_index);
+		void DestroyProxies(size_t object_index);
+
+		// Resolve the user data of a proxy
+		SceneQueryResult GetQueryResult(int proxy);
+
+		// Picks occluders from the frustum visible models and removes the hidden ones
+		void CullOccluded(const DirectX::XMMATRIX& view_projection);
+		OcclusionCuller m_OcclusionCuller;
+
+		// Fills the visible list from the set of the camera cell, the list is kept while the camera stays in the cell
+		void CullPrecomputed(Camera& camera);
+		PotentiallyVisibleSet m_PotentiallyVisibleSet;
+
+		// Packed object and model index of every bit in the sets
+		std::vector<uint64_t> m_VisibilityModels;
+		std::vector<uint64_t> m_VisibilityWords;
+		int m_VisibilityCell = -1;
+
+		// Discards the sets once the scene has changed
+		void InvalidateVisibilitySets();
+
+		// Culling scratch memory kept between frames
+		std::vector<int> m_InsideProxies;
+		std::vector<int> m_IntersectingProxies;
+		BoundsSoA m_IntersectingBounds;
+		std::vector<uint32_t> m_IntersectingVisible;
+		std::vector<uint64_t> m_VisibleModels;
+		std::vector<int> m_QueryProxies;
+		BoundsSoA m_CandidateBounds;
+		std::vector<uint32_t> m_OccluderOrder;
+		std::vector<uint32_t> m_OcclusionVisible;
+
+		CullingStats m_CullingStats;
+
+		// Worlds of the models of the objects that moved, computed together each update
+		std::vector<size_t> m_DirtyObjects;
+		std::vector<DirectX::XMMATRIX> m_DirtyWorlds;
+		std::vector<WorldBuffer> m_DirtyWorldBuffers;
+		TransformStats m_TransformStats;
+
+		// Visible instances of the instanced model being submitted
+		std::vector<uint32_t> m_InstanceVisible;
+
+		// Lights tested against the bounds of each draw
+		const LightList* m_Lights = nullptr;
+		ObjectLights m_ObjectLights;
+
+		// Per frame memory and the draws of the frame
+		FrameArena m_FrameArena;
+		RenderQueue m_RenderQueue;
+		RenderStats m_RenderStats;
+
+		// Commands of the frame and the backend replaying them
+		CommandRecorder m_CommandRecorder;
+		DxCommandBackend m_CommandBackend;
+
+		// Cost of each command of the frame, split between the models of its batch
+		std::vector<CommandCost> m_CommandCosts;
+		uint64_t m_FrameIndex = 0;
+		uint64_t m_ConstantBytes = 0;
+
+		// Shader variant of a draw, a negative light count is shaded by the light clusters
+		uint16_t GetShaderVariant(uint32_t material, int light_count, bool instanced);
+
+		// Render queue id of each geometry with the number of models drawing it. The id of a geometry is freed with its
+		// last model and reused, so ids stay within the bits of the sort key and never go to a new geometry at the address
+		// of a destroyed one.
+		struct GeometryUse
+		{
+			uint32_t id;
+			uint32_t models;
+		};
+
+		std::map<const MeshGeometry*, GeometryUse> m_GeometryIds;
+		std::vector<uint32_t> m_FreeGeometryIds;
+
+		// Geometry of each id, which the command backend binds for the geometry of a command
+		std::vector<const MeshGeometry*> m_Geometries;
+		void AssignRenderIds(Object* object);
+		void ReleaseRenderIds(Object* object);
+	};
+}
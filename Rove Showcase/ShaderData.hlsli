@@ -7,6 +7,20 @@ struct VertexInput
 	float3 tangent : TANGENT;
 };
 
+// Instance input of the instanced vertex shader, the world constants of one instance
+struct InstanceInput
+{
+	float4 world0 : WORLD0;
+	float4 world1 : WORLD1;
+	float4 world2 : WORLD2;
+	float4 world3 : WORLD3;
+
+	float4 worldInverse0 : WORLDINVERSE0;
+	float4 worldInverse1 : WORLDINVERSE1;
+	float4 worldInverse2 : WORLDINVERSE2;
+	float4 worldInverse3 : WORLDINVERSE3;
+};
+
 // Vertex output / pixel input structure
 struct PixelInput
 {
@@ -30,9 +44,14 @@ cbuffer WorldBuffer : register(b1)
 {
 	matrix cWorld;
 	matrix cWorldInverse;
+
+	// Lights the draw is shaded with when there are no clusters, strongest first
+	uint cObjectLightCount;
+	uint3 _worldBufferPadding;
+	uint4 cObjectLights[2];
 }
 
-// Point light structure
+// Point light structure, the w of the position is the radius
 struct PointLight
 {
 	float4 lightPointPosition;
@@ -41,14 +60,8 @@ struct PointLight
 	float4 lightPointSpecular;
 };
 
-// Point light buffer
-cbuffer PointLightBuffer : register(b2)
-{
-	int cLightCount;
-	float3 padding;
-
-	PointLight cPointLight[255];
-}
+// Every point light of the scene, the clusters index into it
+StructuredBuffer<PointLight> PointLights : register(t4);
 
 // Material buffer
 cbuffer MaterialBuffer : register(b3)
@@ -62,6 +75,21 @@ cbuffer MaterialBuffer : register(b3)
 	float2 _materialBufferPadding2;
 }
 
+// Light cluster grid, the depth slice of a view depth is floor(log(depth) * scale + bias)
+cbuffer ClusterBuffer : register(b4)
+{
+	uint3 cClusterGrid;
+	float cClusterDepthScale;
+
+	float2 cScreenSize;
+	float cClusterDepthBias;
+	uint cPerObjectLights;
+}
+
+// Offset and count of the lights of each cluster in the light index list
+StructuredBuffer<uint2> ClusterLights : register(t2);
+StructuredBuffer<uint> LightIndices : register(t3);
+
 // Texture sampler
 SamplerState SamplerStateAnisotropic : register(s0);
 
@@ -0,0 +1,177 @@
+#include "Pch.h"
+#include "ShaderVariantCache.h"
+
+namespace
+{
+	constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+	constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+	uint64_t HashBytes(uint64_t hash, const char* data, size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= static_cast<uint8_t>(data[i]);
+			hash *= FNV_PRIME;
+		}
+
+		return hash;
+	}
+}
+
+Rove::ShaderKey Rove::ShaderPermutation::MakeKey(bool normal_map, bool diffuse_map, int light_count, bool instancing, bool compact_vertex)
+{
+	ShaderKey key = PERMUTATION;
+	key |= normal_map ? NORMAL_MAP : 0;
+	key |= diffuse_map ? DIFFUSE_MAP : 0;
+	key |= instancing ? INSTANCING : 0;
+	key |= compact_vertex ? COMPACT_VERTEX : 0;
+
+	// Smallest bucket holding the lights, the clusters otherwise
+	uint32_t bucket = 0;
+	if (light_count >= 0)
+	{
+		bucket = 1;
+		while (bucket < 3 && static_cast<uint32_t>(light_count) > LIGHT_BUCKETS[bucket])
+		{
+			++bucket;
+		}
+	}
+
+	return key | (bucket << LIGHT_BUCKET_SHIFT);
+}
+
+Rove::ShaderKey Rove::ShaderPermutation::MakeUberKey(bool instancing, bool compact_vertex)
+{
+	return (instancing ? INSTANCING : 0) | (compact_vertex ? COMPACT_VERTEX : 0);
+}
+
+std::vector<std::pair<std::string, std::string>> Rove::ShaderPermutation::GetDefines(ShaderKey key)
+{
+	std::vector<std::pair<std::string, std::string>> defines;
+	if ((key & COMPACT_VERTEX) != 0)
+	{
+		defines.emplace_back("COMPACT_VERTEX", "1");
+	}
+
+	if ((key & PERMUTATION) == 0)
+	{
+		return defines;
+	}
+
+	defines.emplace_back("PERMUTATION", "1");
+	defines.emplace_back("HAS_NORMAL_MAP", (key & NORMAL_MAP) != 0 ? "1" : "0");
+	defines.emplace_back("HAS_DIFFUSE_MAP", (key & DIFFUSE_MAP) != 0 ? "1" : "0");
+	defines.emplace_back("LIGHT_BUCKET", std::to_string(LIGHT_BUCKETS[GetLightBucket(key)]));
+	return defines;
+}
+
+std::string Rove::ShaderPermutation::GetName(ShaderStage stage, ShaderKey key)
+{
+	std::string name = stage == ShaderStage::Vertex ? "vs" : "ps";
+	if ((key & PERMUTATION) == 0)
+	{
+		name += "_uber";
+	}
+
+	if (stage == ShaderStage::Vertex)
+	{
+		name += (key & INSTANCING) != 0 ? "_inst" : "";
+		name += (key & COMPACT_VERTEX) != 0 ? "_compact" : "";
+	}
+	else if ((key & PERMUTATION) != 0)
+	{
+		name += (key & NORMAL_MAP) != 0 ? "_nm" : "";
+		name += (key & DIFFUSE_MAP) != 0 ? "_dm" : "";
+		name += GetLightBucket(key) == 0 ? "_clustered" : "_l" + std::to_string(LIGHT_BUCKETS[GetLightBucket(key)]);
+	}
+
+	return name;
+}
+
+Rove::ShaderVariantCache::ShaderVariantCache(const std::filesystem::path& directory, uint64_t source_hash, CompileFunction compile)
+	: m_Directory(directory), m_SourceHash(source_hash), m_Compile(std::move(compile))
+{
+	std::fill(std::begin(m_Variants), std::end(m_Variants), static_cast<int16_t>(-1));
+}
+
+uint16_t Rove::ShaderVariantCache::AddVariant(ShaderKey key)
+{
+	uint16_t variant = static_cast<uint16_t>(m_Keys.size());
+	m_Variants[key] = static_cast<int16_t>(variant);
+	m_Keys.push_back(key);
+	return variant;
+}
+
+const std::vector<uint8_t>* Rove::ShaderVariantCache::GetBytecode(ShaderStage stage, ShaderKey key)
+{
+	// Only the bits of the stage matter, so variants differing in the other stage share the same entry
+	key = stage == ShaderStage::Vertex ? ShaderPermutation::GetVertexKey(key) : ShaderPermutation::GetPixelKey(key);
+	Bytecode& bytecode = m_Bytecode[static_cast<int>(stage)][key];
+	if (bytecode.loaded)
+	{
+		++m_Stats.memory_hits;
+		return bytecode.data.empty() ? nullptr : &bytecode.data;
+	}
+
+	bytecode.loaded = true;
+
+	// A cached file is only read when it was compiled from the same sources
+	std::filesystem::path path = GetCachePath(stage, key);
+	std::error_code error;
+	if (!m_Directory.empty() && std::filesystem::exists(path, error))
+	{
+		std::ifstream file(path, std::fstream::in | std::fstream::binary);
+		bytecode.data.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if (!bytecode.data.empty())
+		{
+			++m_Stats.disk_hits;
+			return &bytecode.data;
+		}
+	}
+
+	std::string compile_error;
+	if (!m_Compile || !m_Compile(stage, key, bytecode.data, compile_error) || bytecode.data.empty())
+	{
+		bytecode.data.clear();
+		++m_Stats.failures;
+		m_Stats.last_error = ShaderPermutation::GetName(stage, key) + ": " + (compile_error.empty() ? "no bytecode" : compile_error);
+		return nullptr;
+	}
+
+	++m_Stats.compiles;
+
+	// Failing to write the cache only costs a compile next time
+	if (!m_Directory.empty())
+	{
+		std::filesystem::create_directories(m_Directory, error);
+		std::ofstream file(path, std::fstream::out | std::fstream::binary | std::fstream::trunc);
+		file.write(reinterpret_cast<const char*>(bytecode.data.data()), bytecode.data.size());
+	}
+
+	return &bytecode.data;
+}
+
+std::filesystem::path Rove::ShaderVariantCache::GetCachePath(ShaderStage stage, ShaderKey key) const
+{
+	char name[64];
+	std::snprintf(name, sizeof(name), "%s_%02x_%016llx.cso", stage == ShaderStage::Vertex ? "vs" : "ps", key, static_cast<unsigned long long>(m_SourceHash));
+	return m_Directory / name;
+}
+
+uint64_t Rove::ShaderVariantCache::HashFiles(const std::vector<std::filesystem::path>& paths)
+{
+	uint64_t hash = FNV_OFFSET_BASIS;
+	for (const std::filesystem::path& path : paths)
+	{
+		std::ifstream file(path, std::fstream::in | std::fstream::binary);
+		if (!file)
+		{
+			continue;
+		}
+
+		std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		hash = HashBytes(hash, data.data(), data.size());
+	}
+
+	return hash;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "Pch.h"
+#include "StateTracker.h"
+
+namespace Rove
+{
+	// Features a shader variant is compiled with, packed into a key
+	using ShaderKey = uint32_t;
+
+	// Builds the keys of the shader variants and the defines each is compiled with. A key without the PERMUTATION bit
+	// is the uber shader, which branches on the material and light mode at run time, while a permutation has the
+	// branches resolved at compile time and the per object light loop bounded by its light bucket.
+	class ShaderPermutation
+	{
+	public:
+		// Vertex features
+		static constexpr ShaderKey INSTANCING = 1 << 0;
+		static constexpr ShaderKey COMPACT_VERTEX = 1 << 1;
+
+		// Pixel features
+		static constexpr ShaderKey NORMAL_MAP = 1 << 2;
+		static constexpr ShaderKey DIFFUSE_MAP = 1 << 3;
+
+		// Two bits of light bucket, 0 reads the light clusters and 1 to 3 read up to LIGHT_BUCKETS lights from the light
+		// list of the draw
+		static constexpr uint32_t LIGHT_BUCKET_SHIFT = 4;
+		static constexpr ShaderKey LIGHT_BUCKET_MASK = 3 << LIGHT_BUCKET_SHIFT;
+		static constexpr uint32_t LIGHT_BUCKETS[4] = { 0, 2, 4, 8 };
+
+		// Features are compiled in instead of read from the material
+		static constexpr ShaderKey PERMUTATION = 1 << 6;
+
+		// Every key is below this
+		static constexpr uint32_t KEY_COUNT = 1 << 7;
+
+		// Key of a draw, a negative light count shades it with the light clusters
+		static ShaderKey MakeKey(bool normal_map, bool diffuse_map, int light_count, bool instancing, bool compact_vertex);
+
+		// Key of the uber shader for a kind of draw
+		static ShaderKey MakeUberKey(bool instancing, bool compact_vertex);
+
+		// Light bucket of a key and the most lights it loops over
+		static uint32_t GetLightBucket(ShaderKey key) { return (key & LIGHT_BUCKET_MASK) >> LIGHT_BUCKET_SHIFT; }
+
+		// Only the bits each stage is compiled with, variants differing in the other stage share the bytecode
+		static ShaderKey GetVertexKey(ShaderKey key) { return key & (INSTANCING | COMPACT_VERTEX | PERMUTATION); }
+		static ShaderKey GetPixelKey(ShaderKey key) { return key & (NORMAL_MAP | DIFFUSE_MAP | LIGHT_BUCKET_MASK | PERMUTATION); }
+
+		// Name and value of each define of a key
+		static std::vector<std::pair<std::string, std::string>> GetDefines(ShaderKey key);
+
+		// Short readable name such as "ps_nm_dm_l4"
+		static std::string GetName(ShaderStage stage, ShaderKey key);
+	};
+
+	// Lookups, loads and compiles of the variant cache since it was created
+	struct ShaderCacheStats
+	{
+		// Variant lookups and the ones that found the variant already assigned
+		int64_t lookups = 0;
+		int64_t hits = 0;
+
+		// Bytecode read from memory, read from the disk cache and compiled
+		int memory_hits = 0;
+		int disk_hits = 0;
+		int compiles = 0;
+		int failures = 0;
+
+		// Variant name and compiler output of the last variant that failed, it falls back to the uber shaders
+		std::string last_error;
+	};
+
+	// Gives each shader key seen a small dense index stored in the draw commands, and keeps the bytecode of each stage of
+	// each variant in memory and in a cache directory on disk. Cached files are named by stage, key and a hash of the
+	// shader sources, so editing a source compiles its variants again and old files are simply no longer read. The
+	// compiler is a callback so the cache is the same with no graphics API behind it.
+	class ShaderVariantCache
+	{
+	public:
+		// Compiles one stage of a key, returns false with the reason in the error when it could not
+		using CompileFunction = std::function<bool(ShaderStage stage, ShaderKey key, std::vector<uint8_t>& bytecode, std::string& error)>;
+
+		ShaderVariantCache(const std::filesystem::path& directory, uint64_t source_hash, CompileFunction compile);
+		virtual ~ShaderVariantCache() = default;
+
+		// Index of a key, the first lookup of a key appends it. Not safe to call from several threads.
+		uint16_t GetVariant(ShaderKey key)
+		{
+			++m_Stats.lookups;
+			int16_t variant = m_Variants[key];
+			if (variant >= 0)
+			{
+				++m_Stats.hits;
+				return static_cast<uint16_t>(variant);
+			}
+
+			return AddVariant(key);
+		}
+
+		// Key of an index
+		ShaderKey GetKey(uint16_t variant) const { return m_Keys[variant]; }
+
+		// Number of variants assigned an index
+		size_t GetVariantCount() const { return m_Keys.size(); }
+
+		// Bytecode of one stage of a key from memory, the disk cache or the compiler, null when it could not be compiled
+		const std::vector<uint8_t>* GetBytecode(ShaderStage stage, ShaderKey key);
+
+		// Lookups since the cache was created
+		const ShaderCacheStats& GetStats() const { return m_Stats; }
+
+		// FNV-1a hash of the contents of the files that exist, used as the source hash
+		static uint64_t HashFiles(const std::vector<std::filesystem::path>& paths);
+
+	private:
+		std::filesystem::path m_Directory;
+		uint64_t m_SourceHash = 0;
+		CompileFunction m_Compile;
+
+		// Index of each key, -1 until it is first looked up
+		int16_t m_Variants[ShaderPermutation::KEY_COUNT];
+		std::vector<ShaderKey> m_Keys;
+		uint16_t AddVariant(ShaderKey key);
+
+		// Bytecode of each stage and key loaded so far, empty when it failed
+		struct Bytecode
+		{
+			bool loaded = false;
+			std::vector<uint8_t> data;
+		};
+
+		Bytecode m_Bytecode[static_cast<int>(ShaderStage::Count)][ShaderPermutation::KEY_COUNT];
+		std::filesystem::path GetCachePath(ShaderStage stage, ShaderKey key) const;
+
+		ShaderCacheStats m_Stats;
+	};
+}
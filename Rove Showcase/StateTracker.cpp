@@ -0,0 +1,104 @@
+#include "StateTracker.h"
+
+void Rove::StateTracker::Invalidate()
+{
+	m_InputLayout.known = false;
+	m_Topology.known = false;
+	m_IndexBuffer.known = false;
+	m_RenderTargets.known = false;
+	m_RasterizerState.known = false;
+
+	for (auto& binding : m_VertexBuffers)
+	{
+		binding.known = false;
+	}
+
+	for (size_t stage = 0; stage < static_cast<size_t>(ShaderStage::Count); ++stage)
+	{
+		m_Shaders[stage].known = false;
+
+		for (auto& binding : m_ConstantBuffers[stage])
+		{
+			binding.known = false;
+		}
+
+		for (auto& binding : m_ShaderResources[stage])
+		{
+			binding.known = false;
+		}
+	}
+}
+
+bool Rove::StateTracker::SetInputLayout(const void* layout)
+{
+	return Filter(m_InputLayout, layout);
+}
+
+bool Rove::StateTracker::SetPrimitiveTopology(uint32_t topology)
+{
+	return Filter(m_Topology, topology);
+}
+
+bool Rove::StateTracker::SetVertexBuffer(uint32_t slot, const void* buffer, uint32_t stride, uint32_t offset)
+{
+	bool issued = slot >= VERTEX_BUFFER_SLOTS ? Untracked() : Filter(m_VertexBuffers[slot], std::make_tuple(buffer, stride, offset));
+	m_Stats.buffer_binds += issued ? 1 : 0;
+	return issued;
+}
+
+bool Rove::StateTracker::SetIndexBuffer(const void* buffer, uint32_t format, uint32_t offset)
+{
+	bool issued = Filter(m_IndexBuffer, std::make_tuple(buffer, format, offset));
+	m_Stats.buffer_binds += issued ? 1 : 0;
+	return issued;
+}
+
+bool Rove::StateTracker::SetShader(ShaderStage stage, const void* shader)
+{
+	return Filter(m_Shaders[static_cast<size_t>(stage)], shader);
+}
+
+bool Rove::StateTracker::SetConstantBuffer(ShaderStage stage, uint32_t slot, const void* buffer, uint32_t first_constant, uint32_t constant_count)
+{
+	bool issued = slot >= CONSTANT_BUFFER_SLOTS ? Untracked() : Filter(m_ConstantBuffers[static_cast<size_t>(stage)][slot], std::make_tuple(buffer, first_constant, constant_count));
+	m_Stats.buffer_binds += issued ? 1 : 0;
+	return issued;
+}
+
+bool Rove::StateTracker::SetShaderResource(ShaderStage stage, uint32_t slot, const void* view)
+{
+	bool issued = slot >= SHADER_RESOURCE_SLOTS ? Untracked() : Filter(m_ShaderResources[static_cast<size_t>(stage)][slot], view);
+	m_Stats.resource_binds += issued ? 1 : 0;
+	return issued;
+}
+
+bool Rove::StateTracker::SetRenderTargets(const void* render_target, const void* depth_stencil)
+{
+	return Filter(m_RenderTargets, std::make_tuple(render_target, depth_stencil));
+}
+
+bool Rove::StateTracker::SetRasterizerState(const void* state)
+{
+	return Filter(m_RasterizerState, state);
+}
+
+template <typename T>
+bool Rove::StateTracker::Filter(Binding<T>& binding, const T& value)
+{
+	if (binding.known && binding.value == value)
+	{
+		++m_Stats.filtered;
+		return false;
+	}
+
+	binding.value = value;
+	binding.known = true;
+	++m_Stats.issued;
+	return true;
+}
+
+bool Rove::StateTracker::Untracked()
+{
+	++m_Stats.issued;
+	return true;
+}
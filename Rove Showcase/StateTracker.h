@@ -0,0 +1,122 @@
+#pragma once
+
+// Only the standard library so the tracker builds and is tested without a graphics API
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+
+namespace Rove
+{
+	// Bindings sent to the context and bindings dropped because they were already bound
+	struct StateCacheStats
+	{
+		int issued = 0;
+		int filtered = 0;
+
+		// Issued vertex, index and constant buffer bindings and shader resource slots
+		int buffer_binds = 0;
+		int resource_binds = 0;
+	};
+
+	// Shader stages with their own constant buffer and shader resource slots
+	enum class ShaderStage
+	{
+		Vertex,
+		Pixel,
+		Count
+	};
+
+	// Slots of a binding that changed, from the first to the last, empty when none did
+	struct SlotRange
+	{
+		uint32_t first = 0;
+		uint32_t count = 0;
+	};
+
+	// Remembers the input assembler, shader and output merger state last bound to a context and reports whether a new
+	// binding changes it. Objects are only compared by address so no graphics API is needed and the tracking can be
+	// driven by any context. Every binding starts unknown and after Invalidate the next binding of each is always issued.
+	class StateTracker
+	{
+	public:
+		// Slots tracked, bindings to higher slots are always issued
+		static constexpr uint32_t VERTEX_BUFFER_SLOTS = 4;
+		static constexpr uint32_t CONSTANT_BUFFER_SLOTS = 8;
+		static constexpr uint32_t SHADER_RESOURCE_SLOTS = 8;
+
+		StateTracker() = default;
+		virtual ~StateTracker() = default;
+
+		// Forgets every binding, used when something else has bound state on the context
+		void Invalidate();
+
+		// Each returns true when the binding differs from the one tracked and must be issued
+		bool SetInputLayout(const void* layout);
+		bool SetPrimitiveTopology(uint32_t topology);
+		bool SetVertexBuffer(uint32_t slot, const void* buffer, uint32_t stride, uint32_t offset);
+		bool SetIndexBuffer(const void* buffer, uint32_t format, uint32_t offset);
+		bool SetShader(ShaderStage stage, const void* shader);
+
+		// A constant count of zero binds the whole buffer
+		bool SetConstantBuffer(ShaderStage stage, uint32_t slot, const void* buffer, uint32_t first_constant, uint32_t constant_count);
+		bool SetShaderResource(ShaderStage stage, uint32_t slot, const void* view);
+
+		// Tracks consecutive shader resource slots and returns the range one call has to issue to cover every change
+		template <typename View>
+		SlotRange SetShaderResources(ShaderStage stage, uint32_t start_slot, uint32_t count, View* const* views);
+
+		bool SetRenderTargets(const void* render_target, const void* depth_stencil);
+		bool SetRasterizerState(const void* state);
+
+		// Counters since the last reset
+		const StateCacheStats& GetStats() const { return m_Stats; }
+
+		// Zeroes the counters
+		void ResetStats() { m_Stats = StateCacheStats(); }
+
+	private:
+		// Binding with whether it is known to be on the context
+		template <typename T>
+		struct Binding
+		{
+			T value = T();
+			bool known = false;
+		};
+
+		Binding<const void*> m_InputLayout;
+		Binding<uint32_t> m_Topology;
+		Binding<std::tuple<const void*, uint32_t, uint32_t>> m_VertexBuffers[VERTEX_BUFFER_SLOTS];
+		Binding<std::tuple<const void*, uint32_t, uint32_t>> m_IndexBuffer;
+		Binding<const void*> m_Shaders[static_cast<size_t>(ShaderStage::Count)];
+		Binding<std::tuple<const void*, uint32_t, uint32_t>> m_ConstantBuffers[static_cast<size_t>(ShaderStage::Count)][CONSTANT_BUFFER_SLOTS];
+		Binding<const void*> m_ShaderResources[static_cast<size_t>(ShaderStage::Count)][SHADER_RESOURCE_SLOTS];
+		Binding<std::tuple<const void*, const void*>> m_RenderTargets;
+		Binding<const void*> m_RasterizerState;
+
+		StateCacheStats m_Stats;
+
+		// Records the value and counts the binding as issued or filtered
+		template <typename T>
+		bool Filter(Binding<T>& binding, const T& value);
+
+		// Bindings outside the tracked slots cannot be compared
+		bool Untracked();
+	};
+
+	template <typename View>
+	SlotRange StateTracker::SetShaderResources(ShaderStage stage, uint32_t start_slot, uint32_t count, View* const* views)
+	{
+		uint32_t first = count;
+		uint32_t last = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (SetShaderResource(stage, start_slot + i, views[i]))
+			{
+				first = first < count ? first : i;
+				last = i;
+			}
+		}
+
+		return first < count ? SlotRange{ start_slot + first, last - first + 1 } : SlotRange();
+	}
+}
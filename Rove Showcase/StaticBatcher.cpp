@@ -0,0 +1,234 @@
+#include "Pch.h"
+#include "StaticBatcher.h"
+#include "JobSystem.h"
+
+namespace
+{
+	// Copies the vertices into world space, positions and tangents by the world and normals by the inverse transpose
+	void TransformVertices(const std::vector<Rove::Vertex>& source, const Rove::WorldBuffer& world_buffer, std::vector<Rove::Vertex>& output)
+	{
+		output = source;
+		if (output.empty())
+		{
+			return;
+		}
+
+		// The cached world is stored transposed for the shader and the inverse is not
+		DirectX::XMMATRIX world = DirectX::XMMatrixTranspose(world_buffer.world);
+		DirectX::XMMATRIX normal_matrix = DirectX::XMMatrixTranspose(world_buffer.worldInverse);
+
+		const size_t stride = sizeof(Rove::Vertex);
+		DirectX::XMFLOAT3* positions = reinterpret_cast<DirectX::XMFLOAT3*>(&output[0].x);
+		DirectX::XMFLOAT3* normals = reinterpret_cast<DirectX::XMFLOAT3*>(&output[0].normal_x);
+		DirectX::XMFLOAT3* tangents = reinterpret_cast<DirectX::XMFLOAT3*>(&output[0].tangent_x);
+
+		DirectX::XMVector3TransformCoordStream(positions, stride, positions, stride, output.size(), world);
+		DirectX::XMVector3TransformNormalStream(normals, stride, normals, stride, output.size(), normal_matrix);
+		DirectX::XMVector3TransformNormalStream(tangents, stride, tangents, stride, output.size(), world);
+
+		// Scaling changes the length of the normals and tangents
+		for (Rove::Vertex& vertex : output)
+		{
+			DirectX::XMFLOAT3* normal = reinterpret_cast<DirectX::XMFLOAT3*>(&vertex.normal_x);
+			DirectX::XMFLOAT3* tangent = reinterpret_cast<DirectX::XMFLOAT3*>(&vertex.tangent_x);
+			DirectX::XMStoreFloat3(normal, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(normal)));
+			DirectX::XMStoreFloat3(tangent, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(tangent)));
+		}
+	}
+
+	// Model of a dirty object transformed by one job
+	struct TransformJob
+	{
+		Rove::Object* object;
+		size_t model;
+		std::vector<Rove::Vertex> vertices;
+	};
+}
+
+Rove::StaticBatcher::StaticBatcher(DxRenderer* renderer, DxShader* shader, MaterialTable* material_table, GeometryPool* geometry_pool, JobSystem* job_system)
+	: m_DxRenderer(renderer), m_DxShader(shader), m_MaterialTable(material_table), m_GeometryPool(geometry_pool), m_JobSystem(job_system)
+{
+}
+
+void Rove::StaticBatcher::MarkDirty(Object* object)
+{
+	m_DirtyObjects.push_back(object);
+}
+
+void Rove::StaticBatcher::RemoveObject(Object* object)
+{
+	DropChunks(object);
+	m_Chunks.erase(object);
+	m_DirtyObjects.erase(std::remove(m_DirtyObjects.begin(), m_DirtyObjects.end(), object), m_DirtyObjects.end());
+}
+
+void Rove::StaticBatcher::Clear()
+{
+	m_Chunks.clear();
+	m_Batches.clear();
+	m_DirtyObjects.clear();
+	m_DirtyMaterials.clear();
+}
+
+void Rove::StaticBatcher::Update(const std::vector<std::unique_ptr<Object>>& objects)
+{
+	// Objects not seen before are built as well
+	for (const std::unique_ptr<Object>& object : objects)
+	{
+		if (m_Chunks.find(object.get()) == m_Chunks.end())
+		{
+			m_DirtyObjects.push_back(object.get());
+		}
+	}
+
+	if (m_DirtyObjects.empty() && m_DirtyMaterials.empty())
+	{
+		return;
+	}
+
+	std::sort(m_DirtyObjects.begin(), m_DirtyObjects.end());
+	m_DirtyObjects.erase(std::unique(m_DirtyObjects.begin(), m_DirtyObjects.end()), m_DirtyObjects.end());
+
+	// Every batchable model of the dirty objects is one job
+	std::vector<TransformJob> jobs;
+	for (Object* object : m_DirtyObjects)
+	{
+		DropChunks(object);
+		m_Chunks[object];
+
+		const std::vector<std::unique_ptr<Model>>& models = object->GetModels();
+		for (size_t i = 0; i < models.size(); ++i)
+		{
+			if (models[i]->Instances.empty() && models[i]->Geometry->IndexCount > 0)
+			{
+				jobs.push_back({ object, i, {} });
+			}
+		}
+	}
+
+	auto transform = [&jobs](uint32_t index)
+	{
+		TransformJob& job = jobs[index];
+		const Model* model = job.object->GetModels()[job.model].get();
+		TransformVertices(model->Geometry->Vertices, job.object->GetWorldBuffers()[job.model], job.vertices);
+	};
+
+	if (m_JobSystem != nullptr)
+	{
+		m_JobSystem->ParallelFor(static_cast<uint32_t>(jobs.size()), transform);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < jobs.size(); ++i)
+		{
+			transform(i);
+		}
+	}
+
+	// Appended in model order so a batch is the same however the jobs were spread over the threads
+	for (TransformJob& job : jobs)
+	{
+		const Model* model = job.object->GetModels()[job.model].get();
+		Chunk& chunk = m_Chunks[job.object][model->MaterialIndex];
+
+		uint32_t base_vertex = static_cast<uint32_t>(chunk.vertices.size());
+		chunk.vertices.insert(chunk.vertices.end(), job.vertices.begin(), job.vertices.end());
+		for (uint32_t index : model->Geometry->Indices)
+		{
+			chunk.indices.push_back(base_vertex + index);
+		}
+
+		++chunk.model_count;
+		m_DirtyMaterials.push_back(model->MaterialIndex);
+	}
+
+	std::sort(m_DirtyMaterials.begin(), m_DirtyMaterials.end());
+	m_DirtyMaterials.erase(std::unique(m_DirtyMaterials.begin(), m_DirtyMaterials.end()), m_DirtyMaterials.end());
+
+	for (uint32_t material : m_DirtyMaterials)
+	{
+		MergeBatch(material);
+	}
+
+	m_DirtyObjects.clear();
+	m_DirtyMaterials.clear();
+}
+
+void Rove::StaticBatcher::DropChunks(Object* object)
+{
+	auto it = m_Chunks.find(object);
+	if (it == m_Chunks.end())
+	{
+		return;
+	}
+
+	for (auto& chunk : it->second)
+	{
+		m_DirtyMaterials.push_back(chunk.first);
+	}
+
+	it->second.clear();
+}
+
+void Rove::StaticBatcher::MergeBatch(uint32_t material)
+{
+	size_t vertex_count = 0;
+	size_t index_count = 0;
+	int model_count = 0;
+	for (auto& object : m_Chunks)
+	{
+		auto chunk = object.second.find(material);
+		if (chunk != object.second.end())
+		{
+			vertex_count += chunk->second.vertices.size();
+			index_count += chunk->second.indices.size();
+			model_count += chunk->second.model_count;
+		}
+	}
+
+	if (vertex_count == 0)
+	{
+		m_Batches.erase(material);
+		return;
+	}
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	vertices.reserve(vertex_count);
+	indices.reserve(index_count);
+
+	for (auto& object : m_Chunks)
+	{
+		auto chunk = object.second.find(material);
+		if (chunk == object.second.end())
+		{
+			continue;
+		}
+
+		uint32_t base_vertex = static_cast<uint32_t>(vertices.size());
+		vertices.insert(vertices.end(), chunk->second.vertices.begin(), chunk->second.vertices.end());
+		for (uint32_t index : chunk->second.indices)
+		{
+			indices.push_back(base_vertex + index);
+		}
+	}
+
+	StaticBatch& batch = m_Batches[material];
+	if (batch.model == nullptr)
+	{
+		batch.model = std::make_unique<Model>(m_DxRenderer, m_DxShader, m_MaterialTable);
+		batch.model->MaterialIndex = material;
+		batch.model->Name = "Static batch";
+	}
+
+	// The old range goes back to the pool before the new one is taken so it can be reused
+	batch.model->Geometry.reset();
+
+	std::shared_ptr<MeshGeometry> geometry = std::make_shared<MeshGeometry>();
+	DirectX::BoundingBox::CreateFromPoints(geometry->Bounds, vertices.size(), reinterpret_cast<const DirectX::XMFLOAT3*>(vertices.data()), sizeof(Vertex));
+	m_GeometryPool->Add(*geometry, vertices, indices.data(), static_cast<UINT>(indices.size()), DXGI_FORMAT_R32_UINT);
+
+	batch.model->Geometry = geometry;
+	batch.bounds = geometry->Bounds;
+	batch.model_count = model_count;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Pch.h"
+#include "Model.h"
+
+namespace Rove
+{
+	// Forward declarations
+	class DxRenderer;
+	class DxShader;
+	class MaterialTable;
+	class GeometryPool;
+	class JobSystem;
+
+	// Merged geometry of every model with one material, already in world space and drawn with an identity world
+	struct StaticBatch
+	{
+		std::unique_ptr<Model> model;
+		DirectX::BoundingBox bounds;
+		int model_count = 0;
+	};
+
+	// Bakes the world transformation of every model into its vertices and merges the models sharing a material into one
+	// range of the geometry pool, so each material is a single draw. The vertices of each object are kept per material so
+	// an object that moves only transforms its own models again and re-merges the batches of its materials.
+	class StaticBatcher
+	{
+	public:
+		StaticBatcher(DxRenderer* renderer, DxShader* shader, MaterialTable* material_table, GeometryPool* geometry_pool, JobSystem* job_system);
+		virtual ~StaticBatcher() = default;
+
+		// Marks an object whose transformation changed, objects the batcher has not seen are built without being marked
+		void MarkDirty(Object* object);
+
+		// Drops the vertices of an object from its batches
+		void RemoveObject(Object* object);
+
+		// Drops every batch
+		void Clear();
+
+		// Transforms the models of the changed objects on the worker threads and re-merges the batches they touch. Models
+		// with their own instances are never batched.
+		void Update(const std::vector<std::unique_ptr<Object>>& objects);
+
+		// Batches by material index
+		const std::map<uint32_t, StaticBatch>& GetBatches() { return m_Batches; }
+
+	private:
+		DxRenderer* m_DxRenderer = nullptr;
+		DxShader* m_DxShader = nullptr;
+		MaterialTable* m_MaterialTable = nullptr;
+		GeometryPool* m_GeometryPool = nullptr;
+		JobSystem* m_JobSystem = nullptr;
+
+		// World space vertices and rebased indices of the models of one object with one material
+		struct Chunk
+		{
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			int model_count = 0;
+		};
+
+		// Chunks of every object by material
+		std::map<Object*, std::map<uint32_t, Chunk>> m_Chunks;
+		std::map<uint32_t, StaticBatch> m_Batches;
+
+		std::vector<Object*> m_DirtyObjects;
+		std::vector<uint32_t> m_DirtyMaterials;
+
+		// Removes the chunks of an object and marks the batches they were in
+		void DropChunks(Object* object);
+
+		// Concatenates the chunks of a material into a new pool range
+		void MergeBatch(uint32_t material);
+	};
+}
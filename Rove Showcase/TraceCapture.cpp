@@ -0,0 +1,48 @@
+#include "Pch.h"
+#include "TraceCapture.h"
+
+void Rove::TraceCapture::Start(uint32_t frame_count, const std::filesystem::path& path)
+{
+	if (m_Writer.IsOpen())
+	{
+		m_Writer.Close();
+	}
+
+	// Zones already in the rings are left out
+	m_Writer.Open(path, Profiler::Now());
+	Profiler::Get().GetCursor(m_Cursor);
+	m_Path = path;
+	m_FrameCount = std::max(frame_count, 1u);
+	m_Frames = 0;
+}
+
+void Rove::TraceCapture::EndFrame()
+{
+	if (!m_Writer.IsOpen())
+	{
+		return;
+	}
+
+	ROVE_PROFILE_ZONE("Capture");
+
+	std::unique_ptr<TraceBatch> batch = m_Writer.AcquireBatch();
+	batch->Collect(m_Cursor);
+	m_Frames = std::min(m_Frames + static_cast<uint32_t>(batch->frames.size()), m_FrameCount);
+	m_Writer.Write(std::move(batch));
+
+	if (m_Frames == m_FrameCount)
+	{
+		m_Writer.Close();
+	}
+}
+
+Rove::TraceCaptureStats Rove::TraceCapture::GetStats() const
+{
+	TraceCaptureStats stats;
+	stats.capturing = m_Writer.IsOpen();
+	stats.frames = m_Frames;
+	stats.frame_count = m_FrameCount;
+	stats.events = m_Writer.GetEvents();
+	stats.bytes = m_Writer.GetBytes();
+	return stats;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Pch.h"
+#include "TraceWriter.h"
+
+namespace Rove
+{
+	// Progress of the current or last capture
+	struct TraceCaptureStats
+	{
+		bool capturing = false;
+		uint32_t frames = 0;
+		uint32_t frame_count = 0;
+
+		// Events and bytes the writer has written so far
+		size_t events = 0;
+		size_t bytes = 0;
+	};
+
+	// Records the profile zones, frames and counters of a number of frames into a Chrome trace file. Each frame the main
+	// thread only copies what the profiler recorded since the last frame into a batch for the trace writer, so the frames
+	// being captured are not slowed down by formatting or the file.
+	class TraceCapture
+	{
+	public:
+		TraceCapture() = default;
+		virtual ~TraceCapture() = default;
+
+		// Starts capturing the next frames into a file, waits for the writer of a previous capture first. Zones recorded
+		// before the first frame, such as loading, are part of the capture.
+		void Start(uint32_t frame_count, const std::filesystem::path& path);
+
+		// A capture has started and not yet reached its frame count
+		bool IsCapturing() const { return m_Writer.IsOpen(); }
+
+		// Queues what was recorded in the frame that just ended, called from the main loop once a frame after
+		// Profiler::MarkFrame. Closes the file once the frame count is reached.
+		void EndFrame();
+
+		// Waits for the writer to finish the file of the last capture
+		void Wait() { m_Writer.Wait(); }
+
+		// Progress of the current or last capture
+		TraceCaptureStats GetStats() const;
+
+		// File of the current or last capture
+		const std::filesystem::path& GetPath() const { return m_Path; }
+
+	private:
+		TraceWriter m_Writer;
+		ProfileCursor m_Cursor;
+		uint32_t m_FrameCount = 0;
+		uint32_t m_Frames = 0;
+		std::filesystem::path m_Path;
+	};
+}
@@ -0,0 +1,268 @@
+#include "Pch.h"
+#include "TraceWriter.h"
+
+namespace
+{
+	// The writer fills this much of its buffer before writing it out
+	constexpr size_t BUFFER_BYTES = 1 << 20;
+
+	// Frames are shown as a thread of their own above the zones of every thread
+	constexpr uint32_t FRAME_THREAD = Rove::Profiler::MAX_THREADS;
+
+	// Appends a JSON string without the quotes
+	void AppendEscaped(std::string& buffer, const char* text)
+	{
+		for (const char* c = text; *c != '\0'; ++c)
+		{
+			if (*c == '"' || *c == '\\')
+			{
+				buffer += '\\';
+			}
+
+			if (static_cast<unsigned char>(*c) >= 0x20)
+			{
+				buffer += *c;
+			}
+		}
+	}
+
+	// Appends an integer
+	void AppendInteger(std::string& buffer, int64_t value)
+	{
+		char text[24];
+		auto result = std::to_chars(text, text + sizeof(text), value);
+		buffer.append(text, result.ptr);
+	}
+
+	// Appends nanoseconds as microseconds with three decimals, much cheaper than formatting a double
+	void AppendMicroseconds(std::string& buffer, int64_t nanoseconds)
+	{
+		if (nanoseconds < 0)
+		{
+			buffer += '-';
+			nanoseconds = -nanoseconds;
+		}
+
+		AppendInteger(buffer, nanoseconds / 1000);
+		int64_t fraction = nanoseconds % 1000;
+		char text[4] = { '.', static_cast<char>('0' + fraction / 100), static_cast<char>('0' + fraction / 10 % 10), static_cast<char>('0' + fraction % 10) };
+		buffer.append(text, sizeof(text));
+	}
+
+	// Appends formatted text of up to 255 characters
+	template <typename... Args>
+	void AppendFormat(std::string& buffer, const char* format, Args... args)
+	{
+		char text[256];
+		int length = std::snprintf(text, sizeof(text), format, args...);
+		buffer.append(text, std::min<size_t>(static_cast<size_t>(std::max(length, 0)), sizeof(text) - 1));
+	}
+}
+
+void Rove::TraceBatch::Collect(ProfileCursor& cursor)
+{
+	Profiler& profiler = Profiler::Get();
+	profiler.CollectZones(cursor, zones);
+	profiler.CollectCounters(cursor, counters);
+	profiler.CollectFrames(cursor, frames);
+	time = Profiler::Now();
+}
+
+Rove::TraceWriter::~TraceWriter()
+{
+	if (m_Open)
+	{
+		Close();
+	}
+
+	Wait();
+}
+
+void Rove::TraceWriter::Open(const std::filesystem::path& path, uint64_t start_time)
+{
+	Wait();
+
+	std::ofstream file(path, std::fstream::out | std::fstream::binary);
+	if (!file)
+	{
+		throw std::exception("Could not create the trace file");
+	}
+
+	m_StartTime = start_time;
+	m_Events = 0;
+	m_Bytes = 0;
+	m_Open = true;
+	m_Writing = true;
+	m_Writer = std::thread(&TraceWriter::WriterLoop, this, std::move(file));
+}
+
+void Rove::TraceWriter::Write(std::unique_ptr<TraceBatch> batch)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Queue.push_back(std::move(batch));
+	}
+
+	m_Condition.notify_one();
+}
+
+void Rove::TraceWriter::Close()
+{
+	// Names are copied here as the writer may still be busy when a thread is renamed
+	Profiler& profiler = Profiler::Get();
+	std::vector<std::string> thread_names;
+	for (uint32_t i = 0; i < profiler.GetThreadCount(); ++i)
+	{
+		thread_names.push_back(profiler.GetThreadName(i));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_ThreadNames = std::move(thread_names);
+		m_Queue.push_back(nullptr);
+	}
+
+	m_Open = false;
+	m_Condition.notify_one();
+}
+
+void Rove::TraceWriter::Wait()
+{
+	if (m_Writer.joinable())
+	{
+		m_Writer.join();
+	}
+}
+
+std::unique_ptr<Rove::TraceBatch> Rove::TraceWriter::AcquireBatch()
+{
+	std::unique_ptr<TraceBatch> batch = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (!m_FreeBatches.empty())
+		{
+			batch = std::move(m_FreeBatches.back());
+			m_FreeBatches.pop_back();
+		}
+	}
+
+	if (batch == nullptr)
+	{
+		return std::make_unique<TraceBatch>();
+	}
+
+	// Keep the memory of the vectors
+	batch->zones.clear();
+	batch->frames.clear();
+	batch->counters.clear();
+	batch->time = 0;
+	return batch;
+}
+
+void Rove::TraceWriter::ReleaseBatch(std::unique_ptr<TraceBatch> batch)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_FreeBatches.push_back(std::move(batch));
+}
+
+void Rove::TraceWriter::WriterLoop(std::ofstream file)
+{
+	std::string buffer;
+	buffer.reserve(BUFFER_BYTES + BUFFER_BYTES / 4);
+	buffer += "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	buffer += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Rove Showcase\"}}";
+
+	while (true)
+	{
+		std::unique_ptr<TraceBatch> batch = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Condition.wait(lock, [this] { return !m_Queue.empty(); });
+			batch = std::move(m_Queue.front());
+			m_Queue.pop_front();
+		}
+
+		if (batch == nullptr)
+		{
+			break;
+		}
+
+		WriteBatch(*batch, buffer);
+		if (buffer.size() >= BUFFER_BYTES)
+		{
+			file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+			m_Bytes += buffer.size();
+			buffer.clear();
+		}
+
+		ReleaseBatch(std::move(batch));
+	}
+
+	WriteThreadNames(buffer);
+	buffer += "\n]}\n";
+	file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	m_Bytes += buffer.size();
+	m_Writing = false;
+}
+
+void Rove::TraceWriter::WriteBatch(const TraceBatch& batch, std::string& buffer)
+{
+	// Complete event of a zone or frame, times are written in microseconds since the start time
+	auto append_complete = [&](const char* category, uint64_t start, uint64_t end, uint32_t thread)
+	{
+		buffer += "\",\"cat\":\"";
+		buffer += category;
+		buffer += "\",\"ph\":\"X\",\"ts\":";
+		AppendMicroseconds(buffer, static_cast<int64_t>(start - m_StartTime));
+		buffer += ",\"dur\":";
+		AppendMicroseconds(buffer, static_cast<int64_t>(end - start));
+		buffer += ",\"pid\":1,\"tid\":";
+		AppendInteger(buffer, thread);
+		buffer += '}';
+	};
+
+	for (const ProfileFrame& frame : batch.frames)
+	{
+		buffer += ",\n{\"name\":\"Frame ";
+		AppendInteger(buffer, static_cast<int64_t>(frame.index));
+		append_complete("frame", frame.start, frame.end, FRAME_THREAD);
+	}
+
+	for (const ProfileZone& zone : batch.zones)
+	{
+		buffer += ",\n{\"name\":\"";
+		AppendEscaped(buffer, zone.name);
+		append_complete("zone", zone.start, zone.end, zone.thread);
+	}
+
+	for (const ProfileCounter& counter : batch.counters)
+	{
+		buffer += ",\n{\"name\":\"";
+		AppendEscaped(buffer, counter.name);
+		buffer += "\",\"cat\":\"counter\",\"ph\":\"C\",\"ts\":";
+		AppendMicroseconds(buffer, static_cast<int64_t>(counter.time - m_StartTime));
+		AppendFormat(buffer, ",\"pid\":1,\"args\":{\"value\":%.15g}}", counter.value);
+	}
+
+	m_Events += batch.frames.size() + batch.zones.size() + batch.counters.size();
+}
+
+void Rove::TraceWriter::WriteThreadNames(std::string& buffer)
+{
+	std::vector<std::string> thread_names;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		thread_names = std::move(m_ThreadNames);
+	}
+
+	AppendFormat(buffer, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"Frames\"}}", FRAME_THREAD);
+	AppendFormat(buffer, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":-1}}", FRAME_THREAD);
+	for (size_t i = 0; i < thread_names.size(); ++i)
+	{
+		AppendFormat(buffer, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", static_cast<uint32_t>(i));
+		AppendEscaped(buffer, thread_names[i].c_str());
+		buffer += "\"}}";
+	}
+
+	m_Events += thread_names.size() + 2;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Pch.h"
+#include "Profiler.h"
+
+namespace Rove
+{
+	// Zones, frames and counters collected in one frame, times in nanoseconds of the profiler clock
+	struct TraceBatch
+	{
+		std::vector<ProfileZone> zones;
+		std::vector<ProfileFrame> frames;
+		std::vector<ProfileCounter> counters;
+
+		// Time the batch was collected
+		uint64_t time = 0;
+
+		// Collects the zones, counters and frames recorded since a cursor
+		void Collect(ProfileCursor& cursor);
+	};
+
+	// Writes batches into a Chrome trace event JSON file, which chrome://tracing and Perfetto open. The batches are queued
+	// and formatted on a writer thread into a buffer written out in large blocks, so the thread queuing them only pays for
+	// the copy out of the profiler. Batches return to a pool once written so their memory is reused.
+	class TraceWriter
+	{
+	public:
+		TraceWriter() = default;
+		virtual ~TraceWriter();
+
+		// Creates the file and starts the writer thread, times are written in microseconds since a time. Waits for the
+		// previous file to be finished first.
+		void Open(const std::filesystem::path& path, uint64_t start_time);
+
+		// Queues a batch for the file
+		void Write(std::unique_ptr<TraceBatch> batch);
+
+		// Names the threads and closes the file once every queued batch is written
+		void Close();
+
+		// Open has been called without Close
+		bool IsOpen() const { return m_Open; }
+
+		// The file is open or the writer has not finished it yet
+		bool IsWriting() const { return m_Writing.load(std::memory_order_acquire); }
+
+		// Waits for the writer to finish the file
+		void Wait();
+
+		// Empty batch from the pool
+		std::unique_ptr<TraceBatch> AcquireBatch();
+
+		// Returns a batch to the pool without writing it
+		void ReleaseBatch(std::unique_ptr<TraceBatch> batch);
+
+		// Events and bytes written to the current or last file
+		size_t GetEvents() const { return m_Events.load(std::memory_order_relaxed); }
+		size_t GetBytes() const { return m_Bytes.load(std::memory_order_relaxed); }
+
+	private:
+		uint64_t m_StartTime = 0;
+
+		// Batches waiting to be written, a null batch closes the file, and written batches ready for reuse
+		std::mutex m_Mutex;
+		std::condition_variable m_Condition;
+		std::deque<std::unique_ptr<TraceBatch>> m_Queue;
+		std::vector<std::unique_ptr<TraceBatch>> m_FreeBatches;
+
+		// Thread names taken when the file is closed
+		std::vector<std::string> m_ThreadNames;
+
+		std::thread m_Writer;
+		bool m_Open = false;
+		std::atomic<bool> m_Writing = false;
+		std::atomic<size_t> m_Events = 0;
+		std::atomic<size_t> m_Bytes = 0;
+		void WriterLoop(std::ofstream file);
+		void WriteBatch(const TraceBatch& batch, std::string& buffer);
+		void WriteThreadNames(std::string& buffer);
+	};
+}
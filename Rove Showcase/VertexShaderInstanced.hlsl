@@ -0,0 +1,28 @@
+#include "ShaderData.hlsli"
+
+// Entry point for the instanced vertex shader - the world constants come from the instance stream instead of the world buffer
+PixelInput main(VertexInput input, InstanceInput instance)
+{
+	PixelInput output;
+
+	// The stream holds the same bytes as the world buffer, which is column major, so the rows read back as columns
+	matrix world = transpose(matrix(instance.world0, instance.world1, instance.world2, instance.world3));
+	matrix worldInverse = transpose(matrix(instance.worldInverse0, instance.worldInverse1, instance.worldInverse2, instance.worldInverse3));
+
+	// Transform to homogeneous clip space.
+	output.positionClipSpace = mul(float4(input.position, 1.0f), world);
+	output.positionClipSpace = mul(output.positionClipSpace, cView);
+	output.positionClipSpace = mul(output.positionClipSpace, cProjection);
+
+	// Transform to world space.
+	output.position = mul(float4(input.position, 1.0f), world).xyz;
+
+	// Transform the normals by the inverse world space
+	output.normal = mul(input.normal, (float3x3)worldInverse).xyz;
+	output.tangent = mul(input.tangent, (float3x3)world);
+
+	// Pass the texture UV coordinates to pixel shader
+	output.tex_coord = input.tex_coord;
+
+	return output;
+}
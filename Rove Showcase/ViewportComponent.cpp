@@ -59,7 +59,7 @@ void Rove::ViewportComponent::Set()
 	context->ClearDepthStencilView(m_TextureDepthStencilView.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 
 	// Bind the render target view to the pipeline's output merger stage
-	context->OMSetRenderTargets(1, m_TextureRenderTargetView.GetAddressOf(), m_TextureDepthStencilView.Get());
+	m_Application->GetRenderer()->GetStateCache()->OMSetRenderTargets(m_TextureRenderTargetView.Get(), m_TextureDepthStencilView.Get());
 
 	// Set viewport
 	SetViewport(m_WindowWidth, m_WindowHeight);
@@ -84,6 +84,7 @@ void Rove::ViewportComponent::CreateSharedTexture(int width, int height)
 	texture_desc.MiscFlags = 0;
 
 	DX::Check(device->CreateTexture2D(&texture_desc, 0, m_SharedTexture.ReleaseAndGetAddressOf()));
+	m_SharedTextureBytes.Set(DX::GetTextureBytes(texture_desc));
 }
 
 void Rove::ViewportComponent::CreateShaderResourceView()
@@ -133,6 +134,7 @@ void Rove::ViewportComponent::CreateDepthStencilView(int width, int height)
 	ComPtr<ID3D11Texture2D> texture = nullptr;
 	DX::Check(device->CreateTexture2D(&texture_desc, nullptr, texture.ReleaseAndGetAddressOf()));
 	DX::Check(device->CreateDepthStencilView(texture.Get(), nullptr, m_TextureDepthStencilView.ReleaseAndGetAddressOf()));
+	m_DepthStencilBytes.Set(DX::GetTextureBytes(texture_desc));
 }
 
 void Rove::ViewportComponent::Resize(int width, int height)
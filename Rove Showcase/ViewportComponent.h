@@ -1,5 +1,7 @@
 #pragma once
 
+#include "MemoryTracker.h"
+
 namespace Rove
 {
 	class Application;
@@ -24,6 +26,7 @@ namespace Rove
 
 		// Texture used for both shader resource and render target
 		ComPtr<ID3D11Texture2D> m_SharedTexture = nullptr;
+		CountedMemory m_SharedTextureBytes = CountedMemory(MemoryTag::GpuTextures);
 		void CreateSharedTexture(int width, int height);
 
 		// Shader resource view
@@ -36,6 +39,7 @@ namespace Rove
 
 		// Depth stencil view
 		ComPtr<ID3D11DepthStencilView> m_TextureDepthStencilView = nullptr;
+		CountedMemory m_DepthStencilBytes = CountedMemory(MemoryTag::GpuTextures);
 		void CreateDepthStencilView(int width, int height);
 
 		// Window size
@@ -0,0 +1,111 @@
+#include "Pch.h"
+#include "WorldTransforms.h"
+
+namespace
+{
+	// Cross product of two vectors held one component per register
+	void Cross(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz, __m128* x, __m128* y, __m128* z)
+	{
+		*x = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+		*y = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+		*z = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+	}
+
+	__m128 Dot(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+	{
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+	}
+
+	// Inverts four affine matrices, the rows are a, b, c and the translation t
+	void InvertAffine4(const DirectX::XMMATRIX* matrices, DirectX::XMMATRIX* inverses)
+	{
+		// Row r of the four matrices becomes one register per component
+		__m128 rows[4][4];
+		for (int r = 0; r < 4; ++r)
+		{
+			rows[r][0] = matrices[0].r[r];
+			rows[r][1] = matrices[1].r[r];
+			rows[r][2] = matrices[2].r[r];
+			rows[r][3] = matrices[3].r[r];
+			_MM_TRANSPOSE4_PS(rows[r][0], rows[r][1], rows[r][2], rows[r][3]);
+		}
+
+		const __m128* a = rows[0];
+		const __m128* b = rows[1];
+		const __m128* c = rows[2];
+		const __m128* t = rows[3];
+
+		// The inverse of the 3x3 part has the cross products of the rows as its columns
+		__m128 bc[3], ca[3], ab[3];
+		Cross(b[0], b[1], b[2], c[0], c[1], c[2], &bc[0], &bc[1], &bc[2]);
+		Cross(c[0], c[1], c[2], a[0], a[1], a[2], &ca[0], &ca[1], &ca[2]);
+		Cross(a[0], a[1], a[2], b[0], b[1], b[2], &ab[0], &ab[1], &ab[2]);
+
+		__m128 inverse_determinant = _mm_div_ps(_mm_set1_ps(1.0f), Dot(a[0], a[1], a[2], bc[0], bc[1], bc[2]));
+		for (int i = 0; i < 3; ++i)
+		{
+			bc[i] = _mm_mul_ps(bc[i], inverse_determinant);
+			ca[i] = _mm_mul_ps(ca[i], inverse_determinant);
+			ab[i] = _mm_mul_ps(ab[i], inverse_determinant);
+		}
+
+		// The translation is moved through the inverse and negated
+		const __m128 zero = _mm_setzero_ps();
+		__m128 inverse_t[3] =
+		{
+			_mm_sub_ps(zero, Dot(t[0], t[1], t[2], bc[0], bc[1], bc[2])),
+			_mm_sub_ps(zero, Dot(t[0], t[1], t[2], ca[0], ca[1], ca[2])),
+			_mm_sub_ps(zero, Dot(t[0], t[1], t[2], ab[0], ab[1], ab[2])),
+		};
+
+		// Back to one matrix per register set, row i of the inverse is component i of each column
+		__m128 output[4][4];
+		for (int i = 0; i < 3; ++i)
+		{
+			output[i][0] = bc[i];
+			output[i][1] = ca[i];
+			output[i][2] = ab[i];
+			output[i][3] = zero;
+			_MM_TRANSPOSE4_PS(output[i][0], output[i][1], output[i][2], output[i][3]);
+		}
+
+		output[3][0] = inverse_t[0];
+		output[3][1] = inverse_t[1];
+		output[3][2] = inverse_t[2];
+		output[3][3] = _mm_set1_ps(1.0f);
+		_MM_TRANSPOSE4_PS(output[3][0], output[3][1], output[3][2], output[3][3]);
+
+		for (int m = 0; m < 4; ++m)
+		{
+			for (int r = 0; r < 4; ++r)
+			{
+				inverses[m].r[r] = output[r][m];
+			}
+		}
+	}
+}
+
+void Rove::ComputeWorldBuffers(const DirectX::XMMATRIX* worlds, WorldBuffer* output, size_t count)
+{
+	DirectX::XMMATRIX inverses[4];
+
+	for (size_t first = 0; first < count; first += 4)
+	{
+		size_t batch = std::min<size_t>(4, count - first);
+
+		// A partial batch is padded with identity matrices
+		DirectX::XMMATRIX matrices[4];
+		for (size_t i = 0; i < 4; ++i)
+		{
+			matrices[i] = i < batch ? worlds[first + i] : DirectX::XMMatrixIdentity();
+		}
+
+		InvertAffine4(matrices, inverses);
+
+		for (size_t i = 0; i < batch; ++i)
+		{
+			output[first + i].world = DirectX::XMMatrixTranspose(matrices[i]);
+			output[first + i].worldInverse = inverses[i];
+		}
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "Pch.h"
+#include "DxShader.h"
+
+namespace Rove
+{
+	// Fills the world constants of a batch of affine world matrices, the transposed world for the shader and the inverse.
+	// The inverses are computed four at a time with the matrices transposed into a structure of arrays so every lane
+	// works on a different matrix. Node and object transformations are translation, rotation and scale only, so the
+	// matrices are always affine.
+	void ComputeWorldBuffers(const DirectX::XMMATRIX* worlds, WorldBuffer* output, size_t count);
+}
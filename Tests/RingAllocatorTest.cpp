@@ -0,0 +1,72 @@
+#include "RingAllocator.h"
+#include <iostream>
+
+using Rove::RingAllocator;
+
+namespace
+{
+	// Allocates frames from a small ring allocator and checks the offsets and used bytes: an allocation that does not
+	// fit before the end skips to the start, one overlapping a frame in flight is refused and completed frames are
+	// released in fence order along with the bytes they skipped
+	int RunRingAllocatorTest(std::ostream& output)
+	{
+		// Five blocks of the alignment so each frame takes two and the third no longer fits before the end
+		RingAllocator ring(5 * 256, 256);
+		int failures = 0;
+		auto expect_used = [&](const char* name, uint64_t expected_used)
+		{
+			output << "# " << name << ": used " << ring.GetUsedBytes() << ", frames in flight " << ring.GetFramesInFlight() << '\n';
+			failures += ring.GetUsedBytes() == expected_used ? 0 : 1;
+		};
+
+		auto expect = [&](const char* name, uint64_t offset, uint64_t expected_offset, uint64_t expected_used)
+		{
+			output << "# " << name << ": offset " << static_cast<int64_t>(offset) << ", used " << ring.GetUsedBytes() << ", frames in flight " << ring.GetFramesInFlight() << '\n';
+			failures += offset == expected_offset && ring.GetUsedBytes() == expected_used ? 0 : 1;
+		};
+
+		auto invalid = RingAllocator::INVALID_OFFSET;
+		expect("first frame", ring.Allocate(300), 0, 512);
+		ring.FinishFrame(1);
+		expect("second frame", ring.Allocate(512), 512, 1024);
+		ring.FinishFrame(2);
+
+		ring.ReleaseCompletedFrames(0);
+		expect_used("nothing completed", 1024);
+		ring.ReleaseCompletedFrames(1);
+		expect_used("first frame completed", 512);
+
+		// 768 bytes are free but split by the second frame, which is still in flight
+		expect("overlapping the second frame", ring.Allocate(768), invalid, 512);
+
+		// The 256 bytes at the end are skipped and charged to the third frame with the range
+		expect("skipped to the start", ring.Allocate(512), 0, 1280);
+		expect("full", ring.Allocate(256), invalid, 1280);
+		ring.FinishFrame(3);
+
+		// Frames are released in fence order, the third frame frees the skipped bytes with its range
+		ring.ReleaseCompletedFrames(2);
+		expect_used("second frame completed", 768);
+		expect("between the head and the tail", ring.Allocate(512), 512, 1280);
+		ring.FinishFrame(4);
+
+		ring.ReleaseCompletedFrames(3);
+		expect_used("third frame completed", 512);
+		ring.ReleaseCompletedFrames(4);
+		expect_used("every frame completed", 0);
+		expect("started again from the beginning", ring.Allocate(1280), 0, 1280);
+
+		if (failures > 0 || ring.GetFramesInFlight() != 0)
+		{
+			output << "# ring allocations do not match\n";
+			return 1;
+		}
+
+		return 0;
+	}
+}
+
+int main()
+{
+	return RunRingAllocatorTest(std::cout);
+}
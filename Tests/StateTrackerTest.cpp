@@ -0,0 +1,126 @@
+#include "StateTracker.h"
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using Rove::ShaderStage;
+using Rove::SlotRange;
+using Rove::StateCacheStats;
+using Rove::StateTracker;
+
+namespace
+{
+	// Binds buffers and shader resources through a state tracker driving a mock context and checks the calls it lets
+	// through: repeated bindings dropped, changed buffers and offsets issued, everything issued again after an
+	// invalidate, untracked slots always issued and changed shader resources coalesced into one range
+	int RunStateTrackerTest(std::ostream& output)
+	{
+		// Context that records the calls let through by the tracker, which binds them the way DxStateCache does
+		struct MockContext
+		{
+			StateTracker tracker;
+			std::vector<std::string> calls;
+
+			void IASetVertexBuffer(uint32_t slot, const void* buffer, uint32_t stride, uint32_t offset)
+			{
+				if (tracker.SetVertexBuffer(slot, buffer, stride, offset))
+				{
+					calls.push_back("IASetVertexBuffers " + std::to_string(slot) + " " + std::to_string(offset));
+				}
+			}
+
+			void VSSetConstantBuffer1(uint32_t slot, const void* buffer, uint32_t first_constant, uint32_t constant_count)
+			{
+				if (tracker.SetConstantBuffer(ShaderStage::Vertex, slot, buffer, first_constant, constant_count))
+				{
+					calls.push_back("VSSetConstantBuffers1 " + std::to_string(slot) + " " + std::to_string(first_constant));
+				}
+			}
+
+			void PSSetShaderResources(uint32_t start_slot, uint32_t count, const int* const* views)
+			{
+				SlotRange range = tracker.SetShaderResources(ShaderStage::Pixel, start_slot, count, views);
+				if (range.count > 0)
+				{
+					calls.push_back("PSSetShaderResources " + std::to_string(range.first) + " " + std::to_string(range.count));
+				}
+			}
+		};
+
+		// Objects are only compared by address
+		int buffers[2] = {};
+		int textures[StateTracker::SHADER_RESOURCE_SLOTS + 2] = {};
+		const int* views[StateTracker::SHADER_RESOURCE_SLOTS + 2] = {};
+		for (uint32_t i = 0; i < StateTracker::SHADER_RESOURCE_SLOTS + 2; ++i)
+		{
+			views[i] = &textures[i];
+		}
+
+		MockContext context;
+		int failures = 0;
+		auto expect = [&](const char* name, const std::vector<std::string>& calls)
+		{
+			bool same = context.calls == calls;
+			output << "# " << name << ": " << context.calls.size() << " calls" << (same ? "" : ", expected " + std::to_string(calls.size())) << '\n';
+			failures += same ? 0 : 1;
+			context.calls.clear();
+		};
+
+		context.IASetVertexBuffer(0, &buffers[0], 32, 0);
+		context.VSSetConstantBuffer1(1, &buffers[0], 0, 16);
+		expect("first bindings issued", { "IASetVertexBuffers 0 0", "VSSetConstantBuffers1 1 0" });
+
+		context.IASetVertexBuffer(0, &buffers[0], 32, 0);
+		context.VSSetConstantBuffer1(1, &buffers[0], 0, 16);
+		expect("repeated bindings filtered", {});
+
+		context.IASetVertexBuffer(0, &buffers[1], 32, 0);
+		context.IASetVertexBuffer(0, &buffers[1], 32, 64);
+		context.VSSetConstantBuffer1(1, &buffers[0], 16, 16);
+		expect("changed buffer or offset issued", { "IASetVertexBuffers 0 0", "IASetVertexBuffers 0 64", "VSSetConstantBuffers1 1 16" });
+
+		context.tracker.Invalidate();
+		context.IASetVertexBuffer(0, &buffers[1], 32, 64);
+		expect("binding issued again after invalidate", { "IASetVertexBuffers 0 64" });
+
+		context.IASetVertexBuffer(StateTracker::VERTEX_BUFFER_SLOTS, &buffers[0], 32, 0);
+		context.IASetVertexBuffer(StateTracker::VERTEX_BUFFER_SLOTS, &buffers[0], 32, 0);
+		expect("untracked slot always issued", { "IASetVertexBuffers 4 0", "IASetVertexBuffers 4 0" });
+
+		// One call covers the first to the last changed slot, slots past the tracked ones are always part of it
+		context.PSSetShaderResources(0, StateTracker::SHADER_RESOURCE_SLOTS, views);
+		expect("every shader resource issued", { "PSSetShaderResources 0 8" });
+
+		std::swap(views[2], views[5]);
+		context.PSSetShaderResources(0, StateTracker::SHADER_RESOURCE_SLOTS, views);
+		expect("changed shader resources coalesced", { "PSSetShaderResources 2 4" });
+
+		context.PSSetShaderResources(0, StateTracker::SHADER_RESOURCE_SLOTS, views);
+		expect("repeated shader resources filtered", {});
+
+		views[3] = &textures[9];
+		context.PSSetShaderResources(0, StateTracker::SHADER_RESOURCE_SLOTS, views);
+		expect("single changed shader resource", { "PSSetShaderResources 3 1" });
+
+		context.PSSetShaderResources(6, 4, views + 6);
+		expect("untracked shader resources issued", { "PSSetShaderResources 8 2" });
+
+		const StateCacheStats& stats = context.tracker.GetStats();
+		output << "# issued " << stats.issued << ", filtered " << stats.filtered << ", buffer binds " << stats.buffer_binds << ", resource binds " << stats.resource_binds << '\n';
+		failures += stats.issued != 21 || stats.filtered != 25 || stats.buffer_binds != 8 || stats.resource_binds != 13 ? 1 : 0;
+
+		if (failures > 0)
+		{
+			output << "# state tracker bindings do not match\n";
+			return 1;
+		}
+
+		return 0;
+	}
+}
+
+int main()
+{
+	return RunStateTrackerTest(std::cout);
+}